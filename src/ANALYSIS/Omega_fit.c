@@ -17,7 +17,8 @@
 int
 omega_analysis( struct input_params *Input )
 {
-  init_phi3v2( 1000 ) ;
+  // one Phi3 bootstrap for each sample of the data we fit
+  init_phi3v2( Input -> Data.y[0].NSAMPLES ) ;
   set_phi3v2( 0 , true ) ;
 
   double chi = 0.0 ;
@@ -34,6 +34,9 @@ fit_alphas( struct input_params *Input )
 {
   test_running( ) ;
 
+  // the distributions are run off the tabulated flow from here on
+  init_running_tables( ) ;
+
   const double mu = 2.0 ;
 
   if( Input -> Fit.Fitdef == ALPHA_D0_MULTI ) {
@@ -131,6 +134,8 @@ fit_alphas( struct input_params *Input )
 	
   free( amz.resampled ) ;
 
+  free_running_tables( ) ;
+
   return SUCCESS ;
 }
 
@@ -12,6 +12,7 @@
 #include "CPCV.h"
 #include "decay_wilson.h"
 #include "fit_and_plot.h"
+#include "fit_scan.h"
 #include "exceptional.h"
 #include "general_ops.h"
 #include "HLBL.h"
@@ -107,6 +108,8 @@ an_wrapper( struct input_params *Input )
     return sun_set( Input ) ;
   case ZV :
     return ZV_analysis( Input ) ;
+  case FitScan :
+    return fit_scan( Input ) ;
   case Fit :
     //return nrqcd_baremass_analysis( Input ) ;
     //return c4c7_analysis( Input ) ;
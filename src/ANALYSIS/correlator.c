@@ -28,58 +28,66 @@
 
 //#define CDIV
 
+// correlator data for sample k, k == NSAMPLES is the average
+static void
+get_sample( double *dst ,
+	    const struct resampled *src ,
+	    const size_t Ndata ,
+	    const size_t k )
+{
+  size_t j ;
+  for( j = 0 ; j < Ndata ; j++ ) {
+    dst[ j ] = ( k == src[j].NSAMPLES ) ? src[j].avg : src[j].resampled[k] ;
+  }
+}
+
 void 
 my_little_prony( const struct input_params *Input )
 {
   make_xmgrace_graph( "MProny.agr" , "t/a" , "am\\seff" ) ;
   
   const size_t Nstates = Input -> Fit.N ;
-  size_t i , j , k , l , shift = 0 ;
+  size_t i , j , shift = 0 ;
   for( i = 0 ; i < Input -> Data.Nsim ; i++ ) {
 
     const size_t Ndata = Input -> Data.Ndata[i] ;
-    double data[ Ndata ] ;
-    double masses[ Nstates ][ Ndata ] ;
+    const size_t NSAMPLES = Input -> Data.x[shift].NSAMPLES ;
 
     struct resampled *effmass =
       malloc( Nstates * Ndata * sizeof( struct resampled ) ) ;
     for( j = 0 ; j < Nstates * Ndata ; j++ ) {
-      effmass[j] = init_dist( NULL , Input -> Data.x[shift].NSAMPLES ,
+      effmass[j] = init_dist( NULL , NSAMPLES ,
 			      Input -> Data.x[shift].restype ) ;
     }
-    
-    for( k = 0 ; k < Input -> Data.x[shift].NSAMPLES ; k++ ) {
-      for( j = shift ; j < shift + Ndata ; j++ ) {
-	data[ j - shift ] = Input -> Data.y[j].resampled[k] ;
-      }
-      
-      blackbox( data , Ndata , Nstates , masses ) ;
-      
-      for( l = 0 ; l < Nstates ; l++ ) {
-	for( j = 0 ; j < Ndata ; j++ ) {
-	  effmass[j + l*Ndata].resampled[k] = masses[l][j] ;
+
+    // samples and the average in parallel, k == NSAMPLES is the average
+    #pragma omp parallel
+    {
+      struct bb_temps *W = alloc_blackbox( Nstates ) ;
+      double data[ Ndata ] ;
+      double masses[ Nstates ][ Ndata ] ;
+      #pragma omp for schedule(dynamic)
+      for( size_t k = 0 ; k <= NSAMPLES ; k++ ) {
+	get_sample( data , Input -> Data.y + shift , Ndata , k ) ;
+	blackbox( data , Ndata , Nstates , masses , W ) ;
+	for( size_t l = 0 ; l < Nstates ; l++ ) {
+	  for( size_t t = 0 ; t < Ndata ; t++ ) {
+	    if( k == NSAMPLES ) {
+	      effmass[t + l*Ndata].avg = masses[l][t] ;
+	    } else {
+	      effmass[t + l*Ndata].resampled[k] = masses[l][t] ;
+	    }
+	  }
 	}
       }
-      printf( "[PRONY] Samples %1.2f percent done\n" ,
-	      100. * k/(double)Input->Data.x[shift].NSAMPLES ) ;
-    }
-
-    // same for the average
-    for( j = shift ; j < shift + Ndata ; j++ ) {
-      data[ j - shift ] = Input -> Data.y[j].avg ;
+      free_blackbox( W ) ;
     }
-    blackbox( data , Ndata , Nstates , masses ) ;
-    for( l = 0 ; l < Nstates ; l++ ) {
-      for( j = 0 ; j < Ndata ; j++ ) {
-	effmass[j + l*Ndata].avg = masses[l][j] ;
-      }
-    } 
     
     for( j = 0 ; j < Nstates * Ndata ; j++ ) {
       compute_err( &effmass[j] ) ;
     }
 
-    for( l = 0 ; l < Nstates ; l++ ) {
+    for( size_t l = 0 ; l < Nstates ; l++ ) {
       plot_data( Input -> Data.x + shift , effmass + l*Ndata ,
 		 Input -> Data.Ndata[i] ) ;
     }
@@ -111,58 +119,68 @@ write_fitmass_graph( FILE *file ,
 void 
 boot_pade_laplace( const struct input_params *Input )
 {
-  // do the average first
-  size_t i , j , k , shift = 0 ;
+  // taylor expansion points
+  const size_t Np = 20 ;
+  double p0[ Np ] ;
+  size_t i , j , p , shift = 0 ;
+  for( p = 0 ; p < Np ; p++ ) {
+    p0[ p ] = 0.25 * p ;
+  }
+  const size_t Npars = 2 * Input -> Fit.N ;
+
   for( i = 0 ; i < Input -> Data.Nsim ; i++ ) {
-    double p0 ;
     const size_t Ndata = Input -> Data.Ndata[i] ;
-    double y[ Ndata ] , x[ Ndata ] ;
-    double fparams[ 2*Input -> Fit.N ] ;
-    struct resampled *poles = malloc( Input -> Fit.N * 2 * sizeof( struct resampled ) ) ;
+    const size_t NSAMPLES = Input -> Data.x[shift].NSAMPLES ;
 
-    // loop taylor expansion point
-    for( p0 = 0.0 ; p0 < 5.0 ; p0 += 0.25 ) {
+    // poles[ j + Npars*p ] is parameter j at expansion point p
+    struct resampled *poles = malloc( Npars * Np * sizeof( struct resampled ) ) ;
+    for( j = 0 ; j < Npars * Np ; j++ ) {
+      poles[ j ] = init_dist( NULL , NSAMPLES ,
+			      Input -> Data.x[shift].restype ) ;
+    }
 
-      for( j = 0 ; j < Input -> Fit.N * 2 ; j++ ) {
-	poles[ j ] = init_dist( NULL ,
-				Input -> Data.x[shift].NSAMPLES ,
-				Input -> Data.x[shift].restype ) ;
+    // every p0 from one read of the correlator, k == NSAMPLES is the average
+    #pragma omp parallel
+    {
+      double y[ Ndata ] , x[ Ndata ] ;
+      double fparams[ Np ][ Npars ] , *fp[ Np ] ;
+      for( size_t q = 0 ; q < Np ; q++ ) {
+	fp[ q ] = fparams[ q ] ;
       }
-      
-      size_t idx = 0 ;
-      // loop N samples
-      for( k = 0 ; k < Input -> Data.x[shift].NSAMPLES ; k++ ) {
-	idx = 0 ;
-	for( j = shift ; j < shift + Ndata ; j++ ) {
-	  x[ idx ] = Input -> Data.x[ j ].resampled[k] ;
-	  y[ idx ] = Input -> Data.y[ j ].resampled[k] ;
-	  idx++ ;
+      #pragma omp for schedule(dynamic)
+      for( size_t k = 0 ; k <= NSAMPLES ; k++ ) {
+	get_sample( x , Input -> Data.x + shift , Ndata , k ) ;
+	get_sample( y , Input -> Data.y + shift , Ndata , k ) ;
+	for( size_t q = 0 ; q < Np ; q++ ) {
+	  for( size_t l = 0 ; l < Npars ; l++ ) {
+	    fparams[q][l] = sqrt(-1) ;
+	  }
 	}
-	pade_laplace( fparams , x , y , Ndata , Input -> Fit.N , p0 ) ;
+	pade_laplace_scan( fp , x , y , Ndata , Input -> Fit.N , p0 , Np ) ;
 	// equate fparams to our resampled data
-	for( j = 0 ; j < 2*Input -> Fit.N ; j++ ) {
-	  poles[j].resampled[k] = fparams[j] ;
+	for( size_t q = 0 ; q < Np ; q++ ) {
+	  for( size_t l = 0 ; l < Npars ; l++ ) {
+	    if( k == NSAMPLES ) {
+	      poles[ l + Npars*q ].avg = fparams[q][l] ;
+	    } else {
+	      poles[ l + Npars*q ].resampled[k] = fparams[q][l] ;
+	    }
+	  }
 	}
       }
-      // do the average too
-      idx = 0 ;
-      for( j = shift ; j < shift + Ndata ; j++ ) {
-	x[ idx ] = Input -> Data.x[ j ].avg ;
-	y[ idx ] = Input -> Data.y[ j ].avg ;
-	idx++ ;
-      }
-      pade_laplace( fparams , x , y , Ndata , Input -> Fit.N , p0 ) ;
-      for( j = 0 ; j < 2*Input -> Fit.N ; j++ ) {
-	poles[j].avg = fparams[j] ;
-	compute_err( &poles[j] ) ;
+    }
 
-	printf( "[PLAP] %f PARAM_%zu %e %e \n" , p0 , j , poles[j].avg , poles[j].err ) ;
+    for( p = 0 ; p < Np ; p++ ) {
+      for( j = 0 ; j < Npars ; j++ ) {
+	compute_err( &poles[ j + Npars*p ] ) ;
+	printf( "[PLAP] %f PARAM_%zu %e %e \n" , p0[p] , j ,
+		poles[ j + Npars*p ].avg , poles[ j + Npars*p ].err ) ;
       }
       printf( "\n" ) ;
     }
 
     shift += Ndata ;
-    for( j = 0 ; j < 2*Input -> Fit.N ; j++ ) {
+    for( j = 0 ; j < Npars * Np ; j++ ) {
       free( poles[j].resampled ) ;
     }
     free( poles ) ;
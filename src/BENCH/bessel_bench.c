@@ -0,0 +1,159 @@
+/**
+   @file bessel_bench.c
+   @brief microbenchmark of the batched K_0, K_1 against GSL
+
+   Times and compares bessel_K01_array with gsl_sf_bessel_K0/K1 over
+   the argument ranges the fits use, and the finite volume shell sums
+   computed with GSL, with the batched kernels and from the tables.
+   Build with "make bessel_bench" and run it without arguments
+ */
+#include "gens.h"
+
+#include "bessel.h"
+#include "fv_bessel.h"
+
+#include <gsl/gsl_sf_bessel.h>
+#include <time.h>
+
+// arguments per range and how many times we go over them
+#define NARGS (1<<14)
+#define NREPS (50)
+
+static double
+now( void )
+{
+  struct timespec t ;
+  clock_gettime( CLOCK_MONOTONIC , &t ) ;
+  return t.tv_sec + 1E-9*t.tv_nsec ;
+}
+
+// the twelve shell K1 sum done one scalar at a time with GSL
+static double
+gsl_shell_K1( const double x )
+{
+  const double sr[ 12 ] = { 1.0 , 1.4142135623730951 , 1.7320508075688772 , 2.0 ,
+			    2.23606797749979 , 2.449489742783178 , 2.8284271247461903 ,
+			    3.0 , 3.1622776601683795 , 3.3166247903554 ,
+			    3.4641016151377544 , 3.605551275463989 } ;
+  const double m[ 12 ] = { 6 , 12 , 8 , 6 , 24 , 24 , 12 , 30 , 24 , 24 , 8 , 24 } ;
+  register double sum = 0.0 ;
+  size_t i ;
+  for( i = 0 ; i < 12 ; i++ ) {
+    sum += m[i]*gsl_sf_bessel_K1( sr[i]*x )/sr[i] ;
+  }
+  return sum ;
+}
+
+static void
+bench_range( const double xlo ,
+	     const double xhi ,
+	     double *x ,
+	     double *K0 ,
+	     double *K1 )
+{
+  size_t i , r ;
+  for( i = 0 ; i < NARGS ; i++ ) {
+    x[i] = xlo + ( xhi - xlo )*( i + 0.5 )/NARGS ;
+  }
+
+  // GSL one at a time
+  double g0 = 0.0 , g1 = 0.0 ;
+  double t = now() ;
+  for( r = 0 ; r < NREPS ; r++ ) {
+    for( i = 0 ; i < NARGS ; i++ ) {
+      g0 += gsl_sf_bessel_K0( x[i] ) ;
+      g1 += gsl_sf_bessel_K1( x[i] ) ;
+    }
+  }
+  const double tgsl = ( now() - t )/( NREPS*(double)NARGS ) ;
+
+  t = now() ;
+  for( r = 0 ; r < NREPS ; r++ ) {
+    bessel_K01_array( K0 , K1 , x , NARGS , false ) ;
+  }
+  const double tbatch = ( now() - t )/( NREPS*(double)NARGS ) ;
+
+  // accuracy, relative to GSL which quotes ~1E-15 itself
+  double err0 = 0.0 , err1 = 0.0 ;
+  for( i = 0 ; i < NARGS ; i++ ) {
+    const double k0 = gsl_sf_bessel_K0( x[i] ) , k1 = gsl_sf_bessel_K1( x[i] ) ;
+    const double e0 = fabs( K0[i] - k0 )/k0 , e1 = fabs( K1[i] - k1 )/k1 ;
+    if( !( e0 <= err0 ) ) err0 = e0 ;
+    if( !( e1 <= err1 ) ) err1 = e1 ;
+  }
+  fprintf( stdout , "[BESSEL] x in [%5.1f,%5.1f] GSL %7.2f ns batch %7.2f ns"
+	   " speedup %5.2f | max rel diff K0 %.2e K1 %.2e (%g)\n" ,
+	   xlo , xhi , 1E9*tgsl , 1E9*tbatch , tgsl/tbatch , err0 , err1 ,
+	   g0 + g1 ) ;
+  return ;
+}
+
+static void
+bench_shells( const double xlo ,
+	      const double xhi )
+{
+  size_t i , r ;
+  double sum = 0.0 , t , err = 0.0 , errtab = 0.0 ;
+  double tm[3] ;
+
+  t = now() ;
+  for( r = 0 ; r < NREPS ; r++ ) {
+    for( i = 0 ; i < NARGS ; i++ ) {
+      sum += gsl_shell_K1( xlo + ( xhi - xlo )*( i + 0.5 )/NARGS ) ;
+    }
+  }
+  tm[0] = ( now() - t )/( NREPS*(double)NARGS ) ;
+
+  t = now() ;
+  for( r = 0 ; r < NREPS ; r++ ) {
+    for( i = 0 ; i < NARGS ; i++ ) {
+      sum += fv_bessel_sum_direct( FV_K1 , xlo + ( xhi - xlo )*( i + 0.5 )/NARGS ) ;
+    }
+  }
+  tm[1] = ( now() - t )/( NREPS*(double)NARGS ) ;
+
+  t = now() ;
+  for( r = 0 ; r < NREPS ; r++ ) {
+    for( i = 0 ; i < NARGS ; i++ ) {
+      sum += fv_bessel_sum( FV_K1 , xlo + ( xhi - xlo )*( i + 0.5 )/NARGS ) ;
+    }
+  }
+  tm[2] = ( now() - t )/( NREPS*(double)NARGS ) ;
+
+  for( i = 0 ; i < NARGS ; i++ ) {
+    const double x = xlo + ( xhi - xlo )*( i + 0.5 )/NARGS ;
+    const double ref = gsl_shell_K1( x ) ;
+    const double e1 = fabs( fv_bessel_sum_direct( FV_K1 , x ) - ref )/ref ;
+    const double e2 = fabs( fv_bessel_sum( FV_K1 , x ) - ref )/ref ;
+    if( !( e1 <= err ) ) err = e1 ;
+    if( !( e2 <= errtab ) ) errtab = e2 ;
+  }
+  fprintf( stdout , "[SHELLS] mL in [%5.1f,%5.1f] GSL %7.2f ns batch %7.2f ns"
+	   " table %7.2f ns | max rel diff batch %.2e table %.2e (%g)\n" ,
+	   xlo , xhi , 1E9*tm[0] , 1E9*tm[1] , 1E9*tm[2] , err , errtab , sum ) ;
+  return ;
+}
+
+int
+main( void )
+{
+  double *x  = malloc( NARGS * sizeof( double ) ) ;
+  double *K0 = malloc( NARGS * sizeof( double ) ) ;
+  double *K1 = malloc( NARGS * sizeof( double ) ) ;
+
+  bench_range( 0.05 , 2.0 , x , K0 , K1 ) ;
+  bench_range( 2.0 , 10.0 , x , K0 , K1 ) ;
+  bench_range( 10.0 , 60.0 , x , K0 , K1 ) ;
+
+  if( init_fv_bessel( 1E-13 ) == FAILURE ) {
+    fprintf( stderr , "[SHELLS] tables failed, timing the direct sums\n" ) ;
+  }
+  bench_shells( 2.0 , 8.0 ) ;
+  bench_shells( 8.0 , 40.0 ) ;
+  free_fv_bessel() ;
+
+  free( x ) ;
+  free( K0 ) ;
+  free( K1 ) ;
+  return 0 ;
+}
@@ -0,0 +1,610 @@
+/**
+   @file fit_conformance.c
+   @brief checks of the fit models and of the minimizers on each of them
+
+   For every fittype the analytic dF is compared with central
+   differences of F, and d2F with central differences of dF, at random
+   parameters. Then fake data is generated for each model from random
+   true parameters and fitted from perturbed starts with every
+   minimizer that supports the model. A fit has converged if it reaches
+   a chisq no larger than that of the true parameters, which is where a
+   fit to data with little noise should end up.
+
+   Each check runs in its own process with a time limit so that a model
+   or minimizer that crashes or hangs only costs its own row. Rows go
+   to stdout, tab separated, anything the fits print goes to /dev/null.
+   Models that need a per-sample context set up from data (FVOL_DELTA)
+   are skipped. The exit status is non-zero if a derivative check
+   failed or a check crashed.
+
+   Build with "make fit_conformance" and run as
+
+   ./fit_conformance [-t Ntrials] [-T timeout] [-f MODEL] [-m MINIMIZER] [-d]
+
+   where -d only does the derivative checks
+ */
+#include "gens.h"
+
+#include "BFGS.h"
+#include "CG.h"
+#include "chisq.h"
+#include "correlation.h"
+#include "fake.h"
+#include "ffunction.h"
+#include "fit_chooser.h"
+#include "GA.h"
+#include "GLS.h"
+#include "GLS_pade.h"
+#include "LM.h"
+#include "pmap.h"
+#include "powell.h"
+#include "SD.h"
+#include "Simplex.h"
+#include "VarPro.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// bump this if the columns change
+#define CONF_FORMAT (1)
+
+#define CONF_SEED (20240611)
+
+// points, time extent and measurements of the test data
+#define CONF_NDATA (12)
+#define CONF_LT (32)
+#define CONF_NMEAS (32)
+#define CONF_YSIGMA (1E-3)
+
+// true parameters are drawn from [PLO,PHI]
+#define CONF_PLO (0.2)
+#define CONF_PHI (1.0)
+
+// relative spread of the starting points about the true parameters
+#define CONF_SPREAD (0.1)
+
+// allowed relative differences with the finite differences
+#define CONF_DFTOL (1E-5)
+#define CONF_D2FTOL (1E-4)
+
+// random points for the derivative checks
+#define CONF_NPOINTS (3)
+
+#define NAME( x ) [ x ] = #x
+
+static const char *model_names[ TEST + 1 ] = {
+  NAME( ALPHA_D0 ) , NAME( ALPHA_D0_MULTI ) , NAME( ADLERALPHA_D0 ) ,
+  NAME( ADLERALPHA_D0_MULTI ) , NAME( HALEXP ) , NAME( EXP ) ,
+  NAME( EXP_XINV ) , NAME( COSH ) , NAME( COSH_ASYMM ) ,
+  NAME( COSH_PLUSC ) , NAME( EXP_PLUSC ) , NAME( HLBL_CONT ) ,
+  NAME( NRQCD_EXP ) , NAME( NRQCD_EXP2 ) , NAME( NOFIT ) , NAME( PADE ) ,
+  NAME( PEXP ) , NAME( POLY ) , NAME( PP_AA ) , NAME( PP_AA_WW ) ,
+  NAME( PP_AA_WW_R2 ) , NAME( PP_AA_EXP ) , NAME( PPAA ) ,
+  NAME( QCORR_BESSEL ) , NAME( QSUSC_SU2 ) , NAME( SINH ) , NAME( TANH ) ,
+  NAME( POLES ) , NAME( QSLAB ) , NAME( QSLAB_FIXED ) , NAME( CORNELL ) ,
+  NAME( CORNELL_V2 ) , NAME( FVOL1 ) , NAME( FVOL2 ) , NAME( FVOL3 ) ,
+  NAME( FVOL4 ) , NAME( FVOL5 ) , NAME( FVOL6 ) , NAME( UDCB_HEAVY ) ,
+  NAME( C4C7 ) , NAME( SOL ) , NAME( SOL2 ) , NAME( SU2_SHITFIT ) ,
+  NAME( SUN_CONT ) , NAME( ZV_EXP ) , NAME( FVOLCC ) , NAME( LARGENB ) ,
+  NAME( FVOL_DELTA ) , NAME( TEST ) } ;
+
+#undef NAME
+
+struct minimizer {
+  const char *Name ;
+  int (*Minimize) ( void *fdesc ,
+		    const void *data ,
+		    const double **W ,
+		    const double TOL ) ;
+} ;
+
+// same names as FitMin in the input file
+static const struct minimizer minimizers[] = {
+  { "LM" , lm_iter } , { "CG" , cg_iter } , { "SD" , sd_iter } ,
+  { "BFGS" , BFGS_iter } , { "POWELL" , powell_iter } ,
+  { "SIMPLEX" , simplex_iter } , { "GA" , ga_iter } , { "GLS" , gls_iter } ,
+  { "GLS_pade" , gls_pade_iter } , { "VARPRO" , vp_iter } } ;
+
+#define NMIN ( sizeof( minimizers )/sizeof( minimizers[0] ) )
+
+struct conformance {
+  size_t Ntrials ;
+  unsigned Timeout ;
+  const char *Model ;
+  const char *Min ;
+  bool Derivs_Only ;
+  FILE *out ;
+} ;
+
+// what a child process is asked to do
+struct job {
+  fittype Fitdef ;
+  size_t Min ;
+  size_t Ntrials ;
+} ;
+
+static double
+now( void )
+{
+  struct timespec t ;
+  clock_gettime( CLOCK_MONOTONIC , &t ) ;
+  return t.tv_sec + 1E-9*t.tv_nsec ;
+}
+
+// one simulation with the lowest N and M a model supports
+static struct fit_info
+conformance_fit( const fittype Fitdef )
+{
+  struct fit_info Fit ;
+  memset( &Fit , 0 , sizeof( struct fit_info ) ) ;
+  Fit.Fitdef = Fitdef ;
+  Fit.Corrfit = UNCORRELATED ;
+  Fit.N = Fit.M = 1 ;
+  Fit.Nparam = get_Nparam( Fit ) ;
+  Fit.Nlogic = Fit.Nparam ;
+  Fit.Sims = calloc( Fit.Nparam , sizeof( bool ) ) ;
+  Fit.Prior = malloc( Fit.Nlogic * sizeof( struct prior ) ) ;
+  size_t i ;
+  for( i = 0 ; i < Fit.Nlogic ; i++ ) {
+    Fit.Prior[i].Initialised = false ;
+    Fit.Prior[i].Val = Fit.Prior[i].Err = UNINIT_FLAG ;
+  }
+  Fit.GA = ga_defaults() ;
+  Fit.Tol = 1E-8 ;
+  Fit.Nstarts = 1 ;
+  return Fit ;
+}
+
+static void
+free_conformance_fit( struct fit_info *Fit )
+{
+  free( Fit -> Sims ) ;
+  free( Fit -> Prior ) ;
+  return ;
+}
+
+// models like FVOL_DELTA need a context set up from data before they
+// can even be evaluated
+static bool
+needs_ctx( const struct fit_info Fit )
+{
+  struct data_info Probe ;
+  memset( &Probe , 0 , sizeof( struct data_info ) ) ;
+  Probe.Ntot = 1 ;
+  struct fit_descriptor fdesc = init_fit( Probe , Fit ) ;
+  const bool ctx = fdesc.ctx != NULL ;
+  free_ffunction( &fdesc.f , fdesc.Nlogic ) ;
+  return ctx ;
+}
+
+// largest relative difference of a and its finite difference estimate
+// b, relative to the size of the model if b is small
+static double
+rel_diff( const double a ,
+	  const double b ,
+	  const double scale )
+{
+  const double d = fabs( a - b ) / ( fabs( b ) + 1E-7*scale ) ;
+  return isfinite( d ) ? d : HUGE_VAL ;
+}
+
+// dF against central differences of F and d2F against those of dF
+static int
+check_derivs( FILE *p ,
+	      const struct job J )
+{
+  struct fit_info Fit = conformance_fit( J.Fitdef ) ;
+  const size_t Np = Fit.Nlogic , n = CONF_NDATA ;
+  size_t Ndata[ 1 ] = { n } , LT[ n ] , i , j , k , pt ;
+  double x[ n ] , y[ n ] ;
+  for( i = 0 ; i < n ; i++ ) {
+    x[i] = i + 1 ;
+    y[i] = 0.0 ;
+    LT[i] = CONF_LT ;
+  }
+  struct data_info Data ;
+  memset( &Data , 0 , sizeof( struct data_info ) ) ;
+  Data.Nsim = 1 ; Data.Ndata = Ndata ; Data.Ntot = n ; Data.LT = LT ;
+  Fit.map = parammap( Data , Fit ) ;
+
+  struct fit_descriptor fdesc = init_fit( Data , Fit ) ;
+  int flag = SUCCESS ;
+  if( fdesc.ctx != NULL || fdesc.F == NULL ||
+      fdesc.dF == NULL || fdesc.d2F == NULL ) {
+    fprintf( p , "derivs\t%s\t%zu\tnan\tnan\tskipped\n" ,
+	     model_names[ J.Fitdef ] , Np ) ;
+    goto end ;
+  }
+
+  struct data d = { n , x , y , LT , fdesc.Nparam , Fit.map ,
+		    Fit.N , Fit.M , NULL } ;
+  struct ffunction fp = allocate_ffunction( Np , n ) ;
+  struct ffunction fm = allocate_ffunction( Np , n ) ;
+  double **df = fdesc.f.df , **d2f = fdesc.f.d2f ;
+  double errdf = 0.0 , errd2f = 0.0 ;
+
+  gsl_rng *r = gsl_rng_alloc( gsl_rng_mt19937 ) ;
+  gsl_rng_set( r , CONF_SEED + J.Fitdef ) ;
+  for( pt = 0 ; pt < CONF_NPOINTS ; pt++ ) {
+    double par[ Np ] ;
+    for( j = 0 ; j < Np ; j++ ) {
+      par[j] = CONF_PLO + ( CONF_PHI - CONF_PLO )*gsl_rng_uniform( r ) ;
+    }
+    fdesc.F( fdesc.f.f , &d , par ) ;
+    fdesc.dF( df , &d , par ) ;
+    fdesc.d2F( d2f , &d , par ) ;
+    double scale = 0.0 ;
+    for( i = 0 ; i < n ; i++ ) {
+      if( fabs( fdesc.f.f[i] ) > scale ) scale = fabs( fdesc.f.f[i] ) ;
+    }
+
+    for( j = 0 ; j < Np ; j++ ) {
+      const double h = 1E-5*fabs( par[j] ) ;
+      double pp[ Np ] , pm[ Np ] ;
+      memcpy( pp , par , Np*sizeof( double ) ) ;
+      memcpy( pm , par , Np*sizeof( double ) ) ;
+      pp[j] += h ;
+      pm[j] -= h ;
+      fdesc.F( fp.f , &d , pp ) ;
+      fdesc.F( fm.f , &d , pm ) ;
+      fdesc.dF( fp.df , &d , pp ) ;
+      fdesc.dF( fm.df , &d , pm ) ;
+      for( i = 0 ; i < n ; i++ ) {
+	const double e = rel_diff( df[j][i] , ( fp.f[i] - fm.f[i] )/( 2*h ) ,
+				   scale ) ;
+	if( !( e <= errdf ) ) errdf = e ;
+	// column j of the hessian from the change of every dF_k
+	for( k = 0 ; k < Np ; k++ ) {
+	  const double e2 = rel_diff( d2f[ k + Np*j ][i] ,
+				      ( fp.df[k][i] - fm.df[k][i] )/( 2*h ) ,
+				      scale ) ;
+	  if( !( e2 <= errd2f ) ) errd2f = e2 ;
+	}
+      }
+    }
+  }
+  gsl_rng_free( r ) ;
+
+  const char *status = "ok" ;
+  if( errdf > CONF_DFTOL ) {
+    status = "dF" ; flag = FAILURE ;
+  } else if( errd2f > CONF_D2FTOL ) {
+    status = "d2F" ; flag = FAILURE ;
+  }
+  fprintf( p , "derivs\t%s\t%zu\t%.3e\t%.3e\t%s\n" ,
+	   model_names[ J.Fitdef ] , Np , errdf , errd2f , status ) ;
+
+  free_ffunction( &fp , Np ) ;
+  free_ffunction( &fm , Np ) ;
+ end :
+  free_ffunction( &fdesc.f , fdesc.Nlogic ) ;
+  free_pmap( Fit.map , n ) ;
+  free_conformance_fit( &Fit ) ;
+  return flag ;
+}
+
+// counting wrappers around the model, only ever one model per process
+static void (*real_F) ( double* , const void* , const double* ) ;
+static void (*real_dF) ( double** , const void* , const double* ) ;
+static void (*real_d2F) ( double** , const void* , const double* ) ;
+static void (*real_FdF) ( double* , double** , double** ,
+			  const void* , const double* ) ;
+static size_t NF = 0 , NDF = 0 ;
+
+static void
+count_F( double *f , const void *data , const double *fparams )
+{
+  #pragma omp atomic
+  NF++ ;
+  real_F( f , data , fparams ) ;
+}
+
+static void
+count_dF( double **df , const void *data , const double *fparams )
+{
+  #pragma omp atomic
+  NDF++ ;
+  real_dF( df , data , fparams ) ;
+}
+
+static void
+count_d2F( double **d2f , const void *data , const double *fparams )
+{
+  #pragma omp atomic
+  NDF++ ;
+  real_d2F( d2f , data , fparams ) ;
+}
+
+static void
+count_FdF( double *f , double **df , double **d2f ,
+	   const void *data , const double *fparams )
+{
+  #pragma omp atomic
+  NF++ ;
+  if( df != NULL ) {
+    #pragma omp atomic
+    NDF++ ;
+  }
+  real_FdF( f , df , d2f , data , fparams ) ;
+}
+
+static double
+chisq_at( struct fit_descriptor *fdesc ,
+	  const struct data *d ,
+	  const double **W ,
+	  const double *par )
+{
+  memcpy( fdesc -> f.fparams , par , fdesc -> Nlogic*sizeof( double ) ) ;
+  invalidate_ffunction( &fdesc -> f ) ;
+  fdesc -> f.Prior = fdesc -> Prior ;
+  real_F( fdesc -> f.f , d , par ) ;
+  return compute_chisq( fdesc -> f , W , fdesc -> f.CORRFIT ) ;
+}
+
+// fits of fake data from Ntrials perturbed starting points
+static int
+check_fits( FILE *p ,
+	    const struct job J )
+{
+  struct fit_info Fit = conformance_fit( J.Fitdef ) ;
+  const size_t Np = Fit.Nlogic ;
+  const struct minimizer Min = minimizers[ J.Min ] ;
+  Fit.Minimize = Min.Minimize ;
+  if( needs_ctx( Fit ) ) {
+    fprintf( p , "fits\t%s\t%s\t%zu\t0\tnan\tnan\tnan\tnan\tskipped\n" ,
+	     model_names[ J.Fitdef ] , Min.Name , J.Ntrials ) ;
+    free_conformance_fit( &Fit ) ;
+    return SUCCESS ;
+  }
+
+  size_t Dims[ 4 ] = { CONF_LT , CONF_LT , CONF_LT , CONF_LT } , i , t ;
+  struct traj Traj ;
+  memset( &Traj , 0 , sizeof( struct traj ) ) ;
+  Traj.Dimensions = Dims ;
+  Traj.Nd = 4 ;
+
+  gsl_rng *r = gsl_rng_alloc( gsl_rng_mt19937 ) ;
+  gsl_rng_set( r , CONF_SEED + J.Fitdef ) ;
+  double truth[ Np ] ;
+  for( i = 0 ; i < Np ; i++ ) {
+    truth[i] = CONF_PLO + ( CONF_PHI - CONF_PLO )*gsl_rng_uniform( r ) ;
+  }
+
+  struct data_info Data ;
+  memset( &Data , 0 , sizeof( struct data_info ) ) ;
+  Data.Nsim = 1 ;
+  Data.Cov.Estimator = SAMPLE_COV ;
+  Data.Cov.Eigenvalue_Tol = 1E-8 ;
+  const struct fake_ensemble E = { .Ndata = CONF_NDATA , .X0 = 1.0 ,
+				   .Nmeas = CONF_NMEAS , .Xsigma = 0.0 ,
+				   .Ysigma = CONF_YSIGMA , .Rho = 0.0 ,
+				   .Params = truth , .Seed = CONF_SEED ,
+				   .Verbose = false } ;
+  generate_fake_ensemble( &Data , Fit , &Traj , E ) ;
+  Fit.map = parammap( Data , Fit ) ;
+
+  const size_t n = Data.Ntot ;
+  double x[ n ] , y[ n ] ;
+  bool finite = true ;
+  for( i = 0 ; i < n ; i++ ) {
+    x[i] = Data.x[i].avg ;
+    y[i] = Data.y[i].avg ;
+    finite = finite && isfinite( y[i] ) && Data.y[i].err > 0 ;
+  }
+
+  struct fit_descriptor fdesc = init_fit( Data , Fit ) ;
+  fdesc.Prior = Fit.Prior ;
+  real_F = fdesc.F ; real_dF = fdesc.dF ;
+  real_d2F = fdesc.d2F ; real_FdF = fdesc.FdF ;
+
+  if( !finite ) {
+    fprintf( p , "fits\t%s\t%s\t%zu\t0\tnan\tnan\tnan\tnan\tbad_data\n" ,
+	     model_names[ J.Fitdef ] , Min.Name , J.Ntrials ) ;
+    goto end ;
+  }
+  if( fdesc.F != NULL ) fdesc.F = count_F ;
+  if( fdesc.dF != NULL ) fdesc.dF = count_dF ;
+  if( fdesc.d2F != NULL ) fdesc.d2F = count_d2F ;
+  if( fdesc.FdF != NULL ) fdesc.FdF = count_FdF ;
+
+  inverse_correlation( &Data , Fit ) ;
+  const double **W = (const double**)Data.Cov.W ;
+  struct data d = { n , x , y , Data.LT , fdesc.Nparam , Fit.map ,
+		    Fit.N , Fit.M , NULL } ;
+
+  const double chi_true = chisq_at( &fdesc , &d , W , truth ) ;
+  size_t Nconv = 0 , iters = 0 ;
+  double time = 0.0 ;
+  for( t = 0 ; t < J.Ntrials ; t++ ) {
+    double start[ Np ] ;
+    for( i = 0 ; i < Np ; i++ ) {
+      start[i] = truth[i]*( 1 + gsl_ran_gaussian( r , CONF_SPREAD ) ) ;
+    }
+    memcpy( fdesc.f.fparams , start , Np*sizeof( double ) ) ;
+    invalidate_ffunction( &fdesc.f ) ;
+    const double t1 = now() ;
+    const int ret = Fit.Minimize( &fdesc , &d , W , Fit.Tol ) ;
+    time += now() - t1 ;
+    iters += ret > 0 ? (size_t)ret : 0 ;
+
+    double res[ Np ] ;
+    memcpy( res , fdesc.f.fparams , Np*sizeof( double ) ) ;
+    const double chi = chisq_at( &fdesc , &d , W , res ) ;
+    if( isfinite( chi ) && chi <= chi_true*( 1 + 1E-3 ) + 1E-8 ) {
+      Nconv++ ;
+    }
+  }
+  fprintf( p , "fits\t%s\t%s\t%zu\t%zu\t%.1f\t%.1f\t%.1f\t%.3e\t%s\n" ,
+	   model_names[ J.Fitdef ] , Min.Name , J.Ntrials , Nconv ,
+	   iters/(double)J.Ntrials , NF/(double)J.Ntrials ,
+	   NDF/(double)J.Ntrials , time/J.Ntrials ,
+	   Nconv == J.Ntrials ? "ok" : ( Nconv ? "partial" : "unconverged" ) ) ;
+
+  for( i = 0 ; i < ( Fit.Corrfit == CORRELATED ? n : 1 ) ; i++ ) {
+    free( Data.Cov.W[i] ) ;
+  }
+  free( Data.Cov.W ) ;
+ end :
+  gsl_rng_free( r ) ;
+  free_ffunction( &fdesc.f , fdesc.Nlogic ) ;
+  free_pmap( Fit.map , n ) ;
+  for( i = 0 ; i < n ; i++ ) {
+    free( Data.x[i].resampled ) ;
+    free( Data.y[i].resampled ) ;
+  }
+  free( Data.x ) ;
+  free( Data.y ) ;
+  free( Data.Ndata ) ;
+  free( Data.LT ) ;
+  free_conformance_fit( &Fit ) ;
+  return SUCCESS ;
+}
+
+// runs a check in a child process that writes its row down a pipe, if
+// it dies or runs out of time we write the row here with fill for the
+// numbers it would have given. FAILURE if the check failed or died
+static int
+isolate( const struct conformance C ,
+	 int (*check)( FILE *p , const struct job J ) ,
+	 const struct job J ,
+	 const char *head ,
+	 const char *fill )
+{
+  int fd[2] ;
+  if( pipe( fd ) == -1 ) {
+    fprintf( stderr , "[CONFORMANCE] pipe failed\n" ) ;
+    return FAILURE ;
+  }
+  fflush( C.out ) ;
+  fflush( stdout ) ;
+  const pid_t pid = fork() ;
+  if( pid == -1 ) {
+    fprintf( stderr , "[CONFORMANCE] fork failed\n" ) ;
+    close( fd[0] ) ;
+    close( fd[1] ) ;
+    return FAILURE ;
+  }
+  if( pid == 0 ) {
+    close( fd[0] ) ;
+    FILE *p = fdopen( fd[1] , "w" ) ;
+    alarm( C.Timeout ) ;
+    const int flag = check( p , J ) ;
+    fclose( p ) ;
+    _exit( flag == SUCCESS ? 0 : 2 ) ;
+  }
+  close( fd[1] ) ;
+
+  char buf[ 1024 ] ;
+  size_t Nbuf = 0 ;
+  ssize_t got ;
+  while( ( got = read( fd[0] , buf + Nbuf , sizeof( buf ) - Nbuf ) ) > 0 ) {
+    Nbuf += got ;
+    if( Nbuf == sizeof( buf ) ) break ;
+  }
+  close( fd[0] ) ;
+
+  int status ;
+  waitpid( pid , &status , 0 ) ;
+  if( WIFEXITED( status ) && Nbuf > 0 ) {
+    fwrite( buf , 1 , Nbuf , C.out ) ;
+    return WEXITSTATUS( status ) == 0 ? SUCCESS : FAILURE ;
+  }
+  if( WIFSIGNALED( status ) && WTERMSIG( status ) == SIGALRM ) {
+    fprintf( C.out , "%s\t%s\ttimeout\n" , head , fill ) ;
+  } else if( WIFSIGNALED( status ) ) {
+    fprintf( C.out , "%s\t%s\tcrashed(%s)\n" , head , fill ,
+	     strsignal( WTERMSIG( status ) ) ) ;
+  } else {
+    fprintf( C.out , "%s\t%s\tno_output\n" , head , fill ) ;
+  }
+  return FAILURE ;
+}
+
+static void
+usage( const char *prog )
+{
+  fprintf( stderr , "USAGE :: %s [-t Ntrials] [-T timeout] [-f MODEL] "
+	   "[-m MINIMIZER] [-d]\n" , prog ) ;
+  return ;
+}
+
+int
+main( int argc , char *argv[] )
+{
+  struct conformance C = { .Ntrials = 4 , .Timeout = 60 , .Model = NULL ,
+			   .Min = NULL , .Derivs_Only = false , .out = NULL } ;
+  int opt ;
+  while( ( opt = getopt( argc , argv , "t:T:f:m:d" ) ) != -1 ) {
+    switch( opt ) {
+    case 't' : C.Ntrials = strtoul( optarg , NULL , 10 ) ; break ;
+    case 'T' : C.Timeout = strtoul( optarg , NULL , 10 ) ; break ;
+    case 'f' : C.Model = optarg ; break ;
+    case 'm' : C.Min = optarg ; break ;
+    case 'd' : C.Derivs_Only = true ; break ;
+    default : usage( argv[0] ) ; return FAILURE ;
+    }
+  }
+  if( C.Ntrials == 0 || C.Timeout == 0 ) {
+    fprintf( stderr , "[CONFORMANCE] need non-zero Ntrials and timeout\n" ) ;
+    usage( argv[0] ) ;
+    return FAILURE ;
+  }
+
+  // keep our stdout for the results and silence the fits
+  fflush( stdout ) ;
+  const int fd = dup( STDOUT_FILENO ) ;
+  if( fd == -1 || ( C.out = fdopen( fd , "w" ) ) == NULL ||
+      freopen( "/dev/null" , "w" , stdout ) == NULL ) {
+    fprintf( stderr , "[CONFORMANCE] cannot redirect stdout\n" ) ;
+    return FAILURE ;
+  }
+
+  fprintf( C.out , "# fit_conformance %d seed=%d Ndata=%d Nmeas=%d "
+	   "Ysigma=%g Ntrials=%zu timeout=%u\n" , CONF_FORMAT , CONF_SEED ,
+	   CONF_NDATA , CONF_NMEAS , CONF_YSIGMA , C.Ntrials , C.Timeout ) ;
+  fprintf( C.out , "# derivs\tmodel\tNparam\tmax_rel_dF\tmax_rel_d2F\t"
+	   "status\n" ) ;
+
+  size_t Nfail = 0 , Nmodels = 0 , m ;
+  fittype f ;
+  char head[ 128 ] ;
+  for( f = 0 ; f <= TEST ; f++ ) {
+    if( f == NOFIT ) continue ;
+    if( C.Model != NULL && strcmp( C.Model , model_names[f] ) ) continue ;
+    const struct job J = { .Fitdef = f } ;
+    snprintf( head , sizeof( head ) , "derivs\t%s\tnan" , model_names[f] ) ;
+    Nfail += isolate( C , check_derivs , J , head , "nan\tnan" ) != SUCCESS ;
+    Nmodels++ ;
+  }
+  if( Nmodels == 0 ) {
+    fprintf( stderr , "[CONFORMANCE] unknown model %s\n" , C.Model ) ;
+    return FAILURE ;
+  }
+
+  if( C.Derivs_Only == false ) {
+    fprintf( C.out , "# fits\tmodel\tminimizer\ttrials\tconverged\t"
+	     "mean_iters\tmean_F\tmean_dF\tmean_s\tstatus\n" ) ;
+    for( f = 0 ; f <= TEST ; f++ ) {
+      if( f == NOFIT ) continue ;
+      if( C.Model != NULL && strcmp( C.Model , model_names[f] ) ) continue ;
+      for( m = 0 ; m < NMIN ; m++ ) {
+	if( C.Min != NULL && strcmp( C.Min , minimizers[m].Name ) ) continue ;
+	if( minimizer_supports( minimizers[m].Name , f ) == false ) continue ;
+	const struct job J = { .Fitdef = f , .Min = m , .Ntrials = C.Ntrials } ;
+	snprintf( head , sizeof( head ) , "fits\t%s\t%s\t%zu" ,
+		  model_names[f] , minimizers[m].Name , C.Ntrials ) ;
+	// fits that do not converge are reported but are not failures
+	if( isolate( C , check_fits , J , head ,
+		     "0\tnan\tnan\tnan\tnan" ) != SUCCESS ) {
+	  Nfail++ ;
+	}
+      }
+    }
+  }
+
+  fprintf( C.out , "# %zu failures\n" , Nfail ) ;
+  fclose( C.out ) ;
+  return Nfail == 0 ? SUCCESS : FAILURE ;
+}
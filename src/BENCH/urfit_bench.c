@@ -0,0 +1,519 @@
+/**
+   @file urfit_bench.c
+   @brief timings of the core kernels on synthetic ensembles
+
+   Generates raw data for a model with generate_fake_ensemble and times
+   bootstrap_full, jackknife_full, inverse_correlation, lm_iter for each
+   model, solve_GEVP and effective_mass in isolation. Every kernel gets
+   a fresh copy of its input so that the repetitions do the same work,
+   and anything the kernels print goes to /dev/null. The results go to
+   stdout as one tab separated line per kernel below a header recording
+   the settings, the times are the min and median over the repetitions
+   per call of the kernel. The last column is the number of points for
+   the data kernels and the mean LM iterations per fit for lm_iter.
+   effective_mass writes effmass.agr to the working directory as usual.
+
+   Build with "make urfit_bench" and run as
+
+   ./urfit_bench [-n Ndata] [-s Nsim] [-m Nmeas] [-b Nboots] [-r Rho]
+                 [-y Ysigma] [-R Nreps] [-f MODEL] [-c] [-l label]
+ */
+#include "gens.h"
+
+#include "bootstrap.h"
+#include "correlation.h"
+#include "effmass.h"
+#include "fake.h"
+#include "ffunction.h"
+#include "fit_chooser.h"
+#include "gevp.h"
+#include "jacknife.h"
+#include "LM.h"
+#include "pmap.h"
+#include "resampled_ops.h"
+#include "stats.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+  #include <omp.h>
+#endif
+
+// bump this if the columns change
+#define BENCH_FORMAT (1)
+
+// fixed seed so that every run sees the same ensemble
+#define BENCH_SEED (1234567)
+
+struct bench {
+  size_t Ndata , Nsim , Nmeas , Nboots , Nreps ;
+  double Rho , Ysigma ;
+  corrtype Corrfit ;
+  const char *Model ; // NULL for all of them
+  const char *Label ;
+  FILE *out ;
+} ;
+
+// models we fit and the parameters we generate them with, repeated
+// for each simulation
+struct bench_model {
+  const char *Name ;
+  fittype Fitdef ;
+  size_t N ;
+  double Params[ 4 ] ;
+} ;
+
+static const struct bench_model models[] = {
+  { "EXP" , EXP , 1 , { 1.0 , 0.2 } } ,
+  { "COSH" , COSH , 1 , { 1.0 , 0.2 } } ,
+  { "EXP_PLUSC" , EXP_PLUSC , 1 , { 0.1 , 1.0 , 0.2 } } ,
+  { "POLY" , POLY , 2 , { 1.0 , 0.1 , 0.01 } } } ;
+
+#define NMODELS ( sizeof( models )/sizeof( models[0] ) )
+
+static double
+now( void )
+{
+  struct timespec t ;
+  clock_gettime( CLOCK_MONOTONIC , &t ) ;
+  return t.tv_sec + 1E-9*t.tv_nsec ;
+}
+
+static int
+comp_double( const void *a , const void *b )
+{
+  const double da = *(const double*)a , db = *(const double*)b ;
+  return ( da > db ) - ( da < db ) ;
+}
+
+// sorts t in place, prints the min and median of the Nreps timings
+// divided by the number of calls in each
+static void
+report( const struct bench B ,
+	const char *kernel ,
+	const char *model ,
+	const size_t calls ,
+	double *t ,
+	const double extra )
+{
+  qsort( t , B.Nreps , sizeof( double ) , comp_double ) ;
+  const double med = B.Nreps%2 ? t[ B.Nreps/2 ] :
+    0.5*( t[ B.Nreps/2 - 1 ] + t[ B.Nreps/2 ] ) ;
+  fprintf( B.out , "%s\t%s\t%zu\t%.6e\t%.6e\t%.6e\n" , kernel , model ,
+	   calls , t[0]/calls , med/calls , extra ) ;
+  fflush( B.out ) ;
+  return ;
+}
+
+// fit descriptor settings for model m, the caller frees Sims and Prior
+static struct fit_info
+bench_fit( const struct bench B ,
+	   const struct bench_model m )
+{
+  struct fit_info Fit ;
+  memset( &Fit , 0 , sizeof( struct fit_info ) ) ;
+  Fit.Fitdef = m.Fitdef ;
+  Fit.Corrfit = B.Corrfit ;
+  Fit.N = m.N ;
+  Fit.M = 0 ;
+  Fit.Nparam = get_Nparam( Fit ) ;
+  Fit.Nlogic = B.Nsim * Fit.Nparam ;
+  Fit.Sims = calloc( Fit.Nparam , sizeof( bool ) ) ;
+  Fit.Prior = malloc( Fit.Nlogic * sizeof( struct prior ) ) ;
+  size_t i ;
+  for( i = 0 ; i < Fit.Nlogic ; i++ ) {
+    Fit.Prior[i].Initialised = false ;
+    Fit.Prior[i].Val = Fit.Prior[i].Err = UNINIT_FLAG ;
+  }
+  Fit.Minimize = lm_iter ;
+  Fit.Tol = 1E-8 ;
+  Fit.Nstarts = 1 ;
+  return Fit ;
+}
+
+// raw measurements of model m, LT is twice the number of points
+static int
+bench_data( struct data_info *Data ,
+	    struct traj *Traj ,
+	    size_t *Dims ,
+	    const struct bench B ,
+	    const struct bench_model m ,
+	    const struct fit_info Fit )
+{
+  double params[ Fit.Nlogic ] ;
+  size_t i ;
+  for( i = 0 ; i < Fit.Nlogic ; i++ ) {
+    params[i] = m.Params[ i%Fit.Nparam ] ;
+  }
+  for( i = 0 ; i < 4 ; i++ ) {
+    Dims[i] = 2*B.Ndata*B.Nsim ;
+  }
+  for( i = 0 ; i < B.Nsim ; i++ ) {
+    Traj[i].Dimensions = Dims ;
+    Traj[i].Nd = 4 ;
+  }
+  memset( Data , 0 , sizeof( struct data_info ) ) ;
+  Data -> Nsim = B.Nsim ;
+  Data -> Nboots = B.Nboots ;
+  Data -> Cov.Estimator = SAMPLE_COV ;
+  Data -> Cov.Eigenvalue_Tol = 1E-8 ;
+  const struct fake_ensemble E = { .Ndata = B.Ndata , .Nmeas = B.Nmeas ,
+				   .Xsigma = 0.0 , .Ysigma = B.Ysigma ,
+				   .Rho = B.Rho , .Params = params ,
+				   .Seed = BENCH_SEED , .Verbose = false } ;
+  return generate_fake_ensemble( Data , Fit , Traj , E ) ;
+}
+
+// deep copy of the x and y data, everything else is shared
+static struct data_info
+copy_data( const struct data_info Data )
+{
+  struct data_info D = Data ;
+  D.x = malloc( Data.Ntot * sizeof( struct resampled ) ) ;
+  D.y = malloc( Data.Ntot * sizeof( struct resampled ) ) ;
+  size_t i ;
+  for( i = 0 ; i < Data.Ntot ; i++ ) {
+    D.x[i] = init_dist( &Data.x[i] , Data.x[i].NSAMPLES , Data.x[i].restype ) ;
+    D.y[i] = init_dist( &Data.y[i] , Data.y[i].NSAMPLES , Data.y[i].restype ) ;
+  }
+  D.Cov.W = NULL ;
+  return D ;
+}
+
+static void
+free_copy( struct data_info *D )
+{
+  size_t i ;
+  for( i = 0 ; i < D -> Ntot ; i++ ) {
+    free( D -> x[i].resampled ) ;
+    free( D -> y[i].resampled ) ;
+  }
+  free( D -> x ) ;
+  free( D -> y ) ;
+  return ;
+}
+
+static void
+free_W( struct data_info *D ,
+	const corrtype Corrfit )
+{
+  if( D -> Cov.W == NULL ) return ;
+  const size_t N = Corrfit == CORRELATED ? D -> Ntot : 1 ;
+  size_t i ;
+  for( i = 0 ; i < N ; i++ ) {
+    free( D -> Cov.W[i] ) ;
+  }
+  free( D -> Cov.W ) ;
+  D -> Cov.W = NULL ;
+  return ;
+}
+
+// the resampling of the raw data, Boot is left with the bootstraps
+static void
+bench_resampling( const struct bench B ,
+		  const struct data_info Raw ,
+		  const char *model ,
+		  struct data_info *Boot )
+{
+  double t[ B.Nreps ] ;
+  size_t r ;
+  struct input_params Input ;
+  for( r = 0 ; r < B.Nreps ; r++ ) {
+    Input.Data = copy_data( Raw ) ;
+    const double t1 = now() ;
+    bootstrap_full( &Input ) ;
+    t[r] = now() - t1 ;
+    if( r+1 < B.Nreps ) {
+      free_copy( &Input.Data ) ;
+    }
+  }
+  *Boot = Input.Data ;
+  report( B , "bootstrap_full" , model , 1 , t , Raw.Ntot ) ;
+
+  for( r = 0 ; r < B.Nreps ; r++ ) {
+    Input.Data = copy_data( Raw ) ;
+    const double t1 = now() ;
+    jackknife_full( &Input ) ;
+    t[r] = now() - t1 ;
+    free_copy( &Input.Data ) ;
+  }
+  report( B , "jackknife_full" , model , 1 , t , Raw.Ntot ) ;
+  return ;
+}
+
+// inverse of the covariance of the bootstraps
+static void
+bench_covariance( const struct bench B ,
+		  const struct data_info Boot ,
+		  const struct fit_info Fit ,
+		  const char *model )
+{
+  double t[ B.Nreps ] ;
+  struct data_info D = Boot ;
+  size_t r ;
+  for( r = 0 ; r < B.Nreps ; r++ ) {
+    D.Cov.W = NULL ;
+    const double t1 = now() ;
+    inverse_correlation( &D , Fit ) ;
+    t[r] = now() - t1 ;
+    free_W( &D , Fit.Corrfit ) ;
+  }
+  report( B , "inverse_correlation" , model , 1 , t , Boot.Ntot ) ;
+  return ;
+}
+
+// lm_iter on every bootstrap warm started from the fit to the average
+// like perform_bootfit does, extra is the mean number of iterations
+static void
+bench_lm( const struct bench B ,
+	  struct data_info Boot ,
+	  const struct fit_info Fit ,
+	  const struct bench_model m )
+{
+  struct fit_descriptor fdesc = init_fit( Boot , Fit ) ;
+  fdesc.Prior = Fit.Prior ;
+  inverse_correlation( &Boot , Fit ) ;
+  const double **W = (const double**)Boot.Cov.W ;
+
+  double xloc[ Boot.Ntot ] , yloc[ Boot.Ntot ] , avg[ Fit.Nlogic ] ;
+  struct data d = { Boot.Ntot , xloc , yloc , Boot.LT ,
+		    fdesc.Nparam , Fit.map , Fit.N , Fit.M , NULL } ;
+  size_t i , k , r , iters = 0 ;
+
+  // average from just off the true parameters
+  for( i = 0 ; i < Boot.Ntot ; i++ ) {
+    xloc[i] = Boot.x[i].avg ;
+    yloc[i] = Boot.y[i].avg ;
+  }
+  for( i = 0 ; i < Fit.Nlogic ; i++ ) {
+    fdesc.f.fparams[i] = 1.1*m.Params[ i%Fit.Nparam ] ;
+  }
+  Fit.Minimize( &fdesc , &d , W , Fit.Tol ) ;
+  memcpy( avg , fdesc.f.fparams , Fit.Nlogic*sizeof( double ) ) ;
+
+  double t[ B.Nreps ] ;
+  for( r = 0 ; r < B.Nreps ; r++ ) {
+    t[r] = 0.0 ;
+    for( k = 0 ; k < Boot.y[0].NSAMPLES ; k++ ) {
+      for( i = 0 ; i < Boot.Ntot ; i++ ) {
+	xloc[i] = Boot.x[i].resampled[k] ;
+	yloc[i] = Boot.y[i].resampled[k] ;
+      }
+      memcpy( fdesc.f.fparams , avg , Fit.Nlogic*sizeof( double ) ) ;
+      const double t1 = now() ;
+      const int n = Fit.Minimize( &fdesc , &d , W , Fit.Tol ) ;
+      t[r] += now() - t1 ;
+      if( r == 0 ) iters += n ;
+    }
+  }
+  report( B , "lm_iter" , m.Name , Boot.y[0].NSAMPLES , t ,
+	  iters/(double)Boot.y[0].NSAMPLES ) ;
+
+  free_W( &Boot , Fit.Corrfit ) ;
+  free_ffunction( &fdesc.f , fdesc.Nlogic ) ;
+  return ;
+}
+
+static void
+bench_effmass( const struct bench B ,
+	       const struct data_info Boot ,
+	       struct traj *Traj ,
+	       const char *model )
+{
+  const effmass_type types[ 2 ] = { LOG_EFFMASS , ACOSH_EFFMASS } ;
+  const char *names[ 2 ] = { "effective_mass_log" , "effective_mass_acosh" } ;
+  struct input_params Input ;
+  Input.Data = Boot ;
+  Input.Traj = Traj ;
+  double t[ B.Nreps ] ;
+  size_t r , n , i ;
+  for( n = 0 ; n < 2 ; n++ ) {
+    for( r = 0 ; r < B.Nreps ; r++ ) {
+      const double t1 = now() ;
+      struct resampled *m = effective_mass( &Input , types[n] ) ;
+      t[r] = now() - t1 ;
+      for( i = 0 ; i < Boot.Ntot ; i++ ) {
+	free( m[i].resampled ) ;
+      }
+      free( m ) ;
+    }
+    report( B , names[n] , model , 1 , t , Boot.Ntot ) ;
+  }
+  return ;
+}
+
+// two-state 2x2 correlator matrix with Ysigma relative noise on each
+// bootstrap, C_ij(t) = sum_n Z_in Z_jn exp( -E_n t )
+static void
+bench_gevp( const struct bench B )
+{
+  const size_t N = 2 , Nt = B.Ndata ;
+  const double E[ 2 ] = { 0.2 , 0.5 } ;
+  const double Z[ 2 ][ 2 ] = { { 1.0 , 0.5 } , { 0.3 , 1.0 } } ;
+  struct resampled *y = malloc( N*N*Nt*sizeof( struct resampled ) ) ;
+  size_t i , j , n , t , k , r ;
+
+  gsl_rng *rng = gsl_rng_alloc( gsl_rng_mt19937 ) ;
+  gsl_rng_set( rng , BENCH_SEED ) ;
+  for( i = 0 ; i < N ; i++ ) {
+    for( j = 0 ; j < N ; j++ ) {
+      for( t = 0 ; t < Nt ; t++ ) {
+	struct resampled *C = &y[ t + Nt*( j + N*i ) ] ;
+	*C = init_dist( NULL , B.Nboots , BootStrap ) ;
+	for( n = 0 ; n < N ; n++ ) {
+	  C -> avg += Z[i][n]*Z[j][n]*exp( -E[n]*t ) ;
+	}
+	for( k = 0 ; k < B.Nboots ; k++ ) {
+	  C -> resampled[k] = C -> avg*( 1 + gsl_ran_gaussian( rng , B.Ysigma ) ) ;
+	}
+	compute_err( C ) ;
+      }
+    }
+  }
+  gsl_rng_free( rng ) ;
+
+  double tm[ B.Nreps ] ;
+  for( r = 0 ; r < B.Nreps ; r++ ) {
+    const double t1 = now() ;
+    struct resampled *ev = solve_GEVP( y , Nt , N , N , 1 , 3 ) ;
+    tm[r] = now() - t1 ;
+    if( ev != NULL ) {
+      for( i = 0 ; i < N*Nt ; i++ ) {
+	free( ev[i].resampled ) ;
+      }
+      free( ev ) ;
+    }
+  }
+  report( B , "solve_GEVP" , "2x2" , 1 , tm , Nt ) ;
+
+  for( i = 0 ; i < N*N*Nt ; i++ ) {
+    free( y[i].resampled ) ;
+  }
+  free( y ) ;
+  return ;
+}
+
+// everything that runs on the ensemble of one model
+static int
+bench_model( const struct bench B ,
+	     const struct bench_model m ,
+	     const bool ensemble_kernels )
+{
+  struct traj Traj[ B.Nsim ] ;
+  size_t Dims[ 4 ] ;
+  struct data_info Raw , Boot ;
+  struct fit_info Fit = bench_fit( B , m ) ;
+  memset( Traj , 0 , B.Nsim*sizeof( struct traj ) ) ;
+
+  if( bench_data( &Raw , Traj , Dims , B , m , Fit ) == FAILURE ) {
+    fprintf( stderr , "[BENCH] data generation failed for %s\n" , m.Name ) ;
+    return FAILURE ;
+  }
+  Fit.map = parammap( Raw , Fit ) ;
+
+  if( ensemble_kernels ) {
+    bench_resampling( B , Raw , m.Name , &Boot ) ;
+    bench_covariance( B , Boot , Fit , m.Name ) ;
+    bench_effmass( B , Boot , Traj , m.Name ) ;
+  } else {
+    struct input_params Input ;
+    Input.Data = copy_data( Raw ) ;
+    bootstrap_full( &Input ) ;
+    Boot = Input.Data ;
+  }
+  bench_lm( B , Boot , Fit , m ) ;
+
+  free_copy( &Boot ) ;
+  free_copy( &Raw ) ;
+  free( Raw.Ndata ) ;
+  free( Raw.LT ) ;
+  free_pmap( Fit.map , Raw.Ntot ) ;
+  free( Fit.Sims ) ;
+  free( Fit.Prior ) ;
+  return SUCCESS ;
+}
+
+static void
+usage( const char *prog )
+{
+  fprintf( stderr , "USAGE :: %s [-n Ndata] [-s Nsim] [-m Nmeas] "
+	   "[-b Nboots] [-r Rho] [-y Ysigma] [-R Nreps] [-f MODEL] "
+	   "[-c] [-l label]\n" , prog ) ;
+  return ;
+}
+
+int
+main( int argc , char *argv[] )
+{
+  struct bench B = { .Ndata = 32 , .Nsim = 1 , .Nmeas = 400 ,
+		     .Nboots = 1000 , .Nreps = 5 , .Rho = 0.5 ,
+		     .Ysigma = 0.01 , .Corrfit = UNCORRELATED ,
+		     .Model = NULL , .Label = "" , .out = NULL } ;
+  int opt ;
+  while( ( opt = getopt( argc , argv , "n:s:m:b:r:y:R:f:cl:" ) ) != -1 ) {
+    switch( opt ) {
+    case 'n' : B.Ndata  = strtoul( optarg , NULL , 10 ) ; break ;
+    case 's' : B.Nsim   = strtoul( optarg , NULL , 10 ) ; break ;
+    case 'm' : B.Nmeas  = strtoul( optarg , NULL , 10 ) ; break ;
+    case 'b' : B.Nboots = strtoul( optarg , NULL , 10 ) ; break ;
+    case 'r' : B.Rho    = strtod( optarg , NULL ) ; break ;
+    case 'y' : B.Ysigma = strtod( optarg , NULL ) ; break ;
+    case 'R' : B.Nreps  = strtoul( optarg , NULL , 10 ) ; break ;
+    case 'f' : B.Model  = optarg ; break ;
+    case 'c' : B.Corrfit = CORRELATED ; break ;
+    case 'l' : B.Label  = optarg ; break ;
+    default : usage( argv[0] ) ; return FAILURE ;
+    }
+  }
+  if( B.Ndata < 4 || B.Nsim == 0 || B.Nmeas < 2 || B.Nboots == 0 ||
+      B.Nreps == 0 || !( fabs( B.Rho ) < 1 ) ) {
+    fprintf( stderr , "[BENCH] need Ndata > 3, Nmeas > 1, |Rho| < 1 "
+	     "and non-zero Nsim, Nboots and Nreps\n" ) ;
+    usage( argv[0] ) ;
+    return FAILURE ;
+  }
+
+  // keep our stdout for the results and silence the kernels
+  fflush( stdout ) ;
+  const int fd = dup( STDOUT_FILENO ) ;
+  if( fd == -1 || ( B.out = fdopen( fd , "w" ) ) == NULL ||
+      freopen( "/dev/null" , "w" , stdout ) == NULL ) {
+    fprintf( stderr , "[BENCH] cannot redirect stdout\n" ) ;
+    return FAILURE ;
+  }
+
+  size_t threads = 1 ;
+#ifdef _OPENMP
+  threads = omp_get_max_threads() ;
+#endif
+  fprintf( B.out , "# urfit_bench %d label=%s Ndata=%zu Nsim=%zu Nmeas=%zu "
+	   "Nboots=%zu Rho=%g Ysigma=%g Corrfit=%s Nreps=%zu threads=%zu\n" ,
+	   BENCH_FORMAT , B.Label , B.Ndata , B.Nsim , B.Nmeas , B.Nboots ,
+	   B.Rho , B.Ysigma , B.Corrfit == CORRELATED ? "CORRELATED" :
+	   "UNCORRELATED" , B.Nreps , threads ) ;
+  fprintf( B.out , "# kernel\tmodel\tcalls\tmin_s_per_call\t"
+	   "median_s_per_call\textra\n" ) ;
+
+  size_t i , Nrun = 0 ;
+  for( i = 0 ; i < NMODELS ; i++ ) {
+    if( B.Model != NULL && strcmp( B.Model , models[i].Name ) ) continue ;
+    // the data kernels only need timing on the first ensemble
+    if( bench_model( B , models[i] , Nrun == 0 ) == FAILURE ) {
+      return FAILURE ;
+    }
+    Nrun++ ;
+  }
+  if( Nrun == 0 ) {
+    fprintf( stderr , "[BENCH] unknown model %s, have" , B.Model ) ;
+    for( i = 0 ; i < NMODELS ; i++ ) {
+      fprintf( stderr , " %s" , models[i].Name ) ;
+    }
+    fprintf( stderr , "\n" ) ;
+    return FAILURE ;
+  }
+  bench_gevp( B ) ;
+
+  fclose( B.out ) ;
+  return SUCCESS ;
+}
@@ -4,6 +4,9 @@
 
    From the paper what lattice theorists can learn from fMRI by Fleming
    ... apparently the answer is "not all that much" ....
+
+   The default HTLS variant works in a bb_temps workspace so a thread
+   can reuse it over all the timeslices and samples it does
  */
 #include <complex.h>
 
@@ -17,16 +20,75 @@
 
 #include "gens.h"
 
+#include "blackbox.h"
+
 //#define BB1
 //#define BB2
 //#define BB3
 //#define BB4
 
+// rows of the hankel matrix
+#define NT(NSTATES) ( (NSTATES) + 10 )
+
+struct bb_temps {
+  size_t Nstates ;
+  gsl_matrix *alpha , *Q , *HK , *Qq , *A , *B , *Binv , *C ;
+  gsl_vector *S , *Work , *Ss , *WorkQ ;
+  gsl_permutation *perm ;
+  gsl_vector_complex *eval ;
+  gsl_eigen_nonsymm_workspace *w ;
+} ;
+
+struct bb_temps *
+alloc_blackbox( const size_t NSTATES )
+{
+  struct bb_temps *W = malloc( sizeof( struct bb_temps ) ) ;
+  W -> Nstates = NSTATES ;
+  W -> alpha = gsl_matrix_alloc( NT(NSTATES) , NSTATES+1 ) ;
+  W -> Q     = gsl_matrix_alloc( NSTATES+1 , NSTATES+1 ) ;
+  W -> S     = gsl_vector_alloc( NSTATES+1 ) ;
+  W -> Work  = gsl_vector_alloc( NSTATES+1 ) ;
+  W -> HK    = gsl_matrix_alloc( 2*NSTATES , NSTATES ) ;
+  W -> Qq    = gsl_matrix_alloc( NSTATES , NSTATES ) ;
+  W -> Ss    = gsl_vector_alloc( NSTATES ) ;
+  W -> WorkQ = gsl_vector_alloc( NSTATES ) ;
+  W -> A     = gsl_matrix_alloc( NSTATES , NSTATES ) ;
+  W -> B     = gsl_matrix_alloc( NSTATES , NSTATES ) ;
+  W -> Binv  = gsl_matrix_alloc( NSTATES , NSTATES ) ;
+  W -> C     = gsl_matrix_alloc( NSTATES , NSTATES ) ;
+  W -> perm  = gsl_permutation_alloc( NSTATES ) ;
+  W -> eval  = gsl_vector_complex_alloc( NSTATES ) ;
+  W -> w     = gsl_eigen_nonsymm_alloc( NSTATES ) ;
+  return W ;
+}
+
+void
+free_blackbox( struct bb_temps *W )
+{
+  gsl_matrix_free( W -> alpha ) ;
+  gsl_matrix_free( W -> Q ) ;
+  gsl_vector_free( W -> S ) ;
+  gsl_vector_free( W -> Work ) ;
+  gsl_matrix_free( W -> HK ) ;
+  gsl_matrix_free( W -> Qq ) ;
+  gsl_vector_free( W -> Ss ) ;
+  gsl_vector_free( W -> WorkQ ) ;
+  gsl_matrix_free( W -> A ) ;
+  gsl_matrix_free( W -> B ) ;
+  gsl_matrix_free( W -> Binv ) ;
+  gsl_matrix_free( W -> C ) ;
+  gsl_permutation_free( W -> perm ) ;
+  gsl_vector_complex_free( W -> eval ) ;
+  gsl_eigen_nonsymm_free( W -> w ) ;
+  free( W ) ;
+}
+
 #ifdef BB1
 
 // standard Prony's method
 static void
 blackboxT( double complex *x ,
+	   struct bb_temps *W ,
 	   const double *data ,
 	   const size_t Ndata ,
 	   const size_t Nstates ,
@@ -97,6 +159,7 @@ blackboxT( double complex *x ,
 // standard Prony's method some small variation from the above
 static void
 blackboxT( double complex *x ,
+	   struct bb_temps *W ,
 	   const double *data ,
 	   const size_t Ndata ,
 	   const size_t Nstates ,
@@ -171,6 +234,7 @@ blackboxT( double complex *x ,
 // TLS variant
 static void
 blackboxT( double complex *x ,
+	   struct bb_temps *W ,
 	   const double *data ,
 	   const size_t Ndata ,
 	   const size_t Nstates ,
@@ -237,6 +301,7 @@ blackboxT( double complex *x ,
 // HTLS variant
 static void
 blackboxT( double complex *x ,
+	   struct bb_temps *W ,
 	   const double *data ,
 	   const size_t Ndata ,
 	   const size_t Nstates ,
@@ -245,68 +310,41 @@ blackboxT( double complex *x ,
 {
   size_t i , j ;
 
-  // gsl matrix allocations
-  gsl_matrix *alpha = gsl_matrix_alloc( Nt , Nstates+1 ) ;
-  gsl_matrix *Q     = gsl_matrix_alloc( Nstates+1 , Nstates+1 ) ;
-  gsl_vector *S     = gsl_vector_alloc( Nstates+1 ) ;
-  gsl_vector *Work  = gsl_vector_alloc( Nstates+1 ) ;
-
   for( i = 0 ; i < Nt ; i++ ) {
     for( j = 0 ; j < Nstates ; j++ ) {
       const size_t didx = ( t + i + j )%Ndata ;
-      gsl_matrix_set( alpha , i , j , -data[ didx ] ) ;
+      gsl_matrix_set( W -> alpha , i , j , -data[ didx ] ) ;
     }
     const size_t yidx = ( t + Nstates + i )%Ndata ;
-    gsl_matrix_set( alpha , i , j , data[ yidx ] ) ;
+    gsl_matrix_set( W -> alpha , i , j , data[ yidx ] ) ;
   }
 
-  gsl_linalg_SV_decomp( alpha , Q , S , Work ) ;
-  gsl_matrix_free( Q ) ;
-  gsl_vector_free( Work ) ;
+  gsl_linalg_SV_decomp( W -> alpha , W -> Q , W -> S , W -> Work ) ;
 
   // truncate Hankel matrix to rank K, i.e. Nstates
-  gsl_matrix *HK = gsl_matrix_alloc( 2*Nstates , Nstates ) ;
   for( i = 0 ; i < Nstates ; i++ ) {
     for( j = 0 ; j < Nstates ; j++ ) {
-      gsl_matrix_set( HK , i , j ,
-		      gsl_matrix_get( alpha , i , j ) ) ;
-      gsl_matrix_set( HK , Nstates + i , j ,
-		      gsl_matrix_get( alpha , i + 1 , j ) ) ;
+      gsl_matrix_set( W -> HK , i , j ,
+		      gsl_matrix_get( W -> alpha , i , j ) ) ;
+      gsl_matrix_set( W -> HK , Nstates + i , j ,
+		      gsl_matrix_get( W -> alpha , i + 1 , j ) ) ;
     }
   }
 
-  // free the gsl vectors
-  gsl_matrix_free( alpha ) ;
-
-  gsl_matrix *Qq     = gsl_matrix_alloc( Nstates , Nstates ) ;
-  gsl_vector *Ss     = gsl_vector_alloc( Nstates ) ;
-  gsl_vector *WorkQ  = gsl_vector_alloc( Nstates ) ;
-
-  gsl_linalg_SV_decomp( HK , Qq , Ss , WorkQ ) ;
-
-  gsl_matrix_free( Qq ) ;
-  gsl_vector_free( Ss ) ;
-  gsl_vector_free( WorkQ ) ;
+  gsl_linalg_SV_decomp( W -> HK , W -> Qq , W -> Ss , W -> WorkQ ) ;
 
   // split HK into two
-  gsl_matrix *A = gsl_matrix_alloc( Nstates , Nstates ) ;
-  gsl_matrix *B = gsl_matrix_alloc( Nstates , Nstates ) ;
-  gsl_matrix *Binv = gsl_matrix_alloc( Nstates , Nstates ) ;
-  gsl_matrix *C = gsl_matrix_alloc( Nstates , Nstates ) ;
-  
   for( i = 0 ; i < Nstates ; i++ ) {
     for( j = 0 ; j < Nstates ; j++ ) {
-      gsl_matrix_set( A , i , j , gsl_matrix_get( HK , i , j ) ) ;
-      gsl_matrix_set( B , i , j , gsl_matrix_get( HK , i + Nstates , j  ) ) ;
+      gsl_matrix_set( W -> A , i , j , gsl_matrix_get( W -> HK , i , j ) ) ;
+      gsl_matrix_set( W -> B , i , j , gsl_matrix_get( W -> HK , i + Nstates , j  ) ) ;
     }
   }
 
   // invert B and multiply by A
   int signum ;
-  gsl_permutation *perm = gsl_permutation_alloc( Nstates ) ;
-  
-  gsl_linalg_LU_decomp( B , perm , &signum ) ;
-  gsl_linalg_LU_invert( B , perm , Binv ) ;
+  gsl_linalg_LU_decomp( W -> B , W -> perm , &signum ) ;
+  gsl_linalg_LU_invert( W -> B , W -> perm , W -> Binv ) ;
 
   for( i = 0 ; i < Nstates ; i++ ) {
     for( j = 0 ; j < Nstates ; j++ ) {
@@ -314,33 +352,24 @@ blackboxT( double complex *x ,
       size_t k ;
       for( k = 0 ; k < Nstates ; k++ ) {
 	loc_sum +=
-	  gsl_matrix_get( A , i , k ) * gsl_matrix_get( Binv , k , j ) ;
+	  gsl_matrix_get( W -> A , i , k ) * gsl_matrix_get( W -> Binv , k , j ) ;
       }
-      gsl_matrix_set( C , i , j , loc_sum ) ;
+      gsl_matrix_set( W -> C , i , j , loc_sum ) ;
     }
   }
 
   // compute the eigenvalues of C
-  gsl_vector_complex *eval = gsl_vector_complex_alloc( Nstates ) ;
-  gsl_eigen_nonsymm_workspace *w = gsl_eigen_nonsymm_alloc( Nstates ) ;
-  gsl_eigen_nonsymm( C , eval , w ) ;
+  gsl_eigen_nonsymm( W -> C , W -> eval , W -> w ) ;
 
   for( i = 0 ; i < Nstates ; i++ ) {
 #if GSL_MINOR_VERSION > 6
-    x[i] = gsl_vector_complex_get( eval , i ) ;
+    x[i] = gsl_vector_complex_get( W -> eval , i ) ;
 #else
-    const gsl_complex tmp = gsl_vector_complex_get( eval , i ) ;
+    const gsl_complex tmp = gsl_vector_complex_get( W -> eval , i ) ;
     x[i] = tmp.dat[0] + I * tmp.dat[1] ;
 #endif
   }
 
-  gsl_matrix_free( A ) ;
-  gsl_matrix_free( B ) ;
-  gsl_matrix_free( Binv  ) ;
-  gsl_matrix_free( C  ) ;
-  gsl_vector_complex_free( eval ) ;
-  gsl_eigen_nonsymm_free( w ) ;
-
   return ;
 }
 #endif
@@ -424,26 +453,31 @@ get_safe_masses( const size_t NSTATES ,
   return ;
 }
 
-// compute the blackbox effective mass for a correlator of y-data
+// compute the blackbox effective mass for a correlator of y-data, W
+// is a workspace from alloc_blackbox or NULL to make our own
 void
 blackbox( const double *data ,
 	  const size_t NDATA ,
 	  const size_t NSTATES ,
-	  double masses[ NSTATES ][ NDATA ] )
+	  double masses[ NSTATES ][ NDATA ] ,
+	  struct bb_temps *W )
 { 
   // some cut off t
   const size_t smallt = NDATA ;
 
-  double complex *x = malloc( NSTATES * sizeof( double complex ) ) ;
+  double complex x[ NSTATES ] ;
+  struct bb_temps *Wloc = ( W == NULL ) ? alloc_blackbox( NSTATES ) : W ;
 
   size_t t ;
   for( t = 0 ; t < smallt ; t++ ) {
 
-    blackboxT( x , data , NDATA , NSTATES , t , NSTATES+10 ) ;
+    blackboxT( x , Wloc , data , NDATA , NSTATES , t , NT(NSTATES) ) ;
     
     get_safe_masses( NSTATES , NDATA , masses , x , t ) ;
   }
-  free( x ) ;
+  if( W == NULL ) {
+    free_blackbox( Wloc ) ;
+  }
 
   return ;
 }
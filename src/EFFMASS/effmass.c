@@ -14,155 +14,167 @@
 
 #define EFFMASSTOL 1E-30
 
+// the closed-form effective masses, each is f( arg ) with arg a ratio
+// of correlators that has to be in the domain of f
+typedef enum { EM_LOG , EM_ACOSH , EM_ASINH , EM_ATANH } em_func ;
+
+// which correlators a timeslice's effective mass needs
+struct em_slice {
+  const struct resampled *y1 , *y2 , *y3 ;
+  const struct resampled *x1 , *x2 ;
+  em_func f ;
+  double sign ;
+} ;
+
 // set it to zero
 static void
-zero_effmass( struct resampled *effmass ,
-	      const struct resampled bootavg )
+zero_effmass( struct resampled *effmass )
 {
   equate_constant( effmass , 0.0 , 
-		   bootavg.NSAMPLES , 
-		   bootavg.restype ) ;
+		   effmass -> NSAMPLES , 
+		   effmass -> restype ) ;
   return ;
 }
 
-// asinh breaks down if acosh( n < 1 )
-static bool
-acosh_range( const struct resampled effmass )
+static inline double
+em_arg( const em_func f ,
+	const double y1 ,
+	const double y2 ,
+	const double y3 )
 {
-  size_t i ;
-  for( i = 0 ; i < effmass.NSAMPLES ; i++ ) {
-    if( effmass.resampled[ i ] < 1 ) {
-      return true ;
-    }
+  switch( f ) {
+  case EM_LOG : return y1 / y2 ;
+  case EM_ACOSH : return 0.5 * ( y1 + y3 ) / y2 ;
+  case EM_ASINH : return 0.5 * ( y1 - y3 ) / y2 ;
+  case EM_ATANH : return ( y1 - y2 ) / ( y1 + y2 ) ;
   }
-  return false ;
+  return 0.0 ;
 }
 
-// make sure this is in the right range for the atanh
-static bool
-atanh_range( const struct resampled effmass ) 
+// is the argument outside of the domain of f
+static inline int
+em_bad( const em_func f ,
+	const double arg )
 {
-  size_t i ;
-  for( i = 0 ; i < effmass.NSAMPLES ; i++ ) {
-    if( effmass.resampled[ i ] < -1 ||
-	effmass.resampled[ i ] > 1 ) {
-      return true ;
-    }
+  switch( f ) {
+  case EM_LOG : return arg < 0 ;
+  case EM_ACOSH : return arg < 1 ;
+  case EM_ASINH : return 0 ;
+  case EM_ATANH : return ( arg < -1 ) | ( arg > 1 ) ;
   }
-  return false ;
+  return 0 ;
 }
 
-// if the data doesn't work we set the whole thing to zero
-static bool
-log_range( const struct resampled log )
+static inline double
+em_apply( const struct em_slice S ,
+	  const double arg ,
+	  const double x1 ,
+	  const double x2 )
 {
-  size_t i ;
-  for( i = 0 ; i < log.NSAMPLES ; i++ ) {
-    if( log.resampled[ i ] < 0 ) {
-      return true ;
-    }
+  switch( S.f ) {
+  case EM_LOG : return S.sign * log( arg ) / ( x1 - x2 ) ;
+  case EM_ACOSH : return acosh( arg ) ;
+  case EM_ASINH : return asinh( arg ) ;
+  case EM_ATANH : return atanh( arg ) ;
   }
-  return false ;
+  return 0.0 ;
 }
 
-// log effective mass
-static void
-log_effmass( struct resampled *effmass ,
-	     struct resampled y1 , struct resampled y2 ,
-	     struct resampled x1 , struct resampled x2 )
+// log effective mass of the two neighbours t and t+dt
+static struct em_slice
+log_slice( const struct resampled *y ,
+	   const struct resampled *x ,
+	   const size_t t ,
+	   const size_t dt ,
+	   const double sign )
 {
-  if( y2.avg == 0.0 ) { zero_effmass( effmass , y2 ) ; return ; }
-  if( y1.avg == 0.0 ) { zero_effmass( effmass , y1 ) ; return ; }
-  
-  equate( effmass , y1 ) ;
-  divide( effmass , y2 ) ;
-  
-  // if it is still negative we set to zero
-  if( log_range( *effmass ) == true ) {
-    zero_effmass( effmass , y1 ) ;
-  } else {
-    res_log( effmass ) ;
-  }
-
-  struct resampled Delta = init_dist( &x1 , x1.NSAMPLES , x1.restype ) ;
-
-  subtract( &Delta , x2 ) ;
-  divide( effmass , Delta ) ;
-  
-  free( Delta.resampled ) ;
+  const struct em_slice S = { &y[t] , &y[t+dt] , NULL ,
+			      &x[t+dt] , &x[t] , EM_LOG , sign } ;
+  return S ;
 }
 
-// atanh effmass
-static void
-atanh_effmass( struct resampled *effmass ,
-	       struct resampled y1 ,
-	       struct resampled y2 )
+// map the effmass type at timeslice j onto its correlators, the ends
+// are always a log effective mass. LOG2 and EVALUE (the latter for
+// GEVP eigenvalues) are the forward log mass
+static struct em_slice
+set_slice( const struct resampled *y ,
+	   const struct resampled *x ,
+	   const size_t j ,
+	   const size_t Ndata ,
+	   const effmass_type type )
 {
-  // is E^{-m(t-1)} - E^{-m(t+1)}
-  equate( effmass , y1 ) ;
-  subtract( effmass , y2 ) ;
-  
-  // is E^{-m(t-1)} + E^{-m(t+1)}
-  struct resampled temp = init_dist( &y1 , y1.NSAMPLES , y1.restype ) ;
-  add( &temp , y2 ) ;
-  
-  // divide the two and take the tanh
-  divide( effmass , temp ) ;
-
-  // if it is still negative we set to zero
-  if( atanh_range( *effmass ) == true ) {
-    zero_effmass( effmass , y1 ) ;
-  } else {
-    res_atanh( effmass ) ;
+  if( j == 0 ) {
+    return log_slice( y , x , j , 1 , 1 ) ;
   }
-
-  //
-  free( temp.resampled ) ;
-  
-  return ;
-}
-
-// acosh effmass
-static void
-acosh_effmass( struct resampled *effmass ,
-	       struct resampled y1 ,
-	       struct resampled y2 ,
-	       struct resampled y3 )
-{
-  equate( effmass , y1 ) ;
-  add( effmass , y3 ) ;
-  divide( effmass , y2 ) ;
-  mult_constant( effmass , 0.5 ) ;
-    
-  // if it is still negative we set to zero
-  if( acosh_range( *effmass ) == true ) {
-    zero_effmass( effmass , y2 ) ;
-  } else {
-    res_acosh( effmass ) ;
+  if( j == Ndata-1 ) {
+    return log_slice( y , x , j-1 , 1 , 1 ) ;
+  }
+  struct em_slice S = { &y[j-1] , &y[j] , &y[j+1] , NULL , NULL , EM_LOG , 1 } ;
+  switch( type ) {
+  case LOGBWD_EFFMASS :
+    S = log_slice( y , x , j-1 , 1 , -1 ) ;
+    S.x1 = &x[j-1] ; S.x2 = &x[j] ;
+    return S ;
+  case ATANH_EFFMASS :
+    S.f = EM_ATANH ;
+    S.y2 = &y[j+1] ;
+    return S ;
+  case ACOSH_EFFMASS :
+    S.f = EM_ACOSH ;
+    return S ;
+  case ASINH_EFFMASS :
+    S.f = EM_ASINH ;
+    return S ;
+  default :
+    return log_slice( y , x , j , 1 , 1 ) ;
   }
-
-  return ;
 }
 
-// asinh effective mass
+// one timeslice for all samples, any sample outside the domain zeroes
+// the whole timeslice as before. The check is done in the same pass
 static void
-asinh_effmass( struct resampled *effmass ,
-	       struct resampled y1 ,
-	       struct resampled y2 ,
-	       struct resampled y3 )
+effmass_slice( struct resampled *m ,
+	       const struct em_slice S )
 {
-  if( y2.avg == 0.0 ) { zero_effmass( effmass , y2 ) ; return ; }
-  
-  // compute ( y[i+1] - y[i-1] / y[i] ) 
-  equate( effmass , y1 ) ;
-  subtract( effmass , y3 ) ;
-  //add( effmass , y3 ) ;
-  divide( effmass , y2 ) ;
-  mult_constant( effmass , 0.5 ) ;
-    
-  // asinh is valid for all inputs apart from exact zeros
-  res_asinh( effmass ) ;
+  const size_t N = m -> NSAMPLES ;
+  const double *y1 = S.y1 -> resampled , *y2 = S.y2 -> resampled ;
+  const double *y3 = ( S.y3 != NULL ) ? S.y3 -> resampled : y1 ;
+  double *r = m -> resampled ;
+  size_t k ;
+  int bad = 0 ;
+
+  if( ( S.f == EM_LOG && ( S.y1 -> avg == 0.0 || S.y2 -> avg == 0.0 ) ) ||
+      ( S.f == EM_ASINH && S.y2 -> avg == 0.0 ) ) {
+    zero_effmass( m ) ;
+    return ;
+  }
 
+  #pragma omp simd reduction(|:bad)
+  for( k = 0 ; k < N ; k++ ) {
+    r[k] = em_arg( S.f , y1[k] , y2[k] , y3[k] ) ;
+    bad |= em_bad( S.f , r[k] ) ;
+  }
+  if( bad ) {
+    zero_effmass( m ) ;
+    return ;
+  }
+  const double avg = em_arg( S.f , S.y1 -> avg , S.y2 -> avg ,
+			     S.y3 != NULL ? S.y3 -> avg : 0.0 ) ;
+  if( S.f == EM_LOG ) {
+    const double *x1 = S.x1 -> resampled , *x2 = S.x2 -> resampled ;
+    #pragma omp simd
+    for( k = 0 ; k < N ; k++ ) {
+      r[k] = em_apply( S , r[k] , x1[k] , x2[k] ) ;
+    }
+    m -> avg = em_apply( S , avg , S.x1 -> avg , S.x2 -> avg ) ;
+  } else {
+    #pragma omp simd
+    for( k = 0 ; k < N ; k++ ) {
+      r[k] = em_apply( S , r[k] , 0 , 0 ) ;
+    }
+    m -> avg = em_apply( S , avg , 0 , 0 ) ;
+  }
+  compute_err( m ) ;
   return ;
 }
 
@@ -215,25 +227,54 @@ newton_meff( const double initialguess ,
   return meff ;
 }
 
-// iterative cosh
+// k == NSAMPLES is the average
+static inline double
+lane( const struct resampled y ,
+      const size_t k )
+{
+  return k == y.NSAMPLES ? y.avg : y.resampled[k] ;
+}
+
+// iterative masses of the interior timeslices, each sample runs along
+// t warm-started from its solution at the previous timeslice
 static void
 iterative_mass( struct resampled *effmass ,
-		struct resampled y1 , struct resampled y2 ,
-		struct resampled x1 , struct resampled x2 ,
+		const struct resampled *y ,
+		const struct resampled *x ,
+		const size_t Ndata ,
 		const int LT ,
 		double (*f)( const double meff , const double ct , const double ct1 , const double t , const double t1 , const double Lt ) )
 {
-  if( y2.avg == 0.0 ) { zero_effmass( effmass , y2 ) ; return ; }
-  if( y1.avg == 0.0 ) { zero_effmass( effmass , y1 ) ; return ; }
-  // do the avg first --> need a more educated guess
-  effmass -> avg = newton_meff( 0.5 , y1.avg , y2.avg , x1.avg , x2.avg , LT , f ) ;
-  for( size_t k = 0 ; k < effmass -> NSAMPLES ; k++ ) {
-    effmass -> resampled[k] = newton_meff( effmass -> avg ,
-					   y1.resampled[k] , y2.resampled[k] ,
-					   x1.resampled[k] , x2.resampled[k] , LT ,
-					   f ) ;
+  if( Ndata < 3 ) return ;
+  const size_t NSAMPLES = effmass[0].NSAMPLES ;
+  bool zero[ Ndata ] ;
+  size_t j ;
+  for( j = 1 ; j < Ndata-1 ; j++ ) {
+    zero[j] = ( y[j].avg == 0.0 || y[j+1].avg == 0.0 ) ;
+  }
+
+  #pragma omp parallel for private(j)
+  for( size_t k = 0 ; k <= NSAMPLES ; k++ ) {
+    double guess = 0.5 ;
+    for( j = 1 ; j < Ndata-1 ; j++ ) {
+      double meff = 0.0 ;
+      if( zero[j] == false ) {
+	meff = newton_meff( guess , lane( y[j] , k ) , lane( y[j+1] , k ) ,
+			    lane( x[j] , k ) , lane( x[j+1] , k ) , LT , f ) ;
+	if( isfinite( meff ) ) {
+	  guess = meff ;
+	}
+      }
+      if( k == NSAMPLES ) {
+	effmass[j].avg = meff ;
+      } else {
+	effmass[j].resampled[k] = meff ;
+      }
+    }
+  }
+  for( j = 1 ; j < Ndata-1 ; j++ ) {
+    compute_err( &effmass[j] ) ;
   }
-  compute_err( effmass ) ;
 }
 
 // computes the effective mass and plots a graph of it
@@ -245,76 +286,33 @@ effective_mass( struct input_params *Input ,
   
   struct resampled *effmass = malloc( Input -> Data.Ntot * sizeof( struct resampled ) ) ;
 
-  size_t i , j , shift = 0 ;
+  const bool iterative = ( type == ACOSH_ITERATIVE_EFFMASS ||
+			   type == ASINH_ITERATIVE_EFFMASS ) ;
+  size_t i , shift = 0 ;
   for( i = 0 ; i < Input -> Data.Nsim ; i++ ) {
-    for( j = shift ; j < shift + Input -> Data.Ndata[i] ; j++ ) {
+    const size_t Ndata = Input -> Data.Ndata[i] ;
+    const struct resampled *y = Input -> Data.y + shift ;
+    const struct resampled *x = Input -> Data.x + shift ;
+    struct resampled *m = effmass + shift ;
 
-      effmass[j].NSAMPLES = Input -> Data.y[j].NSAMPLES ;
-      effmass[j].restype  = Input -> Data.y[j].restype ;
-      effmass[j].resampled = malloc( Input -> Data.y[j].NSAMPLES * sizeof( double ) ) ;
-
-      if( j == shift ) {
-	log_effmass( &effmass[j] ,
-		     Input -> Data.y[j] , Input -> Data.y[j+1] ,
-		     Input -> Data.x[j+1] , Input -> Data.x[j] ) ;
-      } else if( j == ( shift + Input -> Data.Ndata[i] - 1 ) ) {
-	log_effmass( &effmass[j] ,
-		     Input -> Data.y[j-1] , Input -> Data.y[j] ,
-		     Input -> Data.x[j] , Input -> Data.x[j-1] ) ;
-      } else {
-
-	// switch the various effective masses
-	switch( type ) {
-	case LOG_EFFMASS :
-	case LOGFWD_EFFMASS :
-	  log_effmass( &effmass[j] ,
-		       Input -> Data.y[j] , Input -> Data.y[j+1] ,
-		       Input -> Data.x[j+1] , Input -> Data.x[j] ) ;
-	  break ;
-	case LOGBWD_EFFMASS :
-	  log_effmass( &effmass[j] ,
-		       Input -> Data.y[j-1] , Input -> Data.y[j] ,
-		       Input -> Data.x[j-1] , Input -> Data.x[j] ) ;
-	  mult_constant( &effmass[j] , -1 ) ;
-	  break ;
-	case ATANH_EFFMASS :
-	  atanh_effmass( &effmass[j] ,
-			 Input -> Data.y[j-1] , Input -> Data.y[j+1] ) ;
-	  break ;
-	case ACOSH_EFFMASS :
-	  acosh_effmass( &effmass[j] ,
-			 Input -> Data.y[j-1] ,
-			 Input -> Data.y[j] ,
-			 Input -> Data.y[j+1] ) ;
-	  break ;
-	case ACOSH_ITERATIVE_EFFMASS :
-	  iterative_mass( &effmass[j] ,
-			  Input -> Data.y[j] , Input -> Data.y[j+1] ,
-			  Input -> Data.x[j] , Input -> Data.x[j+1] ,
-			  Input -> Traj[i].Dimensions[3] , fcosh ) ;
-	  break ;
-	case ASINH_EFFMASS :
-	  asinh_effmass( &effmass[j] ,
-			 Input -> Data.y[j-1] ,
-			 Input -> Data.y[j] ,
-			 Input -> Data.y[j+1] ) ;
-	  break ;
-	case ASINH_ITERATIVE_EFFMASS :
-	  iterative_mass( &effmass[j] ,
-			  Input -> Data.y[j] , Input -> Data.y[j+1] ,
-			  Input -> Data.x[j] , Input -> Data.x[j+1] ,
-			  Input -> Traj[i].Dimensions[3] , fsinh ) ;
-	  break ;
-	default :
-	  // do nothing
-	  break ;
-	}
+    #pragma omp parallel for
+    for( size_t j = 0 ; j < Ndata ; j++ ) {
+      m[j].NSAMPLES = y[j].NSAMPLES ;
+      m[j].restype  = y[j].restype ;
+      m[j].resampled = malloc( y[j].NSAMPLES * sizeof( double ) ) ;
+      if( iterative == false || j == 0 || j == Ndata-1 ) {
+	effmass_slice( &m[j] , set_slice( y , x , j , Ndata , type ) ) ;
       }
     }
-    plot_data( Input -> Data.x + shift , effmass + shift ,
-	       Input -> Data.Ndata[i] ) ;
+
+    if( iterative ) {
+      iterative_mass( m , y , x , Ndata , Input -> Traj[i].Dimensions[3] ,
+		      type == ACOSH_ITERATIVE_EFFMASS ? fcosh : fsinh ) ;
+    }
+
+    plot_data( Input -> Data.x + shift , effmass + shift , Ndata ) ;
     
-    shift = j ;
+    shift += Ndata ;
   }
 
   close_xmgrace_graph() ;
@@ -5,10 +5,24 @@
    Solves the system
 
    A.v = \lambda B.v
-   
-   where A and B are real matrices
 
-   Uses GSL's eigenvalue sort routines for the eigenvalues
+   where A = C(t) and B = C(t0) are real matrices
+
+   By default B is symmetrised and cholesky factorised once per
+   sample, B = L.L^T, and each timeslice solves
+
+   L^{-1}.A.L^{-T} w = \lambda w , v = L^{-T} w
+
+   The general solver is used if B is not positive definite or if
+   GENERAL_GEVP is defined. With more operators than states every
+   timeslice is projected onto the leading singular vectors of the
+   average C(t0), then solved with the general solver.
+
+   Each thread has its own workspace.
+
+   States are ordered by eigenvalue once, for the average just after
+   t0. After that they follow the largest C(t0) overlap of their
+   eigenvectors so that level crossings and noise do not swap them
  */
 #include "gens.h"
 
@@ -18,574 +32,712 @@
 
 #include "stats.h"
 
-//#define ABS_EVALUES
-
 #define OPTIMISED_CORRELATOR
 
-//#define SYMMETRIC_GEVP
+//#define GENERAL_GEVP
 
 struct GEVP_temps {
+  // symmetric reduced problem
+  gsl_matrix *red ;
+  gsl_vector *eval ;
+  gsl_matrix *revec ;
+  gsl_eigen_symmv_workspace *symm ;
+  // general problem
   gsl_matrix *a ;
   gsl_matrix *b ;
-#ifdef SYMMETRIC_GEVP
-  gsl_eigen_gensymmv_workspace *work ;
-  double *ev ;
-  gsl_matrix *evec ;
-  gsl_vector *eval ;
-#else
   gsl_eigen_genv_workspace *work ;
   gsl_vector_complex *alpha ;
   gsl_vector *beta ;
-  gsl_matrix_complex *evec ;
-  double complex *ev ;
-#endif
-  double *evec_norm ;
-  size_t N ;
+  gsl_matrix_complex *cevec ;
+  // cholesky factor of B, lower triangular
+  double *L ;
+  bool has_L ;
+  // rectangular projector U, U^T.C(t0) and U^T.C(t)
+  gsl_matrix *U ;
+  gsl_matrix *Q ;
+  gsl_vector *S ;
+  double *PB , *PC ;
+  // linearised C(t) and C(t0)
+  double *C0 , *C1 ;
+  // real eigenvalues and unit eigenvectors, vector a is evec[ N*a ]
+  double *ev ;
+  double *evec ;
+  size_t N , M ;
 } ;
 
-#ifdef SYMMETRIC_GEVP
-  static int
-  comp_desc( const double ev1 ,
-	     const double ev2 )
-  {
-    return ev1 < ev2 ;
+// k == NSAMPLES is the average
+static inline double
+get_sample( const struct resampled y ,
+	    const size_t k )
+{
+  return k == y.NSAMPLES ? y.avg : y.resampled[k] ;
+}
+
+static inline void
+set_sample( struct resampled *y ,
+	    const size_t k ,
+	    const double val )
+{
+  if( k == y -> NSAMPLES ) {
+    y -> avg = val ;
+  } else {
+    y -> resampled[k] = val ;
   }
-  static int
-  comp_asc( const double ev1 ,
-	    const double ev2 )
-  {
-    return ev1 > ev2 ;
+}
+
+// put the correlator matrix at time t in a linearised matrix
+static void
+get_matrix( double *C ,
+	    const struct resampled *y ,
+	    const size_t t ,
+	    const size_t k ,
+	    const size_t Ndata ,
+	    const size_t NM )
+{
+  size_t i ;
+  for( i = 0 ; i < NM ; i++ ) {
+    C[i] = get_sample( y[ t + Ndata*i ] , k ) ;
   }
-#else
-  #ifdef ABS_EVALUES
-  static int
-  comp_desc( const double complex ev1 ,
-	     const double complex ev2 )
-  {
-    return cabs(ev1) < cabs(ev2) ;
+}
+
+// lower triangular cholesky factor of the symmetrised B
+static int
+cholesky( double *L ,
+	  const double *B ,
+	  const size_t N )
+{
+  size_t i , j , k ;
+  for( i = 0 ; i < N ; i++ ) {
+    for( j = 0 ; j <= i ; j++ ) {
+      register double sum = 0.5 * ( B[ j + N*i ] + B[ i + N*j ] ) ;
+      for( k = 0 ; k < j ; k++ ) {
+	sum -= L[ k + N*i ] * L[ k + N*j ] ;
+      }
+      if( i == j ) {
+	if( !( sum > 0.0 ) ) return FAILURE ;
+	L[ i + N*i ] = sqrt( sum ) ;
+      } else {
+	L[ j + N*i ] = sum / L[ j + N*j ] ;
+      }
+    }
+    for( j = i+1 ; j < N ; j++ ) {
+      L[ j + N*i ] = 0.0 ;
+    }
   }
+  return SUCCESS ;
+}
 
-  static int
-  comp_asc( const double complex ev1 ,
-	    const double complex ev2 )
-  {
-    return cabs(ev1) > cabs(ev2) ;
+// out = U^T.C for the M x N correlator matrix C
+static void
+project_tls( double *out ,
+	     const gsl_matrix *U ,
+	     const double *C ,
+	     const size_t N ,
+	     const size_t M )
+{
+  size_t a , i , j ;
+  for( a = 0 ; a < N ; a++ ) {
+    for( j = 0 ; j < N ; j++ ) {
+      register double sum = 0.0 ;
+      for( i = 0 ; i < M ; i++ ) {
+	sum += gsl_matrix_get( U , i , a ) * C[ j + N*i ] ;
+      }
+      out[ j + N*a ] = sum ;
+    }
   }
-  #else
-  static int
-  comp_desc( const double complex ev1 ,
-	     const double complex ev2 )
-  {
-    return creal(ev1) < creal(ev2) ;
+}
+
+// leading N left singular vectors of the M x N matrix C(t0), if
+// new_U is false we keep the one we have
+static int
+tls_projector( struct GEVP_temps *G ,
+	       const bool new_U )
+{
+  const size_t N = G -> N , M = G -> M ;
+  size_t i , j ;
+  if( new_U == false ) {
+    project_tls( G -> PB , G -> U , G -> C1 , N , M ) ;
+    return SUCCESS ;
   }
-  static int
-  comp_asc( const double complex ev1 ,
-	    const double complex ev2 )
-  {
-    return creal(ev1) > creal(ev2) ;
+  for( i = 0 ; i < M ; i++ ) {
+    for( j = 0 ; j < N ; j++ ) {
+      gsl_matrix_set( G -> U , i , j , G -> C1[ j + N*i ] ) ;
+    }
   }
-  #endif
-#endif
+  if( gsl_linalg_SV_decomp_jacobi( G -> U , G -> Q , G -> S ) ) {
+    fprintf( stderr , "[SVD] GSL SVD comp failure \n" ) ;
+    return FAILURE ;
+  }
+  project_tls( G -> PB , G -> U , G -> C1 , N , M ) ;
+  return SUCCESS ;
+}
 
-// sort by whatever I specify in comp at the moment just eigenvalues
-static void
-insertion_sort( struct GEVP_temps *G ,
-		#ifdef SYMMETRIC_GEVP
-		int (*comp)( const double ev1 ,
-			     const double ev2 )
-		#else
-		int (*comp)( const double complex ev1 ,
-			     const double complex ev2 )
-		#endif
-		)
+// factorise C(t0) sitting in C1, if cholesky fails we use the general
+// solver. Rectangular problems get their projector instead
+static int
+factorise_t0( struct GEVP_temps *G ,
+	      const bool new_U )
 {
-  #ifdef SYMMETRIC_GEVP
-  gsl_vector *tevec = gsl_vector_alloc( G -> N ) ;
-  #else
-  gsl_vector_complex *tevec = gsl_vector_complex_alloc( G -> N ) ;
-  #endif
-  
-  size_t i , j ;
-  for( i = 0 ; i < G -> N ; i++ ) {
+  G -> has_L = false ;
+  if( G -> N != G -> M ) {
+    return tls_projector( G , new_U ) ;
+  }
+#ifndef GENERAL_GEVP
+  G -> has_L = ( cholesky( G -> L , G -> C1 , G -> N ) == SUCCESS ) ;
+#endif
+  return SUCCESS ;
+}
 
-    const double complex ev1 = G -> ev[i] ;
-    for( j = 0 ; j < G -> N ; j++ ) {
-#ifdef SYMMETRIC_GEVP
-      gsl_vector_set( tevec , j , gsl_matrix_get( G->evec , j , i ) ) ;
+// solves L^{-1}.A.L^{-T} w = \lambda w and sets v = L^{-T} w
+static int
+reduced_gevp( struct GEVP_temps *G )
+{
+  const size_t N = G -> N ;
+  const double *L = G -> L ;
+  double X[ N*N ] , R[ N*N ] ;
+  size_t i , j , k ;
 
-#else
-      gsl_vector_complex_set( tevec , j ,
-			      gsl_matrix_complex_get( G->evec , j , i ) ) ;
-#endif
+  // X = L^{-1}.A by forward substitution down each column
+  for( j = 0 ; j < N ; j++ ) {
+    for( i = 0 ; i < N ; i++ ) {
+      register double sum = 0.5 * ( G -> C0[ j + N*i ] + G -> C0[ i + N*j ] ) ;
+      for( k = 0 ; k < i ; k++ ) {
+	sum -= L[ k + N*i ] * X[ j + N*k ] ;
+      }
+      X[ j + N*i ] = sum / L[ i + N*i ] ;
     }
-    
-    int hole = (int)i - 1 ;
-    while( hole >= 0 && comp( G -> ev[hole] , ev1 ) ) {
-      // copy data
-      G -> ev[hole+1] = G -> ev[hole] ;
-      for( j = 0 ; j < G -> N ; j++ ) {
-#ifdef SYMMETRIC_GEVP
-        gsl_matrix_set( G->evec , j , hole+1 ,
-			gsl_matrix_get( G->evec , j , hole ) ) ;
-#else
-        gsl_matrix_complex_set( G->evec , j , hole+1 ,
-				gsl_matrix_complex_get( G->evec , j , hole ) ) ;
-#endif
+  }
+  // A is symmetric so L^{-1}.A.L^{-T} = L^{-1}.X^T
+  for( j = 0 ; j < N ; j++ ) {
+    for( i = 0 ; i < N ; i++ ) {
+      register double sum = X[ i + N*j ] ;
+      for( k = 0 ; k < i ; k++ ) {
+	sum -= L[ k + N*i ] * R[ j + N*k ] ;
       }
-      hole-- ;
+      R[ j + N*i ] = sum / L[ i + N*i ] ;
     }
-    G -> ev[hole+1] = ev1 ;
-    for( j = 0 ; j < G -> N ; j++ ) {
-#ifdef SYMMETRIC_GEVP
-      gsl_matrix_set( G -> evec , j , hole+1 , gsl_vector_get( tevec , j ) ) ;
-#else
-      gsl_matrix_complex_set( G -> evec , j , hole+1 ,
-			      gsl_vector_complex_get( tevec , j ) ) ;
-#endif
+  }
+  for( i = 0 ; i < N ; i++ ) {
+    for( j = 0 ; j < N ; j++ ) {
+      gsl_matrix_set( G -> red , i , j , R[ j + N*i ] ) ;
     }
   }
 
-#ifdef SYMMETRIC_GEVP
-  gsl_vector_free( tevec ) ;
-#else
-  gsl_vector_complex_free( tevec ) ;
-#endif
-  return ;
-}
+  const int err = gsl_eigen_symmv( G -> red , G -> eval ,
+				   G -> revec , G -> symm ) ;
+  if( err != 0 ) {
+    fprintf( stderr , "%s\n" , gsl_strerror( err ) ) ;
+    return FAILURE ;
+  }
 
-#ifdef OPTIMISED_CORRELATOR
+  // back substitute v = L^{-T} w and normalise
+  for( j = 0 ; j < N ; j++ ) {
+    double *v = G -> evec + N*j ;
+    register double norm = 0.0 ;
+    for( i = N ; i-- > 0 ; ) {
+      register double sum = gsl_matrix_get( G -> revec , i , j ) ;
+      for( k = i+1 ; k < N ; k++ ) {
+	sum -= L[ i + N*k ] * v[k] ;
+      }
+      v[i] = sum / L[ i + N*i ] ;
+      norm += v[i] * v[i] ;
+    }
+    norm = 1.0 / sqrt( norm ) ;
+    for( i = 0 ; i < N ; i++ ) {
+      v[i] *= norm ;
+    }
+    G -> ev[j] = gsl_vector_get( G -> eval , j ) ;
+  }
+  return SUCCESS ;
+}
 
-// compute the "optimised correlator" from the eigenvectors
+// set the a and b matrices, projecting if rectangular
 static void
-optimised_correlator( struct GEVP_temps *G ,
-		      const struct resampled *y ,
-		      const size_t k ,
-		      const bool is_avg ,
-		      const size_t N ,
-		      const size_t M ,
-		      const size_t Ndata ,
-		      const size_t td )
+set_ab( struct GEVP_temps *G )
 {
-  // check diagonalisation with V^\dag C(t) V
-  double C0[ N*M ] ;
-  double complex V2[N][N][N];
-  for( size_t a = 0 ; a < N ; a++ ) {
-    for( size_t b = 0 ; b < N ; b++ ) {
-      const double complex v1 = conj( gsl_matrix_complex_get( G[td].evec , b , a ) ) ;
-      for( size_t c = 0 ; c < N ; c++ ) {
-	const double complex v2 = gsl_matrix_complex_get( G[td].evec , c , a ) ;
-	V2[a][b][c] = v1*v2 ;
-      }
+  const size_t N = G -> N ;
+  const double *A = G -> C0 , *B = G -> C1 ;
+  size_t i , j ;
+  if( N != G -> M ) {
+    project_tls( G -> PC , G -> U , G -> C0 , N , G -> M ) ;
+    A = G -> PC ;
+    B = G -> PB ;
+  }
+  for( i = 0 ; i < N ; i++ ) {
+    for( j = 0 ; j < N ; j++ ) {
+      gsl_matrix_set( G -> a , i , j , A[ j + N*i ] ) ;
+      gsl_matrix_set( G -> b , i , j , B[ j + N*i ] ) ;
     }
   }
-    
-  for( size_t j = 0 ; j < Ndata ; j++ ) {    
-    // put these in the linearised matrices
-    size_t shift = 0 ;
-    for( size_t i = 0 ; i < N*M ; i++ ) {
-      if( is_avg == true ) {
-	C0[i] = y[ j  + shift ].avg ;
-      } else {
-	C0[i] = y[ j  + shift ].resampled[k] ;
+  return ;
+}
+
+// uses GSL's general solver, the eigenvectors are rotated so that
+// their largest component is real and we keep the real part
+static int
+general_gevp( struct GEVP_temps *G )
+{
+  const size_t N = G -> N ;
+  size_t i , j ;
+
+  set_ab( G ) ;
+
+  const int err = gsl_eigen_genv( G -> a , G -> b , G -> alpha ,
+				  G -> beta , G -> cevec , G -> work ) ;
+  if( err != 0 ) {
+    fprintf( stderr , "%s\n" , gsl_strerror( err ) ) ;
+    return FAILURE ;
+  }
+
+  for( j = 0 ; j < N ; j++ ) {
+    const gsl_complex al = gsl_vector_complex_get( G -> alpha , j ) ;
+    G -> ev[j] = GSL_REAL( al ) / gsl_vector_get( G -> beta , j ) ;
+
+    double re = 1.0 , im = 0.0 , max = -1.0 ;
+    for( i = 0 ; i < N ; i++ ) {
+      const gsl_complex z = gsl_matrix_complex_get( G -> cevec , i , j ) ;
+      const double mod = hypot( GSL_REAL( z ) , GSL_IMAG( z ) ) ;
+      if( mod > max ) {
+	max = mod ; re = GSL_REAL( z ) ; im = GSL_IMAG( z ) ;
       }
-      shift += Ndata ;
     }
-    // diagonalise
-    double complex *p1 = (double complex*)V2 ;
-    for( size_t a = 0 ; a < N ; a++ ) {
-      double *p2 = (double*)C0 ;
-      register double sum = 0.0 ;
-      for( size_t i = 0 ; i < N*N ; i++ ) {
-	sum += creal((*p1))*(*p2) ;
-	p1++ ; p2++ ;
-      }
-      G[j].ev[a] = creal(sum) ;
+    double *v = G -> evec + N*j ;
+    register double norm = 0.0 ;
+    for( i = 0 ; i < N ; i++ ) {
+      const gsl_complex z = gsl_matrix_complex_get( G -> cevec , i , j ) ;
+      v[i] = ( GSL_REAL( z ) * re + GSL_IMAG( z ) * im ) ;
+      norm += v[i] * v[i] ;
+    }
+    norm = norm > 0.0 ? 1.0 / sqrt( norm ) : 0.0 ;
+    for( i = 0 ; i < N ; i++ ) {
+      v[i] *= norm ;
     }
   }
-  return ;
+  return SUCCESS ;
 }
 
-// compute the "optimised correlator" from the eigenvectors
+// sort eigenpairs ascending before t0 and descending after
 static void
-optimised_correlator2( struct GEVP_temps *G1 ,
-		       const struct GEVP_temps G2 ,
-		       const double *C0 ,
-		       const size_t N )
+insertion_sort( struct GEVP_temps *G ,
+		const bool before )
 {
-  size_t a , b , c ;
-  for( a = 0 ; a < N ; a++ ) {
-#ifdef SYMMETRIC_GEVP
-    register double Sum1 = 0. ;
-#else
-    register double complex Sum1 = 0. ;
-#endif
-    for( b = 0 ; b < N ; b++ ) {
-      #ifdef SYMMETRIC_GEVP
-      register double Sum1 = 0. ;
-      const double A = gsl_matrix_get( G2.evec , b , a ) ;
-      const double AC = A ;
-      #else
-      register double complex Sum1 = 0. ;
-      const gsl_complex A = gsl_matrix_complex_get( G2.evec , b , a ) ;
-         #if GSL_MINOR_VERSION > 6
-         const double complex AC = conj( A ) ;
-         #else
-         const double complex AC = A.dat[0] - I*A.dat[1] ;
-         #endif
-      #endif
-      for( c = 0 ; c < N ; c++ ) {
-	#ifdef SYMMETRIC_GEVP
-	const double B = gsl_matrix_get( G2.evec , c , a ) ;
-	const double BC = B ;
-        #else
-	const gsl_complex B = gsl_matrix_complex_get( G2.evec , c , a ) ;
-           #if GSL_MINOR_VERSION > 6
-	   const double complex BC = B ;
-           #else
-	   const double complex BC = B.dat[0] + I*B.dat[1] ;
-           #endif
-	#endif
-	Sum1 += AC * BC * C0[ c + N*b ] ;
+  const size_t N = G -> N ;
+  double tevec[ N ] ;
+  size_t i , j ;
+  for( i = 1 ; i < N ; i++ ) {
+    const double ev1 = G -> ev[i] ;
+    memcpy( tevec , G -> evec + N*i , N*sizeof( double ) ) ;
+    int hole = (int)i - 1 ;
+    while( hole >= 0 && ( before ? G -> ev[hole] > ev1 :
+			  G -> ev[hole] < ev1 ) ) {
+      G -> ev[hole+1] = G -> ev[hole] ;
+      for( j = 0 ; j < N ; j++ ) {
+	G -> evec[ j + N*(hole+1) ] = G -> evec[ j + N*hole ] ;
       }
+      hole-- ;
     }
-    #ifdef SYMMETRIC_GEVP
-    G1 -> ev[a] = Sum1 ;
-    #else
-    G1 -> ev[a] = creal( Sum1 ) ;
-    #endif
+    G -> ev[hole+1] = ev1 ;
+    memcpy( G -> evec + N*(hole+1) , tevec , N*sizeof( double ) ) ;
   }
 }
-#endif
 
-// uses GSL to solve a generalised eigenvalue problem
-// returns the real part of the eigenvalues
-// solves A.v = \lambda B.v
-// where A and B are real matrices
+// solves A.v = \lambda B.v for A in C0 and B in C1 which
+// must have been factorised with factorise_t0
 static int
 gevp2( struct GEVP_temps *G ,
-       const size_t n ,
-       const bool before ,
-       const size_t t ,
-       const bool write_evalues ) 
+       const bool before )
 {
-  int flag = SUCCESS ;
-  
-  // perform decomposition
-#ifdef SYMMETRIC_GEVP
-  const int err = gsl_eigen_gensymmv( G[t].a , G[t].b ,
-				      G[t].eval , G[t].evec , G[t].work ) ;
-#else
-  const int err = gsl_eigen_genv( G[t].a , G[t].b , G[t].alpha ,
-				  G[t].beta , G[t].evec , G[t].work ) ;
-#endif
-  if( err != 0 ) {
-    fprintf( stderr , "%s\n" , gsl_strerror( err ) ) ;
-    fprintf( stderr , "GEVP Aborting\n" ) ;
-    flag = FAILURE ;
-  }
-
-#ifndef OPTIMISED_CORRELATOR
-  // set the ev
   size_t i ;
+  const int flag = G -> has_L ? reduced_gevp( G ) : general_gevp( G ) ;
+  if( flag == FAILURE ) {
+    fprintf( stderr , "[GEVP] Aborting\n" ) ;
+    return FAILURE ;
+  }
   for( i = 0 ; i < G -> N ; i++ ) {
-    #ifdef SYMMETRIC_GEVP
-    G[t].ev[i] = gsl_vector_get( G[t].eval , i ) ;
-    #else
-    G[t].ev[i] = gsl_vector_complex_get( G[t].alpha , i )/gsl_vector_get( G[t].beta , i ) ;
-    if( creal( G[t].ev[i] ) < 0.0 ) {
-      G[t].ev[i] = 1E-16 ;
+    if( G -> ev[i] < 0.0 ) {
+      G -> ev[i] = 1E-16 ;
     }
-    #endif
   }
+  insertion_sort( G , before ) ;
+  return SUCCESS ;
+}
 
-  // sort by the real part
-  if( before ) {
-    insertion_sort( &G[t] , comp_asc ) ;
-  } else {
-    insertion_sort( &G[t] , comp_desc ) ;
+static void
+write_evalues( const struct GEVP_temps *G ,
+	       const size_t t )
+{
+  size_t j , nevec ;
+  for( j = 0 ; j < G -> N ; j++ ) {
+    fprintf( stdout , "STATE_%zu %zu evalue %e\n" , j , t , G -> ev[j] ) ;
+    for( nevec = 0 ; nevec < G -> N ; nevec++ ) {
+      fprintf( stdout , "STATE_%zu %zu evec %zu %e\n" ,
+	       j , t , nevec , G -> evec[ nevec + G -> N * j ] ) ;
+    }
   }
+}
 
-  size_t j ;
-  for( j = 0 ; j < G -> N ; j++ ) {
-    if( write_evalues ) {
-      // if we want them written
-      fprintf( stdout , "STATE_%zu %zu evalue %e %e \n" ,
-	       j , t , creal( G -> ev[j]) , cimag( G -> ev[j]) ) ;
-      size_t nevec ;
-      for( nevec = 0 ; nevec < G->N ; nevec++ ) {
-	fprintf( stdout , "STATE_%zu %zu evec %zu %e %e\n" ,
-		 j , t , nevec ,
-		 #ifdef SYMMETRIC_GEVP
-		 ( gsl_matrix_get( G -> evec , nevec , j ) ) , 0.0 
-		 #else
-		 ( creal( gsl_matrix_complex_get( G -> evec , nevec , j ) ) )
-		 ,
-		 ( cimag( gsl_matrix_complex_get( G -> evec , j , nevec ) ) )
-		 #endif
-		 ) ;
-      }
-      //
+#ifdef OPTIMISED_CORRELATOR
+// the "optimised correlator" v_a^T C(t) v_a for the N x N C(t)
+static double
+optimised_correlator( const struct GEVP_temps *G ,
+		      const double *C ,
+		      const size_t a )
+{
+  const size_t N = G -> N ;
+  const double *v = G -> evec + N*a ;
+  register double sum = 0.0 ;
+  size_t b , c ;
+  for( b = 0 ; b < N ; b++ ) {
+    register double sumc = 0.0 ;
+    for( c = 0 ; c < N ; c++ ) {
+      sumc += C[ c + N*b ] * v[c] ;
     }
+    sum += v[b] * sumc ;
   }
+  return sum ;
+}
 #endif
 
-  return flag ;
+// |<u|B|v>| normalised by the B-norms of u and v, B is the symmetrised
+// C(t0) or the identity for the rectangular case
+static double
+overlap( const struct GEVP_temps *G ,
+	 const double *u ,
+	 const double *v )
+{
+  const size_t N = G -> N ;
+  register double uv = 0.0 , uu = 0.0 , vv = 0.0 ;
+  size_t b , c ;
+  if( G -> N != G -> M ) {
+    for( b = 0 ; b < N ; b++ ) {
+      uv += u[b] * v[b] ; uu += u[b] * u[b] ; vv += v[b] * v[b] ;
+    }
+  } else {
+    for( b = 0 ; b < N ; b++ ) {
+      for( c = 0 ; c < N ; c++ ) {
+	const double B = 0.5 * ( G -> C1[ c + N*b ] + G -> C1[ b + N*c ] ) ;
+	uv += u[b] * B * v[c] ;
+	uu += u[b] * B * u[c] ;
+	vv += v[b] * B * v[c] ;
+      }
+    }
+  }
+  return fabs( uv ) / sqrt( fabs( uu * vv ) ) ;
 }
 
-// take the SVD
-static int 
-svd_TLS( gsl_matrix *a ,
-	 gsl_matrix *b ,
-	 const double *C0 ,
-	 const double *C1 ,
-	 const size_t NROWS ,
-	 const size_t NCOLS )
+// reorder the eigenpairs so state a is the one with the largest
+// overlap with reference vector a, assigned greedily from the largest
+static void
+match_states( struct GEVP_temps *G ,
+	      const double *ref )
 {
-  // allocations
-  gsl_matrix *U  = gsl_matrix_alloc( 2*NROWS , NCOLS ) ;
-  gsl_matrix *Q  = gsl_matrix_alloc( NCOLS , NCOLS ) ;
-  gsl_vector *S  = gsl_vector_alloc( NCOLS ) ;
-  gsl_vector *WORK  = gsl_vector_alloc( NCOLS ) ;
+  const size_t N = G -> N ;
+  double O[ N*N ] , ev[ N ] , evec[ N*N ] ;
+  bool used_ref[ N ] , used_new[ N ] ;
+  size_t perm[ N ] , a , b , n ;
 
-  size_t i , j ;
-  int FLAG = SUCCESS ;
-
-  // initialize our matrix
-  for( i = 0 ; i < NROWS ; i++ ){
-    for( j = 0 ; j < NCOLS ; j++ ) {
-      gsl_matrix_set( U , i , j , C0[j+i*NCOLS] ) ;
-      gsl_matrix_set( U , i + NROWS , j , C1[j+i*NCOLS] ) ;
+  for( a = 0 ; a < N ; a++ ) {
+    for( b = 0 ; b < N ; b++ ) {
+      O[ b + N*a ] = overlap( G , ref + N*a , G -> evec + N*b ) ;
+    }
+    used_ref[a] = used_new[a] = false ;
+    perm[a] = a ;
+  }
+  for( n = 0 ; n < N ; n++ ) {
+    size_t amax = 0 , bmax = 0 ;
+    double max = -1.0 ;
+    for( a = 0 ; a < N ; a++ ) {
+      if( used_ref[a] ) continue ;
+      for( b = 0 ; b < N ; b++ ) {
+	if( used_new[b] == false && O[ b + N*a ] > max ) {
+	  max = O[ b + N*a ] ; amax = a ; bmax = b ;
+	}
+      }
     }
+    perm[ amax ] = bmax ;
+    used_ref[ amax ] = used_new[ bmax ] = true ;
   }
 
-  // perform the decomposition
-  if( gsl_linalg_SV_decomp_jacobi( U , Q , S ) ) {
-    printf( "[SVD] GSL SVD comp failure \n" ) ;
-    FLAG = FAILURE ;
-    goto FREE ;
+  memcpy( ev , G -> ev , N*sizeof( double ) ) ;
+  memcpy( evec , G -> evec , N*N*sizeof( double ) ) ;
+  for( a = 0 ; a < N ; a++ ) {
+    G -> ev[a] = ev[ perm[a] ] ;
+    memcpy( G -> evec + N*a , evec + N*perm[a] , N*sizeof( double ) ) ;
   }
+}
 
-  for( i = 0 ; i < NCOLS ; i++ ) {
-    for( j = 0 ; j < NCOLS ; j++ ) {
-      gsl_matrix_set( a , i , j , gsl_matrix_get( U , i , j ) ) ;
-      gsl_matrix_set( b , i , j , gsl_matrix_get( U , i + NROWS , j ) ) ;
+// timeslice j of sample k, states are labelled like the vectors in
+// ref[ N*N*r ] or by eigenvalue if r is Ndata. The central value's
+// vectors are stored in ref for the bootstraps to follow
+static int
+gevp_slice( struct GEVP_temps *G ,
+	    struct resampled *evalues ,
+	    double *ref ,
+	    const struct resampled *y ,
+	    const size_t k ,
+	    const size_t j ,
+	    const size_t r ,
+	    const size_t Ndata ,
+	    const size_t t0 ,
+	    const bool fixed )
+{
+  const size_t N = G -> N , NM = G -> N * G -> M ;
+  size_t i ;
+  get_matrix( G -> C0 , y , j , k , Ndata , NM ) ;
+  if( fixed ) {
+    get_matrix( G -> C1 , y , (j+t0)%Ndata , k , Ndata , NM ) ;
+    if( factorise_t0( G , true ) == FAILURE ) {
+      return FAILURE ;
     }
   }
-
- FREE :
-  gsl_matrix_free( U ) ;
-  gsl_matrix_free( Q ) ;
-  gsl_vector_free( S ) ;
-  gsl_vector_free( WORK ) ;
-
-  return 0 ;
+  if( gevp2( G , fixed || j < t0 ) == FAILURE ) {
+    return FAILURE ;
+  }
+  if( r < Ndata ) {
+    match_states( G , ref + N*N*r ) ;
+  }
+  if( k == y[0].NSAMPLES ) {
+    memcpy( ref + N*N*j , G -> evec , N*N*sizeof( double ) ) ;
+    write_evalues( G , j ) ;
+  }
+  for( i = 0 ; i < N ; i++ ) {
+    set_sample( &evalues[ j + Ndata*i ] , k , G -> ev[i] ) ;
+  }
+  return SUCCESS ;
 }
 
-// set the a and b matrices
-static void
-set_ab( gsl_matrix *a , gsl_matrix *b ,
-	const double *C0 , const double *C1 ,
-	const size_t N , const size_t M )
+// all timeslices of sample k, against C(t0) which is factorised once
+// or against C(t+t0) if fixed. The central value (k == NSAMPLES) must
+// be done first as it provides the state labels in ref
+static int
+gevp_sample( struct GEVP_temps *G ,
+	     struct resampled *evalues ,
+	     double *ref ,
+	     const struct resampled *y ,
+	     const size_t k ,
+	     const size_t Ndata ,
+	     const size_t t0 ,
+	     const size_t td ,
+	     const bool fixed )
 {
+  const size_t N = G -> N , NM = G -> N * G -> M ;
+  const bool is_avg = ( k == y[0].NSAMPLES ) ;
   size_t i , j ;
-  if( N == M ) {
-    for( i = 0 ; i < N ; i++ ) {
-      for( j = 0 ; j < N ; j++ ) {
-	gsl_matrix_set( a , i , j , *C0 ) ; C0++ ;
-	gsl_matrix_set( b , i , j , *C1 ) ; C1++ ;
+
+  if( fixed == false ) {
+    // the rectangular projector comes from the central value so the
+    // bootstraps are solved in the same basis
+    get_matrix( G -> C1 , y , t0 , k , Ndata , NM ) ;
+    if( factorise_t0( G , is_avg ) == FAILURE ) {
+      return FAILURE ;
+    }
+  }
+
+#ifdef OPTIMISED_CORRELATOR
+  // only the eigenvectors at td are needed
+  if( fixed == false ) {
+    get_matrix( G -> C0 , y , td , k , Ndata , NM ) ;
+    if( gevp2( G , td < t0 ) == FAILURE ) {
+      return FAILURE ;
+    }
+    if( is_avg ) {
+      memcpy( ref , G -> evec , N*N*sizeof( double ) ) ;
+    } else {
+      match_states( G , ref ) ;
+    }
+    const double *C = G -> C0 ;
+    if( N != G -> M ) {
+      C = G -> PC ;
+    }
+    for( j = 0 ; j < Ndata ; j++ ) {
+      get_matrix( G -> C0 , y , j , k , Ndata , NM ) ;
+      if( N != G -> M ) {
+	project_tls( G -> PC , G -> U , G -> C0 , N , G -> M ) ;
+      }
+      for( i = 0 ; i < N ; i++ ) {
+	set_sample( &evalues[ j + Ndata*i ] , k ,
+		    optimised_correlator( G , C , i ) ) ;
       }
     }
-  } else {
-    svd_TLS( a , b , C0 , C1 , M , N ) ;
+    return SUCCESS ;
   }
-  return ;
+#endif
+
+  // bootstraps follow the central value at the same timeslice
+  if( is_avg == false ) {
+    for( j = 0 ; j < Ndata ; j++ ) {
+      if( gevp_slice( G , evalues , ref , y , k , j , j ,
+		      Ndata , t0 , fixed ) == FAILURE ) {
+	return FAILURE ;
+      }
+    }
+    return SUCCESS ;
+  }
+
+  // central value is ordered by eigenvalue just after t0, where it is
+  // cleanest, and each timeslice follows its neighbour from there
+  const size_t tstart = fixed ? 0 : ( t0+1 < Ndata ? t0+1 : Ndata-1 ) ;
+  size_t prev = Ndata ;
+  for( j = tstart ; j < Ndata ; j++ ) {
+    if( gevp_slice( G , evalues , ref , y , k , j , prev ,
+		    Ndata , t0 , fixed ) == FAILURE ) {
+      return FAILURE ;
+    }
+    prev = j ;
+  }
+  prev = tstart ;
+  for( j = tstart ; j-- > 0 ; ) {
+    if( gevp_slice( G , evalues , ref , y , k , j , prev ,
+		    Ndata , t0 , fixed ) == FAILURE ) {
+      return FAILURE ;
+    }
+    prev = j ;
+  }
+  return SUCCESS ;
 }
 
 static void
 allocate_G( struct GEVP_temps *G ,
-	    const size_t N )
+	    const size_t N ,
+	    const size_t M )
 {
-  // set the data
-  G -> a = gsl_matrix_alloc( N , N ) ;
-  G -> b = gsl_matrix_alloc( N , N ) ;
-#ifdef SYMMETRIC_GEVP
-  G -> work  = gsl_eigen_gensymmv_alloc( N ) ;
-  G -> evec  = gsl_matrix_alloc( N , N ) ;
-  G -> evec_norm = malloc( N*sizeof(double) ) ;
-  G -> eval = gsl_vector_alloc( N ) ;
-  G -> ev = malloc( N*sizeof(double) ) ;
-#else
-  // allocations for GSL
+  G -> red   = gsl_matrix_alloc( N , N ) ;
+  G -> eval  = gsl_vector_alloc( N ) ;
+  G -> revec = gsl_matrix_alloc( N , N ) ;
+  G -> symm  = gsl_eigen_symmv_alloc( N ) ;
+  G -> a     = gsl_matrix_alloc( N , N ) ;
+  G -> b     = gsl_matrix_alloc( N , N ) ;
   G -> work  = gsl_eigen_genv_alloc( N ) ;
   G -> alpha = gsl_vector_complex_alloc( N ) ;
   G -> beta  = gsl_vector_alloc( N ) ;
-  G -> evec  = gsl_matrix_complex_alloc( N , N ) ;
-  G -> evec_norm = malloc( N*sizeof(double) ) ;
-  G -> ev = malloc( N*sizeof( double complex ) ) ;
-#endif
+  G -> cevec = gsl_matrix_complex_alloc( N , N ) ;
+  G -> L     = malloc( N*N*sizeof( double ) ) ;
+  G -> U     = gsl_matrix_alloc( M , N ) ;
+  G -> Q     = gsl_matrix_alloc( N , N ) ;
+  G -> S     = gsl_vector_alloc( N ) ;
+  G -> PB    = malloc( N*N*sizeof( double ) ) ;
+  G -> PC    = malloc( N*N*sizeof( double ) ) ;
+  G -> C0    = malloc( N*M*sizeof( double ) ) ;
+  G -> C1    = malloc( N*M*sizeof( double ) ) ;
+  G -> ev    = malloc( N*sizeof( double ) ) ;
+  G -> evec  = malloc( N*N*sizeof( double ) ) ;
+  G -> has_L = false ;
   G -> N = N ;
+  G -> M = M ;
 }
 
 static void
 free_G( struct GEVP_temps *G )
 {
-#ifdef SYMMETRIC_GEVP
-  gsl_matrix_free( G -> evec ) ;
-  gsl_eigen_gensymmv_free( G-> work ) ;
-  gsl_vector_free( G->eval ) ;
-  free( G -> evec_norm ) ;
-#else
-  gsl_matrix_complex_free( G -> evec ) ;
-  gsl_vector_complex_free( G -> alpha ) ;
-  gsl_vector_free( G -> beta ) ;
-  gsl_eigen_genv_free( G-> work ) ;
+  gsl_matrix_free( G -> red ) ;
+  gsl_vector_free( G -> eval ) ;
+  gsl_matrix_free( G -> revec ) ;
+  gsl_eigen_symmv_free( G -> symm ) ;
   gsl_matrix_free( G -> a ) ;
   gsl_matrix_free( G -> b ) ;
+  gsl_eigen_genv_free( G -> work ) ;
+  gsl_vector_complex_free( G -> alpha ) ;
+  gsl_vector_free( G -> beta ) ;
+  gsl_matrix_complex_free( G -> cevec ) ;
+  free( G -> L ) ;
+  gsl_matrix_free( G -> U ) ;
+  gsl_matrix_free( G -> Q ) ;
+  gsl_vector_free( G -> S ) ;
+  free( G -> PB ) ;
+  free( G -> PC ) ;
+  free( G -> C0 ) ;
+  free( G -> C1 ) ;
   free( G -> ev ) ;
-  free( G -> evec_norm ) ;
-#endif
+  free( G -> evec ) ;
 }
 
-// solve the GEVP
-struct resampled *
-solve_GEVP( const struct resampled *y ,
-	    const size_t Ndata ,
-	    const size_t N ,
-	    const size_t M ,
-	    const size_t t0 ,
-	    const size_t td )
+// loops samples and the average in parallel with a workspace per thread
+static struct resampled *
+solve_all( const struct resampled *y ,
+	   const size_t Ndata ,
+	   const size_t N ,
+	   const size_t M ,
+	   const size_t t0 ,
+	   const size_t td ,
+	   const bool fixed )
 {
-  fprintf( stdout , "GEVP solver ----> " ) ;
-  
   if( N > M ) {
     fprintf( stderr , "[GEVP] cannot solve when N states "
 	     "are less than M correlators\n" ) ;
     return NULL ;
   }
 
-  
   // initialise the generalised eigenvalues
+  const size_t NSAMPLES = y[0].NSAMPLES ;
   struct resampled *evalues = malloc( Ndata*N*
 				      sizeof( struct resampled ) ) ;
-  size_t i , j , k ;
+  size_t j , Nfail = 0 ;
   for( j = 0 ; j < Ndata*N ; j++ ) {
-    evalues[j].resampled = malloc( y[0].NSAMPLES *
-				   sizeof( double ) ) ;
+    evalues[j].resampled = malloc( NSAMPLES * sizeof( double ) ) ;
     evalues[j].restype = y[0].restype ;
-    evalues[j].NSAMPLES = y[0].NSAMPLES ;
+    evalues[j].NSAMPLES = NSAMPLES ;
   }
 
-
-  struct GEVP_temps *G = malloc( Ndata*sizeof( struct GEVP_temps ) ) ;
-
-  double C0[ N*M ] , C1[ N*M ] ;
-  
-  // ugh loop order is all weird
-  for( j = 0 ; j < Ndata ; j++ ) {
-    allocate_G( &G[j] , N );
+  // central value first as it labels the states for the bootstraps
+  double *ref = malloc( Ndata*N*N*sizeof( double ) ) ;
+  struct GEVP_temps Gavg ;
+  allocate_G( &Gavg , N , M ) ;
+  if( gevp_sample( &Gavg , evalues , ref , y , NSAMPLES ,
+		   Ndata , t0 , td , fixed ) == FAILURE ) {
+    Nfail = 1 ;
+    goto end ;
   }
-  
-  // loop resamples
-  for( k = 0 ; k < y[0].NSAMPLES ; k++ ) {
-    
-    for( j = 0 ; j < Ndata ; j++ ) {
 
-      // put these in the linearised matrices
-      size_t shift = 0 ;
-      for( i = 0 ; i < N*M ; i++ ) {
-	C0[i] = y[ j  + shift ].resampled[k] ;
-	C1[i] = y[ t0 + shift ].resampled[k] ;
-	shift += Ndata ;
-      }      
-
-      // set AB by squaring the matrices, possibly
-      set_ab( G[j].a , G[j].b , C0 , C1 , N , M ) ;
-      
-      // compute eigenvalues
-      if( gevp2( G , N , j<t0 , j , false ) == FAILURE ) {
-	fprintf( stderr , "[GEVP] GEVP solve failed \n" ) ;
-        return NULL ;
-      }
+  #pragma omp parallel
+  {
+    struct GEVP_temps G ;
+    allocate_G( &G , N , M ) ;
+    if( N != M ) {
+      gsl_matrix_memcpy( G.U , Gavg.U ) ;
     }
 
-#ifdef OPTIMISED_CORRELATOR
-    optimised_correlator( G , y , k , false , N , M , Ndata , td ) ;
-#endif
-    
-    for( j = 0 ; j < Ndata ; j++ ) {
-      // poke into solution
-      for( i = 0 ; i < N ; i++ ) {
-	#ifdef SYMMETRIC_GEVP
-	evalues[j+Ndata*i].resampled[ k ] = gsl_vector_get( G[j].eval , i ) ;
-	#else
-	evalues[j+Ndata*i].resampled[ k ] = creal( G[j].ev[i] ) ;
-	#endif
-      }
-      //
+    #pragma omp for schedule(dynamic) reduction(+:Nfail)
+    for( size_t k = 0 ; k < NSAMPLES ; k++ ) {
+      Nfail += ( gevp_sample( &G , evalues , ref , y , k ,
+			      Ndata , t0 , td , fixed ) == FAILURE ) ;
     }
+    free_G( &G ) ;
   }
 
-  for( j = 0 ; j < Ndata ; j++ ) {
-    // redo for the average
-    size_t shift = 0 ;
-    for( i = 0 ; i < N*M ; i++ ) {
-      C0[i] = y[ j  + shift ].avg ;
-      C1[i] = y[ t0 + shift ].avg ;
-      shift += Ndata ;
-    }
+ end :
+  free_G( &Gavg ) ;
+  free( ref ) ;
 
-    // print the matrices
-    for( i = 0 ; i < N ; i++ ) {
-      for( size_t k = 0 ; k < M ; k++ ) {
-	printf( "%e ", C0[k+i*M] ) ;
-      }
-      printf( "\n" ) ;
-    }
-    printf( "\n" ) ;
-    // print the matrices
-    for( i = 0 ; i < N ; i++ ) {
-      for( size_t k = 0 ; k < M ; k++ ) {
-	printf( "%e ", C1[k+i*M] ) ;
-      }
-      printf( "\n" ) ;
-    }
-    printf( "\n" ) ;
-    
-    // set AB by squaring the matrices possibly
-    set_ab( G[j].a , G[j].b , C0 , C1 , N , M ) ;
-
-    // compute eigenvalues
-    if( gevp2( G , N , j<t0 , j , true ) == FAILURE ) {
-      fprintf( stderr , "[GEVP] GEVP solve failed \n" ) ;
-      return NULL ;
-    }
-  }
-#ifdef OPTIMISED_CORRELATOR
-  optimised_correlator( G , y , 0 , true , N , M , Ndata , td ) ;
-#endif
-  
-  for( j = 0 ; j < Ndata ; j++ ) {
-    // poke into solution
-    for( i = 0 ; i < N ; i++ ) {
-      #ifdef SYMMETRIC_GEVP
-      evalues[j+Ndata*i].avg = gsl_vector_get( G[j].eval , i ) ;
-      #else
-      evalues[j+Ndata*i].avg = creal( G[j].ev[i] ) ;
-      #endif
-      compute_err( &evalues[j+Ndata*i] ) ;
+  if( Nfail > 0 ) {
+    fprintf( stderr , "[GEVP] GEVP solve failed for %zu samples\n" , Nfail ) ;
+    for( j = 0 ; j < Ndata*N ; j++ ) {
+      free( evalues[j].resampled ) ;
     }
+    free( evalues ) ;
+    return NULL ;
   }
-  
-  for( j = 0 ; j < Ndata ; j++ ) {
-    free_G( &G[j] ) ;
+
+  for( j = 0 ; j < Ndata*N ; j++ ) {
+    compute_err( &evalues[j] ) ;
   }
-  free( G ) ;
-  
   return evalues ;
 }
 
 // solve the GEVP
 struct resampled *
+solve_GEVP( const struct resampled *y ,
+	    const size_t Ndata ,
+	    const size_t N ,
+	    const size_t M ,
+	    const size_t t0 ,
+	    const size_t td )
+{
+  fprintf( stdout , "GEVP solver ----> " ) ;
+  return solve_all( y , Ndata , N , M , t0 , td , false ) ;
+}
+
+// solve the GEVP with C(t+t0) on the right hand side
+struct resampled *
 solve_GEVP_fixed( const struct resampled *y ,
 		  const size_t Ndata ,
 		  const size_t N ,
@@ -593,95 +745,5 @@ solve_GEVP_fixed( const struct resampled *y ,
 		  const size_t t0 ,
 		  const size_t td )
 {
-  if( N > M ) {
-    fprintf( stderr , "[GEVP] cannot solve when N states "
-	     "are less than M correlators\n" ) ;
-    return NULL ;
-  }
-  
-  // initialise the generalised eigenvalues
-  struct resampled *evalues = malloc( Ndata*N*
-				      sizeof( struct resampled ) ) ;
-  size_t i , j , k ;
-  for( j = 0 ; j < Ndata*N ; j++ ) {
-    evalues[j].resampled = malloc( y[0].NSAMPLES *
-				   sizeof( double ) ) ;
-    evalues[j].restype = y[0].restype ;
-    evalues[j].NSAMPLES = y[0].NSAMPLES ;
-  }
-
-  struct GEVP_temps *G = malloc( Ndata*sizeof( struct GEVP_temps ) ) ;
-
-  double C0[ N*M ] , C1[ N*M ] ;
-  
-  // ugh loop order is all weird
-  for( j = 0 ; j < Ndata ; j++ ) {
-    allocate_G( &G[j] , N );
-  }
-
-  // loop resamples
-  for( k = 0 ; k < y[0].NSAMPLES ; k++ ) {
-    
-    for( j = 0 ; j < Ndata ; j++ ) {
-
-      // put these in the linearised matrices
-      size_t shift = 0 ;
-      for( i = 0 ; i < N*M ; i++ ) {
-	C0[i] = y[ j + shift ].resampled[k] ;
-	C1[i] = y[ (j+t0)%Ndata + shift ].resampled[k] ;
-	shift += Ndata ;
-      }
-
-      // set AB by squaring the matrices, possibly
-      set_ab( G[j].a , G[j].b , C0 , C1 , N , M ) ;
-      
-      // compute eigenvalues
-      if( gevp2( G , N , true , j , false ) == FAILURE ) {
-	fprintf( stderr , "[GEVP] GEVP solve failed \n" ) ;
-        return NULL ;
-      }
-    }
-    
-    for( j = 0 ; j < Ndata ; j++ ) {
-      // poke into solution
-      for( i = 0 ; i < N ; i++ ) {
-	evalues[j+Ndata*i].resampled[ k ] = creal( G[j].ev[i] ) ;
-      }
-      //
-    }
-  }
-
-  for( j = 0 ; j < Ndata ; j++ ) {
-    // redo for the average
-    size_t shift = 0 ;
-    for( i = 0 ; i < N*M ; i++ ) {
-      C0[i] = y[ j  + shift ].avg ;
-      C1[i] = y[ (j+t0)%Ndata + shift ].avg ;
-      shift += Ndata ;
-    }
-
-    // set AB by squaring the matrices possibly
-    set_ab( G[j].a , G[j].b , C0 , C1 , N , M ) ;
-
-    // compute eigenvalues
-    if( gevp2( G , N , true , j , true ) == FAILURE ) {
-      fprintf( stderr , "[GEVP] GEVP solve failed \n" ) ;
-      return NULL ;
-    }
-  }
-  
-  for( j = 0 ; j < Ndata ; j++ ) {
-    // poke into solution
-    for( i = 0 ; i < N ; i++ ) {
-      evalues[j+Ndata*i].avg = creal( G[j].ev[i] ) ;
-      compute_err( &evalues[j+Ndata*i] ) ;
-    }
-  }
-  
-  for( j = 0 ; j < Ndata ; j++ ) {
-    free_G( &G[j] ) ;
-  }
-  free( G ) ;
-  
-  return evalues ;
+  return solve_all( y , Ndata , N , M , t0 , td , true ) ;
 }
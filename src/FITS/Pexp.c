@@ -3,6 +3,8 @@
  */
 #include "gens.h"
 
+#include "dual.h"
+
 double
 fPexp( const struct x_desc X , const double *fparams , const size_t Npars )
 {
@@ -32,31 +34,59 @@ Pexp_f( double *f , const void *data , const double *fparams )
   return ;
 }
 
-// derivatives
+// derivatives, E0 is shared and each state j has an amplitude A_j
+// and energy E_j
 void
 Pexp_df( double **df , const void *data , const double *fparams )
 {
   const struct data *DATA = ( const struct data* )data ;
-  size_t i ;
+  size_t i , j ;
   for( i = 0 ; i < DATA -> n ; i++ ) {
     const double t = DATA -> x[i] ;
-    const double e1 = exp(-fparams[DATA -> map[i].p[0]] * t) ;
-    size_t j ;
-    for( j = 0 ; j < DATA->N ; j++ ) {
-      const double A = fparams[DATA -> map[i].p[1+2*j]] ;
-      const double e2 = exp(-fparams[DATA -> map[i].p[2+2*j]] * t) ;
-      df[DATA -> map[i].p[0]][i] = -t * ( 1 + A ) * e1 ;
-      df[DATA -> map[i].p[1]][i] = -e1 + e2 ;
-      df[DATA -> map[i].p[2]][i] = t * A * fparams[DATA -> map[i].p[2+2*j]] * e2 ;
+    const double e1 = exp( -fparams[ DATA -> map[i].p[0] ] * t ) ;
+    double sumA = 0.0 ;
+    for( j = 0 ; j < DATA -> N ; j++ ) {
+      const size_t pA = DATA -> map[i].p[1+2*j] ;
+      const size_t pE = DATA -> map[i].p[2+2*j] ;
+      const double e2 = exp( -fparams[ pE ] * t ) ;
+      sumA += fparams[ pA ] ;
+      df[ pA ][i] = e2 - e1 ;
+      df[ pE ][i] = -t * fparams[ pA ] * e2 ;
     }
+    df[ DATA -> map[i].p[0] ][i] = -t * e1 * ( 1 - sumA ) ;
   }
   return ;
 }
 
-// second derivatives
+// second derivatives, the only non-zero ones are (E0,E0), (E0,A_j),
+// (A_j,E_j) and (E_j,E_j)
 void
 Pexp_d2f( double **d2f , const void *data , const double *fparams )
 {
+  const struct data *DATA = ( const struct data* )data ;
+  const size_t Nlogic = ad_nlogic( DATA ) ;
+  size_t i , j , k ;
+  for( i = 0 ; i < DATA -> n ; i++ ) {
+    const double t = DATA -> x[i] ;
+    const size_t p0 = DATA -> map[i].p[0] ;
+    const double e1 = exp( -fparams[ p0 ] * t ) ;
+    for( j = 0 ; j < DATA -> Npars ; j++ ) {
+      for( k = 0 ; k < DATA -> Npars ; k++ ) {
+	d2f[ DATA -> map[i].p[j] + Nlogic * DATA -> map[i].p[k] ][i] = 0.0 ;
+      }
+    }
+    double sumA = 0.0 ;
+    for( j = 0 ; j < DATA -> N ; j++ ) {
+      const size_t pA = DATA -> map[i].p[1+2*j] ;
+      const size_t pE = DATA -> map[i].p[2+2*j] ;
+      const double e2 = exp( -fparams[ pE ] * t ) ;
+      sumA += fparams[ pA ] ;
+      d2f[ p0 + Nlogic * pA ][i] = d2f[ pA + Nlogic * p0 ][i] = t * e1 ;
+      d2f[ pA + Nlogic * pE ][i] = d2f[ pE + Nlogic * pA ][i] = -t * e2 ;
+      d2f[ pE + Nlogic * pE ][i] = t * t * fparams[ pA ] * e2 ;
+    }
+    d2f[ p0 + Nlogic * p0 ][i] = t * t * e1 * ( 1 - sumA ) ;
+  }
   return ;
 }
 
@@ -10,79 +10,71 @@
  */
 #include "gens.h"
 
-#include "gsl/gsl_sf_bessel.h"
+#include "dual.h"
 
 #define FITAMP1
 
-double
-fQcorr_bessel( const struct x_desc X , const double *fparams , const size_t Npars )
-{
+// the model written once, fQcorr_bessel is used for the value and
+// fQcorr_bessel_dual for the derivatives
 #ifdef FITAMP1
-  return fparams[0] / ( X.X ) * exp( -fparams[1] * X.X ) ;
+#define FQCORR( name , T )						\
+  T name( const struct x_desc X , const T *fparams , const size_t Npars )	\
+  {									\
+    return AD_SCALE( AD_MUL( fparams[0] ,				\
+			     AD_EXP( AD_SCALE( fparams[1] , -X.X ) ) ) , \
+		     1.0 / X.X ) ;					\
+  }
 #elif defined FITAMP2
-  return fparams[0] / ( X.X ) * exp( -fparams[1] * X.X ) *
-    sqrt( M_PI / ( 2. * fparams[1] * X.X ) )
-    * ( 1 + 3./( 8 * fparams[1] * X.X ) )
-    ;
+#define FQCORR( name , T )						\
+  T name( const struct x_desc X , const T *fparams , const size_t Npars )	\
+  {									\
+    const T mx = AD_SCALE( fparams[1] , X.X ) ;				\
+    const T fac = AD_MUL( AD_SQRT( AD_SCALE( AD_INV( mx ) , M_PI/2. ) ) , \
+			  AD_SHIFT( AD_SCALE( AD_INV( mx ) , 3./8. ) , 1 ) ) ; \
+    return AD_SCALE( AD_MUL( AD_MUL( fparams[0] ,			\
+				     AD_EXP( AD_SCALE( fparams[1] , -X.X ) ) ) , \
+			     fac ) , 1.0 / X.X ) ;			\
+  }
 #else
-  return ( fparams[0] / ( 4.0 * M_PI * M_PI * X.X ) ) *
-    exp( -fparams[0] * X.X ) *
-    sqrt( M_PI / ( 2. * fparams[0] * X.X ) ) *
-    ( 1 + 3./( 8 * fparams[0] * X.X ) ) ;
+#define FQCORR( name , T )						\
+  T name( const struct x_desc X , const T *fparams , const size_t Npars )	\
+  {									\
+    const T mx = AD_SCALE( fparams[0] , X.X ) ;				\
+    const T fac = AD_MUL( AD_SQRT( AD_SCALE( AD_INV( mx ) , M_PI/2. ) ) , \
+			  AD_SHIFT( AD_SCALE( AD_INV( mx ) , 3./8. ) , 1 ) ) ; \
+    return AD_SCALE( AD_MUL( AD_MUL( fparams[0] , AD_EXP( AD_SCALE( mx , -1 ) ) ) , \
+			     fac ) , 1.0 / ( 4.0 * M_PI * M_PI * X.X ) ) ; \
+  }
 #endif
+
+FQCORR( fQcorr_bessel , double )
+static FQCORR( fQcorr_bessel_dual , struct dual )
+
+// f, df and d2f in a single pass
+void
+Qcorr_bessel_fdf( double *f , double **df , double **d2f ,
+                  const void *data , const double *fparams )
+{
+  ad_fdf( f , df , d2f , data , fparams , fQcorr_bessel_dual ) ;
 }
 
 void
 Qcorr_bessel_f( double *f , const void *data , const double *fparams )
 {
-  const struct data *DATA = (const struct data*)data ;
-  size_t i , j ; 
-  for( i = 0 ; i < DATA -> n ; i++ ) {
-    double p[ DATA -> Npars ] ;
-    for( j = 0 ; j < DATA -> Npars ; j++ ) {
-      p[ j ] = fparams[ DATA -> map[ i ].p[ j ] ] ;
-    }
-    struct x_desc X = { DATA -> x[i] , DATA -> LT[i] ,
-			DATA -> N , DATA -> M } ;
-    f[i] = fQcorr_bessel( X , p , DATA -> Npars ) - DATA -> y[i] ;
-  }
-  return ;
+  ad_f( f , data , fparams , fQcorr_bessel ) ;
 }
 
 // derivatives
 void
 Qcorr_bessel_df( double **df , const void *data , const double *fparams )
 {
-  const struct data *DATA = (const struct data*)data ;
-  size_t i , j ;
-  for( i = 0 ; i < DATA -> n ; i++ ) {
-
-    const double h = 1E-8 ;
-    struct x_desc X = { DATA -> x[i] , DATA -> LT[i] ,
-			DATA -> N , DATA -> M } ;
-
-    for( j = 0 ; j < DATA -> Npars ; j++ ) {
-      double p1[ DATA -> Npars ] , p2[ DATA -> Npars ] ;
-      size_t k ;
-      for( k = 0 ; k < DATA -> Npars ; k++ ) {
-	p1[ k ] = p2[ k ] = fparams[ DATA -> map[ i ].p[ k ] ] ;
-      }
-      p1[j] += h ; p2[j] -= h ;
-      
-      df[ DATA -> map[i].p[ j ] ][i] =
-	( fQcorr_bessel( X , p1 , DATA -> Npars ) -
-	  fQcorr_bessel( X , p2 , DATA -> Npars ) ) / ( 2.*h ) ;
-      
-    }
-
-  }
-  return ;
+  ad_df( df , data , fparams , fQcorr_bessel_dual ) ;
 }
 
 void
 Qcorr_bessel_d2f( double **d2f , const void *data , const double *fparams )
 {
-  return ;
+  ad_d2f( d2f , data , fparams , fQcorr_bessel_dual ) ;
 }
 
 void
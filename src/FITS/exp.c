@@ -3,61 +3,54 @@
  */
 #include "gens.h"
 
+#include "dual.h"
 #include "fit_chooser.h"
 #include "GLS.h"
 #include "pade_laplace.h"
 
-double
-fexp( const struct x_desc X , const double *fparams , const size_t Npars )
-{
-  size_t i ;
-  register double sum = 0.0 ;
-  for( i = 0 ; i < 2 * X.N ; i+=2 ) {
-    sum += fparams[i] * exp( -fparams[i+1] * X.X ) ;
+// the model written once, fexp is used for the value and fexp_dual
+// for the derivatives
+#define FEXP( name , T )						\
+  T name( const struct x_desc X , const T *fparams , const size_t Npars )	\
+  {									\
+    size_t i ;								\
+    T sum = AD_CONST( 0.0 , fparams[0] ) ;				\
+    for( i = 0 ; i < 2 * X.N ; i+=2 ) {					\
+      sum = AD_ADD( sum , AD_MUL( fparams[i] ,				\
+				  AD_EXP( AD_SCALE( fparams[i+1] , -X.X ) ) ) ) ; \
+    }									\
+    return sum ;							\
   }
-  return sum ;
+
+FEXP( fexp , double )
+static FEXP( fexp_dual , struct dual )
+
+// f, df and d2f in a single pass
+void
+exp_fdf( double *f , double **df , double **d2f ,
+         const void *data , const double *fparams )
+{
+  ad_fdf( f , df , d2f , data , fparams , fexp_dual ) ;
 }
 
 void
 exp_f( double *f , const void *data , const double *fparams )
 {
-  const struct data *DATA = (const struct data*)data ;
-  size_t i , j ; 
-  for( i = 0 ; i < DATA -> n ; i++ ) {
-    double p[ DATA -> N * 2 ] ;
-    for( j = 0 ; j < DATA -> N * 2 ; j++ ) {
-      p[ j ] = fparams[ DATA -> map[ i ].p[ j ] ] ;
-    }
-    struct x_desc X = { DATA -> x[i] , DATA -> LT[i] ,
-			DATA -> N , DATA -> M } ;
-    f[i] = fexp( X , p , DATA -> N * 2 ) - DATA -> y[i] ;
-  }
-  return ;
+  ad_f( f , data , fparams , fexp ) ;
 }
 
 // derivatives
 void
 exp_df( double **df , const void *data , const double *fparams )
 {
-  const struct data *DATA = (const struct data*)data ;
-  size_t i , j ;
-  for( i = 0 ; i < DATA -> n ; i++ ) {    
-    for( j = 0 ; j < 2*DATA -> N ; j+=2 ) {
-      const double t = DATA -> x[i] ;
-      const double e = exp( -fparams[ DATA-> map[i].p[j+1] ] * t ) ;
-      
-      df[ DATA-> map[i].p[j+0] ][i] = e ;
-      df[ DATA-> map[i].p[j+1] ][i] = -t * fparams[ DATA-> map[i].p[j] ] * e ;
-    }
-  }
-  return ;
+  ad_df( df , data , fparams , fexp_dual ) ;
 }
 
-// second derivatives? Will we ever use them - J?
+// second derivatives
 void
 exp_d2f( double **d2f , const void *data , const double *fparams )
 {
-  return ;
+  ad_d2f( d2f , data , fparams , fexp_dual ) ;
 }
 
 // guesses using the data, we don't need to be too accurate
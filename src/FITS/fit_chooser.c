@@ -11,6 +11,7 @@
 #include "adler_alpha_D0_multi.h"
 #include "cornell.h"
 #include "cornell_v2.h"
+#include "dual.h"
 #include "cosh.h"
 #include "cosh_asymm.h"
 #include "cosh_plusc.h"
@@ -133,6 +134,51 @@ get_Nparam( const struct fit_info Fit )
  return 0 ;
 }
 
+// whether the minimizer called min in the input file can fit Fitdef,
+// GLS and GLS_pade solve a linear system and variable projection
+// needs a model that is linear in its amplitudes
+bool
+minimizer_supports( const char *min ,
+		    const fittype Fitdef )
+{
+  if( strcmp( min , "GLS" ) == 0 ) {
+    return Fitdef == POLY || Fitdef == NOFIT ||
+      Fitdef == POLES || Fitdef == LARGENB ;
+  } else if( strcmp( min , "GLS_pade" ) == 0 ) {
+    return Fitdef == PADE || Fitdef == NOFIT ;
+  } else if( strcmp( min , "VARPRO" ) == 0 ) {
+    switch( Fitdef ) {
+    case COSH : case COSH_PLUSC : case EXP : case EXP_PLUSC :
+    case PEXP : case SINH : case NOFIT :
+      return true ;
+    default :
+      return false ;
+    }
+  }
+  return true ;
+}
+
+// which parameters the model is linear in, for variable projection
+static bool
+linear_even( const size_t j )
+{
+  return j%2 == 0 ;
+}
+
+// amplitudes are at odd indices, p[0] being an energy
+static bool
+linear_odd( const size_t j )
+{
+  return j%2 == 1 ;
+}
+
+// amplitudes are at odd indices, p[0] being a constant
+static bool
+linear_plusc( const size_t j )
+{
+  return j == 0 || j%2 == 1 ;
+}
+
 // initialise the fit
 struct fit_descriptor
 init_fit( const struct data_info Data ,
@@ -140,6 +186,8 @@ init_fit( const struct data_info Data ,
 {
   struct fit_descriptor fdesc ;
   fdesc.linmat = NULL ;
+  fdesc.FdF = NULL ;
+  fdesc.ctx = NULL ;
   
   switch( Fit.Fitdef ) {
   case ALPHA_D0 :
@@ -203,6 +251,7 @@ init_fit( const struct data_info Data ,
     fdesc.F          = cosh_f ;
     fdesc.dF         = cosh_df ;
     fdesc.d2F        = cosh_d2f ;
+    fdesc.FdF        = cosh_fdf ;
     fdesc.guesses    = exp_guesses ;
     break ;
   case COSH_ASYMM :
@@ -224,6 +273,7 @@ init_fit( const struct data_info Data ,
     fdesc.F          = exp_f ;
     fdesc.dF         = exp_df ;
     fdesc.d2F        = exp_d2f ;
+    fdesc.FdF        = exp_fdf ;
     fdesc.guesses    = exp_guesses ; 
     break ;
   case EXP_PLUSC : 
@@ -279,6 +329,7 @@ init_fit( const struct data_info Data ,
     fdesc.F          = fvol5_f ;
     fdesc.dF         = fvol5_df ;
     fdesc.d2F        = fvol5_d2f ;
+    fdesc.FdF        = fvol5_fdf ;
     fdesc.guesses    = fvol5_guesses ;
     break ;
   case FVOL6 :
@@ -293,7 +344,9 @@ init_fit( const struct data_info Data ,
     fdesc.F          = fvol_deltav2_f ;
     fdesc.dF         = fvol_deltav2_df ;
     fdesc.d2F        = fvol_deltav2_d2f ;
+    fdesc.FdF        = fvol_deltav2_fdf ;
     fdesc.guesses    = fvol_deltav2_guesses ;
+    fdesc.ctx        = fvol_deltav2_ctx ;
     break ;
   case HALEXP :
     fdesc.func       = fHALexp ;
@@ -401,6 +454,7 @@ init_fit( const struct data_info Data ,
     fdesc.F          = sinh_f ;
     fdesc.dF         = sinh_df ;
     fdesc.d2F        = sinh_d2f ;
+    fdesc.FdF        = sinh_fdf ;
     fdesc.guesses    = exp_guesses ;
     break ;
   case SOL :
@@ -436,6 +490,7 @@ init_fit( const struct data_info Data ,
     fdesc.F          = Qcorr_bessel_f ;
     fdesc.dF         = Qcorr_bessel_df ;
     fdesc.d2F        = Qcorr_bessel_d2f ;
+    fdesc.FdF        = Qcorr_bessel_fdf ;
     fdesc.guesses    = Qcorr_bessel_guesses ;
     break ;
   case QSLAB_FIXED :
@@ -492,8 +547,39 @@ init_fit( const struct data_info Data ,
     break ;
   }
 
+  // parameters variable projection can eliminate, products
+  // of amplitudes like in PP_AA are not linear
+  switch( Fit.Fitdef ) {
+  case COSH : case EXP : case SINH :
+    fdesc.is_linear = linear_even ;
+    break ;
+  case COSH_PLUSC : case EXP_PLUSC :
+    fdesc.is_linear = linear_plusc ;
+    break ;
+  case PEXP :
+    fdesc.is_linear = linear_odd ;
+    break ;
+  default :
+    fdesc.is_linear = NULL ;
+    break ;
+  }
+
   fdesc.Nparam = get_Nparam( Fit ) ;
 
+  // models written in dual numbers carry at most NDUAL derivatives
+  switch( Fit.Fitdef ) {
+  case COSH : case EXP : case FVOL_DELTA : case QCORR_BESSEL : case SINH :
+    if( fdesc.Nparam > NDUAL ) {
+      fprintf( stderr , "[FIT] %zu parameters is more than the %d the "
+	       "dual number derivatives support, increase NDUAL\n" ,
+	       fdesc.Nparam , NDUAL ) ;
+      exit(1) ;
+    }
+    break ;
+  default :
+    break ;
+  }
+
   // count how many common parameters we have
   size_t Ncommon = 0 , i ;
   for( i = 0 ; i < fdesc.Nparam ; i++ ) {
@@ -507,6 +593,9 @@ init_fit( const struct data_info Data ,
   fdesc.N = Fit.N ;
   fdesc.M = Fit.M ;
 
+  // settings for the genetic algorithm
+  fdesc.GA = Fit.GA ;
+
   // allocate the fitfunction
   fdesc.f = allocate_ffunction( fdesc.Nlogic , Data.Ntot ) ;
   
@@ -5,7 +5,7 @@
 #include "gens.h"
 
 #include "Nder.h"
-#include <gsl/gsl_sf_bessel.h>
+#include "fv_bessel.h"
 
 //#define HIGH_LOOPS
 
@@ -61,22 +61,7 @@ static const double asq[ 23 ] = {
 static inline double
 fv_correction_k1( const double mQL )
 {
-  const double r2 = 1.4142135623730951 , r3 = 1.7320508075688772 , r5 = 2.23606797749979 ;
-  const double r6 = 2.449489742783178 , r8 = 2.8284271247461903 , r10 = 3.1622776601683795 ;
-  const double r11 = 3.3166247903554 , r12 = 3.4641016151377544 , r13 = 3.605551275463989 ;
-  return ( +6*gsl_sf_bessel_K1( mQL     )
-	  +12*gsl_sf_bessel_K1( r2*mQL  )/r2
-	   +8*gsl_sf_bessel_K1( r3*mQL  )/r3
-	   +6*gsl_sf_bessel_K1( 2*mQL   )/2
-	   +24*gsl_sf_bessel_K1( r5*mQL  )/r5
-	   +24*gsl_sf_bessel_K1( r6*mQL  )/r6
-	   +12*gsl_sf_bessel_K1( r8*mQL  )/r8
-	   +30*gsl_sf_bessel_K1( 3*mQL   )/3
-	   +24*gsl_sf_bessel_K1( r10*mQL )/r10
-	   +24*gsl_sf_bessel_K1( r11*mQL )/r11
-	   +8*gsl_sf_bessel_K1( r12*mQL )/r12
-	   +24*gsl_sf_bessel_K1( r13*mQL )/r13
-	   )/mQL ;
+  return fv_bessel_sum( FV_K1 , mQL )/mQL ;
 }
 
 static inline double
@@ -95,10 +80,18 @@ msqIQ0( const double phi , const double sub , const double MQL )
   return fv/(16*M_PI*M_PI) ; //(phi*phi*log(phi/musq) - sub + fv )/(16*M_PI*M_PI) ;
 }
 
+// finite volume term of point i, depends on the ensemble and not on
+// the fit parameters
+static inline double
+fvol5_FV( const size_t i )
+{
+  return msqIQ0( phiK[i] , log( phiKcont / musq ) , MKL[ i ] )/phif ;
+}
+
 double
 ffvol5( const struct x_desc X , const double *fparams , const size_t Npars )
 {
-  const double FV = msqIQ0( phiK[Npars] , log( phiKcont / musq ) , MKL[ Npars ] )/phif ;
+  const double FV = fvol5_FV( Npars ) ;
  
   return fparams[0] * ( 1 + fparams[1]*(X.X-phipicont)
 			+fparams[2]*FV
@@ -110,56 +103,50 @@ ffvol5( const struct x_desc X , const double *fparams , const size_t Npars )
 			) ; 
 }
 
+// f and df in one pass so the FV sum is only done once per point,
+// there are no second derivatives
 void
-fvol5_f( double *f , const void *data , const double *fparams )
+fvol5_fdf( double *f , double **df , double **d2f ,
+	   const void *data , const double *fparams )
 {
   const struct data *DATA = (const struct data*)data ;
-  size_t i , j ; 
-  for( i = 0 ; i < DATA -> n ; i++ ) {
-    double p[ DATA -> Npars ] ;
-    for( j = 0 ; j < DATA -> Npars ; j++ ) {
-      p[ j ] = fparams[ DATA -> map[ i ].p[ j ] ] ;
-    }
-    struct x_desc X = { DATA -> x[i] , DATA -> LT[i] ,
-			DATA -> N , DATA -> M } ;
+  for( size_t i = 0 ; i < DATA -> n ; i++ ) {
+    const size_t *mp = DATA->map[i].p ;
+    const double X = DATA -> x[i] ;
 
-    f[i] = ffvol5( X , p , i ) - DATA -> y[i] ;
+    const double FV = fvol5_FV( i ) ;
+    #ifdef ORDERA
+    const double a = sqrt(asq[i]) ;
+    #else
+    const double a = asq[i] ;
+    #endif
+    const double inner = ( 1 + fparams[ mp[1] ]*(X-phipicont)
+			   +fparams[ mp[2] ]*FV
+			   +fparams[ mp[3] ]*a ) ;
+    if( f != NULL ) {
+      f[i] = fparams[ mp[0] ]*inner - DATA -> y[i] ;
+    }
+    if( df != NULL ) {
+      df[ mp[0] ][ i ] = inner ;
+      df[ mp[1] ][ i ] = fparams[mp[0]]*(X-phipicont) ;
+      df[ mp[2] ][ i ] = fparams[mp[0]]*FV ;
+      df[ mp[3] ][ i ] = fparams[mp[0]]*a ;
+    }
   }
   return ;
 }
 
+void
+fvol5_f( double *f , const void *data , const double *fparams )
+{
+  fvol5_fdf( f , NULL , NULL , data , fparams ) ;
+}
+
 // derivatives
 void
 fvol5_df( double **df , const void *data , const double *fparams )
 {
-  const struct data *DATA = (const struct data*)data ;
-  for( size_t i = 0 ; i < DATA -> n ; i++ ) {
-    struct x_desc X = { DATA -> x[i] , DATA -> LT[i] ,
-			DATA -> N , DATA -> M } ;
-
-    const size_t *mp = DATA->map[i].p ;
-
-    const double FV = msqIQ0( phiK[i] , log( phiKcont / musq ) , MKL[ i ] )/phif ;
-  
-    df[ mp[0] ][ i ] = ( 1 + fparams[ mp[1] ]*(X.X-phipicont)
-			 +fparams[ mp[2] ]*FV
-			 #ifdef ORDERA
-			 +fparams[ mp[3] ]*sqrt(asq[i])
-			 #else
-			 +fparams[ mp[3] ]*asq[i]
-			 #endif
-			 ) ;
-    df[ mp[1] ][ i ] = fparams[mp[0]]*(X.X-phipicont) ;
-    df[ mp[2] ][ i ] = fparams[mp[0]]*FV ;
-    #ifdef ORDERA
-    df[ mp[3] ][ i ] = fparams[mp[0]]*sqrt(asq[i]) ; //fparams[mp[4]]*fparams[mp[4]] ; //asq[i] ;
-    #else
-    df[ mp[3] ][ i ] = fparams[mp[0]]*asq[i] ; //fparams[mp[4]]*fparams[mp[4]] ; //asq[i] ;
-    #endif
-
-    //df[ mp[4] ][ i ] = 0.0 ; //2*fparams[mp[0]]*fparams[mp[3]]*fparams[mp[4]] ; //asq[i] ;
-  }
-  return ;
+  fvol5_fdf( NULL , df , NULL , data , fparams ) ;
 }
 
 // second derivatives? Will we ever use them - J?
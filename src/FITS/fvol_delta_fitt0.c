@@ -7,10 +7,17 @@
 #include "fake.h"
 
 #include "Nder.h"
-#include <gsl/gsl_sf_bessel.h>
+#include "fv_bessel.h"
+#include "gkquad.h"
 
 #define COMPUTE_ZOMEGA
 
+// use the direct Bessel sums rather than the tables, for validation
+//#define FV_DIRECT
+
+// relative tolerance of the tabulated Bessel sums
+#define FV_TOL (1E-13)
+
 // choices for param2
 //#define ASQ_TERM
 //#define A_TERM
@@ -282,115 +289,41 @@ integrand( const double z ,
 	   const double mQL ,
 	   const double mBL )
 {
-  const double r2 = 1.4142135623730951 , r3 = 1.7320508075688772 , r5 = 2.23606797749979 ;
-  const double r6 = 2.449489742783178 , r8 = 2.8284271247461903 , r10 = 3.1622776601683795 ;
-  const double r11 = 3.3166247903554 , r12 = 3.4641016151377544 , r13 = 3.605551275463989 ;
-  const double muz = mu( z , mRL , mQL , mBL ) ; 
-  return (  +6*gsl_sf_bessel_K0(    muz  ) 
-	   +12*gsl_sf_bessel_K0( r2*muz  )/r2
-	    +8*gsl_sf_bessel_K0( r3*muz  )/r3
-	    +6*gsl_sf_bessel_K0(  2*muz  )/2
-	   +24*gsl_sf_bessel_K0( r5*muz  )/r5
-	   +24*gsl_sf_bessel_K0( r6*muz  )/r6
-	   +12*gsl_sf_bessel_K0( r8*muz  )/r8
-	   +30*gsl_sf_bessel_K0(  3*muz  )/3
-	   +24*gsl_sf_bessel_K0( r10*muz )/r10
-	   +24*gsl_sf_bessel_K0( r11*muz )/r11
-	    +8*gsl_sf_bessel_K0( r12*muz )/r12
-	   +24*gsl_sf_bessel_K0( r13*muz )/r13
-	    ) ;
+  return fv_bessel_sum( FV_K0 , mu( z , mRL , mQL , mBL ) ) ;
 }
 
 static double
 intz_indep( const double mRL ,
 	    const double mQL )
 {
-  const double r2 = 1.4142135623730951 , r3 = 1.7320508075688772 , r5 = 2.23606797749979 ;
-  const double r6 = 2.449489742783178 , r8 = 2.8284271247461903 , r10 = 3.1622776601683795 ;
-  const double r11 = 3.3166247903554 , r12 = 3.4641016151377544 , r13 = 3.605551275463989 ;
-  return 2*(mQL/(mRL*mRL-mQL*mQL))*(   6*gsl_sf_bessel_K1( mQL     )
-				     +12*gsl_sf_bessel_K1( r2*mQL  )/r2
-				      +8*gsl_sf_bessel_K1( r3*mQL  )/r3
-				      +6*gsl_sf_bessel_K1( 2*mQL   )/2
-				     +24*gsl_sf_bessel_K1( r5*mQL  )/r5
-				     +24*gsl_sf_bessel_K1( r6*mQL  )/r6
-				     +12*gsl_sf_bessel_K1( r8*mQL  )/r8
-				     +30*gsl_sf_bessel_K1( 3*mQL   )/3
-				     +24*gsl_sf_bessel_K1( r10*mQL )/r10
-				     +24*gsl_sf_bessel_K1( r11*mQL )/r11
-				      +8*gsl_sf_bessel_K1( r12*mQL )/r12
-				     +24*gsl_sf_bessel_K1( r13*mQL )/r13 ) ;
+  return 2*(mQL/(mRL*mRL-mQL*mQL))*fv_bessel_sum( FV_K1 , mQL ) ;
 }
 
-typedef struct {
-  double a , b , eps , whole, fa , fb , fm ;
-  int rec ;
-  double mRL , mQL , mBL ;
-} simp_args ;
-
-static inline double
-inner_simp( const double a ,
-	    const double b ,
-	    const double fa ,
-	    const double fb ,
-	    const double fm )
+// the integrand at all of the quadrature nodes, args are mRL, mQL, mBL
+static void
+integrand_nodes( double *f ,
+		 const double *z ,
+		 const size_t Nz ,
+		 const size_t Nsamples ,
+		 void *args )
 {
-  return (b-a)*( fa + 4*fm + fb )/6. ; 
-}
-
-// adaptive routine adapted fromm wikipedia
-// https://en.wikipedia.org/wiki/Adaptive_Simpson%27s_method
-static double
-simpson( const simp_args Simp )
-{  
-  register const double m  = (Simp.a+Simp.b)/2 ;
-  register const double lm = (Simp.a+m)/2 ;
-  register const double rm = (m+Simp.b)/2 ;
-
-  const double flm = integrand( lm , Simp.mRL , Simp.mQL , Simp.mBL ) ;
-  const double frm = integrand( rm , Simp.mRL , Simp.mQL , Simp.mBL ) ;
-  const double left  = inner_simp( Simp.a/2 , Simp.b/2, Simp.fa , Simp.fm , flm ) ;
-  const double right = inner_simp( Simp.a/2 , Simp.b/2, Simp.fm , Simp.fb , frm ) ;
-
-  const double delta = left + right - Simp.whole ;
-  
-  if( Simp.rec < 0 ) {
-    printf( "out of recursions %d %e\n" , Simp.rec , delta ) ;
-    return sqrt(-1) ;
+  const double *m = (const double*)args ;
+  size_t i ;
+  for( i = 0 ; i < Nz ; i++ ) {
+    f[i] = integrand( z[i] , m[0] , m[1] , m[2] ) ;
   }
-
-  if( fabs( delta ) < 15*Simp.eps ) {
-    return left + right + delta/15 ;
-  }
-
-  const simp_args SimpLeft  = { .a = Simp.a , .b = m , .eps = Simp.eps/2 ,
-				.whole = left , .fa = Simp.fa , .fb = Simp.fm ,
-				.fm = flm , .rec = Simp.rec-1 ,
-				.mRL = Simp.mRL , .mQL = Simp.mQL , .mBL = Simp.mBL } ;
-  const simp_args SimpRight = { .a = m , .b = Simp.b , .eps = Simp.eps/2 ,
-				.whole = right , .fa = Simp.fm , .fb = Simp.fb ,
-				.fm = frm , .rec = Simp.rec-1 ,
-				.mRL = Simp.mRL , .mQL = Simp.mQL , .mBL = Simp.mBL } ;
-  
-  return simpson( SimpLeft ) +	simpson( SimpRight ) ;
+  return ;
 }
 
-// simpsons adaptive routine
+// gauss-kronrod integral over the feynman parameter
 static double
 fv_IQR( const double mRL ,
 	const double mQL ,
 	const double mBL )
 {
-  const double a = 0 , b = 1 , h = b-a ;
-  const double fa = integrand( a , mRL , mQL , mBL ) ;
-  const double fb = integrand( b , mRL , mQL , mBL ) ;
-  const double fm = integrand( (a+b)/2 , mRL , mQL , mBL ) ;  
-  const double whole = (h/6)*(fa+4*fm+fb) ;
-  const simp_args SimpInitial  = { .a = a , .b = 1 , .eps = 1E-12 ,
-				   .whole = whole , .fa = fa , .fb = fb ,
-				   .fm = fm , .rec = 35 ,
-				   .mRL = mRL , .mQL = mQL , .mBL = mBL } ;
-  return 2*( simpson( SimpInitial ) - intz_indep( mRL , mQL )) ;
+  double m[3] = { mRL , mQL , mBL } ;
+  return 2*( gk_integrate( integrand_nodes , m , 0 , 1 , 1E-12 , 0 , GK15 )
+	     - intz_indep( mRL , mQL ) ) ;
 }
 
 void
@@ -408,41 +341,13 @@ set_phi3( const size_t sample_idx , const bool is_avg )
 static inline double
 fv_correction_k1( const double mQL )
 {
-  const double r2 = 1.4142135623730951 , r3 = 1.7320508075688772 , r5 = 2.23606797749979 ;
-  const double r6 = 2.449489742783178 , r8 = 2.8284271247461903 , r10 = 3.1622776601683795 ;
-  const double r11 = 3.3166247903554 , r12 = 3.4641016151377544 , r13 = 3.605551275463989 ;
-  return ( +6*gsl_sf_bessel_K1( mQL     )
-	  +12*gsl_sf_bessel_K1( r2*mQL  )/r2
-	   +8*gsl_sf_bessel_K1( r3*mQL  )/r3
-	   +6*gsl_sf_bessel_K1( 2*mQL   )/2
-	  +24*gsl_sf_bessel_K1( r5*mQL  )/r5
-	  +24*gsl_sf_bessel_K1( r6*mQL  )/r6
-	  +12*gsl_sf_bessel_K1( r8*mQL  )/r8
-	  +30*gsl_sf_bessel_K1( 3*mQL   )/3
-	  +24*gsl_sf_bessel_K1( r10*mQL )/r10
-	  +24*gsl_sf_bessel_K1( r11*mQL )/r11
-	   +8*gsl_sf_bessel_K1( r12*mQL )/r12
-	  +24*gsl_sf_bessel_K1( r13*mQL )/r13 )/mQL ;
+  return fv_bessel_sum( FV_K1 , mQL )/mQL ;
 }
 
 static inline double
 fv_correction_k2( const double mQL )
 {
-  const double r2 = 1.4142135623730951 , r3 = 1.7320508075688772 , r5 = 2.23606797749979 ;
-  const double r6 = 2.449489742783178 , r8 = 2.8284271247461903 , r10 = 3.1622776601683795 ;
-  const double r11 = 3.3166247903554 , r12 = 3.4641016151377544 , r13 = 3.605551275463989 ;
-  return (   6*gsl_sf_bessel_Kn( 2 , mQL     )
-	   +12*gsl_sf_bessel_Kn( 2 , r2*mQL  )/2
-	    +8*gsl_sf_bessel_Kn( 2 , r3*mQL  )/3
-	    +6*gsl_sf_bessel_Kn( 2 , 2*mQL   )/4
-	   +24*gsl_sf_bessel_Kn( 2 , r5*mQL  )/5
-	   +24*gsl_sf_bessel_Kn( 2 , r6*mQL  )/6
-	   +12*gsl_sf_bessel_Kn( 2 , r8*mQL  )/8
-	   +30*gsl_sf_bessel_Kn( 2 , 3*mQL   )/9
-	   +24*gsl_sf_bessel_Kn( 2 , r10*mQL )/10
-	   +24*gsl_sf_bessel_Kn( 2 , r11*mQL )/11
-	    +8*gsl_sf_bessel_Kn( 2 , r12*mQL )/12
-	   +24*gsl_sf_bessel_Kn( 2 , r13*mQL )/13 )/(mQL*mQL) ;
+  return fv_bessel_sum( FV_K2 , mQL )/(mQL*mQL) ;
 }
 
 static inline double
@@ -652,6 +557,10 @@ init_phi3( const size_t Nboots )
     fprintf( stdout , "PHI3 set --> %zu %e %e\n" , i , phi3_res[i].avg , phi3_res[i].err ) ;
   }
 
+#ifndef FV_DIRECT
+  init_fv_bessel( FV_TOL ) ;
+#endif
+
   // precompute all bubbles
   fprintf( stdout , "Precomputing bubbles\n" ) ;
   for( size_t i = 0 ; i < NENSEMBLES ; i++ ) {
@@ -4,13 +4,21 @@
  */
 #include "gens.h"
 
+#include "dual.h"
 #include "fake.h"
+#include "init.h" // free_fitparams
 
-#include "Nder.h"
-#include <gsl/gsl_sf_bessel.h>
+#include "fv_bessel.h"
+#include "gkquad.h"
 
 //#define COMPUTE_ZOMEGA
 
+// use the direct Bessel sums rather than the tables, for validation
+//#define FV_DIRECT
+
+// relative tolerance of the tabulated Bessel sums
+#define FV_TOL (1E-13)
+
 // GeV values
 static const double mpi = 0.1348 ;
 static const double mk  = 0.4942 ;
@@ -58,16 +66,36 @@ struct LUT {
   // pion
   double fvpi0[ NENSEMBLES ] ;
   double fvpi2[ NENSEMBLES ] ;
+
+  // K1 and K2 finite volume sums for the kaon and pion, zero if the
+  // ensemble has no finite volume correction
+  double fvk1K[ NENSEMBLES+1 ] ;
+  double fvk2K[ NENSEMBLES+1 ] ;
+  double fvk1pi[ NENSEMBLES+1 ] ;
+  double fvk2pi[ NENSEMBLES+1 ] ;
   
   double IMetaSub ;
 } ;
 
-static struct LUT lut ;
+// resampled Phi3 and the lookup table computed from it, the fits get
+// one of these per bootstrap so they can run in parallel
+struct fvol_ctx {
+  double Phi3[ NENSEMBLES+1 ] ;
+  struct LUT lut ;
+} ;
+
+// Nctx bootstraps with the average at ctx[Nctx]
+static struct fvol_ctx *ctx = NULL ;
+static size_t Nctx = 0 ;
 
-// need to give this an error
-static double Phi3[ NENSEMBLES+1 ] = { };
+// context used when we are not handed one, e.g. in the plotting
+static const struct fvol_ctx *def_ctx = NULL ;
 
-static struct resampled *phi3_res = NULL ;
+// continuum lookup table, t0 is fixed so it only needs doing once
+static struct LUT lutcont ;
+
+// the Phi3-independent finite volume integrals, the expensive bit
+static double fvIQR[ NENSEMBLES ][ 3 ] ;
 
 // GMOR (4*\phi_K-\phi_\pi)/3.
 static const double PhiEta[ NENSEMBLES+1 ] = {
@@ -267,167 +295,75 @@ integrand( const double z ,
 	   const double mQL ,
 	   const double mBL )
 {
-  const double r2 = 1.4142135623730951 , r3 = 1.7320508075688772 , r5 = 2.23606797749979 ;
-  const double r6 = 2.449489742783178 , r8 = 2.8284271247461903 , r10 = 3.1622776601683795 ;
-  const double r11 = 3.3166247903554 , r12 = 3.4641016151377544 , r13 = 3.605551275463989 ;
-  const double muz = mu( z , mRL , mQL , mBL ) ; 
-  return (  +6*gsl_sf_bessel_K0(    muz  ) 
-	   +12*gsl_sf_bessel_K0( r2*muz  )/r2
-	    +8*gsl_sf_bessel_K0( r3*muz  )/r3
-	    +6*gsl_sf_bessel_K0(  2*muz  )/2
-	   +24*gsl_sf_bessel_K0( r5*muz  )/r5
-	   +24*gsl_sf_bessel_K0( r6*muz  )/r6
-	   +12*gsl_sf_bessel_K0( r8*muz  )/r8
-	   +30*gsl_sf_bessel_K0(  3*muz  )/3
-	   +24*gsl_sf_bessel_K0( r10*muz )/r10
-	   +24*gsl_sf_bessel_K0( r11*muz )/r11
-	    +8*gsl_sf_bessel_K0( r12*muz )/r12
-	   +24*gsl_sf_bessel_K0( r13*muz )/r13
-	    ) ;
+  return fv_bessel_sum( FV_K0 , mu( z , mRL , mQL , mBL ) ) ;
 }
 
 static double
 intz_indep( const double mRL ,
 	    const double mQL )
 {
-  const double r2 = 1.4142135623730951 , r3 = 1.7320508075688772 , r5 = 2.23606797749979 ;
-  const double r6 = 2.449489742783178 , r8 = 2.8284271247461903 , r10 = 3.1622776601683795 ;
-  const double r11 = 3.3166247903554 , r12 = 3.4641016151377544 , r13 = 3.605551275463989 ;
-  return 2*(mQL/(mRL*mRL-mQL*mQL))*(   6*gsl_sf_bessel_K1( mQL     )
-				     +12*gsl_sf_bessel_K1( r2*mQL  )/r2
-				      +8*gsl_sf_bessel_K1( r3*mQL  )/r3
-				      +6*gsl_sf_bessel_K1( 2*mQL   )/2
-				     +24*gsl_sf_bessel_K1( r5*mQL  )/r5
-				     +24*gsl_sf_bessel_K1( r6*mQL  )/r6
-				     +12*gsl_sf_bessel_K1( r8*mQL  )/r8
-				     +30*gsl_sf_bessel_K1( 3*mQL   )/3
-				     +24*gsl_sf_bessel_K1( r10*mQL )/r10
-				     +24*gsl_sf_bessel_K1( r11*mQL )/r11
-				      +8*gsl_sf_bessel_K1( r12*mQL )/r12
-				     +24*gsl_sf_bessel_K1( r13*mQL )/r13 ) ;
+  return 2*(mQL/(mRL*mRL-mQL*mQL))*fv_bessel_sum( FV_K1 , mQL ) ;
 }
 
-typedef struct {
-  double a , b , eps , whole, fa , fb , fm ;
-  int rec ;
-  double mRL , mQL , mBL ;
-} simp_args ;
-
-static inline double
-inner_simp( const double a ,
-	    const double b ,
-	    const double fa ,
-	    const double fb ,
-	    const double fm )
+// the integrand at all of the quadrature nodes, args are mRL, mQL, mBL
+static void
+integrand_nodes( double *f ,
+		 const double *z ,
+		 const size_t Nz ,
+		 const size_t Nsamples ,
+		 void *args )
 {
-  return (b-a)*( fa + 4*fm + fb )/6. ; 
-}
-
-// adaptive routine adapted fromm wikipedia
-// https://en.wikipedia.org/wiki/Adaptive_Simpson%27s_method
-static double
-simpson( const simp_args Simp )
-{  
-  register const double m  = (Simp.a+Simp.b)/2 ;
-  register const double lm = (Simp.a+m)/2 ;
-  register const double rm = (m+Simp.b)/2 ;
-
-  const double flm = integrand( lm , Simp.mRL , Simp.mQL , Simp.mBL ) ;
-  const double frm = integrand( rm , Simp.mRL , Simp.mQL , Simp.mBL ) ;
-  const double left  = inner_simp( Simp.a/2 , Simp.b/2, Simp.fa , Simp.fm , flm ) ;
-  const double right = inner_simp( Simp.a/2 , Simp.b/2, Simp.fm , Simp.fb , frm ) ;
-
-  const double delta = left + right - Simp.whole ;
-  
-  if( Simp.rec < 0 ) {
-    printf( "out of recursions %d %e\n" , Simp.rec , delta ) ;
-    return sqrt(-1) ;
-  }
-
-  if( fabs( delta ) < 15*Simp.eps ) {
-    return left + right + delta/15 ;
+  const double *m = (const double*)args ;
+  size_t i ;
+  for( i = 0 ; i < Nz ; i++ ) {
+    f[i] = integrand( z[i] , m[0] , m[1] , m[2] ) ;
   }
-
-  const simp_args SimpLeft  = { .a = Simp.a , .b = m , .eps = Simp.eps/2 ,
-				.whole = left , .fa = Simp.fa , .fb = Simp.fm ,
-				.fm = flm , .rec = Simp.rec-1 ,
-				.mRL = Simp.mRL , .mQL = Simp.mQL , .mBL = Simp.mBL } ;
-  const simp_args SimpRight = { .a = m , .b = Simp.b , .eps = Simp.eps/2 ,
-				.whole = right , .fa = Simp.fm , .fb = Simp.fb ,
-				.fm = frm , .rec = Simp.rec-1 ,
-				.mRL = Simp.mRL , .mQL = Simp.mQL , .mBL = Simp.mBL } ;
-  
-  return simpson( SimpLeft ) +	simpson( SimpRight ) ;
+  return ;
 }
 
-// simpsons adaptive routine
+// gauss-kronrod integral over the feynman parameter
 static double
 fv_IQR( const double mRL ,
 	const double mQL ,
 	const double mBL )
 {
-  const double a = 0 , b = 1 , h = b-a ;
-  const double fa = integrand( a , mRL , mQL , mBL ) ;
-  const double fb = integrand( b , mRL , mQL , mBL ) ;
-  const double fm = integrand( (a+b)/2 , mRL , mQL , mBL ) ;  
-  const double whole = (h/6)*(fa+4*fm+fb) ;
-  const simp_args SimpInitial  = { .a = a , .b = 1 , .eps = 1E-12 ,
-				   .whole = whole , .fa = fa , .fb = fb ,
-				   .fm = fm , .rec = 35 ,
-				   .mRL = mRL , .mQL = mQL , .mBL = mBL } ;
-  return 2*( simpson( SimpInitial ) - intz_indep( mRL , mQL )) ;
+  double m[3] = { mRL , mQL , mBL } ;
+  return 2*( gk_integrate( integrand_nodes , m , 0 , 1 , 1E-12 , 0 , GK15 )
+	     - intz_indep( mRL , mQL ) ) ;
+}
+
+// per-sample context handed to the fit
+const void *
+fvol_deltav2_ctx( const size_t sample_idx , const bool is_avg )
+{
+  if( ctx == NULL ) return NULL ;
+  if( is_avg == true ) return &ctx[ Nctx ] ;
+  if( sample_idx >= Nctx ) {
+    fprintf( stderr , "[FVOL_DELTA] sample %zu but Phi3 only has %zu "
+	     "bootstraps, init_phi3v2 with the NSAMPLES of the data\n" ,
+	     sample_idx , Nctx ) ;
+    return NULL ;
+  }
+  return &ctx[ sample_idx ] ;
 }
 
+// sets the context used when the fit does not give us one
 void
 set_phi3v2( const size_t sample_idx , const bool is_avg )
 {
-  for( size_t i = 0 ; i < NENSEMBLES+1 ; i++ ) {
-    if( is_avg ) {
-      Phi3[i] = phi3_res[i].avg ;
-    } else {
-      Phi3[i] = phi3_res[i].resampled[ sample_idx ] ;
-    }
-  } 
+  def_ctx = fvol_deltav2_ctx( sample_idx , is_avg ) ;
 }
 
 static inline double
 fv_correction_k1( const double mQL )
 {
-  const double r2 = 1.4142135623730951 , r3 = 1.7320508075688772 , r5 = 2.23606797749979 ;
-  const double r6 = 2.449489742783178 , r8 = 2.8284271247461903 , r10 = 3.1622776601683795 ;
-  const double r11 = 3.3166247903554 , r12 = 3.4641016151377544 , r13 = 3.605551275463989 ;
-  return ( +6*gsl_sf_bessel_K1( mQL     )
-	  +12*gsl_sf_bessel_K1( r2*mQL  )/r2
-	   +8*gsl_sf_bessel_K1( r3*mQL  )/r3
-	   +6*gsl_sf_bessel_K1( 2*mQL   )/2
-	  +24*gsl_sf_bessel_K1( r5*mQL  )/r5
-	  +24*gsl_sf_bessel_K1( r6*mQL  )/r6
-	  +12*gsl_sf_bessel_K1( r8*mQL  )/r8
-	  +30*gsl_sf_bessel_K1( 3*mQL   )/3
-	  +24*gsl_sf_bessel_K1( r10*mQL )/r10
-	  +24*gsl_sf_bessel_K1( r11*mQL )/r11
-	   +8*gsl_sf_bessel_K1( r12*mQL )/r12
-	  +24*gsl_sf_bessel_K1( r13*mQL )/r13 )/mQL ;
+  return fv_bessel_sum( FV_K1 , mQL )/mQL ;
 }
 
 static inline double
 fv_correction_k2( const double mQL )
 {
-  const double r2 = 1.4142135623730951 , r3 = 1.7320508075688772 , r5 = 2.23606797749979 ;
-  const double r6 = 2.449489742783178 , r8 = 2.8284271247461903 , r10 = 3.1622776601683795 ;
-  const double r11 = 3.3166247903554 , r12 = 3.4641016151377544 , r13 = 3.605551275463989 ;
-  return (   6*gsl_sf_bessel_Kn( 2 , mQL     )
-	   +12*gsl_sf_bessel_Kn( 2 , r2*mQL  )/2
-	    +8*gsl_sf_bessel_Kn( 2 , r3*mQL  )/3
-	    +6*gsl_sf_bessel_Kn( 2 , 2*mQL   )/4
-	   +24*gsl_sf_bessel_Kn( 2 , r5*mQL  )/5
-	   +24*gsl_sf_bessel_Kn( 2 , r6*mQL  )/6
-	   +12*gsl_sf_bessel_Kn( 2 , r8*mQL  )/8
-	   +30*gsl_sf_bessel_Kn( 2 , 3*mQL   )/9
-	   +24*gsl_sf_bessel_Kn( 2 , r10*mQL )/10
-	   +24*gsl_sf_bessel_Kn( 2 , r11*mQL )/11
-	    +8*gsl_sf_bessel_Kn( 2 , r12*mQL )/12
-	   +24*gsl_sf_bessel_Kn( 2 , r13*mQL )/13 )/(mQL*mQL) ;
+  return fv_bessel_sum( FV_K2 , mQL )/(mQL*mQL) ;
 }
 
 static inline double
@@ -558,10 +494,10 @@ bubble2( const double phiB , const double phiR , const double phiQ , const doubl
   return -p1 + p2 -p3 ;
 }
 
-static struct LUT
-setlutcont( const double t0 )
+static void
+setlutcont( struct LUT *L ,
+	    const double t0 )
 {
-  struct LUT lutcont = lut ;
   {
     const double phiOmega   = 8*t0*mOmega*mOmega ;
     const double phiCascade = 8*t0*mXi*mXi ;
@@ -574,22 +510,77 @@ setlutcont( const double t0 )
     const double eps = 1E-6 ;
     const double mOm = sqrt( phiOmega ) ;
     const double pl = pow( mOm + eps , 2 ) , mn = pow( mOm - eps , 2 ) ;
-    lutcont.b11[i] = bubble1( phiOmega , phiCascade , phi3 , -1 , -1 , 0 )/phif ;
-    lutcont.b21[i] = bubble2( phiOmega , phiCasStar , phi3 , -1 , -1 , 0 )/phif ;
-    lutcont.b22[i] = bubble2( phiOmega , phiOmega   , phi5 , -1 , -1 , 0 )/phif ;
+    L -> b11[i] = bubble1( phiOmega , phiCascade , phi3 , -1 , -1 , 0 )/phif ;
+    L -> b21[i] = bubble2( phiOmega , phiCasStar , phi3 , -1 , -1 , 0 )/phif ;
+    L -> b22[i] = bubble2( phiOmega , phiOmega   , phi5 , -1 , -1 , 0 )/phif ;
     
-    lutcont.IMetaSub = IQ0( phi5 , 0.0 , -1 ) ;
+    L -> IMetaSub = IQ0( phi5 , 0.0 , -1 ) ;
 
-    lutcont.D1[ i ] = sqrt( phiOmega )/phif*\
+    L -> D1[ i ] = sqrt( phiOmega )/phif*\
       ( bubble1( pl , phiCascade , phi3 , -1 , -1 , 0.0 )
 	- bubble1( mn , phiCascade , phi3 , -1 , -1 , 0.0 ) ) / (2*eps) ;
-    lutcont.D2[ i ] = (1/3.)*sqrt( phiOmega )/phif*\
+    L -> D2[ i ] = (1/3.)*sqrt( phiOmega )/phif*\
       ( + bubble2( pl , phiCasStar , phi3 , -1 , -1 , 0.0 )
 	- bubble2( mn , phiCasStar , phi3 , -1 , -1 , 0.0 )
 	+ bubble2( pl , pl , phi3 , -1 , -1 , 0.0 )
 	- bubble2( mn , mn , phi3 , -1 , -1 , 0.0 ) ) / (2*eps) ;
   }
-  return lutcont ;
+  return ;
+}
+
+// entries of the lookup table that do not depend on Phi3
+static void
+fixed_lut( struct LUT *L )
+{
+  for( size_t i = 0 ; i < NENSEMBLES ; i++ ) {
+    L -> b22[i] = bubble2( PhiOmega[ i ] , PhiOmega[ i ] , PhiEta[ i ] ,
+			   MetaL[ i ] , MOML[i] , fvIQR[i][2] )/phif ;
+
+    // eta lookup table values
+    L -> IMeta[i]        = IQ0( PhiEta[i] , 0.0 , MetaL[i] ) ;
+    L -> IQ0msq_eta[ i ] = msqIQ0( PhiEta[i] , 0 , MetaL[i] ) ;
+    L -> IQ2_eta[ i ]    = mqIQ2( PhiEta[i] , 0 , MetaL[i] ) ;
+
+    L -> fvpi0[ i ] = 4*fv_correction_k1( MPIL[i] )/(16*M_PI*M_PI) ;
+    L -> fvpi2[ i ] = 4*fv_correction_k2( MPIL[i] )/(16*M_PI*M_PI) ;
+  }
+  for( size_t i = 0 ; i < NENSEMBLES+1 ; i++ ) {
+    L -> fvk1K[i]  = MKL[i]  != -1 ? fv_correction_k1( MKL[i] )  : 0.0 ;
+    L -> fvk2K[i]  = MKL[i]  != -1 ? fv_correction_k2( MKL[i] )  : 0.0 ;
+    L -> fvk1pi[i] = MPIL[i] != -1 ? fv_correction_k1( MPIL[i] ) : 0.0 ;
+    L -> fvk2pi[i] = MPIL[i] != -1 ? fv_correction_k2( MPIL[i] ) : 0.0 ;
+  }
+  return ;
+}
+
+// entries of the lookup table that depend on Phi3
+static void
+phi3_lut( struct LUT *L ,
+	  const double *Phi3 )
+{
+  for( size_t i = 0 ; i < NENSEMBLES ; i++ ) {
+    const double eps = 1E-6 ;
+    const double mOm = sqrt(PhiOmega[ i ]) ;
+    const double pl = pow( mOm + eps , 2 ) , mn = pow( mOm - eps , 2 ) ;
+    const double fv1 = fvIQR[i][0] , fv2 = fvIQR[i][1] , fv3 = fvIQR[i][2] ;
+    
+    L -> b11[i] = bubble1( PhiOmega[ i ] , PhiCascade[ i ] , Phi3[ i ]   , MKL[ i ]   , MCasL[i]  , fv1 )/phif ;
+    L -> b21[i] = bubble2( PhiOmega[ i ] , PhiCasStar[ i ] , Phi3[ i ]   , MKL[ i ]   , MCsStL[i] , fv2 )/phif ;
+
+    L -> IQ0msq[ i ] = msqIQ0( Phi3[i] , 0 , MKL[i] ) ;
+    L -> IQ2[ i ]    = mqIQ2( Phi3[i] , 0 , MKL[i] ) ;
+    
+    L -> D1[ i ] = sqrt(8*0.5391144626032651*mOmega*mOmega)/(phif)*	\
+      ( bubble1( pl , PhiCascade[ i ] , Phi3[ i ] , MKL[ i ] , MCasL[ i ] , fv1 )
+	- bubble1( mn , PhiCascade[ i ] , Phi3[ i ] , MKL[ i ] , MCasL[ i ] , fv1 ) ) / (2*eps) ;
+
+    L -> D2[ i ] = (1/3.)*sqrt(8*0.5391144626032651*mOmega*mOmega)/(phif)*	\
+      ( + bubble2( pl , PhiCasStar[ i ] , Phi3[ i ] , MKL[ i ] , MCsStL[ i ] , fv2 )
+	- bubble2( mn , PhiCasStar[ i ] , Phi3[ i ] , MKL[ i ] , MCsStL[ i ] , fv2 )
+	+ bubble2( pl , pl , Phi3[ i ] , MetaL[ i ] , MOML[ i ] , fv3 )
+	- bubble2( mn , mn , Phi3[ i ] , MetaL[ i ] , MOML[ i ] , fv3 ) ) / (2*eps) ; 
+  }
+  return ;
 }
 
 void
@@ -620,137 +611,147 @@ init_phi3v2( const size_t Nboots )
     3.09814e-05, 3.86936e-05,
     0.0
   };
-  phi3_res = generate_fake_boot( NENSEMBLES+1, Nboots, y , dy ) ;
-
-  set_phi3v2( 0 , true ) ;
+  struct resampled *phi3_res = generate_fake_boot( NENSEMBLES+1, Nboots, y , dy ) ;
   for( size_t i = 0 ; i < NENSEMBLES+1 ; i++ ) {
     fprintf( stdout , "PHI3 set --> %zu %e %e\n" , i , phi3_res[i].avg , phi3_res[i].err ) ;
   }
 
-  // precompute all bubbles
+#ifndef FV_DIRECT
+  init_fv_bessel( FV_TOL ) ;
+#endif
+
+  // precompute all bubbles, the fv integrals and everything that does
+  // not care about Phi3 are done once and shared by all the samples
   fprintf( stdout , "Precomputing bubbles\n" ) ;
+  #pragma omp parallel for
   for( size_t i = 0 ; i < NENSEMBLES ; i++ ) {
-
-    const double eps = 1E-6 ;
-    const double mOm = sqrt(PhiOmega[ i ]) ;
-    const double pl = pow( mOm + eps , 2 ) , mn = pow( mOm - eps , 2 ) ;
-    
-    const double fv1 = fv_IQR( MCasL[i]  , MKL[i]   , MOML[i] ) ;
-    lut.b11[i] = bubble1( PhiOmega[ i ] , PhiCascade[ i ] , Phi3[ i ]   , MKL[ i ]   , MCasL[i]  , fv1 )/phif ;
-
-    const double fv2 = fv_IQR( MCsStL[i] , MKL[i]   , MOML[i] ) ;
-    lut.b21[i] = bubble2( PhiOmega[ i ] , PhiCasStar[ i ] , Phi3[ i ]   , MKL[ i ]   , MCsStL[i] , fv2 )/phif ;
-
-    const double fv3 = fv_IQR( MOML[i]   , MetaL[i] , MOML[i] ) ; 
-    lut.b22[i] = bubble2( PhiOmega[ i ] , PhiOmega[ i ]   , PhiEta[ i ] , MetaL[ i ] , MOML[i]   , fv3 )/phif ;
-
-    lut.IQ0msq[ i ] = msqIQ0( Phi3[i] , 0 , MKL[i] ) ;
-    lut.IQ2[ i ]    = mqIQ2( Phi3[i] , 0 , MKL[i] ) ;
-    
-    // eta lookup table values
-    lut.IMeta[i]        = IQ0( PhiEta[i] , 0.0 , MetaL[i] ) ;
-    lut.IQ0msq_eta[ i ] = msqIQ0( PhiEta[i] , 0 , MetaL[i] ) ;
-    lut.IQ2_eta[ i ]    = mqIQ2( PhiEta[i] , 0 , MetaL[i] ) ;
-
-    lut.fvpi0[ i ] = 4*fv_correction_k1( MPIL[i] )/(16*M_PI*M_PI) ;
-    lut.fvpi2[ i ] = 4*fv_correction_k2( MPIL[i] )/(16*M_PI*M_PI) ;
-    
-    
-    lut.D1[ i ] = sqrt(8*0.5391144626032651*mOmega*mOmega)/(phif)*		\
-      ( bubble1( pl , PhiCascade[ i ] , Phi3[ i ] , MKL[ i ] , MCasL[ i ] , fv1 )
-	- bubble1( mn , PhiCascade[ i ] , Phi3[ i ] , MKL[ i ] , MCasL[ i ] , fv1 ) ) / (2*eps) ;
-
-    lut.D2[ i ] = (1/3.)*sqrt(8*0.5391144626032651*mOmega*mOmega)/(phif)*			\
-      ( + bubble2( pl , PhiCasStar[ i ] , Phi3[ i ] , MKL[ i ] , MCsStL[ i ] , fv2 )
-	- bubble2( mn , PhiCasStar[ i ] , Phi3[ i ] , MKL[ i ] , MCsStL[ i ] , fv2 )
-	+ bubble2( pl , pl , Phi3[ i ] , MetaL[ i ] , MOML[ i ] , fv3 )
-	- bubble2( mn , mn , Phi3[ i ] , MetaL[ i ] , MOML[ i ] , fv3 ) ) / (2*eps) ; 
+    fvIQR[i][0] = fv_IQR( MCasL[i]  , MKL[i]   , MOML[i] ) ;
+    fvIQR[i][1] = fv_IQR( MCsStL[i] , MKL[i]   , MOML[i] ) ;
+    fvIQR[i][2] = fv_IQR( MOML[i]   , MetaL[i] , MOML[i] ) ;
   }
-}
+  // fixed_lut and phi3_lut leave the continuum entries and IMetaSub alone
+  struct LUT fixed ;
+  memset( &fixed , 0 , sizeof( struct LUT ) ) ;
+  fixed_lut( &fixed ) ;
+  setlutcont( &lutcont , 1.0 ) ;
+
+  free( ctx ) ;
+  Nctx = phi3_res[0].NSAMPLES ;
+  ctx = malloc( ( Nctx + 1 ) * sizeof( struct fvol_ctx ) ) ;
+  #pragma omp parallel for
+  for( size_t k = 0 ; k < Nctx+1 ; k++ ) {
+    for( size_t i = 0 ; i < NENSEMBLES+1 ; i++ ) {
+      ctx[k].Phi3[i] = ( k == Nctx ) ? phi3_res[i].avg : phi3_res[i].resampled[k] ;
+    }
+    ctx[k].lut = fixed ;
+    phi3_lut( &ctx[k].lut , ctx[k].Phi3 ) ;
+  }
+  free_fitparams( phi3_res , NENSEMBLES+1 ) ;
 
-#ifdef COMPUTE_ZOMEGA
-static inline double
-Zomega( const double *fparams , const struct LUT lt , const int Npars )
-{  
-  return 1 + fparams[6]*fparams[6]*lt.D1[Npars] + fparams[7]*fparams[7]*(lt.D2[Npars]) ;
+  set_phi3v2( 0 , true ) ;
 }
-#endif
-
-double
-ffvol_deltav2( const struct x_desc X , const double *fparams , const size_t Npars )
-{
-  const double asq = fparams[0]*fparams[0] ;
-  const double t0 = 1.0 ; //fparams[13] ;
-
-  const double t0_asq = t0/asq  ; //+ fparams[2]*(X.X-mpi*mpi*asq) ;
-  //const double t0_asq = fparams[13]/asq ; //*(1 + fparams[2]*(X.X/asq-mpi*mpi) );
-  
-  const double phi2 = 8*t0_asq*X.X ;
-  const double phi3 = 8*t0_asq*Phi3[Npars] ;
-  const double phi5 = (4*phi3-phi2)/3. ;
-
-  const double phi2cont = 8*t0*(mpi*mpi) ;
-  const double phi3cont = 8*t0*(mk*mk) ;
-  const double phi5cont = (4*phi3cont-phi2cont)/3. ;
-
-  //printf( "Here %g \n" , t0 ) ;
-  //printf( "Here %g %g \n" , t0_asq , fparams[0] ) ; 
-  //printf( "Test phi2 %g | phi3 %g | phi5 %g\n" , phi2 , phi3 , phi5 ) ;
-
-  const struct LUT lutcont = setlutcont( t0 ) ;
-
-  const double c1 = phi2cont*phi2cont ;
-  const double c3 = phi3cont*phi3cont ;
-
-  const double t0musq = 8*t0*chiral_mu*chiral_mu ;
-
-  const double c4 = (c3*log(phi3cont/t0musq))/(16*M_PI*M_PI);
-  
-  const double c8 = (c1*log(phi2cont/t0musq))/(16*M_PI*M_PI);
-
-  const double c6  = phi3cont-phi2cont ;
-  const double c11 = phi3cont+phi2cont/2. ;
-
-  const double fv1 = msqIQ0( phi3 , 0 , MKL[Npars] ) ;
-  const double fv2 = mqIQ2( phi3 , 0 , MKL[Npars] ) ;
-
-  const double fv3 = msqIQ0( phi2 , 0 , MPIL[Npars] ) ;
-  const double fv4 = mqIQ2( phi2 , 0 , MPIL[Npars] ) ;
 
 #ifdef COMPUTE_ZOMEGA
-  const double Zom = Zomega( fparams , lut     , Npars      ) ;
-  const double Zph = Zomega( fparams , lutcont , NENSEMBLES ) ;  
+  // only the value of the parameters goes into Zomega
+  #define ZOMEGA( fparams , lt , idx )					\
+    ( 1 + AD_VAL( fparams[6] )*AD_VAL( fparams[6] )*(lt).D1[idx]	\
+      + AD_VAL( fparams[7] )*AD_VAL( fparams[7] )*(lt).D2[idx] )
 #else
-  const double Zom = 1.0 , Zph = 1.0  ;
-#endif
-
-  const double fif = 8*t0*chiral_f*chiral_f ;
-  
-  return fparams[0]*( 1 
-		      +fparams[1]*( -(8/3.)*( (phi3-phi2) - c6 ) )
-
-
-		      //+fparams[3]*( (phi3-phi2)*phi5 - c6*phi5cont )
-		      -fparams[4]*(fv1-c4)/fif
-		      -fparams[5]*(fv2-c4/4.)/fif
-
-		      -fparams[8]*(fv3-c8)/fif
-		      -fparams[9]*(fv4-c8/4.)/fif
-
-		      //
-		      +fparams[6]*fparams[6]*( +lut.b11[Npars]/Zom - lutcont.b11[NENSEMBLES]/Zph )
-		      +fparams[7]*fparams[7]*(1/3.)*( +lut.b21[Npars]/Zom - lutcont.b21[NENSEMBLES]/Zph
-						      +lut.b22[Npars]/Zom - lutcont.b22[NENSEMBLES]/Zph )
+  #define ZOMEGA( fparams , lt , idx ) (1.0)
+#endif
+
+// msqIQ0 and mqIQ2 where only phi carries derivatives, k1 and k2 are
+// the tabulated finite volume sums
+#define LUT_MSQIQ0( phi , k1 )						\
+  AD_SCALE( AD_ADD( AD_MUL( AD_MUL( phi , phi ) ,			\
+			    AD_LOG( AD_SCALE( phi , 1./musq ) ) ) ,	\
+		    AD_SCALE( AD_MUL( phi , phi ) , 4*(k1) ) ) ,	\
+	    1./(16*M_PI*M_PI) )
+
+#define LUT_MQIQ2( phi , k2 )						\
+  AD_SCALE( AD_SUB( AD_SCALE( AD_MUL( AD_MUL( phi , phi ) ,		\
+				      AD_LOG( AD_SCALE( phi , 1./musq ) ) ) , 1/4. ) , \
+		    AD_SCALE( AD_MUL( phi , phi ) , 4*(k2) ) ) ,	\
+	    1./(16*M_PI*M_PI) )
+
+// the model written once, ffvol_deltav2 is used for the value and
+// ffvol_deltav2_dual for the derivatives. Npars is the ensemble index
+#define FFVOL_DELTAV2( name , T )					\
+  T name( const struct x_desc X , const T *fparams , const size_t Npars ) \
+  {									\
+    const double t0 = 1.0 ; /*fparams[13]*/				\
+									\
+    const struct fvol_ctx *C = ( X.Ctx != NULL ) ? X.Ctx : def_ctx ;	\
+    if( C == NULL ) {							\
+      return AD_CONST( NAN , fparams[0] ) ;				\
+    }									\
+    const struct LUT *lut = &C -> lut ;					\
+									\
+    /* t0/a^2 */							\
+    const T t0_asq = AD_SCALE( AD_INV( AD_MUL( fparams[0] , fparams[0] ) ) , t0 ) ; \
+									\
+    const T phi2 = AD_SCALE( t0_asq , 8*X.X ) ;				\
+    const T phi3 = AD_SCALE( t0_asq , 8*C -> Phi3[Npars] ) ;		\
+									\
+    const double phi2cont = 8*t0*(mpi*mpi) ;				\
+    const double phi3cont = 8*t0*(mk*mk) ;				\
+									\
+    const double c1 = phi2cont*phi2cont ;				\
+    const double c3 = phi3cont*phi3cont ;				\
+									\
+    const double t0musq = 8*t0*chiral_mu*chiral_mu ;			\
+									\
+    const double c4 = (c3*log(phi3cont/t0musq))/(16*M_PI*M_PI) ;	\
+    const double c8 = (c1*log(phi2cont/t0musq))/(16*M_PI*M_PI) ;	\
+									\
+    const double c6  = phi3cont-phi2cont ;				\
+    const double c11 = phi3cont+phi2cont/2. ;				\
+									\
+    const T fv1 = LUT_MSQIQ0( phi3 , lut -> fvk1K[Npars] ) ;		\
+    const T fv2 = LUT_MQIQ2( phi3 , lut -> fvk2K[Npars] ) ;		\
+									\
+    const T fv3 = LUT_MSQIQ0( phi2 , lut -> fvk1pi[Npars] ) ;		\
+    const T fv4 = LUT_MQIQ2( phi2 , lut -> fvk2pi[Npars] ) ;		\
+									\
+    const double Zom = ZOMEGA( fparams , *lut , Npars ) ;		\
+    const double Zph = ZOMEGA( fparams , lutcont , NENSEMBLES ) ;	\
+									\
+    const double fif = 8*t0*chiral_f*chiral_f ;				\
+									\
+    T sum = AD_CONST( 1.0 , fparams[0] ) ;				\
+									\
+    sum = AD_ADD( sum , AD_MUL( fparams[1] ,				\
+				AD_SCALE( AD_SHIFT( AD_SUB( phi3 , phi2 ) , -c6 ) , -8/3. ) ) ) ; \
+									\
+    sum = AD_SUB( sum , AD_SCALE( AD_MUL( fparams[4] , AD_SHIFT( fv1 , -c4 ) ) , 1./fif ) ) ; \
+    sum = AD_SUB( sum , AD_SCALE( AD_MUL( fparams[5] , AD_SHIFT( fv2 , -c4/4. ) ) , 1./fif ) ) ; \
+    sum = AD_SUB( sum , AD_SCALE( AD_MUL( fparams[8] , AD_SHIFT( fv3 , -c8 ) ) , 1./fif ) ) ; \
+    sum = AD_SUB( sum , AD_SCALE( AD_MUL( fparams[9] , AD_SHIFT( fv4 , -c8/4. ) ) , 1./fif ) ) ; \
+									\
+    sum = AD_ADD( sum , AD_SCALE( AD_MUL( fparams[6] , fparams[6] ) ,	\
+				  lut -> b11[Npars]/Zom - lutcont.b11[NENSEMBLES]/Zph ) ) ; \
+    sum = AD_ADD( sum , AD_SCALE( AD_MUL( fparams[7] , fparams[7] ) ,	\
+				  (1/3.)*( lut -> b21[Npars]/Zom - lutcont.b21[NENSEMBLES]/Zph \
+					   +lut -> b22[Npars]/Zom - lutcont.b22[NENSEMBLES]/Zph ) ) ) ; \
+									\
+    sum = AD_SUB( sum , AD_SCALE( AD_MUL( AD_ADD( fparams[12] , AD_SCALE( fparams[1] , 1/3. ) ) , \
+					  AD_SHIFT( AD_ADD( phi3 , AD_SCALE( phi2 , 0.5 ) ) , -c11 ) ) , 4 ) ) ; \
+									\
+    return AD_MUL( fparams[0] , sum ) ;					\
+  }
 
-		      -4*(fparams[12]+fparams[1]/3.)*( (phi3+phi2/2.) - c11 )
-		      ) ; 
-}
+FFVOL_DELTAV2( ffvol_deltav2 , double )
+static FFVOL_DELTAV2( ffvol_deltav2_dual , struct dual )
 
+// single pass over the data for f, df and d2f which can be NULL
 void
-fvol_deltav2_f( double *f , const void *data , const double *fparams )
+fvol_deltav2_fdf( double *f , double **df , double **d2f ,
+		  const void *data , const double *fparams )
 {
   const double mul = (1.67245/mOmega) ;
   const struct data *DATA = (const struct data*)data ;
+  const int order = ( d2f != NULL ) ? 2 : ( df != NULL ) ? 1 : 0 ;
+  const size_t Nlogic = ( d2f != NULL ) ? ad_nlogic( DATA ) : 0 ;
   size_t i , j ; 
   for( i = 0 ; i < DATA -> n ; i++ ) {
     double p[ DATA -> Npars ] ;
@@ -758,41 +759,41 @@ fvol_deltav2_f( double *f , const void *data , const double *fparams )
       p[ j ] = fparams[ DATA -> map[ i ].p[ j ] ] ;
     }
     struct x_desc X = { DATA -> x[i] , DATA -> LT[i] ,
-			DATA -> N , DATA -> M } ;
-
-    f[i] = ffvol_deltav2( X , p , i ) - DATA -> y[i]*mul ;
+			DATA -> N , DATA -> M , DATA -> Ctx } ;
+    if( order == 0 ) {
+      if( f != NULL ) {
+	f[i] = ffvol_deltav2( X , p , i ) - DATA -> y[i]*mul ;
+      }
+      continue ;
+    }
+    const struct dual res = ad_point( ffvol_deltav2_dual , X , p , i ,
+				      DATA -> Npars , order ) ;
+    ad_set_point( NULL , df , d2f , DATA , i , Nlogic , res ) ;
+    if( f != NULL ) {
+      f[i] = res.v - DATA -> y[i]*mul ;
+    }
   }
   return ;
 }
 
+void
+fvol_deltav2_f( double *f , const void *data , const double *fparams )
+{
+  fvol_deltav2_fdf( f , NULL , NULL , data , fparams ) ;
+}
+
 // derivatives
 void
 fvol_deltav2_df( double **df , const void *data , const double *fparams )
 {
-  const struct data *DATA = (const struct data*)data ;
-
-  for( size_t i = 0 ; i < DATA -> n ; i++ ) {
-    struct x_desc X = { DATA -> x[i] , DATA -> LT[i] ,
-			DATA -> N , DATA -> M } ;
-
-    size_t j ;
-    for( j = 0 ; j < DATA -> Npars ; j++ ) {
-      df[ DATA -> map[i].p[j] ][i] = Nder( ffvol_deltav2 ,
-					   X ,
-					   i,
-					   fparams ,
-					   j ,
-					   DATA -> Npars ) ;
-    }
-  }
-  return ;
+  fvol_deltav2_fdf( NULL , df , NULL , data , fparams ) ;
 }
 
-// second derivatives? Will we ever use them - J?
+// second derivatives
 void
 fvol_deltav2_d2f( double **d2f , const void *data , const double *fparams )
 {
-  return ;
+  fvol_deltav2_fdf( NULL , NULL , d2f , data , fparams ) ;
 }
 
 void
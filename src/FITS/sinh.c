@@ -5,58 +5,50 @@
  */
 #include "gens.h"
 
-double
-fsinh( const struct x_desc X , const double *fparams , const size_t Npars )
-{
-  size_t i ;
-  register double sum = 0.0 ;
-  for( i = 0 ; i < 2 * X.N ; i+=2 ) {
-    sum += fparams[i] * ( exp( -fparams[i+1] * X.X ) -
-			  exp( -fparams[i+1] * ( X.LT - X.X ) ) ) ;
+#include "dual.h"
+
+// the model written once, fsinh is used for the value and fsinh_dual
+// for the derivatives
+#define FSINH( name , T )						\
+  T name( const struct x_desc X , const T *fparams , const size_t Npars )	\
+  {									\
+    size_t i ;								\
+    T sum = AD_CONST( 0.0 , fparams[0] ) ;				\
+    for( i = 0 ; i < 2 * X.N ; i+=2 ) {					\
+      const T fwd = AD_EXP( AD_SCALE( fparams[i+1] , -X.X ) ) ;	\
+      const T bwd = AD_EXP( AD_SCALE( fparams[i+1] , -( X.LT - X.X ) ) ) ; \
+      sum = AD_ADD( sum , AD_MUL( fparams[i] , AD_SUB( fwd , bwd ) ) ) ; \
+    }									\
+    return sum ;							\
   }
-  return sum ;
+
+FSINH( fsinh , double )
+static FSINH( fsinh_dual , struct dual )
+
+// f, df and d2f in a single pass
+void
+sinh_fdf( double *f , double **df , double **d2f ,
+          const void *data , const double *fparams )
+{
+  ad_fdf( f , df , d2f , data , fparams , fsinh_dual ) ;
 }
 
 void
 sinh_f( double *f , const void *data , const double *fparams )
 {
-  const struct data *DATA = (const struct data*)data ;
-  size_t i , j ; 
-  for (i = 0; i < DATA -> n ; i++) {
-    double p[ DATA -> N * 2 ] ;
-    for( j = 0 ; j < DATA -> N * 2 ; j++ ) {
-      p[ j ] = fparams[ DATA -> map[ i ].p[ j ] ] ;
-    }
-    const struct x_desc X = { DATA -> x[i] , DATA -> LT[i] ,
-			      DATA -> N , DATA -> M } ;
-    f[i] = fsinh( X , p , DATA -> N * 2 ) - DATA -> y[i] ;
-  }
-  return ;
+  ad_f( f , data , fparams , fsinh ) ;
 }
 
 // derivatives
 void
 sinh_df( double **df , const void *data , const double *fparams )
 {
-  const struct data *DATA = (const struct data*)data ;
-  size_t i , j ;
-  for( i = 0 ; i < DATA -> n ; i++ ) {
-    for( j = 0 ; j < 2*DATA -> N ; j+= 2 ) {
-    const double t = DATA -> x[i] ;
-      const double fwd = exp( -fparams[ DATA -> map[i].p[j+1] ] * t ) ;
-      const double bwd = exp( -fparams[ DATA -> map[i].p[j+1] ] * ( DATA -> LT[i] - t ) ) ;
-      df[ DATA -> map[i].p[j+0] ][i] = fwd - bwd ;
-      df[ DATA -> map[i].p[j+1] ][i] = -fparams[ DATA -> map[i].p[j] ] *
-	( t * fwd - ( DATA -> LT[i] - t ) * bwd ) ;
-    }
-  }
-  return ;
+  ad_df( df , data , fparams , fsinh_dual ) ;
 }
 
 // second derivatives
 void
 sinh_d2f( double **d2f , const void *data , const double *fparams )
 {
-  return ;
+  ad_d2f( d2f , data , fparams , fsinh_dual ) ;
 }
-
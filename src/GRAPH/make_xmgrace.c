@@ -1,32 +1,74 @@
 /**
    @file make_xmgrace.c
    @brief draw an xmgrace graph
+
+   Everything is formatted into one buffer that is written out a dataset
+   at a time. If asked for, the points also go to a compact csv file
+   next to the .agr with lines "set,x,y" for curves and
+   "set,x,y,dx+,dx-,dy+,dy-" for data
  */
 #include "gens.h"
 
+#include <stdarg.h>
+
 #include "ffunction.h"
 #include "fitfunc.h"
+#include "make_xmgrace.h"
 #include "plot_fitfunc.h"
 
-static FILE *file ;
+static FILE *file = NULL , *csv = NULL ;
 static size_t dataset = 0 , colorset = 1 ;
 
+// formatting buffer
+static char *buf = NULL ;
+static size_t buflen = 0 , bufsize = 0 ;
+
+// append to the buffer, growing it if we need to
+static void
+gprintf( const char *fmt , ... )
+{
+  for(;;) {
+    va_list ap ;
+    va_start( ap , fmt ) ;
+    const int n = vsnprintf( buf + buflen , bufsize - buflen , fmt , ap ) ;
+    va_end( ap ) ;
+    if( n < 0 ) return ;
+    if( buflen + n < bufsize ) {
+      buflen += n ;
+      return ;
+    }
+    bufsize = 2*( buflen + n ) + 4096 ;
+    buf = realloc( buf , bufsize ) ;
+  }
+}
+
+// write whatever is buffered to the graph
+static void
+flush_graph( void )
+{
+  if( file != NULL && buflen > 0 ) {
+    fwrite( buf , 1 , buflen , file ) ;
+  }
+  buflen = 0 ;
+  return ;
+}
+
 static void
 PrintHeader( void )
 {
   const size_t symbol = ( dataset + 1 ) % 11 ;
-  fprintf( file , "@\ts%zu hidden false\n" , dataset ) ;  
-  fprintf( file , "@\ts%zu symbol %zu\n" , dataset , symbol ) ;  
-  fprintf( file , "@\ts%zu symbol size 0.62\n" , dataset ) ;  
-  fprintf( file , "@\ts%zu symbol color %zu\n" , dataset , colorset ) ;  
-  fprintf( file , "@\ts%zu symbol fill color %zu\n" , dataset , colorset ) ;  
-  fprintf( file , "@\ts%zu symbol fill pattern 1\n" , dataset ) ;  
-  fprintf( file , "@\ts%zu line type 0\n" , dataset ) ;  
-  fprintf( file , "@\ts%zu line color %zu\n" , dataset , colorset ) ;  
-  fprintf( file , "@\ts%zu errorbar on\n" , dataset ) ;  
-  fprintf( file , "@\ts%zu errorbar place both\n" , dataset ) ;  
-  fprintf( file , "@\ts%zu errorbar color %zu\n" , dataset , colorset ) ;  
-  fprintf( file , "@\ts%zu errorbar size 1\n" , dataset ) ; 
+  gprintf( "@\ts%zu hidden false\n" , dataset ) ;  
+  gprintf( "@\ts%zu symbol %zu\n" , dataset , symbol ) ;  
+  gprintf( "@\ts%zu symbol size 0.62\n" , dataset ) ;  
+  gprintf( "@\ts%zu symbol color %zu\n" , dataset , colorset ) ;  
+  gprintf( "@\ts%zu symbol fill color %zu\n" , dataset , colorset ) ;  
+  gprintf( "@\ts%zu symbol fill pattern 1\n" , dataset ) ;  
+  gprintf( "@\ts%zu line type 0\n" , dataset ) ;  
+  gprintf( "@\ts%zu line color %zu\n" , dataset , colorset ) ;  
+  gprintf( "@\ts%zu errorbar on\n" , dataset ) ;  
+  gprintf( "@\ts%zu errorbar place both\n" , dataset ) ;  
+  gprintf( "@\ts%zu errorbar color %zu\n" , dataset , colorset ) ;  
+  gprintf( "@\ts%zu errorbar size 1\n" , dataset ) ; 
   return ;
 }
 
@@ -34,59 +76,59 @@ static void
 initialise_graph( const char *x_axis , 
 		  const char *y_axis )
 {
-  fprintf( file , "@map font 0 to \"Times-Roman\", \"Times-Roman\"\n" ) ;
-  fprintf( file , "@map font 1 to \"Symbol\", \"Symbol\"\n" ) ;
-  fprintf( file , "@map font 2 to \"Helvetica\", \"Helvetica\"\n" ) ;
-  fprintf( file , "@map color 0 to (255,255,255), \"white\"\n" ) ;
-  fprintf( file , "@map color 1 to (0,0,0), \"black\"\n" ) ;
-  fprintf( file , "@map color 2 to (255,0,0), \"red\"\n" ) ;
-  fprintf( file , "@map color 3 to (0,100,0), \"dark green\"\n" ) ;
-  fprintf( file , "@map color 4 to (0,0,255), \"blue\"\n" ) ;
-  fprintf( file , "@map color 5 to (188,143,143), \"rosy brown\"\n" ) ;
-  fprintf( file , "@map color 6 to (178,34,34), \"firebrick\"\n" ) ;
-  fprintf( file , "@map color 7 to (205,92,92), \"indian red\"\n" ) ;
-  fprintf( file , "@map color 8 to (46,139,87), \"sea green\"\n" ) ;
-  fprintf( file , "@map color 9 to (255,69,0), \"orange red\"\n" ) ;
-  fprintf( file , "@map color 10 to (0,128,128), \"teal\"\n" ) ;
-  fprintf( file , "@map color 11 to (128,128,0), \"olive\"\n" ) ;
-  fprintf( file , "@map color 12 to (184,134,11), \"dark golden rod\"\n" ) ;
-  fprintf( file , "@map color 13 to (47,79,79), \"dark slate gray\"\n" ) ;
-  fprintf( file , "@map color 14 to (128,0,128), \"purple\"\n" ) ;
-  fprintf( file , "@map color 15 to (160,82,45), \"sienna\"\n" ) ;
-  fprintf( file , "@default linestyle 1\n" ) ;
-  fprintf( file , "@default linewidth 1.0\n" ) ;
-  fprintf( file , "@default color 1\n" ) ;
-  fprintf( file , "@default pattern 1\n" ) ;
-  fprintf( file , "@default font 0\n" ) ;
-  fprintf( file , "@background color 0\n" ) ;
-  fprintf( file , "@page background fill on\n" ) ;
-  fprintf( file , "@g0 on\n" ) ;
-  fprintf( file , "@g0 type XY\n" ) ;
-  fprintf( file , "@with g0\n" ) ;
-  fprintf( file , "@\tview 0.180000, 0.180000, 1.250000, 0.950000\n" ) ;
-  fprintf( file , "@\txaxes invert off\n" ) ;  
-  fprintf( file , "@\tyaxes invert off\n" ) ;  
-  fprintf( file , "@\txaxes scale Normal\n" ) ;  
-  fprintf( file , "@\tyaxes scale Normal\n" ) ;  
-  fprintf( file , "@\txaxis on\n" ) ;  
-  fprintf( file , "@\txaxis\tlabel char size 1.490000\n" ) ;  
-  fprintf( file , "@\txaxis\ttick minor ticks 0\n" ) ; 
-  fprintf( file , "@\txaxis\ttick out\n" ) ;  
-  fprintf( file , "@\tyaxis on\n" ) ;  
-  fprintf( file , "@\tyaxis\tlabel char size 1.490000\n" ) ; 
-  fprintf( file , "@\tyaxis\ttick minor ticks 0\n" ) ; 
-  fprintf( file , "@\tyaxis\ttick out\n" ) ; 
+  gprintf( "@map font 0 to \"Times-Roman\", \"Times-Roman\"\n" ) ;
+  gprintf( "@map font 1 to \"Symbol\", \"Symbol\"\n" ) ;
+  gprintf( "@map font 2 to \"Helvetica\", \"Helvetica\"\n" ) ;
+  gprintf( "@map color 0 to (255,255,255), \"white\"\n" ) ;
+  gprintf( "@map color 1 to (0,0,0), \"black\"\n" ) ;
+  gprintf( "@map color 2 to (255,0,0), \"red\"\n" ) ;
+  gprintf( "@map color 3 to (0,100,0), \"dark green\"\n" ) ;
+  gprintf( "@map color 4 to (0,0,255), \"blue\"\n" ) ;
+  gprintf( "@map color 5 to (188,143,143), \"rosy brown\"\n" ) ;
+  gprintf( "@map color 6 to (178,34,34), \"firebrick\"\n" ) ;
+  gprintf( "@map color 7 to (205,92,92), \"indian red\"\n" ) ;
+  gprintf( "@map color 8 to (46,139,87), \"sea green\"\n" ) ;
+  gprintf( "@map color 9 to (255,69,0), \"orange red\"\n" ) ;
+  gprintf( "@map color 10 to (0,128,128), \"teal\"\n" ) ;
+  gprintf( "@map color 11 to (128,128,0), \"olive\"\n" ) ;
+  gprintf( "@map color 12 to (184,134,11), \"dark golden rod\"\n" ) ;
+  gprintf( "@map color 13 to (47,79,79), \"dark slate gray\"\n" ) ;
+  gprintf( "@map color 14 to (128,0,128), \"purple\"\n" ) ;
+  gprintf( "@map color 15 to (160,82,45), \"sienna\"\n" ) ;
+  gprintf( "@default linestyle 1\n" ) ;
+  gprintf( "@default linewidth 1.0\n" ) ;
+  gprintf( "@default color 1\n" ) ;
+  gprintf( "@default pattern 1\n" ) ;
+  gprintf( "@default font 0\n" ) ;
+  gprintf( "@background color 0\n" ) ;
+  gprintf( "@page background fill on\n" ) ;
+  gprintf( "@g0 on\n" ) ;
+  gprintf( "@g0 type XY\n" ) ;
+  gprintf( "@with g0\n" ) ;
+  gprintf( "@\tview 0.180000, 0.180000, 1.250000, 0.950000\n" ) ;
+  gprintf( "@\txaxes invert off\n" ) ;  
+  gprintf( "@\tyaxes invert off\n" ) ;  
+  gprintf( "@\txaxes scale Normal\n" ) ;  
+  gprintf( "@\tyaxes scale Normal\n" ) ;  
+  gprintf( "@\txaxis on\n" ) ;  
+  gprintf( "@\txaxis\tlabel char size 1.490000\n" ) ;  
+  gprintf( "@\txaxis\ttick minor ticks 0\n" ) ; 
+  gprintf( "@\txaxis\ttick out\n" ) ;  
+  gprintf( "@\tyaxis on\n" ) ;  
+  gprintf( "@\tyaxis\tlabel char size 1.490000\n" ) ; 
+  gprintf( "@\tyaxis\ttick minor ticks 0\n" ) ; 
+  gprintf( "@\tyaxis\ttick out\n" ) ; 
   // X axis label
-  fprintf( file , "@\txaxis label \"%s\" \n" , x_axis ) ;  
+  gprintf( "@\txaxis label \"%s\" \n" , x_axis ) ;  
   // Y axis label
-  fprintf( file , "@\tyaxis label \"%s\" \n" , y_axis ) ;  
-  fprintf( file , "@\txaxis label place auto\n" ) ;  
-  fprintf( file , "@\tyaxis label place auto\n" ) ;  
-  fprintf( file , "@\taltxaxis\toff\n" ) ;  
-  fprintf( file , "@\taltyaxis\toff\n" ) ;  
-  fprintf( file , "@\tlegend on\n" ) ;  
-  fprintf( file , "@\tlegend 0.75, 0.94\n" ) ;  
-  fprintf( file , "@\tlegend char size 1.50000\n") ;  
+  gprintf( "@\tyaxis label \"%s\" \n" , y_axis ) ;  
+  gprintf( "@\txaxis label place auto\n" ) ;  
+  gprintf( "@\tyaxis label place auto\n" ) ;  
+  gprintf( "@\taltxaxis\toff\n" ) ;  
+  gprintf( "@\taltyaxis\toff\n" ) ;  
+  gprintf( "@\tlegend on\n" ) ;  
+  gprintf( "@\tlegend 0.75, 0.94\n" ) ;  
+  gprintf( "@\tlegend char size 1.50000\n") ;  
   return ;
 }
 
@@ -94,8 +136,17 @@ initialise_graph( const char *x_axis ,
 void
 close_xmgrace_graph( void )
 {
+  flush_graph( ) ;
   dataset = 0 ; colorset = 1 ;
   fclose( file ) ;
+  file = NULL ;
+  if( csv != NULL ) {
+    fclose( csv ) ;
+    csv = NULL ;
+  }
+  free( buf ) ;
+  buf = NULL ;
+  buflen = bufsize = 0 ;
   return ;
 }
 
@@ -103,19 +154,28 @@ close_xmgrace_graph( void )
 void
 draw_line( const double *x , const double *y , const size_t n )
 {
-  fprintf( file , "@\ts%zu hidden false\n" , dataset ) ;  
-  fprintf( file , "@\ts%zu symbol 0\n" , dataset ) ;  
-  fprintf( file , "@\ts%zu line color 1\n" , dataset ) ;  
-  fprintf( file , "@\ts%zu errorbar color 1\n" , dataset ) ;  
-  fprintf( file , "@\ts%zu legend \"\"\n" , dataset ) ;  
-  fprintf( file , "@target G0.S%zu\n" , dataset ) ;
-  fprintf( file , "@type xy\n" ) ;
+  gprintf( "@\ts%zu hidden false\n" , dataset ) ;  
+  gprintf( "@\ts%zu symbol 0\n" , dataset ) ;  
+  gprintf( "@\ts%zu line color 1\n" , dataset ) ;  
+  gprintf( "@\ts%zu errorbar color 1\n" , dataset ) ;  
+  gprintf( "@\ts%zu legend \"\"\n" , dataset ) ;  
+  gprintf( "@target G0.S%zu\n" , dataset ) ;
+  gprintf( "@type xy\n" ) ;
 
   size_t i ;
   for( i = 0 ; i < n ; i++ ) {
-    fprintf( file , "%e %e\n" , x[i] , y[i] ) ;
+    gprintf( "%e %e\n" , x[i] , y[i] ) ;
+  }
+  gprintf( "&\n" ) ;
+  flush_graph( ) ;
+
+  if( csv != NULL ) {
+    for( i = 0 ; i < n ; i++ ) {
+      gprintf( "%zu,%.15e,%.15e\n" , dataset , x[i] , y[i] ) ;
+    }
+    fwrite( buf , 1 , buflen , csv ) ;
+    buflen = 0 ;
   }
-  fprintf( file , "&\n" ) ;
 
   dataset ++ ;
 
@@ -131,10 +191,41 @@ make_xmgrace_graph( const char *filename ,
   printf( "\n[GRAPH] name :: %s \n" , filename ) ;
   printf( "[GRAPH] axes (x) %s (y) %s \n" , x_axis , y_axis ) ;
   file = fopen( filename , "w" ) ;
+  buflen = 0 ;
+  if( buf == NULL ) {
+    bufsize = 1<<16 ;
+    buf = malloc( bufsize ) ;
+  }
   initialise_graph( x_axis , y_axis ) ;
+  flush_graph( ) ;
   return ;
 }
 
+// open a graph from the input file settings
+void
+open_graph( const struct graph Graph )
+{
+  make_xmgrace_graph( Graph.Name , Graph.Xaxis , Graph.Yaxis ) ;
+  if( Graph.Csv == true ) {
+    char str[ strlen( Graph.Name ) + 5 ] ;
+    sprintf( str , "%s.csv" , Graph.Name ) ;
+    if( ( csv = fopen( str , "w" ) ) == NULL ) {
+      fprintf( stderr , "[GRAPH] cannot open %s\n" , str ) ;
+    } else {
+      printf( "[GRAPH] csv :: %s \n" , str ) ;
+    }
+  }
+  return ;
+}
+
+// we don't plot infinite or nan points
+static inline bool
+bad_point( const struct resampled y )
+{
+  return isinf( fabs( y.avg ) ) || isnan( fabs( y.avg ) ) ||
+    isinf( fabs( y.err ) ) || isnan( fabs( y.err ) ) ;
+}
+
 // plot the data
 void
 plot_data( const struct resampled *x ,
@@ -144,17 +235,14 @@ plot_data( const struct resampled *x ,
   // plot the data
   PrintHeader( ) ;
 
-  fprintf( file , "@\ts%zu legend \"\" \n" , dataset ) ;  
-  fprintf( file , "@target G0.S%zu\n" , dataset ) ;
-  fprintf( file , "@type xydxdxdydy\n" ) ;
+  gprintf( "@\ts%zu legend \"\" \n" , dataset ) ;  
+  gprintf( "@target G0.S%zu\n" , dataset ) ;
+  gprintf( "@type xydxdxdydy\n" ) ;
 
   size_t i ;
   for( i = 0 ; i < Ndata ; i++ ) {
-    if( isinf( fabs( y[i].avg ) ) ||
-	isnan( fabs( y[i].avg ) ) ||
-	isinf( fabs( y[i].err ) ) ||
-	isnan( fabs( y[i].err ) ) ) continue ;
-    fprintf( file , "%e %e %e %e %e %e\n" ,
+    if( bad_point( y[i] ) ) continue ;
+    gprintf( "%e %e %e %e %e %e\n" ,
 	     x[i].avg , 
 	     y[i].avg ,
 	     x[i].err_hi - x[i].avg , 
@@ -162,7 +250,20 @@ plot_data( const struct resampled *x ,
 	     y[i].err_hi - y[i].avg ,
 	     y[i].avg - y[i].err_lo ) ;
   }
-  fprintf( file , "&\n" ) ;
+  gprintf( "&\n" ) ;
+  flush_graph( ) ;
+
+  if( csv != NULL ) {
+    for( i = 0 ; i < Ndata ; i++ ) {
+      if( bad_point( y[i] ) ) continue ;
+      gprintf( "%zu,%.15e,%.15e,%.15e,%.15e,%.15e,%.15e\n" , dataset ,
+	       x[i].avg , y[i].avg ,
+	       x[i].err_hi - x[i].avg , x[i].avg - x[i].err_lo ,
+	       y[i].err_hi - y[i].avg , y[i].avg - y[i].err_lo ) ;
+    }
+    fwrite( buf , 1 , buflen , csv ) ;
+    buflen = 0 ;
+  }
   dataset ++ ;
   colorset = ( colorset + 1 ) % 16 ;
   return ;
@@ -175,7 +276,7 @@ make_graph( const struct resampled *fitparams ,
 	    const struct graph Graph )
 {
   // make the graph
-  make_xmgrace_graph( Graph.Name , Graph.Xaxis , Graph.Yaxis ) ;
+  open_graph( Graph ) ;
 
   size_t shift = 0 , i ;
   for( i = 0 ; i < Data.Nsim ; i++ ) {
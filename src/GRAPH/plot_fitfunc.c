@@ -8,6 +8,7 @@
 #include "ffunction.h"
 #include "fitfunc.h"
 #include "make_xmgrace.h" // drawing lines
+#include "plot_fitfunc.h"
 #include "pmap.h"
 #include "resampled_ops.h" // compute err
 #include "stats.h"
@@ -15,45 +16,155 @@
 #include "fvol2.h"
 #include "fvol3.h"
 
-struct resampled
-extrap_fitfunc( const struct resampled *f ,
+// how finely we bisect for the x of a target value
+#define BISECT_TOL (1E-5)
+
+// adaptive sampling of the plotted curves, we start with CURVE_NINIT
+// points and refine at most CURVE_NPASS times up to CURVE_NMAX points
+// until the curve and band are straight to CURVE_TOL of the band height
+#define CURVE_NINIT (33)
+#define CURVE_NMAX (1025)
+#define CURVE_NPASS (8)
+#define CURVE_TOL (1E-3)
+
+struct fit_curve
+init_fit_curve( const struct resampled *f ,
 		const struct data_info Data ,
 		const struct fit_info Fit ,
-		const double xpos ,
 		const size_t shift )
 {
-  // set up the fit again
-  struct fit_descriptor fdesc = init_fit( Data , Fit ) ;
+  struct fit_curve C ;
+  C.fdesc    = init_fit( Data , Fit ) ;
+  C.Nsamples = f[0].NSAMPLES ;
+  C.restype  = f[0].restype ;
+  C.Nparam   = C.fdesc.Nparam ;
+  C.LT       = Data.LT[shift] ;
+  C.N        = Fit.N ;
+  C.M        = Fit.M ;
+  C.bnd      = Fit.map[shift].bnd ;
+  C.fparams  = malloc( ( C.Nsamples + 1 ) * C.Nparam * sizeof( double ) ) ;
+  C.Ctx      = malloc( ( C.Nsamples + 1 ) * sizeof( const void* ) ) ;
+  size_t j , p ;
+  for( j = 0 ; j <= C.Nsamples ; j++ ) {
+    const bool is_avg = ( j == C.Nsamples ) ;
+    for( p = 0 ; p < C.Nparam ; p++ ) {
+      const struct resampled *fp = &f[ Fit.map[shift].p[p] ] ;
+      C.fparams[ p + j*C.Nparam ] = is_avg ? fp -> avg : fp -> resampled[j] ;
+    }
+    C.Ctx[j] = C.fdesc.ctx != NULL ? C.fdesc.ctx( is_avg ? 0 : j , is_avg ) : NULL ;
+  }
+  return C ;
+}
 
-  struct resampled data = init_dist( NULL , f[0].NSAMPLES , f[0].restype ) ;
-  
-  struct x_desc xdesc = { xpos , Data.LT[shift] , Fit.N , Fit.M } ;
-  //struct x_desc xdesc = { xpos , 0.0 , Fit.N , Fit.M } ;
-  
+void
+free_fit_curve( struct fit_curve *C )
+{
+  free_ffunction( &C -> fdesc.f , C -> fdesc.Nlogic ) ;
+  free( C -> fparams ) ;
+  free( C -> Ctx ) ;
+  return ;
+}
+
+// sample j (the average is j == Nsamples) at x
+static inline double
+curve_at( const struct fit_curve *C ,
+	  const size_t j ,
+	  const double x )
+{
+  const struct x_desc xdesc = { x , C -> LT , C -> N , C -> M , C -> Ctx[j] } ;
+  return C -> fdesc.func( xdesc , C -> fparams + j*C -> Nparam , C -> bnd ) ;
+}
+
+// y[ i*( Nsamples + 1 ) + j ] is sample j at x[i], all in one pass
+void
+eval_fit_curve( double *y ,
+		const struct fit_curve *C ,
+		const double *x ,
+		const size_t Nx )
+{
+  const size_t Ns = C -> Nsamples + 1 ;
+  size_t ij ;
+#pragma omp parallel for private(ij)
+  for( ij = 0 ; ij < Nx*Ns ; ij++ ) {
+    y[ ij ] = curve_at( C , ij%Ns , x[ ij/Ns ] ) ;
+  }
+  return ;
+}
+
+// copies the evaluation at x[i] into an already allocated distribution
+void
+fit_curve_dist( struct resampled *d ,
+		const struct fit_curve *C ,
+		const double *y ,
+		const size_t i )
+{
+  const double *yi = y + i*( C -> Nsamples + 1 ) ;
+  memcpy( d -> resampled , yi , C -> Nsamples * sizeof( double ) ) ;
+  d -> avg = yi[ C -> Nsamples ] ;
+  compute_err( d ) ;
+  return ;
+}
+
+// the x where each sample reaches target, bisecting every sample at
+// once between xlo and xhi
+struct resampled
+bisect_fit_curve( const struct fit_curve *C ,
+		  const double xlo ,
+		  const double target ,
+		  const double xhi )
+{
+  const size_t Ns = C -> Nsamples + 1 ;
+  struct resampled root = init_dist( NULL , C -> Nsamples , C -> restype ) ;
+  double *x1 = malloc( Ns * sizeof( double ) ) ;
+  double *x2 = malloc( Ns * sizeof( double ) ) ;
+  bool *lo_below = malloc( Ns * sizeof( bool ) ) ;
   size_t j ;
 #pragma omp parallel for private(j)
-  for( j = 0 ; j < f[0].NSAMPLES ; j++ ) {
-    double fparams[ fdesc.Nparam ] ;
-    // evaluate the fitfunc
-    for( size_t p = 0 ; p < fdesc.Nparam ; p++ ) {
-      fparams[ p ] = f[ Fit.map[shift].p[p] ].resampled[j] ;
-      //fparams[p] = f[ p ].resampled[j] ;
+  for( j = 0 ; j < Ns ; j++ ) {
+    x1[j] = xlo ; x2[j] = xhi ;
+    lo_below[j] = curve_at( C , j , xlo ) < target ;
+  }
+  // the same number of halvings for every sample
+  size_t iter , Niter = 1 ;
+  while( ldexp( fabs( xhi - xlo ) , -(int)Niter ) > BISECT_TOL ) {
+    Niter++ ;
+  }
+  for( iter = 0 ; iter < Niter ; iter++ ) {
+#pragma omp parallel for private(j)
+    for( j = 0 ; j < Ns ; j++ ) {
+      const double xmid = 0.5*( x1[j] + x2[j] ) ;
+      if( ( curve_at( C , j , xmid ) < target ) == lo_below[j] ) {
+	x1[j] = xmid ;
+      } else {
+	x2[j] = xmid ;
+      }
     }
-    data.resampled[j] = fdesc.func( xdesc , fparams , Fit.map[shift].bnd ) ;
-    //data.resampled[j] = fdesc.func( xdesc , fparams , shift ) ;
   }
-  // and the average
-  double fparams[ fdesc.Nparam ] ;
-  for( size_t p = 0 ; p < fdesc.Nparam ; p++ ) {
-    fparams[ p ] = f[ Fit.map[shift].p[p] ].avg ;
-    //fparams[ p ] = f[ p ].avg ;
+  for( j = 0 ; j < C -> Nsamples ; j++ ) {
+    root.resampled[j] = 0.5*( x1[j] + x2[j] ) ;
   }
-  data.avg = fdesc.func( xdesc , fparams , Fit.map[shift].bnd ) ;
-  //data.avg = fdesc.func( xdesc , fparams , shift ) ;
-  compute_err( &data ) ;
-	
-  // free the fitfunction
-  free_ffunction( &fdesc.f , fdesc.Nlogic ) ;
+  root.avg = 0.5*( x1[ C -> Nsamples ] + x2[ C -> Nsamples ] ) ;
+  compute_err( &root ) ;
+  free( x1 ) ; free( x2 ) ; free( lo_below ) ;
+  return root ;
+}
+
+struct resampled
+extrap_fitfunc( const struct resampled *f ,
+		const struct data_info Data ,
+		const struct fit_info Fit ,
+		const double xpos ,
+		const size_t shift )
+{
+  struct fit_curve C = init_fit_curve( f , Data , Fit , shift ) ;
+  struct resampled data = init_dist( NULL , f[0].NSAMPLES , f[0].restype ) ;
+  double *y = malloc( ( C.Nsamples + 1 ) * sizeof( double ) ) ;
+
+  eval_fit_curve( y , &C , &xpos , 1 ) ;
+  fit_curve_dist( &data , &C , y , 0 ) ;
+
+  free( y ) ;
+  free_fit_curve( &C ) ;
 
   return data ;
 }
@@ -67,20 +178,11 @@ bisect_fitfunc( const struct resampled *f ,
 		const double xhi ,
 		const size_t shift )
 {
-  struct resampled tavg = init_dist( NULL , f[0].NSAMPLES , f[0].restype ) ;
-  double x1 = xlo , x2 = xhi , tol = 1 , xmid = 0.0 ;
-  while( tol > 1E-5 ) {
-    xmid = 0.5*(x1+x2) ;
-    tavg = extrap_fitfunc( f , Data , Fit , xmid , 0 ) ;
-    if( tavg.avg > target ) {
-      x2 = xmid ;
-    } else {
-      x1 = xmid ;
-    }
-    tol = fabs(x2-x1) ;
-    //fprintf( stdout , "(%f,%f,%f) ----> %f\n", target, tavg.avg, tol, xmid ) ;
-  }
-  free( tavg.resampled ) ;
+  struct fit_curve C = init_fit_curve( f , Data , Fit , shift ) ;
+  struct resampled root = bisect_fit_curve( &C , xlo , target , xhi ) ;
+  const double xmid = root.avg ;
+  free( root.resampled ) ;
+  free_fit_curve( &C ) ;
   return xmid ;
 }
 
@@ -219,10 +321,11 @@ plot_feffmass( const struct resampled *f ,
 {
   // loop x with this granularity
   const size_t granularity = 501 ;
-  double *X    = malloc( granularity * sizeof( double ) ) ;
+  double *X    = malloc( 2 * granularity * sizeof( double ) ) ;
   double *YAVG = malloc( granularity * sizeof( double ) ) ;
   double *YMIN = malloc( granularity * sizeof( double ) ) ;
   double *YMAX = malloc( granularity * sizeof( double ) ) ;
+  double *Y    = malloc( 2 * granularity * ( f[0].NSAMPLES + 1 ) * sizeof( double ) ) ;
 
   size_t h , i ;
   FILE *file = fopen( "feffmass.dat" , "w" ) ;
@@ -247,19 +350,23 @@ plot_feffmass( const struct resampled *f ,
     }    
 
     const double x_step = ( xmax - xmin ) / ( granularity - 1 ) ;
-    for( i = 0 ; i < granularity ; i++ ) {
+    const double dh = 1E-7 ;
 
-      const double dh = 1E-7 ;
-      
+    // evaluate at X and X+dh for all the samples in one go
+    for( i = 0 ; i < granularity ; i++ ) {
       X[ i ] = xmin + x_step*i ;
-      const double X2 = xmin + x_step*i + dh ;
+      X[ i + granularity ] = X[ i ] + dh ;
+    }
+    struct fit_curve C = init_fit_curve( f , Data , Fit , shift ) ;
+    eval_fit_curve( Y , &C , X , 2*granularity ) ;
 
-      // do a derivative here      
-      struct resampled data1 = extrap_fitfunc( f , Data , Fit , X[i] , shift ) ;
-      struct resampled data2 = extrap_fitfunc( f , Data , Fit , X2 , shift ) ;
+    struct resampled data1 = init_dist( NULL , C.Nsamples , C.restype ) ;
+    struct resampled data2 = init_dist( NULL , C.Nsamples , C.restype ) ;
+    for( i = 0 ; i < granularity ; i++ ) {
+      // do a derivative here
+      fit_curve_dist( &data1 , &C , Y , i ) ;
+      fit_curve_dist( &data2 , &C , Y , i + granularity ) ;
 
-      //X[i] -= 0.5 ;
-      
       divide( &data1 , data2 ) ;
       res_log( &data1 ) ;
       divide_constant( &data1 , dh ) ;
@@ -267,11 +374,10 @@ plot_feffmass( const struct resampled *f ,
       YMAX[i] = data1.err_hi ;
       YAVG[i] = data1.avg ;
       YMIN[i] = data1.err_lo ;
-
-      // free the fit distribution
-      free( data1.resampled ) ;
-      free( data2.resampled ) ;
     }
+    free( data1.resampled ) ;
+    free( data2.resampled ) ;
+    free_fit_curve( &C ) ;
 
     // draw lines between the evaluated fitfunctions
     for( size_t i = 0 ; i < granularity ; i++ ) {
@@ -294,24 +400,133 @@ plot_feffmass( const struct resampled *f ,
   printf( "Frees\n" ) ;
 
   // free the x, y , ymin and ymax
-  free( X ) ; free( YAVG ) ; free( YMIN ) ; free( YMAX ) ;
+  free( X ) ; free( YAVG ) ; free( YMIN ) ; free( YMAX ) ; free( Y ) ;
 
   printf( "Frees did\n" ) ;
   
   return SUCCESS ;
 }
 
+// the average and error band of the Nx evaluations in Y, in parallel
+static void
+curve_bands( double *YAVG ,
+	     double *YMIN ,
+	     double *YMAX ,
+	     const struct fit_curve *C ,
+	     const double *Y ,
+	     const size_t Nx )
+{
+#pragma omp parallel
+  {
+    struct resampled d = init_dist( NULL , C -> Nsamples , C -> restype ) ;
+    size_t i ;
+#pragma omp for
+    for( i = 0 ; i < Nx ; i++ ) {
+      fit_curve_dist( &d , C , Y , i ) ;
+      YAVG[i] = d.avg ;
+      YMIN[i] = d.err_lo ;
+      YMAX[i] = d.err_hi ;
+    }
+    free( d.resampled ) ;
+  }
+  return ;
+}
+
+// does y at i deviate from the straight line between its neighbours?
+static inline bool
+bent( const double *x ,
+      const double *y ,
+      const size_t i ,
+      const double tol )
+{
+  const double line = ( y[i-1]*( x[i+1] - x[i] ) + y[i+1]*( x[i] - x[i-1] ) )
+    / ( x[i+1] - x[i-1] ) ;
+  return fabs( y[i] - line ) > tol ;
+}
+
+// samples the curve on [xmin,xmax] starting from CURVE_NINIT points,
+// bisecting both intervals next to a point where the average or either
+// edge of the band is further than CURVE_TOL of the band's height from
+// a straight line. The new points of a pass are evaluated together,
+// returns how many points there are, at most CURVE_NMAX
+static size_t
+sample_curve( double *X ,
+	      double *YAVG ,
+	      double *YMIN ,
+	      double *YMAX ,
+	      const struct fit_curve *C ,
+	      const double xmin ,
+	      const double xmax )
+{
+  double *Y  = malloc( CURVE_NMAX * ( C -> Nsamples + 1 ) * sizeof( double ) ) ;
+  double *Xn = malloc( CURVE_NMAX * sizeof( double ) ) ;
+  double *An = malloc( CURVE_NMAX * sizeof( double ) ) ;
+  double *Ln = malloc( CURVE_NMAX * sizeof( double ) ) ;
+  double *Hn = malloc( CURVE_NMAX * sizeof( double ) ) ;
+  bool *refine = malloc( CURVE_NMAX * sizeof( bool ) ) ;
+  size_t n = CURVE_NINIT , i , pass ;
+
+  for( i = 0 ; i < n ; i++ ) {
+    X[i] = xmin + ( xmax - xmin )*i/(double)( n - 1 ) ;
+  }
+  eval_fit_curve( Y , C , X , n ) ;
+  curve_bands( YAVG , YMIN , YMAX , C , Y , n ) ;
+
+  for( pass = 0 ; pass < CURVE_NPASS ; pass++ ) {
+    double lo = YMIN[0] , hi = YMAX[0] ;
+    for( i = 0 ; i < n ; i++ ) {
+      if( YMIN[i] < lo || !isfinite( lo ) ) lo = YMIN[i] ;
+      if( YMAX[i] > hi || !isfinite( hi ) ) hi = YMAX[i] ;
+    }
+    const double tol = CURVE_TOL*( hi - lo ) ;
+    if( !( tol > 0 ) || !isfinite( tol ) ) break ;
+
+    for( i = 0 ; i < n-1 ; i++ ) {
+      refine[i] = false ;
+    }
+    for( i = 1 ; i < n-1 ; i++ ) {
+      if( bent( X , YAVG , i , tol ) || bent( X , YMIN , i , tol ) ||
+	  bent( X , YMAX , i , tol ) ) {
+	refine[i-1] = refine[i] = true ;
+      }
+    }
+    size_t Nnew = 0 ;
+    for( i = 0 ; i < n-1 ; i++ ) {
+      if( refine[i] ) Xn[ Nnew++ ] = 0.5*( X[i] + X[i+1] ) ;
+    }
+    if( Nnew == 0 || n + Nnew > CURVE_NMAX ) break ;
+
+    eval_fit_curve( Y , C , Xn , Nnew ) ;
+    curve_bands( An , Ln , Hn , C , Y , Nnew ) ;
+
+    // merge in place from the back, midpoints sit after X[i-1]
+    size_t j = n + Nnew , k = Nnew ;
+    for( i = n ; i-- > 0 ; ) {
+      j-- ;
+      X[j] = X[i] ; YAVG[j] = YAVG[i] ; YMIN[j] = YMIN[i] ; YMAX[j] = YMAX[i] ;
+      if( i > 0 && refine[i-1] ) {
+	j-- ; k-- ;
+	X[j] = Xn[k] ; YAVG[j] = An[k] ; YMIN[j] = Ln[k] ; YMAX[j] = Hn[k] ;
+      }
+    }
+    n += Nnew ;
+  }
+
+  free( Y ) ; free( Xn ) ; free( An ) ; free( Ln ) ; free( Hn ) ;
+  free( refine ) ;
+
+  return n ;
+}
+
 int
 plot_fitfunction( const struct resampled *f ,
 		  const struct data_info Data ,
 		  const struct fit_info Fit )
-{    
-  // loop x with this granularity
-  const size_t granularity = 501 ;
-  double *X    = malloc( granularity * sizeof( double ) ) ;
-  double *YAVG = malloc( granularity * sizeof( double ) ) ;
-  double *YMIN = malloc( granularity * sizeof( double ) ) ;
-  double *YMAX = malloc( granularity * sizeof( double ) ) ;
+{
+  double *X    = malloc( CURVE_NMAX * sizeof( double ) ) ;
+  double *YAVG = malloc( CURVE_NMAX * sizeof( double ) ) ;
+  double *YMIN = malloc( CURVE_NMAX * sizeof( double ) ) ;
+  double *YMAX = malloc( CURVE_NMAX * sizeof( double ) ) ;
 
   size_t h , i ;
 
@@ -336,25 +551,12 @@ plot_fitfunction( const struct resampled *f ,
     //xmin = 0.0 ; //0.11233596051497033 ;
     //xmin = 0.07822077018599871 ;
 
-    const double x_step = ( xmax - xmin ) / ( granularity - 1 ) ;
-    
-    for( i = 0 ; i < granularity ; i++ ) {
-      
-      X[ i ] = xmin + x_step*i ;
-	    
-      struct resampled data = extrap_fitfunc( f , Data , Fit , X[i] , shift ) ;
-
-      YMAX[i] = data.err_hi ;
-      YAVG[i] = data.avg ;
-      YMIN[i] = data.err_lo ;
+    struct fit_curve C = init_fit_curve( f , Data , Fit , shift ) ;
+    const size_t granularity = sample_curve( X , YAVG , YMIN , YMAX ,
+					     &C , xmin , xmax ) ;
+    free_fit_curve( &C ) ;
 
-      if( i == 0 ) {
-	fprintf( stdout , "XMIN %e %e\n" , data.avg , data.err ) ;
-      }
-
-      // free the fit distribution
-      free( data.resampled ) ;
-    }
+    fprintf( stdout , "XMIN %e %e\n" , YAVG[0] , 0.5*( YMAX[0] - YMIN[0] ) ) ;
 
     // draw lines between the evaluated fitfunctions
     draw_line( X , YMAX , granularity ) ;
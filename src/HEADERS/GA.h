@@ -1,6 +1,28 @@
 #ifndef GA_H
 #define GA_H
 
+// defaults for the GA_* input tags
+
+#define NGEN (512) // number of chromosomes in gene pool
+
+// number that persist from the previous generation
+#define NBREED (32) 
+
+// number of parents of a child
+#define NPARENTS (16)
+
+// number of draws for tournament selection
+#define NTOURNAMENT (12)
+
+// probability of mutation of the whole pop
+#define PMUTANT (0.7)
+
+// It turns out this one is very important!! WHY???
+#define NOISE (0.15) // guesses * gaussian of width NOISE to start our run
+
+struct ga_info
+ga_defaults( void ) ;
+
 int
 ga_iter( void *fdesc ,
 	 const void *data ,
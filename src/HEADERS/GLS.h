@@ -1,6 +1,23 @@
 #ifndef GLS_H
 #define GLS_H
 
+double
+wdot( const double *u ,
+      const double *v ,
+      const double **W ,
+      const corrtype CORRFIT ,
+      const size_t N ) ;
+
+int
+gls_solve( double *x ,
+	   const double **U ,
+	   const double *y ,
+	   const double **W ,
+	   const corrtype CORRFIT ,
+	   const struct prior *Prior ,
+	   const size_t M ,
+	   const size_t N ) ;
+
 int
 gls_iter( void *fdesc ,
 	  const void *data ,
@@ -4,6 +4,10 @@
 double
 fQcorr_bessel( const struct x_desc X , const double *fparams , const size_t Npars ) ;
   
+void
+Qcorr_bessel_fdf( double *f , double **df , double **d2f ,
+                  const void *data , const double *fparams ) ;
+
 void
 Qcorr_bessel_f( double *f , const void *data , const double *fparams ) ;
 
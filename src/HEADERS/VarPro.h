@@ -0,0 +1,10 @@
+#ifndef VARPRO_H
+#define VARPRO_H
+
+int
+vp_iter( void *fdesc ,
+	 const void *data ,
+	 const double **W ,
+	 const double TOL ) ;
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef BESSEL_H
+#define BESSEL_H
+
+// K_0 and K_1 of the N arguments x, multiplied by e^x if scaled is
+// true. Either of K0 or K1 can be NULL if it is not wanted
+void
+bessel_K01_array( double *K0 ,
+		  double *K1 ,
+		  const double *x ,
+		  const size_t N ,
+		  const bool scaled ) ;
+
+double
+bessel_K0( const double x ) ;
+
+double
+bessel_K1( const double x ) ;
+
+#endif
@@ -1,10 +1,20 @@
 #ifndef BLACKBOX_H
 #define BLACKBOX_H
 
+// reusable workspace, one per thread
+struct bb_temps ;
+
+struct bb_temps *
+alloc_blackbox( const size_t NSTATES ) ;
+
+void
+free_blackbox( struct bb_temps *W ) ;
+
 void
 blackbox( const double *data ,
 	  const size_t NDATA ,
 	  const size_t NSTATES ,
-	  double masses[ NSTATES ][ NDATA ] ) ;
+	  double masses[ NSTATES ][ NDATA ] ,
+	  struct bb_temps *W ) ;
 
 #endif
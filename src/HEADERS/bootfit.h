@@ -6,4 +6,10 @@ perform_bootfit( const struct data_info Data ,
 		 const struct fit_info Fit ,
 		 double *Chi ) ;
 
+struct resampled *
+perform_bootfit_dist( const struct data_info Data ,
+		      const struct fit_info Fit ,
+		      double *Chi ,
+		      struct resampled *chisq_dist ) ;
+
 #endif
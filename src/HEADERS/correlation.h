@@ -7,6 +7,12 @@ compute_upper_correlation( double **correlation ,
 			   const size_t NDATA ,
 			   const corrtype CORRFIT ) ;
 
+int
+compute_covariance( double **C ,
+		    const struct resampled *data ,
+		    const size_t NDATA ,
+		    const struct correlation Cov ) ;
+
 void
 fill_lower_triangular( double **correlation ,
 		       const size_t NDATA ) ;
@@ -19,6 +25,23 @@ int
 inverse_correlation( struct data_info *Data ,
 		     const struct fit_info Fit ) ;
 
+int
+full_covariance( double ***C ,
+		 const struct data_info Data ,
+		 const corrtype Corrfit ) ;
+
+void
+free_covariance( double **C ,
+		 const size_t Ntot ,
+		 const corrtype Corrfit ) ;
+
+int
+subset_inverse_correlation( struct data_info *Data ,
+			    const double **C ,
+			    const bool *in_fitrange ,
+			    const size_t Nfull ,
+			    const corrtype Corrfit ) ;
+
 void
 write_corrmatrix( const double **correlation ,
 		  const size_t NCUT ,
@@ -4,6 +4,10 @@
 double
 fcosh( const struct x_desc X , const double *fparams , const size_t Npars ) ;
 
+void
+cosh_fdf( double *f , double **df , double **d2f ,
+          const void *data , const double *fparams ) ;
+
 void
 cosh_f( double *f , const void *data , const double *fparams ) ;
 
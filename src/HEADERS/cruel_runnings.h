@@ -8,6 +8,14 @@ RUN( double mu ,
      const size_t nf ,
      const size_t loops ) ;
 
+void
+RUN_array( double *alpha ,
+	   const size_t N ,
+	   const double mu ,
+	   const double muprime ,
+	   const size_t nf ,
+	   const size_t loops ) ;
+
 double 
 run_nf3_2MZ( const double alpha ,
 	     const double mu ,
@@ -18,11 +26,23 @@ run_MZ_2nf3( const double alpha ,
 	     const double mu ,
 	     const size_t loops ) ;
 
+void
+run_nf3_2MZ_array( double *alpha ,
+		   const size_t N ,
+		   const double mu ,
+		   const size_t loops ) ;
+
 struct resampled
 run_distribution_nf3_2MZ( struct resampled alpha ,
 			  const double mu ,
 			  const size_t loops ) ;
   
+void
+free_running_tables( void ) ;
+
+int
+init_running_tables( void ) ;
+
 void
 test_running( void ) ;
 
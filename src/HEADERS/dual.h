@@ -0,0 +1,178 @@
+#ifndef DUAL_H
+#define DUAL_H
+
+// maximum number of fit parameters we carry derivatives for
+#define NDUAL (16)
+
+// packed upper-triangular storage for the hessian
+#define NDUAL_HESS ( NDUAL * ( NDUAL + 1 ) / 2 )
+
+// second-order truncated taylor number in Np variables
+//  v -> value, d[i] -> df/dp_i , h[ (i,j) ] -> d^2f/dp_i dp_j for i <= j
+// only the first Np entries are touched and order says how
+// far the expansion goes ( 0 -> value , 1 -> gradient , 2 -> hessian )
+struct dual {
+  double v ;
+  double d[ NDUAL ] ;
+  double h[ NDUAL_HESS ] ;
+  size_t Np ;
+  int order ;
+} ;
+
+// the model in plain doubles, used when only the value is wanted
+typedef double (*scalar_func)( const struct x_desc X ,
+			       const double *fparams ,
+			       const size_t Npars ) ;
+
+// the model in dual numbers
+typedef struct dual (*dual_func)( const struct x_desc X ,
+				  const struct dual *fparams ,
+				  const size_t Npars ) ;
+
+size_t
+dual_hidx( const size_t i , const size_t j , const size_t Np ) ;
+
+struct dual
+dual_const( const double c , const size_t Np , const int order ) ;
+
+struct dual
+dual_var( const double x , const size_t idx ,
+	  const size_t Np , const int order ) ;
+
+struct dual
+dual_add( const struct dual a , const struct dual b ) ;
+
+struct dual
+dual_sub( const struct dual a , const struct dual b ) ;
+
+struct dual
+dual_mul( const struct dual a , const struct dual b ) ;
+
+struct dual
+dual_div( const struct dual a , const struct dual b ) ;
+
+struct dual
+dual_scale( const struct dual a , const double c ) ;
+
+struct dual
+dual_shift( const struct dual a , const double c ) ;
+
+struct dual
+dual_chain( const struct dual a , const double g ,
+	    const double dg , const double d2g ) ;
+
+struct dual
+dual_inv( const struct dual a ) ;
+
+struct dual
+dual_exp( const struct dual a ) ;
+
+struct dual
+dual_log( const struct dual a ) ;
+
+struct dual
+dual_sqrt( const struct dual a ) ;
+
+struct dual
+dual_pow( const struct dual a , const double c ) ;
+
+struct dual
+dual_cosh( const struct dual a ) ;
+
+struct dual
+dual_sinh( const struct dual a ) ;
+
+struct dual
+dual_tanh( const struct dual a ) ;
+
+struct dual
+dual_bessel_K0( const struct dual a ) ;
+
+struct dual
+dual_bessel_K1( const struct dual a ) ;
+
+// arithmetic that works on doubles and on duals alike, a model written
+// with these once is instantiated for both and the plain double one is
+// used when only the value is wanted. Both arguments of the binary
+// ones have to be the same type, constants go through the *_C ones
+static inline double ad_add_d( const double a , const double b ) { return a + b ; }
+static inline double ad_sub_d( const double a , const double b ) { return a - b ; }
+static inline double ad_mul_d( const double a , const double b ) { return a * b ; }
+static inline double ad_div_d( const double a , const double b ) { return a / b ; }
+static inline double ad_scale_d( const double a , const double c ) { return a * c ; }
+static inline double ad_shift_d( const double a , const double c ) { return a + c ; }
+static inline double ad_inv_d( const double a ) { return 1.0 / a ; }
+static inline double ad_val_d( const double a ) { return a ; }
+static inline double ad_const_d( const double c , const double like ) { return c ; }
+
+static inline double ad_val_ad( const struct dual a ) { return a.v ; }
+static inline struct dual
+ad_const_ad( const double c , const struct dual like )
+{
+  return dual_const( c , like.Np , like.order ) ;
+}
+
+#define AD_GENERIC( a , fd , fad ) _Generic( (a) , struct dual : fad , default : fd )
+
+#define AD_ADD( a , b )   AD_GENERIC( a , ad_add_d , dual_add )( a , b )
+#define AD_SUB( a , b )   AD_GENERIC( a , ad_sub_d , dual_sub )( a , b )
+#define AD_MUL( a , b )   AD_GENERIC( a , ad_mul_d , dual_mul )( a , b )
+#define AD_DIV( a , b )   AD_GENERIC( a , ad_div_d , dual_div )( a , b )
+#define AD_SCALE( a , c ) AD_GENERIC( a , ad_scale_d , dual_scale )( a , c )
+#define AD_SHIFT( a , c ) AD_GENERIC( a , ad_shift_d , dual_shift )( a , c )
+#define AD_INV( a )       AD_GENERIC( a , ad_inv_d , dual_inv )( a )
+#define AD_EXP( a )       AD_GENERIC( a , exp , dual_exp )( a )
+#define AD_LOG( a )       AD_GENERIC( a , log , dual_log )( a )
+#define AD_SQRT( a )      AD_GENERIC( a , sqrt , dual_sqrt )( a )
+#define AD_VAL( a )       AD_GENERIC( a , ad_val_d , ad_val_ad )( a )
+
+// the constant c of the same type (and size) as like
+#define AD_CONST( c , like ) AD_GENERIC( like , ad_const_d , ad_const_ad )( c , like )
+
+struct dual
+ad_point( const dual_func func ,
+	  const struct x_desc X ,
+	  const double *p ,
+	  const size_t Npars ,
+	  const size_t Np ,
+	  const int order ) ;
+
+size_t
+ad_nlogic( const struct data *DATA ) ;
+
+void
+ad_set_point( double *f ,
+	      double **df ,
+	      double **d2f ,
+	      const struct data *DATA ,
+	      const size_t i ,
+	      const size_t Nlogic ,
+	      const struct dual res ) ;
+
+void
+ad_fdf( double *f ,
+	double **df ,
+	double **d2f ,
+	const void *data ,
+	const double *fparams ,
+	const dual_func func ) ;
+
+void
+ad_f( double *f ,
+      const void *data ,
+      const double *fparams ,
+      const scalar_func func ) ;
+
+void
+ad_df( double **df ,
+       const void *data ,
+       const double *fparams ,
+       const dual_func func ) ;
+
+void
+ad_d2f( double **d2f ,
+	const void *data ,
+	const double *fparams ,
+	const dual_func func ) ;
+
+#endif
@@ -4,6 +4,10 @@
 double
 fexp( const struct x_desc X , const double *fparams , const size_t Npars ) ;
 
+void
+exp_fdf( double *f , double **df , double **d2f ,
+         const void *data , const double *fparams ) ;
+
 void
 exp_f( double *f , const void *data , const double *fparams ) ;
 
@@ -1,6 +1,20 @@
 #ifndef FAKE_H
 #define FAKE_H
 
+// description of a synthetic ensemble, x = X0,X0+1,... over all the
+// simulations with Nmeas raw measurements of the model at each point
+struct fake_ensemble {
+  size_t Ndata ;         // points per simulation
+  double X0 ;            // x of the first point
+  size_t Nmeas ;         // raw measurements per point
+  double Xsigma ;        // absolute noise on x
+  double Ysigma ;        // relative noise on y
+  double Rho ;           // correlation of the y-noise of neighbouring points
+  const double *Params ; // Nlogic true parameters, NULL gives 1,2,3,...
+  unsigned long Seed ;   // 0 leaves the rng to GSL_RNG_SEED
+  bool Verbose ;         // print the parameters and the data
+} ;
+
 struct resampled
 generate_fake_single( const double y,
 		      const double dy ,
@@ -12,6 +26,12 @@ generate_fake_boot( const size_t N,
 		    const double yarr[N] ,
 		    const double dyarr[N] ) ;
 
+int
+generate_fake_ensemble( struct data_info *Data ,
+			struct fit_info Fit ,
+			struct traj *Traj ,
+			const struct fake_ensemble E ) ;
+
 int
 generate_fake_data( struct data_info *Data ,
 		    struct fit_info Fit ,
@@ -1,6 +1,12 @@
 #ifndef FFUNCTION_H
 #define FFUNCTION_H
 
+// bits saying which of the ffunction's arrays are valid
+#define FCACHE_NONE (0)
+#define FCACHE_F    (1)
+#define FCACHE_DF   (2)
+#define FCACHE_D2F  (4)
+
 struct ffunction
 allocate_ffunction( const size_t NPARAMS ,
 		    const size_t NDATA ) ;
@@ -13,4 +19,23 @@ void
 free_ffunction( struct ffunction *f , 
 		const size_t NPARAMS ) ;
 
+void
+invalidate_ffunction( struct ffunction *f ) ;
+
+void
+cached_F( const struct fit_descriptor *Fit ,
+	  struct ffunction *f ,
+	  const void *data ,
+	  const int order ) ;
+
+void
+cached_dF( const struct fit_descriptor *Fit ,
+	   struct ffunction *f ,
+	   const void *data ) ;
+
+void
+cached_d2F( const struct fit_descriptor *Fit ,
+	    struct ffunction *f ,
+	    const void *data ) ;
+
 #endif
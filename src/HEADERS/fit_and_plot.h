@@ -1,6 +1,11 @@
 #ifndef FIT_AND_PLOT_H
 #define FIT_AND_PLOT_H
 
+bool *
+filter( size_t *N ,
+	const struct data_info Data ,
+	const struct traj *Traj ) ;
+
 struct resampled *
 fit_and_plot( struct input_params Input ,
 	      double *Chi ) ;
@@ -4,6 +4,10 @@
 size_t
 get_Nparam( const struct fit_info Fit ) ;
 
+bool
+minimizer_supports( const char *min ,
+		    const fittype Fitdef ) ;
+
 struct fit_descriptor
 init_fit( const struct data_info Data ,
 	  const struct fit_info Fit ) ;
@@ -0,0 +1,13 @@
+#ifndef FIT_SCAN_H
+#define FIT_SCAN_H
+
+// table of the results of every window
+#define SCAN_FILE "fit_scan.dat"
+
+// prefix of the flat files of the model averaged parameters
+#define AVERAGE_FILE "model_average"
+
+int
+fit_scan( struct input_params *Input ) ;
+
+#endif
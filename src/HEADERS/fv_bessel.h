@@ -0,0 +1,22 @@
+#ifndef FV_BESSEL_H
+#define FV_BESSEL_H
+
+// \sum_r m_r K_0(\sqrt{r}x)/\sqrt{r} , \sum_r m_r K_1(\sqrt{r}x)/\sqrt{r}
+// and \sum_r m_r K_2(\sqrt{r}x)/r over the first twelve shells
+typedef enum { FV_K0 , FV_K1 , FV_K2 , FV_NSUMS } fv_sum ;
+
+double
+fv_bessel_sum_direct( const fv_sum s ,
+		      const double x ) ;
+
+void
+free_fv_bessel( void ) ;
+
+int
+init_fv_bessel( const double tol ) ;
+
+double
+fv_bessel_sum( const fv_sum s ,
+	       const double x ) ;
+
+#endif
@@ -4,6 +4,9 @@
 double
 ffvol5( const struct x_desc X , const double *fparams , const size_t Npars ) ;
 void
+fvol5_fdf( double *f , double **df , double **d2f ,
+	   const void *data , const double *fparams ) ;
+void
 fvol5_f( double *f , const void *data , const double *fparams ) ;
 void
 fvol5_df( double **df , const void *data , const double *fparams ) ;
@@ -53,7 +53,7 @@ typedef enum { Raw , JackKnife , BootStrap } resample_type ;
 // file type we expect to read
 typedef enum { Corr_File , Distribution_File , Fake_File , Flat_File , GLU_Tcorr_File , GLU_File , GLU_Qmoment_File , Adler_File } file_type ;
 
-typedef enum { Adler , Alphas , Beta_crit , Binding_Corr , Correlator , Exceptional , Fit , Fpi_CLS , General , HLBL , HVP , KKops , KK_BK , Nrqcd , PCAC, Pof , Qcorr , Qsusc , Qslab , QslabFix , Ren_Rats , SpinOrbit, StaticPotential , TetraGEVP , TetraGEVP_Fixed , Wflow , Sol , ZV } analysis_type ;
+typedef enum { Adler , Alphas , Beta_crit , Binding_Corr , Correlator , Exceptional , Fit , FitScan , Fpi_CLS , General , HLBL , HVP , KKops , KK_BK , Nrqcd , PCAC, Pof , Qcorr , Qsusc , Qslab , QslabFix , Ren_Rats , SpinOrbit, StaticPotential , TetraGEVP , TetraGEVP_Fixed , Wflow , Sol , ZV } analysis_type ;
 
 // x-data descriptor
 struct x_desc {
@@ -61,6 +61,7 @@ struct x_desc {
   size_t LT ;
   size_t N ;
   size_t M ;
+  const void *Ctx ; // per-sample model context, NULL if there is none
 } ;
 
 // little histogram struct
@@ -95,6 +96,9 @@ struct ffunction {
   size_t NPARAMS ; // number of fit parameters
   corrtype CORRFIT ; // type of fit
   double chisq ; // chisq 
+  double *cache_params ; // parameters f, df and d2f were last evaluated at
+  const void *cache_data ; // and the data they were evaluated with
+  int cache ; // which of f, df and d2f are valid at cache_params
 } ;
 
 // struct containing our statistics
@@ -109,8 +113,12 @@ struct resampled {
 } ;
 
 // struct describing our correlation matrix
+// estimator of the covariance matrix
+typedef enum { SAMPLE_COV , LEDOIT_WOLF , OAS , EIGEN_FLOOR } cov_estimator ;
+
 struct correlation {
   double **W ;
+  cov_estimator Estimator ;
   double Eigenvalue_Tol ;
   bool Divided_Covariance ;
   bool Column_Balanced ;
@@ -129,6 +137,30 @@ struct data_info {
   resample_type Restype ;
 } ;
 
+// genetic algorithm settings
+struct ga_info {
+  size_t Npop ; // number of chromosomes
+  size_t Nbreed ; // elites kept each generation
+  size_t Nparents ; // parents of each child
+  size_t Ntournament ; // draws in the tournament selection
+  double Pmutant ; // probability a gene mutates
+  double Noise ; // relative width of the initial population
+} ;
+
+// range of fit windows scanned for one trajectory
+struct scan_window {
+  double Low_Min , Low_Max ; // range of the lower bound
+  double High_Min , High_Max ; // range of the upper bound
+  double Step ; // grid spacing of both
+  bool Initialised ;
+} ;
+
+// an extra model entering the FitScan model average
+struct model_info {
+  fittype Fitdef ;
+  size_t N , M ;
+} ;
+
 // struct for keeping the fit information
 struct fit_info {
   corrtype Corrfit ;
@@ -137,16 +169,22 @@ struct fit_info {
   bool Guesses_Initialised ;
   size_t M ;
   struct pmap *map ;
+  struct model_info *Models ; // extra models averaged over by FitScan
   int (*Minimize) ( void *fdesc ,
 		    const void *data ,
 		    const double **W ,
 		    const double TOL ) ;
   size_t N ;
   size_t Nlogic ;
+  size_t Nmodels ;
   size_t Nparam ;
   size_t Nprior ;
+  size_t Nstarts ; // number of multi-start fits for the average
+  struct ga_info GA ;
   struct prior *Prior ;
+  struct scan_window *Scan ; // fit windows for Analysis = FitScan, one per traj
   bool *Sims ;
+  double Spread ; // relative size of the multi-start perturbations
   double Tol ;
 } ;
 
@@ -157,8 +195,14 @@ struct fit_descriptor {
   void (*F) ( double *f , const void *data , const double *fparams ) ;
   void (*dF) ( double **df , const void *data , const double *fparams ) ;
   void (*d2F) ( double **d2f , const void *data , const double *fparams ) ;
+  // optional single pass evaluation of f, df and d2f, any can be NULL
+  void (*FdF) ( double *f , double **df , double **d2f , const void *data , const double *fparams ) ;
   void (*guesses) ( double *fparams , const struct data_info Data , const struct fit_info Fit ) ;
   void (*linmat) ( double **U , const void *data , const size_t N , const size_t M , const size_t Nlogic ) ;
+  bool (*is_linear) ( const size_t j ) ; // is local parameter j linear? used by VarPro
+  // optional per-sample context for models with resampled inputs, can be NULL
+  const void *(*ctx) ( const size_t sample_idx , const bool is_average ) ;
+  struct ga_info GA ;
   const struct prior *Prior ;
   size_t Nparam ; // Number of parameters
   size_t Nlogic ;  // logical Nparameters
@@ -176,6 +220,7 @@ struct data {
   struct pmap *map ;
   size_t N ;
   size_t M ;
+  const void *Ctx ; // handed to the model through x_desc
 } ;
 
 // uninitialised flag
@@ -214,6 +259,7 @@ struct graph {
   char *Xaxis ;
   char *Yaxis ;
   size_t Granularity ;
+  bool Csv ; // also write the points to Name.csv
 } ;
 
 // input parameters
@@ -0,0 +1,42 @@
+#ifndef GKQUAD_H
+#define GKQUAD_H
+
+// Gauss-Kronrod pairs, the Gauss rule is embedded in the Kronrod one
+typedef enum { GK15 , GK21 } gk_rule ;
+
+// evaluates the integrand for Nsamples parameter sets at the same Nx
+// nodes, f[ k*Nx + i ] is sample k at node x[i]
+typedef void (*gk_func)( double *f ,
+			 const double *x ,
+			 const size_t Nx ,
+			 const size_t Nsamples ,
+			 void *args ) ;
+
+// adaptive integral of Nsamples integrands over [a,b] on one shared set
+// of intervals, the interval with the largest error over the samples is
+// bisected until every sample has err <= max( epsabs , epsrel*|res| ).
+// res and err can be NULL, FAILURE is returned if we hit max_intervals
+int
+gk_integrate_samples( double *res ,
+		      double *err ,
+		      const gk_func f ,
+		      void *args ,
+		      const size_t Nsamples ,
+		      const double a ,
+		      const double b ,
+		      const double epsabs ,
+		      const double epsrel ,
+		      const size_t max_intervals ,
+		      const gk_rule rule ) ;
+
+// scalar version, f is called with Nsamples = 1
+double
+gk_integrate( const gk_func f ,
+	      void *args ,
+	      const double a ,
+	      const double b ,
+	      const double epsabs ,
+	      const double epsrel ,
+	      const gk_rule rule ) ;
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef INCR_CORRELATION_H
+#define INCR_CORRELATION_H
+
+// inverse covariance of the current window, carried between windows
+struct incr_inverse {
+  size_t *idx ; // data point of each row of Winv
+  size_t *pos ; // and the row of each data point
+  double *Winv ; // n x n inverse with leading dimension Nmax
+  double *u ; // workspace
+  size_t n ;
+  size_t Nmax ;
+  size_t Nupdates ; // since the last full inverse
+} ;
+
+void
+init_incr_inverse( struct incr_inverse *Inv ,
+		   const size_t Nmax ) ;
+
+void
+free_incr_inverse( struct incr_inverse *Inv ) ;
+
+int
+incr_inverse_correlation( struct data_info *Data ,
+			  struct incr_inverse *Inv ,
+			  const double **C ,
+			  const bool *in_fitrange ,
+			  const corrtype Corrfit ) ;
+
+#endif
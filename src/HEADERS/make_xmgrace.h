@@ -14,6 +14,9 @@ make_xmgrace_graph( const char *filename ,
 		    const char *x_axis , 
 		    const char *y_axis ) ;
 
+void
+open_graph( const struct graph Graph ) ;
+
 int
 make_graph( const struct resampled *fitparams ,
 	    const struct data_info Data ,
@@ -0,0 +1,10 @@
+#ifndef MULTISTART_H
+#define MULTISTART_H
+
+double
+multistart_fit( double *fparams ,
+		const void *data ,
+		const struct data_info Data ,
+		const struct fit_info Fit ) ;
+
+#endif
@@ -1,6 +1,15 @@
 #ifndef PADE_LAPLACE_H
 #define PADE_LAPLACE_H
 
+int
+pade_laplace_scan( double **fparams ,
+		   const double *x ,
+		   const double *y ,
+		   const size_t Ndata ,
+		   const size_t Nexps ,
+		   const double *p0 ,
+		   const size_t Np ) ;
+
 int
 pade_laplace( double *fparams ,
 	      const double *x ,
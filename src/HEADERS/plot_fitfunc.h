@@ -1,6 +1,45 @@
 #ifndef PLOT_FITFUNC_H
 #define PLOT_FITFUNC_H
 
+// a fit set up once to be evaluated at many x, the parameters (and
+// model contexts) of every sample are stored with the average last
+struct fit_curve {
+  struct fit_descriptor fdesc ;
+  size_t Nsamples ;
+  resample_type restype ;
+  size_t Nparam ;
+  double *fparams ;
+  const void **Ctx ;
+  size_t LT , N , M , bnd ;
+} ;
+
+struct fit_curve
+init_fit_curve( const struct resampled *f ,
+		const struct data_info Data ,
+		const struct fit_info Fit ,
+		const size_t shift ) ;
+
+void
+free_fit_curve( struct fit_curve *C ) ;
+
+void
+eval_fit_curve( double *y ,
+		const struct fit_curve *C ,
+		const double *x ,
+		const size_t Nx ) ;
+
+void
+fit_curve_dist( struct resampled *d ,
+		const struct fit_curve *C ,
+		const double *y ,
+		const size_t i ) ;
+
+struct resampled
+bisect_fit_curve( const struct fit_curve *C ,
+		  const double xlo ,
+		  const double target ,
+		  const double xhi ) ;
+
 struct resampled
 extrap_fitfunc( const struct resampled *f ,
 		const struct data_info Data ,
@@ -17,7 +56,7 @@ bisect_fitfunc( const struct resampled *f ,
 		const double xhi ,
 		const size_t shift ) ;
 
-void
+int
 plot_fitfunction_HACK( const struct resampled *f ,
 		       const struct data_info Data ,
 		       const struct fit_info Fit ) ;
@@ -27,7 +66,7 @@ plot_feffmass( const struct resampled *f ,
 	       const struct data_info Data ,
 	       const struct fit_info Fit ) ;
 
-void
+int
 plot_fitfunction( const struct resampled *f ,
 		  const struct data_info Data ,
 		  const struct fit_info Fit ) ;
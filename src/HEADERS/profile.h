@@ -0,0 +1,59 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// things we count, summed over threads in the summary
+typedef enum {
+  PROF_FILES ,        // data files opened by the readers
+  PROF_BYTES ,        // bytes read, the file position at fclose
+  PROF_FITS ,         // calls of single_fit
+  PROF_LM_ITERS ,     // Levenberg-Marquardt iterations
+  PROF_FEVALS ,       // evaluations of the fit function and derivatives
+  PROF_COMPUTE_ERR ,  // calls of compute_err
+  PROF_NCOUNTERS } prof_counter ;
+
+// the macros are all we should call, they vanish unless configured
+// with --enable-PROFILE. PROF_START declares prof_<name> in scope
+#ifdef URFIT_PROFILE
+  #define PROF_INIT()           prof_init( )
+  #define PROF_START( name )    const size_t prof_##name = prof_timer_start( #name )
+  #define PROF_STOP( name )     prof_timer_stop( prof_##name )
+  #define PROF_COUNT( c , n )   prof_count( c , n )
+  #define PROF_FILE( file )     prof_file( file )
+  #define PROF_TAG( key , val ) prof_tag( key , val )
+#else
+  #define PROF_INIT()
+  #define PROF_START( name )
+  #define PROF_STOP( name )
+  #define PROF_COUNT( c , n )
+  #define PROF_FILE( file )
+  #define PROF_TAG( key , val )
+#endif
+
+// starts the wall clock and registers the summary with atexit, it is
+// written to $URFIT_PROFILE_JSON or urfit_profile.json
+void
+prof_init( void ) ;
+
+// named timers accumulate over calls, a timer still running at exit is
+// reported as incomplete. Not reentrant for the same name
+size_t
+prof_timer_start( const char *name ) ;
+
+void
+prof_timer_stop( const size_t idx ) ;
+
+// thread-safe, each thread has its own counters
+void
+prof_count( const prof_counter c ,
+	    const size_t n ) ;
+
+// counts a file and its bytes read, call it just before fclose
+void
+prof_file( FILE *file ) ;
+
+// integer key-value pair that goes in the summary
+void
+prof_tag( const char *key ,
+	  const long val ) ;
+
+#endif
@@ -5,6 +5,7 @@
 #include "gens.h"
 
 #include "ffunction.h"
+#include "fake.h"
 #include "fit_chooser.h"
 #include "init.h"
 #include "pmap.h"
@@ -114,26 +115,23 @@ generate_fake_boot( const size_t N,
   return y ;
 }
 
-// assumes x and y have been set
+// synthetic raw data for the model in Fit, Data -> Nsim must be set
 int
-generate_fake_data( struct data_info *Data ,
-		    struct fit_info Fit ,
-		    struct traj *Traj ,
-		    const double xsigma ,
-		    const double ysigma )
+generate_fake_ensemble( struct data_info *Data ,
+			struct fit_info Fit ,
+			struct traj *Traj ,
+			const struct fake_ensemble E )
 {
-  const size_t Nmeas = 200 ;
-  const size_t Ndata = 30 ;
-  
   size_t i , j , k ;
   Data -> Ndata = malloc( Data -> Nsim * sizeof( size_t ) ) ;
   Data -> Ntot = 0 ;
   for( i = 0 ; i < Data -> Nsim ; i++ ) {
-    Data -> Ndata[i] = Ndata ;
+    Data -> Ndata[i] = E.Ndata ;
     Data -> Ntot += Data -> Ndata[i] ;
   }
 
   gsl_rng *r = NULL ;
+  double *eps = NULL ;
 
    // set Lt
   if( init_LT( Data , Traj ) == FAILURE ) {
@@ -143,10 +141,17 @@ generate_fake_data( struct data_info *Data ,
   // set up the gsl rng
   gsl_rng_env_setup( ) ;
   r = gsl_rng_alloc( gsl_rng_default ) ;
+  if( E.Seed != 0 ) {
+    gsl_rng_set( r , E.Seed ) ;
+  }
   
   // allocate the pointers we are passing by reference
   Data -> x = malloc( Data -> Ntot * sizeof( struct resampled ) ) ;
   Data -> y = malloc( Data -> Ntot * sizeof( struct resampled ) ) ;
+
+  // y-noise of the previous point for each measurement
+  eps = calloc( E.Nmeas , sizeof( double ) ) ;
+  const double innov = sqrt( 1 - E.Rho*E.Rho ) ;
   
   // initialise the fit so we can get at the fit function
   struct fit_descriptor fdesc = init_fit( *Data , Fit ) ;
@@ -156,28 +161,30 @@ generate_fake_data( struct data_info *Data ,
 
   // set the fit parameters
   for( i = 0 ; i < Fit.Nlogic ; i++ ) {
-    fdesc.f.fparams[i] = ( i+1 ) ;
-    printf( "FAKED_%zu %f \n" , i , fdesc.f.fparams[i] ) ;
+    fdesc.f.fparams[i] = E.Params != NULL ? E.Params[i] : ( i+1 ) ;
+    if( E.Verbose ) {
+      printf( "FAKED_%zu %f \n" , i , fdesc.f.fparams[i] ) ;
+    }
   }
   
   size_t shift = 0 , p ;
   for( i = 0 ; i < Data -> Nsim ; i++ ) {
     for( j = shift ; j < shift + Data -> Ndata[i] ; j++ ) {
 
-      Data -> x[j].resampled = malloc( Nmeas * sizeof( double ) ) ;
+      Data -> x[j].resampled = malloc( E.Nmeas * sizeof( double ) ) ;
       Data -> x[j].restype   = Raw ;
-      Data -> x[j].NSAMPLES  = Nmeas ;
+      Data -> x[j].NSAMPLES  = E.Nmeas ;
 
-      Data -> y[j].resampled = malloc( Nmeas * sizeof( double ) ) ;
+      Data -> y[j].resampled = malloc( E.Nmeas * sizeof( double ) ) ;
       Data -> y[j].restype   = Raw ;
-      Data -> y[j].NSAMPLES  = Nmeas ;
+      Data -> y[j].NSAMPLES  = E.Nmeas ;
 
       // is a random "x" value
-      const double x_prime = j ; //gsl_rng_uniform( r ) * Ndata / 20 ;
+      const double x_prime = E.X0 + j ; //gsl_rng_uniform( r ) * Ndata / 20 ;
 
       // fill the boots with noise
-      for( k = 0 ; k < Nmeas ; k++ ) {
-	const double xx = x_prime + gsl_ran_gaussian( r , xsigma ) ;
+      for( k = 0 ; k < E.Nmeas ; k++ ) {
+	const double xx = x_prime + gsl_ran_gaussian( r , E.Xsigma ) ;
         Data -> x[j].resampled[k] = xx ;
 	// compute the fit func values
 	double fparams[ fdesc.Nparam ] ;
@@ -185,26 +192,35 @@ generate_fake_data( struct data_info *Data ,
 	  fparams[ p ] = fdesc.f.fparams[ Fit.map[shift].p[p] ] ;
 	}
 	struct x_desc xdesc = { xx , Data -> LT[j] , Fit.N , Fit.M } ;
+	// AR(1) noise along the points of a simulation so that
+	// neighbours are correlated by Rho, independent if it is zero
+	eps[k] = ( j == shift ? 0.0 : E.Rho*eps[k] ) +
+	  innov*gsl_ran_gaussian( r , 1.0 ) ;
 	// evaluate the fit function and add some y-noise to it as well
 	const double y_prime = fdesc.func( xdesc , fparams , fdesc.Nparam ) ;
-        Data -> y[j].resampled[k] = y_prime *
-	  ( 1 + gsl_ran_gaussian( r , ysigma ) ) ;
+        Data -> y[j].resampled[k] = y_prime * ( 1 + E.Ysigma*eps[k] ) ;
       }
 
       compute_err( &(Data -> x[j]) ) ;
       compute_err( &(Data -> y[j]) ) ;
-      printf( "%g %g || %g %g \n" , Data -> x[j].avg , Data -> x[j].err , Data -> y[j].avg , Data -> y[j].err ) ;
+      if( E.Verbose ) {
+	printf( "%g %g || %g %g \n" , Data -> x[j].avg , Data -> x[j].err ,
+		Data -> y[j].avg , Data -> y[j].err ) ;
+      }
     }
     shift += Data -> Ndata[i] ;
   }
 
- memfree :
-  
   // free the fitfunction
   free_ffunction( &fdesc.f , fdesc.Nlogic ) ;
+  
+ memfree :
 
   // free the rng
-  gsl_rng_free( r ) ;
+  if( r != NULL ) {
+    gsl_rng_free( r ) ;
+  }
+  free( eps ) ;
   
   // free the parameter map
   if( Fit.map != NULL ) {
@@ -214,5 +230,20 @@ generate_fake_data( struct data_info *Data ,
   return SUCCESS ;
 }
 
+// assumes x and y have been set
+int
+generate_fake_data( struct data_info *Data ,
+		    struct fit_info Fit ,
+		    struct traj *Traj ,
+		    const double xsigma ,
+		    const double ysigma )
+{
+  const struct fake_ensemble E = { .Ndata = 30 , .Nmeas = 200 ,
+				   .Xsigma = xsigma , .Ysigma = ysigma ,
+				   .Rho = 0.0 , .Params = NULL ,
+				   .Seed = 0 , .Verbose = true } ;
+  return generate_fake_ensemble( Data , Fit , Traj , E ) ;
+}
+
 #undef xnoise
 #undef ynoise
@@ -66,6 +66,14 @@ free_Fit( struct fit_info *Fit )
   if( Fit -> Guess != NULL ) {
     free( Fit -> Guess ) ;
   }
+  // free the scan windows
+  if( Fit -> Scan != NULL ) {
+    free( Fit -> Scan ) ;
+  }
+  // and the models we average over
+  if( Fit -> Models != NULL ) {
+    free( Fit -> Models ) ;
+  }
   return ;
 }
 
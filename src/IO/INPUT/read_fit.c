@@ -10,7 +10,16 @@
    FitSims = , , , , , -> Up to Nlogic of these if there is only NULL at the start we have 0
    Prior = index,val,err -- can have loads of these
    FitTol = tolerance we minimize to
-   FitMin = minimizer we use {CG,GA,LM,SD,POWELL,SIMPLEX,BFGS}
+   FitStarts = number of multi-start fits for the average (optional, default 1)
+   FitSpread = relative size of the multi-start perturbations (optional, default 0.5)
+   ScanWindow = traj,low_min,low_max,high_min,high_max,step -- optional, at most
+   one per trajectory, the fit windows looped over by Analysis = FitScan
+   AverageModel = FITDEF,N,M -- optional, can have loads of these, extra models
+   FitScan fits to every window and averages over with FitDef
+
+   GA_Pop , GA_Breed , GA_Parents , GA_Tournament , GA_Mutate , GA_Noise
+   are optional settings for the genetic algorithm, see GA.h for defaults
+   FitMin = minimizer we use {CG,GA,GLS,GLS_pade,LM,SD,POWELL,SIMPLEX,BFGS,VARPRO}
 
    Guess_0 = val
    Guess_1 = val
@@ -21,6 +30,7 @@
  */
 #include "gens.h"
 
+#include <errno.h>
 #include <string.h>
 
 // minimizers
@@ -33,6 +43,7 @@
 #include "powell.h"
 #include "Simplex.h"
 #include "BFGS.h"
+#include "VarPro.h"
 
 #include "fit_chooser.h"
 #include "read_inputs.h"
@@ -43,6 +54,116 @@ struct node {
   struct node *next ;
 } ;
 
+// map the name of a fit function to its fittype
+static int
+fitdef_from_string( fittype *Fitdef ,
+		    const char *str )
+{
+  if( are_equal( str , "ALPHA_D0" ) ) {
+    *Fitdef = ALPHA_D0 ;
+  } else if( are_equal( str , "ALPHA_D0_MULTI" ) ) {
+    *Fitdef = ALPHA_D0_MULTI ;
+  } else if( are_equal( str , "ADLERALPHA_D0" ) ) {
+    *Fitdef = ADLERALPHA_D0 ;
+  } else if( are_equal( str , "ADLERALPHA_D0_MULTI" ) ) {
+    *Fitdef = ADLERALPHA_D0_MULTI ;
+  } else if( are_equal( str , "C4C7" ) ) {
+    *Fitdef = C4C7 ;
+  } else if( are_equal( str , "CORNELL" ) ) {
+    *Fitdef = CORNELL ;
+  } else if( are_equal( str , "CORNELL_V2" ) ) {
+    *Fitdef = CORNELL_V2 ;
+  } else if( are_equal( str , "COSH" ) ) {
+    *Fitdef = COSH ;
+  } else if( are_equal( str , "COSH_ASYMM" ) ) {
+    *Fitdef = COSH_ASYMM ;
+  } else if( are_equal( str , "COSH_PLUSC" ) ) {
+    *Fitdef = COSH_PLUSC ;
+  } else if( are_equal( str , "EXP" ) ) {
+    *Fitdef = EXP ;
+  } else if( are_equal( str , "EXP_XINV" ) ) {
+    *Fitdef = EXP_XINV ;
+  } else if( are_equal( str , "EXP_PLUSC" ) ) {
+    *Fitdef = EXP_PLUSC ;
+  } else if( are_equal( str , "FVOLCC" ) ) {
+    *Fitdef = FVOLCC ;
+  } else if( are_equal( str , "FVOL1" ) ) {
+    *Fitdef = FVOL1 ;
+  } else if( are_equal( str , "FVOL2" ) ) {
+    *Fitdef = FVOL2 ;
+  } else if( are_equal( str , "FVOL3" ) ) {
+    *Fitdef = FVOL3 ;
+  } else if( are_equal( str , "FVOL4" ) ) {
+    *Fitdef = FVOL4 ;
+  } else if( are_equal( str , "FVOL5" ) ) {
+    *Fitdef = FVOL5 ;
+  } else if( are_equal( str , "FVOL6" ) ) {
+    *Fitdef = FVOL6 ;
+  } else if( are_equal( str , "FVOL_DELTA" ) ) {
+    *Fitdef = FVOL_DELTA ;
+  } else if( are_equal( str , "HALEXP" ) ) {
+    *Fitdef = HALEXP ;
+  } else if( are_equal( str , "HLBL_CONT" ) ) {
+    *Fitdef = HLBL_CONT ;
+  } else if( are_equal( str , "LARGENB" ) ) {
+    *Fitdef = LARGENB ;
+  } else if( are_equal( str , "NRQCD_EXP" ) ) {
+    *Fitdef = NRQCD_EXP ;
+  } else if( are_equal( str , "NRQCD_EXP2" ) ) {
+    *Fitdef = NRQCD_EXP2 ;
+  } else if( are_equal( str , "NOFIT" ) ) {
+    *Fitdef = NOFIT ;
+  } else if( are_equal( str , "PADE" ) ) {
+    *Fitdef = PADE ;
+  } else if( are_equal( str , "PEXP" ) ) {
+    *Fitdef = PEXP ;
+  } else if( are_equal( str , "POLY" ) ) {
+    *Fitdef = POLY ;
+  } else if( are_equal( str , "POLES" ) ) {
+    *Fitdef = POLES ; 
+  } else if( are_equal( str , "PP_AA" ) ) {
+    *Fitdef = PP_AA ;
+  } else if( are_equal( str , "PP_AA_EXP" ) ) {
+    *Fitdef = PP_AA_EXP ;
+  } else if( are_equal( str , "PP_AA_WW" ) ) {
+    *Fitdef = PP_AA_WW ;
+  } else if( are_equal( str , "PP_AA_WW_R2" ) ) {
+    *Fitdef = PP_AA_WW_R2 ;
+  } else if( are_equal( str , "PPAA" ) ) {
+    *Fitdef = PPAA ;
+  } else if( are_equal( str , "SINH" ) ) {
+    *Fitdef = SINH ;
+  } else if( are_equal( str , "TANH" ) ) {
+    *Fitdef = TANH ;
+  } else if( are_equal( str , "SOL" ) ) {
+    *Fitdef = SOL ;
+  } else if( are_equal( str , "SOL2" ) ) {
+    *Fitdef = SOL2 ;
+  } else if( are_equal( str , "SU2_SHITFIT" ) ) {
+    *Fitdef = SU2_SHITFIT ;
+  } else if( are_equal( str , "TEST" ) ) {
+    *Fitdef = TEST ;
+  } else if( are_equal( str , "SUN_CONT" ) ) {
+    *Fitdef = SUN_CONT ;
+  } else if( are_equal( str , "QCORR_BESSEL" ) ) {
+    *Fitdef = QCORR_BESSEL ;
+  } else if( are_equal( str , "QSLAB" ) ) {
+    *Fitdef = QSLAB ;
+  } else if( are_equal( str , "QSLAB_FIXED" ) ) {
+    *Fitdef = QSLAB_FIXED ;
+  } else if( are_equal( str , "QSUSC_SU2" ) ) {
+    *Fitdef = QSUSC_SU2 ;
+  } else if( are_equal( str , "UDCB_HEAVY" ) ) {
+    *Fitdef = UDCB_HEAVY ;
+  } else if( are_equal( str , "ZV_EXP" ) ) {
+    *Fitdef = ZV_EXP ;
+  } else {
+    fprintf( stderr , "[INPUT] Fit %s not recognised\n" , str ) ;
+    return FAILURE ;
+  }
+  return SUCCESS ;
+}
+
 // get the function we are fitting our data to
 static int
 get_fitDef(  struct input_params *Input ,
@@ -54,109 +175,7 @@ get_fitDef(  struct input_params *Input ,
     fprintf( stderr , "[INPUTS] FitDef not found in input file!\n" ) ;
     return FAILURE ;
   }
-  if( are_equal( Flat[tag].Value , "ALPHA_D0" ) ) {
-    Input -> Fit.Fitdef = ALPHA_D0 ;
-  } else if( are_equal( Flat[tag].Value , "ALPHA_D0_MULTI" ) ) {
-    Input -> Fit.Fitdef = ALPHA_D0_MULTI ;
-  } else if( are_equal( Flat[tag].Value , "ADLERALPHA_D0" ) ) {
-    Input -> Fit.Fitdef = ADLERALPHA_D0 ;
-  } else if( are_equal( Flat[tag].Value , "ADLERALPHA_D0_MULTI" ) ) {
-    Input -> Fit.Fitdef = ADLERALPHA_D0_MULTI ;
-  } else if( are_equal( Flat[tag].Value , "C4C7" ) ) {
-    Input -> Fit.Fitdef = C4C7 ;
-  } else if( are_equal( Flat[tag].Value , "CORNELL" ) ) {
-    Input -> Fit.Fitdef = CORNELL ;
-  } else if( are_equal( Flat[tag].Value , "CORNELL_V2" ) ) {
-    Input -> Fit.Fitdef = CORNELL_V2 ;
-  } else if( are_equal( Flat[tag].Value , "COSH" ) ) {
-    Input -> Fit.Fitdef = COSH ;
-  } else if( are_equal( Flat[tag].Value , "COSH_ASYMM" ) ) {
-    Input -> Fit.Fitdef = COSH_ASYMM ;
-  } else if( are_equal( Flat[tag].Value , "COSH_PLUSC" ) ) {
-    Input -> Fit.Fitdef = COSH_PLUSC ;
-  } else if( are_equal( Flat[tag].Value , "EXP" ) ) {
-    Input -> Fit.Fitdef = EXP ;
-  } else if( are_equal( Flat[tag].Value , "EXP_XINV" ) ) {
-    Input -> Fit.Fitdef = EXP_XINV ;
-  } else if( are_equal( Flat[tag].Value , "EXP_PLUSC" ) ) {
-    Input -> Fit.Fitdef = EXP_PLUSC ;
-  } else if( are_equal( Flat[tag].Value , "FVOLCC" ) ) {
-    Input -> Fit.Fitdef = FVOLCC ;
-  } else if( are_equal( Flat[tag].Value , "FVOL1" ) ) {
-    Input -> Fit.Fitdef = FVOL1 ;
-  } else if( are_equal( Flat[tag].Value , "FVOL2" ) ) {
-    Input -> Fit.Fitdef = FVOL2 ;
-  } else if( are_equal( Flat[tag].Value , "FVOL3" ) ) {
-    Input -> Fit.Fitdef = FVOL3 ;
-  } else if( are_equal( Flat[tag].Value , "FVOL4" ) ) {
-    Input -> Fit.Fitdef = FVOL4 ;
-  } else if( are_equal( Flat[tag].Value , "FVOL5" ) ) {
-    Input -> Fit.Fitdef = FVOL5 ;
-  } else if( are_equal( Flat[tag].Value , "FVOL6" ) ) {
-    Input -> Fit.Fitdef = FVOL6 ;
-  } else if( are_equal( Flat[tag].Value , "FVOL_DELTA" ) ) {
-    Input -> Fit.Fitdef = FVOL_DELTA ;
-  } else if( are_equal( Flat[tag].Value , "HALEXP" ) ) {
-    Input -> Fit.Fitdef = HALEXP ;
-  } else if( are_equal( Flat[tag].Value , "HLBL_CONT" ) ) {
-    Input -> Fit.Fitdef = HLBL_CONT ;
-  } else if( are_equal( Flat[tag].Value , "LARGENB" ) ) {
-    Input -> Fit.Fitdef = LARGENB ;
-  } else if( are_equal( Flat[tag].Value , "NRQCD_EXP" ) ) {
-    Input -> Fit.Fitdef = NRQCD_EXP ;
-  } else if( are_equal( Flat[tag].Value , "NRQCD_EXP2" ) ) {
-    Input -> Fit.Fitdef = NRQCD_EXP2 ;
-  } else if( are_equal( Flat[tag].Value , "NOFIT" ) ) {
-    Input -> Fit.Fitdef = NOFIT ;
-  } else if( are_equal( Flat[tag].Value , "PADE" ) ) {
-    Input -> Fit.Fitdef = PADE ;
-  } else if( are_equal( Flat[tag].Value , "PEXP" ) ) {
-    Input -> Fit.Fitdef = PEXP ;
-  } else if( are_equal( Flat[tag].Value , "POLY" ) ) {
-    Input -> Fit.Fitdef = POLY ;
-  } else if( are_equal( Flat[tag].Value , "POLES" ) ) {
-    Input -> Fit.Fitdef = POLES ; 
-  } else if( are_equal( Flat[tag].Value , "PP_AA" ) ) {
-    Input -> Fit.Fitdef = PP_AA ;
-  } else if( are_equal( Flat[tag].Value , "PP_AA_EXP" ) ) {
-    Input -> Fit.Fitdef = PP_AA_EXP ;
-  } else if( are_equal( Flat[tag].Value , "PP_AA_WW" ) ) {
-    Input -> Fit.Fitdef = PP_AA_WW ;
-  } else if( are_equal( Flat[tag].Value , "PP_AA_WW_R2" ) ) {
-    Input -> Fit.Fitdef = PP_AA_WW_R2 ;
-  } else if( are_equal( Flat[tag].Value , "PPAA" ) ) {
-    Input -> Fit.Fitdef = PPAA ;
-  } else if( are_equal( Flat[tag].Value , "SINH" ) ) {
-    Input -> Fit.Fitdef = SINH ;
-  } else if( are_equal( Flat[tag].Value , "TANH" ) ) {
-    Input -> Fit.Fitdef = TANH ;
-  } else if( are_equal( Flat[tag].Value , "SOL" ) ) {
-    Input -> Fit.Fitdef = SOL ;
-  } else if( are_equal( Flat[tag].Value , "SOL2" ) ) {
-    Input -> Fit.Fitdef = SOL2 ;
-  } else if( are_equal( Flat[tag].Value , "SU2_SHITFIT" ) ) {
-    Input -> Fit.Fitdef = SU2_SHITFIT ;
-  } else if( are_equal( Flat[tag].Value , "TEST" ) ) {
-    Input -> Fit.Fitdef = TEST ;
-  } else if( are_equal( Flat[tag].Value , "SUN_CONT" ) ) {
-    Input -> Fit.Fitdef = SUN_CONT ;
-  } else if( are_equal( Flat[tag].Value , "QCORR_BESSEL" ) ) {
-    Input -> Fit.Fitdef = QCORR_BESSEL ;
-  } else if( are_equal( Flat[tag].Value , "QSLAB" ) ) {
-    Input -> Fit.Fitdef = QSLAB ;
-  } else if( are_equal( Flat[tag].Value , "QSLAB_FIXED" ) ) {
-    Input -> Fit.Fitdef = QSLAB_FIXED ;
-  } else if( are_equal( Flat[tag].Value , "QSUSC_SU2" ) ) {
-    Input -> Fit.Fitdef = QSUSC_SU2 ;
-  } else if( are_equal( Flat[tag].Value , "UDCB_HEAVY" ) ) {
-    Input -> Fit.Fitdef = UDCB_HEAVY ;
-  } else if( are_equal( Flat[tag].Value , "ZV_EXP" ) ) {
-    Input -> Fit.Fitdef = ZV_EXP ;
-  } else {
-    fprintf( stderr , "[INPUT] Fit %s not recognised\n" , Flat[tag].Value ) ;
-    return FAILURE ;
-  }
-  return SUCCESS ;
+  return fitdef_from_string( &Input -> Fit.Fitdef , Flat[tag].Value ) ;
 }
 
 // get the function we are fitting our data to
@@ -199,17 +218,14 @@ get_fitMin( struct input_params *Input ,
   } else if( are_equal( Flat[tag].Value , "GA" ) ) {
     Input -> Fit.Minimize = ga_iter ;
   } else if( are_equal( Flat[tag].Value , "GLS" ) ) {
-    if( Input -> Fit.Fitdef == POLY ||
-	Input -> Fit.Fitdef == NOFIT ||
-	Input -> Fit.Fitdef == POLES ||
-	Input -> Fit.Fitdef == LARGENB ) {
+    if( minimizer_supports( "GLS" , Input -> Fit.Fitdef ) ) {
       Input -> Fit.Minimize = gls_iter ;
     } else {
       fprintf( stderr , "[INPUTS] GLS only supports POLY/POLES type fit\n" ) ;
       return FAILURE ;
     }
   } else if( are_equal( Flat[tag].Value , "GLS_pade" ) ) {
-    if( Input -> Fit.Fitdef == PADE || Input -> Fit.Fitdef == NOFIT ) {
+    if( minimizer_supports( "GLS_pade" , Input -> Fit.Fitdef ) ) {
       Input -> Fit.Minimize = gls_pade_iter ;
     } else {
       fprintf( stderr , "[INPUTS] GLS only supports PADE type fit\n" ) ;
@@ -225,12 +241,57 @@ get_fitMin( struct input_params *Input ,
     Input -> Fit.Minimize = simplex_iter ;
   } else if( are_equal( Flat[tag].Value , "BFGS" ) ) {
     Input -> Fit.Minimize = BFGS_iter ;
+  } else if( are_equal( Flat[tag].Value , "VARPRO" ) ) {
+    if( minimizer_supports( "VARPRO" , Input -> Fit.Fitdef ) ) {
+      Input -> Fit.Minimize = vp_iter ;
+    } else {
+      fprintf( stderr , "[INPUTS] VARPRO only supports fits linear "
+	       "in their amplitudes (EXP,COSH,SINH,PEXP,*_PLUSC)\n" ) ;
+      return FAILURE ;
+    }
   } else {
     return FAILURE ;
   }
   return SUCCESS ;
 }
 
+// optional settings for the genetic algorithm
+static int
+get_GA( struct input_params *Input ,
+	const struct flat_file *Flat ,
+	const size_t Ntags )
+{
+  struct ga_info *GA = &Input -> Fit.GA ;
+  char *endptr = NULL ;
+  size_t tag = 0 ;
+  *GA = ga_defaults( ) ;
+  if( ( tag = tag_search( Flat , "GA_Pop" , 0 , Ntags ) ) != Ntags ) {
+    GA -> Npop = strtol( Flat[tag].Value , &endptr , 10 ) ;
+  }
+  if( ( tag = tag_search( Flat , "GA_Breed" , 0 , Ntags ) ) != Ntags ) {
+    GA -> Nbreed = strtol( Flat[tag].Value , &endptr , 10 ) ;
+  }
+  if( ( tag = tag_search( Flat , "GA_Parents" , 0 , Ntags ) ) != Ntags ) {
+    GA -> Nparents = strtol( Flat[tag].Value , &endptr , 10 ) ;
+  }
+  if( ( tag = tag_search( Flat , "GA_Tournament" , 0 , Ntags ) ) != Ntags ) {
+    GA -> Ntournament = strtol( Flat[tag].Value , &endptr , 10 ) ;
+  }
+  if( ( tag = tag_search( Flat , "GA_Mutate" , 0 , Ntags ) ) != Ntags ) {
+    GA -> Pmutant = strtod( Flat[tag].Value , &endptr ) ;
+  }
+  if( ( tag = tag_search( Flat , "GA_Noise" , 0 , Ntags ) ) != Ntags ) {
+    GA -> Noise = strtod( Flat[tag].Value , &endptr ) ;
+  }
+  if( GA -> Nbreed == 0 || GA -> Nbreed > GA -> Npop || GA -> Nparents == 0 ) {
+    fprintf( stderr , "[INPUTS] GA needs 0 < GA_Breed (%zu) <= GA_Pop (%zu)"
+	     " and GA_Parents (%zu) > 0\n" , GA -> Nbreed , GA -> Npop ,
+	     GA -> Nparents ) ;
+    return FAILURE ;
+  }
+  return SUCCESS ;
+}
+
 // get the number of sim params and put them in a list
 static struct node *
 get_Nsims( size_t *Nsims , const char *Value )
@@ -348,6 +409,130 @@ get_Guesses( struct input_params *Input ,
   return SUCCESS ;
 }
   
+// get the fit windows we scan over, trajectories without one
+// keep their TrajFitr range
+static int
+get_Scan( struct input_params *Input ,
+	  const struct flat_file *Flat ,
+	  const size_t Ntags )
+{
+  size_t i , block_idx = 0 ;
+  Input -> Fit.Scan = malloc( Input -> Data.Nsim * sizeof( struct scan_window ) ) ;
+  for( i = 0 ; i < Input -> Data.Nsim ; i++ ) {
+    Input -> Fit.Scan[i].Initialised = false ;
+  }
+  while( ( block_idx = tag_search( Flat , "ScanWindow" , block_idx , Ntags ) )
+	 != Ntags ) {
+    char *tok = strtok( Flat[block_idx].Value , "," ) , *endptr ;
+    double vals[ 5 ] ;
+    const size_t idx = strtol( tok , &endptr , 10 ) ;
+    if( idx >= Input -> Data.Nsim ) {
+      fprintf( stderr , "[INPUTS] ScanWindow trajectory %zu is greater than"
+	       " Nsim %zu \n" , idx , Input -> Data.Nsim ) ;
+      return FAILURE ;
+    }
+    for( i = 0 ; i < 5 ; i++ ) {
+      if( ( tok = strtok( NULL , "," ) ) == NULL ) {
+	fprintf( stderr , "[INPUTS] ScanWindow expects "
+		 "traj,low_min,low_max,high_min,high_max,step\n" ) ;
+	return FAILURE ;
+      }
+      vals[i] = strtod( tok , &endptr ) ;
+    }
+    struct scan_window *S = &Input -> Fit.Scan[idx] ;
+    if( S -> Initialised == true ) {
+      fprintf( stderr , "[INPUTS] ScanWindow for trajectory %zu given twice\n" ,
+	       idx ) ;
+      return FAILURE ;
+    }
+    S -> Low_Min  = vals[0] ; S -> Low_Max  = vals[1] ;
+    S -> High_Min = vals[2] ; S -> High_Max = vals[3] ;
+    S -> Step = vals[4] ;
+    if( S -> Step <= 0.0 || S -> Low_Max < S -> Low_Min ||
+	S -> High_Max < S -> High_Min ) {
+      fprintf( stderr , "[INPUTS] ScanWindow %zu has an empty range or"
+	       " non-positive step\n" , idx ) ;
+      return FAILURE ;
+    }
+    S -> Initialised = true ;
+    block_idx++ ;
+  }
+  return SUCCESS ;
+}
+
+// one of the N,M fields of an AverageModel, has to be a whole
+// non-negative number with nothing trailing it
+static int
+model_order( size_t *val ,
+	     const char *tok ,
+	     const char *name )
+{
+  char *endptr = NULL ;
+  if( tok == NULL ) {
+    fprintf( stderr , "[INPUTS] AverageModel expects FITDEF,N,M\n" ) ;
+    return FAILURE ;
+  }
+  errno = 0 ;
+  const long v = strtol( tok , &endptr , 10 ) ;
+  if( endptr == tok || *endptr != '\0' ) {
+    fprintf( stderr , "[INPUTS] AverageModel %s \"%s\" is not a number\n" ,
+	     name , tok ) ;
+    return FAILURE ;
+  }
+  if( errno == ERANGE || v < 0 ) {
+    fprintf( stderr , "[INPUTS] AverageModel %s %s is out of range\n" ,
+	     name , tok ) ;
+    return FAILURE ;
+  }
+  *val = (size_t)v ;
+  return SUCCESS ;
+}
+
+// extra models for the model average of FitScan
+static int
+get_Models( struct input_params *Input ,
+	    const struct flat_file *Flat ,
+	    const size_t Ntags )
+{
+  size_t block_idx = 0 , Nmodels = 0 ;
+  while( ( block_idx = tag_search( Flat , "AverageModel" , block_idx , Ntags ) )
+	 != Ntags ) {
+    Nmodels++ ; block_idx++ ;
+  }
+  Input -> Fit.Nmodels = Nmodels ;
+  if( Nmodels == 0 ) return SUCCESS ;
+
+  Input -> Fit.Models = malloc( Nmodels * sizeof( struct model_info ) ) ;
+  block_idx = Nmodels = 0 ;
+  while( ( block_idx = tag_search( Flat , "AverageModel" , block_idx , Ntags ) )
+	 != Ntags ) {
+    struct model_info *M = &Input -> Fit.Models[ Nmodels ] ;
+    char *tok = strtok( Flat[block_idx].Value , "," ) ;
+    if( tok == NULL || fitdef_from_string( &M -> Fitdef , tok ) == FAILURE ) {
+      return FAILURE ;
+    }
+    if( model_order( &M -> N , strtok( NULL , "," ) , "N" ) == FAILURE ||
+	model_order( &M -> M , strtok( NULL , "," ) , "M" ) == FAILURE ) {
+      return FAILURE ;
+    }
+    if( ( tok = strtok( NULL , "," ) ) != NULL ) {
+      fprintf( stderr , "[INPUTS] AverageModel expects FITDEF,N,M, "
+	       "found trailing \"%s\"\n" , tok ) ;
+      return FAILURE ;
+    }
+    // N and M have to give the model some parameters
+    struct fit_info Fit = Input -> Fit ;
+    Fit.Fitdef = M -> Fitdef ; Fit.N = M -> N ; Fit.M = M -> M ;
+    if( get_Nparam( Fit ) == 0 ) {
+      fprintf( stderr , "[INPUTS] AverageModel N %zu , M %zu out of range,"
+	       " the model has no parameters\n" , M -> N , M -> M ) ;
+      return FAILURE ;
+    }
+    Nmodels++ ; block_idx++ ;
+  }
+  return SUCCESS ;
+}
+
 // fill out the fit_info struct of Input
 int
 get_fit( struct input_params *Input ,
@@ -366,6 +551,10 @@ get_fit( struct input_params *Input ,
   if( get_fitMin( Input , Flat , Ntags ) == FAILURE ) {
     return FAILURE ;
   }
+  // and the settings of the genetic algorithm
+  if( get_GA( Input , Flat , Ntags ) == FAILURE ) {
+    return FAILURE ;
+  }
   // directly read the tolerance
   char *endptr = NULL ;
   size_t tag = 0 ;
@@ -374,6 +563,16 @@ get_fit( struct input_params *Input ,
     return FAILURE ;
   }
   Input -> Fit.Tol = strtod( Flat[tag].Value , &endptr ) ;
+
+  // multi-start search for the average fit is optional
+  Input -> Fit.Nstarts = 1 ;
+  if( ( tag = tag_search( Flat , "FitStarts" , 0 , Ntags ) ) != Ntags ) {
+    Input -> Fit.Nstarts = strtol( Flat[tag].Value , &endptr , 10 ) ;
+  }
+  Input -> Fit.Spread = 0.5 ;
+  if( ( tag = tag_search( Flat , "FitSpread" , 0 , Ntags ) ) != Ntags ) {
+    Input -> Fit.Spread = strtod( Flat[tag].Value , &endptr ) ;
+  }
   
   // directly read fit n and m
   if( ( tag = tag_search( Flat , "Fit_NM" , 0 , Ntags ) ) == Ntags ) {
@@ -434,9 +633,21 @@ get_fit( struct input_params *Input ,
     return FAILURE ;
   }
 
+  // and any fit windows we might scan over
+  if( get_Scan( Input , Flat , Ntags ) == FAILURE ) {
+    return FAILURE ;
+  }
+  if( get_Models( Input , Flat , Ntags ) == FAILURE ) {
+    return FAILURE ;
+  }
+
   // print out a summary of the priors and simultaneous parameters
   fprintf( stdout , "\n[INPUTS] Summary for fit parameters\n" ) ;
   fprintf( stdout , "[INPUTS] Fit tolerance %e \n" , Input -> Fit.Tol ) ;
+  if( Input -> Fit.Nstarts > 1 ) {
+    fprintf( stdout , "[INPUTS] Multi-start with %zu starts, spread %f \n" ,
+	     Input -> Fit.Nstarts , Input -> Fit.Spread ) ;
+  }
   for( i = 0 ; i < Input -> Fit.Nlogic ; i++ ) {
     if( Input -> Fit.Prior[i].Initialised == true ) {
       fprintf( stdout , "[INPUTS] PRIOR %zu %f %f \n" , i ,
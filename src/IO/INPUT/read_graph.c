@@ -5,6 +5,7 @@
    Graph = %s
    Graph_X = xaxis
    Graph_Y = yaxis
+   Graph_CSV = true -- optional, also writes the points to Graph.csv
  */
 #include "gens.h"
 
@@ -39,10 +40,16 @@ get_graph( struct input_params *Input ,
   Input -> Graph.Yaxis = malloc( Flat[tag].Value_Length * sizeof( char ) ) ;
   strcpy( Input -> Graph.Yaxis , Flat[tag].Value ) ;
 
+  Input -> Graph.Csv = false ;
+  if( ( tag = tag_search( Flat , "Graph_CSV" , 0 , Ntags ) ) != Ntags ) {
+    Input -> Graph.Csv = are_equal( Flat[tag].Value , "true" ) ;
+  }
+
   fprintf( stdout , "\n[INPUTS] summary for graph information\n" ) ;
   fprintf( stdout , "[INPUTS] Graph name -> %s \n" , Input -> Graph.Name ) ;
   fprintf( stdout , "[INPUTS] Graph xaxis -> %s \n" , Input -> Graph.Xaxis ) ;
   fprintf( stdout , "[INPUTS] Graph yaxis -> %s \n" , Input -> Graph.Yaxis ) ;
+  fprintf( stdout , "[INPUTS] Graph csv -> %s \n" , Input -> Graph.Csv ? "true" : "false" ) ;
   
   return SUCCESS ;
 }
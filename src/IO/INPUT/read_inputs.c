@@ -133,10 +133,14 @@ read_inputs( struct input_params *Input ,
   Input -> Fit.Prior = NULL ;
   Input -> Fit.map = NULL ;
   Input -> Fit.Guess = NULL ;
+  Input -> Fit.Scan = NULL ;
+  Input -> Fit.Models = NULL ;
+  Input -> Fit.Nmodels = 0 ;
 
   Input -> Graph.Name = NULL ;
   Input -> Graph.Xaxis = NULL ;
   Input -> Graph.Yaxis = NULL ;
+  Input -> Graph.Csv = false ;
   
   if( infile == NULL ) {
     printf( "[INPUT] Cannot find input file %s \n" , filename ) ;
@@ -208,6 +212,8 @@ read_inputs( struct input_params *Input ,
       Input -> Analysis = Wflow ;
     } else if( are_equal( Flat[ an_tag ].Value , "Fit" ) ) {
       Input -> Analysis = Fit ;
+    } else if( are_equal( Flat[ an_tag ].Value , "FitScan" ) ) {
+      Input -> Analysis = FitScan ;
     } else if( are_equal( Flat[ an_tag ].Value , "Fpi_CLS" ) ) {
       Input -> Analysis = Fpi_CLS ;
     } else if( are_equal( Flat[ an_tag ].Value , "Nrqcd" ) ) {
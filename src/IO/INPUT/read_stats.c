@@ -10,6 +10,9 @@
    CovDiv = {true,false}
    CovBal = {true,false}
    CovEva = %f
+   CovEst = {SAMPLE,LEDOIT_WOLF,OAS,EIGEN_FLOOR} -- optional, default SAMPLE
+   EIGEN_FLOOR raises correlation matrix eigenvalues below CovEva times
+   the largest one
  */
 #include "gens.h"
 
@@ -72,6 +75,7 @@ get_stats( struct input_params *Input ,
   Input -> Data.Cov.Divided_Covariance = false ;
   Input -> Data.Cov.Column_Balanced = false ;
   Input -> Data.Cov.Eigenvalue_Tol = 1E-8 ;
+  Input -> Data.Cov.Estimator = SAMPLE_COV ;
   
   if( Input -> Fit.Corrfit == CORRELATED ) {
     // are we performing divided covariance?
@@ -93,6 +97,22 @@ get_stats( struct input_params *Input ,
       return FAILURE ;
     }
     Input -> Data.Cov.Eigenvalue_Tol = strtod( Flat[tag].Value , &endptr ) ;
+    // covariance estimator is optional
+    if( ( tag = tag_search( Flat , "CovEst" , 0 , Ntags ) ) != Ntags ) {
+      if( are_equal( Flat[tag].Value , "SAMPLE" ) ) {
+	Input -> Data.Cov.Estimator = SAMPLE_COV ;
+      } else if( are_equal( Flat[tag].Value , "LEDOIT_WOLF" ) ) {
+	Input -> Data.Cov.Estimator = LEDOIT_WOLF ;
+      } else if( are_equal( Flat[tag].Value , "OAS" ) ) {
+	Input -> Data.Cov.Estimator = OAS ;
+      } else if( are_equal( Flat[tag].Value , "EIGEN_FLOOR" ) ) {
+	Input -> Data.Cov.Estimator = EIGEN_FLOOR ;
+      } else {
+	fprintf( stderr , "[INPUTS] CovEst %s not recognised\n" ,
+		 Flat[tag].Value ) ;
+	return FAILURE ;
+      }
+    }
 
     if( Input -> Data.Cov.Divided_Covariance == true ) {
       fprintf( stdout , "[INPUTS] Using Divided correlation matrix ala Michaels\n" ) ;
@@ -100,6 +120,18 @@ get_stats( struct input_params *Input ,
     if( Input -> Data.Cov.Column_Balanced == true ) {
       fprintf( stdout , "[INPUTS] Using Column-Balanced SVD for inverse correlation matrix\n" ) ;
     }
+    switch( Input -> Data.Cov.Estimator ) {
+    case SAMPLE_COV : break ;
+    case LEDOIT_WOLF :
+      fprintf( stdout , "[INPUTS] Using Ledoit-Wolf shrinkage of the covariance\n" ) ;
+      break ;
+    case OAS :
+      fprintf( stdout , "[INPUTS] Using OAS shrinkage of the covariance\n" ) ;
+      break ;
+    case EIGEN_FLOOR :
+      fprintf( stdout , "[INPUTS] Flooring covariance eigenvalues\n" ) ;
+      break ;
+    }
     fprintf( stdout , "[INPUTS] Filtering out SVD 'Eigenvalues' that are less than %e \n" , Input -> Data.Cov.Eigenvalue_Tol ) ;
   }
   
@@ -8,6 +8,7 @@
 #include "momenta.h"
 #include "resampled_ops.h"
 #include "stats.h"
+#include "profile.h"
 
 enum{ DO_NOT_ADD , ADD_TO_LIST } list_creation ;
 
@@ -157,6 +158,7 @@ init_dists( struct input_params *Input )
 
     Input -> Data.Ntot += Input -> Data.Ndata[i] ;
 
+    PROF_FILE( file ) ;
     fclose( file ) ;
   }
 
@@ -303,6 +305,7 @@ read_distribution_old( struct input_params *Input )
       }
     }
     
+    PROF_FILE( file ) ;
     fclose( file ) ;
   }
 
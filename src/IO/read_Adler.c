@@ -7,6 +7,7 @@
 #include "GLU_bswap.h"
 #include "stats.h"
 #include "crc32c.h"
+#include "profile.h"
 
 static bool must_swap = false ;
 
@@ -89,6 +90,7 @@ pre_allocate( struct input_params *Input )
     Input -> Data.Ndata[i]  = Nmom ;
     Input -> Data.Ntot     += Input -> Data.Ndata[i] ;
     
+    PROF_FILE( file ) ;
     fclose(file) ;
   }
 
@@ -204,6 +206,7 @@ read_Adler( struct input_params *Input )
       }
 
       
+      PROF_FILE( file ) ;
       fclose( file ) ;
     }    
     shift += Input -> Data.Ndata[i] ;
@@ -9,6 +9,7 @@
 #include "resampled_ops.h"
 #include "sort.h"
 #include "stats.h"
+#include "profile.h"
 
 #define ALLR
 
@@ -96,6 +97,7 @@ init_GLU( struct input_params *Input )
     }
     Input -> Data.Ndata[i] = Nfilter ;
     Input -> Data.Ntot += Input -> Data.Ndata[i] ;
+    PROF_FILE( Infile ) ;
     fclose( Infile ) ;
   }
 
@@ -247,6 +249,7 @@ read_GLU( struct input_params *Input )
       idx++ ;
 
       free( filter ) ;
+      PROF_FILE( Infile ) ;
       fclose( Infile ) ;
     }
     
@@ -1,6 +1,7 @@
 #include "gens.h"
 #include "GLU_bswap.h"
 #include "resampled_ops.h"
+#include "profile.h"
 
 // read 32 bytes
 static int
@@ -62,6 +63,7 @@ pre_allocate( struct input_params *Input )
     Input -> Data.Ndata[i] = (size_t)Nmoments[0] ;
     Input -> Data.Ntot += Input -> Data.Ndata[i] ;
 
+    PROF_FILE( file ) ;
     fclose( file ) ;
   }
   
@@ -169,6 +171,7 @@ read_GLU_Qmoment( struct input_params *Input )
 	#endif
       }
 
+      PROF_FILE( file ) ;
       fclose( file ) ;
 
       meas ++ ;
@@ -6,6 +6,7 @@
 
 #include "GLU_bswap.h"
 #include "stats.h"
+#include "profile.h"
 
 static int
 init_GLU_tcorr( struct input_params *Input )
@@ -155,6 +156,7 @@ read_GLU_tcorr( struct input_params *Input )
       printf( "Closing file \n" ) ;
       #endif
       
+      PROF_FILE( Infile ) ;
       fclose( Infile ) ;
     }
     shift += Input -> Data.Ndata[i] ;
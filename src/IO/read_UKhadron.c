@@ -7,6 +7,7 @@
 #include "GLU_bswap.h"
 #include "resampled_ops.h"
 #include "tfold.h"
+#include "profile.h"
 
 // read 32 bytes
 static int
@@ -115,6 +116,7 @@ pre_allocate( struct input_params *Input ,
       Input -> Data.Ntot += LT ;
     }
     
+    PROF_FILE( file ) ;
     fclose( file ) ;
   }
 
@@ -208,6 +210,7 @@ get_correlator( double complex *C ,
   for( i = 0 ; i < LT ; i++ ) {
     C[ i ] += Ctmp[ i ] ;
   }
+  PROF_FILE( file ) ;
   fclose( file ) ;
   
   return SUCCESS ;
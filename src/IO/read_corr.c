@@ -9,6 +9,7 @@
 #include "GLU_bswap.h"
 #include "resampled_ops.h"
 #include "tfold.h"
+#include "profile.h"
 
 //#define VERBOSE
 
@@ -165,6 +166,7 @@ pre_allocate( struct input_params *Input )
     }
     Input -> Data.Ntot += Input -> Data.Ndata[i] ;
     
+    PROF_FILE( file ) ;
     fclose( file ) ;
   }
 
@@ -270,6 +272,7 @@ get_correlator( double complex *C ,
   for( i = 0 ; i < LT ; i++ ) {
     C[ i ] += Ctmp[ i ] ;
   }
+  PROF_FILE( file ) ;
   fclose( file ) ;
 
   free( Ctmp ) ;
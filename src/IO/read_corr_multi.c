@@ -9,6 +9,7 @@
 #include "GLU_bswap.h"
 #include "resampled_ops.h"
 #include "tfold.h"
+#include "profile.h"
 
 // do we have to byte swap?
 static bool must_swap = false ;
@@ -153,6 +154,7 @@ pre_allocate( struct input_params *Input ,
       break ;
     }
     
+    PROF_FILE( file ) ;
     fclose( file ) ;
   }
 
@@ -253,6 +255,7 @@ get_correlator( double complex *C ,
   for( i = 0 ; i < LT ; i++ ) {
     C[ i ] += Ctmp[ i ] ;
   }
+  PROF_FILE( file ) ;
   fclose( file ) ;
 
   free( Ctmp ) ;
@@ -14,6 +14,7 @@
 #include "gens.h"
 
 #include "stats.h"
+#include "profile.h"
 
 //#define VERBOSE
 
@@ -204,6 +205,7 @@ read_flat_double( struct input_params *Input ,
     #endif
   }
 
+  PROF_FILE( file ) ;
   fclose(file) ;
 
   return SUCCESS ;
@@ -244,6 +246,7 @@ init_data( struct input_params *Input )
     Input -> Data.Ndata[i] = Ndata[i] ;
     Input -> Data.Ntot += Ndata[i] ;
     
+    PROF_FILE( file ) ;
     fclose( file ) ;
   }
 
@@ -298,6 +301,7 @@ init_data( struct input_params *Input )
     }
     shift = j ;
 
+    PROF_FILE( file ) ;
     fclose( file ) ;
   }
   
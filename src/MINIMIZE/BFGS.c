@@ -50,8 +50,10 @@ BFGS_iter( void *fdesc ,
 
   // inverse hessian estimate for initial guess set for now to be the identity matrix
   double H[ Fit -> Nlogic ][ Fit -> Nlogic ] ;  
-  Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ;
-  Fit -> dF( Fit -> f.df , data , Fit -> f.fparams ) ;
+  // the data may have changed since we were last called
+  invalidate_ffunction( &Fit -> f ) ;
+  cached_F( Fit , &Fit -> f , data , 1 ) ;
+  cached_dF( Fit , &Fit -> f , data ) ;
 
   // array temporaries of gradients and things
   double grad[ Fit -> Nlogic ] , s[ Fit -> Nlogic ] , p[ Fit -> Nlogic ] ;
@@ -85,8 +87,8 @@ BFGS_iter( void *fdesc ,
       Fit -> f.fparams[i] += s[i] ;
     }
     // recompute gradients and put in y = \Del
-    Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ;
-    Fit -> dF( Fit -> f.df , data , Fit -> f.fparams ) ;
+    cached_F( Fit , &Fit -> f , data , 1 ) ;
+    cached_dF( Fit , &Fit -> f , data ) ;
     // get new descent direction (-grad hence all the fucking signs)
     get_gradient( y , W , Fit ) ;
 
@@ -30,8 +30,10 @@ cg_iter( void *fdesc ,
   f2.Prior = Fit -> f.Prior = Fit -> Prior ;
 
   // evaluate the function, and its first derivatives
-  Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ;
-  Fit -> dF( Fit -> f.df , data , Fit -> f.fparams ) ;
+  // the data may have changed since we were last called
+  invalidate_ffunction( &Fit -> f ) ;
+  cached_F( Fit , &Fit -> f , data , 1 ) ;
+  cached_dF( Fit , &Fit -> f , data ) ;
   Fit -> f.chisq = compute_chisq( Fit -> f , W , Fit -> f.CORRFIT ) ;
 
   // allocate conjugate directions and set s to descent direction "old_df"
@@ -48,8 +50,8 @@ cg_iter( void *fdesc ,
   double chisq_diff = 10 , chiprev = 123456789 , chinew ;
   while( sqrt(chisq_diff) > TOL && iters < CGMAX ) {
     // update f which has the gradient direction in
-    Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ;
-    Fit -> dF( Fit -> f.df , data , Fit -> f.fparams ) ;
+    cached_F( Fit , &Fit -> f , data , 1 ) ;
+    cached_dF( Fit , &Fit -> f , data ) ;
     chinew = Fit -> f.chisq = compute_chisq( Fit -> f , W , Fit -> f.CORRFIT ) ;
     chisq_diff = fabs( chinew - chiprev ) ;
     chiprev = chinew ;
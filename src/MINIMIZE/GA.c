@@ -31,6 +31,12 @@
    5/01/2017 - Compute the noise based on the s.d of the kept population, changed to a max and min of the population (decent idea but could do with tweaking)
 
    6/01/2017 - Made the mutation population smaller and tuned the ratio of NBREED to NCHILD for a standard use case, troubling how dependent on the initial population this thing is.
+
+   The population size, number of elites, parents, tournament draws,
+   mutation probability and noise come from the GA_* tags of the input
+   file, the defines below are the defaults. Chromosomes are bred and
+   mutated serially but their chisqs are computed in parallel with a
+   scratch residual per thread, and only the elites are sorted
  */
 #include "gens.h"
 
@@ -38,89 +44,112 @@
 
 #include "chisq.h"
 #include "ffunction.h"
+#include "GA.h"
 
 //#define VERBOSE
 
-#define NGEN (512) // number of generations in gene pool
-
-// number that persist from the previous generation
-#define NBREED (32) 
-
-// number of parents of a child
-#define NPARENTS (16)
-
-// number of draws for tournament selection
-#define NTOURNAMENT (12)
-
-// probability of mutation of the whole pop
-#define PMUTANT (0.7)
-
-// It turns out this one is very important!! WHY???
-#define NOISE (0.15) // guesses * gaussian of width NOISE to start our run
-
-// defaults to selection sort but can use insertion sort here too
-#define INSERTION_SORT
-
 // struct for holding our gene pool
 struct genes {
   double *g ;
   double chisq ;
-  size_t Nlogic ;
+  bool eval ; // does chisq need recomputing?
 } ;
 
-// struct for storing the standard deviation of each parameter
-struct sigma {
-  double *s ;
-} ;
+// just enough of an ffunction for compute_chisq, unlike
+// allocate_ffunction there are no derivative arrays
+static struct ffunction
+scratch_ffunction( const struct ffunction f )
+{
+  struct ffunction f2 = f ;
+  f2.f = malloc( f.N * sizeof( double ) ) ;
+  f2.df = NULL ; f2.d2f = NULL ; f2.U = NULL ;
+  return f2 ;
+}
 
-// compute the chi^2 of our fit functions
+// compute the chi^2 of a gene into our thread's scratch
 static double
-compute_chi( struct ffunction *f2 , 
-	     const struct ffunction f1 ,
+compute_chi( struct ffunction *f2 ,
 	     const struct fit_descriptor *fdesc ,
-	     const double *fparam ,
+	     double *fparam ,
 	     const void *data ,
 	     const double **W )
 {
-  // copy f1 to f2 our temporary fit function
-  copy_ffunction( f2 , f1 ) ;
+  f2 -> fparams = fparam ;
+  fdesc -> F( f2 -> f , data , fparam ) ;
+  const double chisq = compute_chisq( *f2 , W , f2 -> CORRFIT ) ;
+  // failed evaluations go to the back of the queue
+  return isfinite( chisq ) ? chisq : HUGE_VAL ;
+}
+
+// compute all the chisqs that need it in parallel
+static void
+evaluate_population( struct genes *G ,
+		     const size_t Npop ,
+		     const struct fit_descriptor *fdesc ,
+		     const void *data ,
+		     const double **W )
+{
   size_t i ;
-  for( i = 0 ; i < fdesc -> Nlogic ; i++ ) {
-    f2 -> fparams[i] = fparam[i] ;
+  #pragma omp parallel private(i)
+  {
+    struct ffunction f2 = scratch_ffunction( fdesc -> f ) ;
+    #pragma omp for schedule(dynamic,8)
+    for( i = 0 ; i < Npop ; i++ ) {
+      if( G[i].eval == true ) {
+	G[i].chisq = compute_chi( &f2 , fdesc , G[i].g , data , W ) ;
+	G[i].eval = false ;
+      }
+    }
+    free( f2.f ) ;
   }
-  fdesc -> F( f2 -> f , data , f2 -> fparams ) ;
-  return compute_chisq( *f2 , W , f2 -> CORRFIT ) ;
+  return ;
+}
+
+static inline void
+swap_genes( struct genes *a , struct genes *b )
+{
+  const struct genes t = *a ; *a = *b ; *b = t ;
 }
 
-// simple insertion sort is enough for small population which is
-// likely to be roughly sorted already
+// restore the max-heap property below idx for a heap of size N
 static void
-insertion_sort_GA( struct genes *G )
+sift_down( struct genes *G ,
+	   size_t idx ,
+	   const size_t N )
 {
-  size_t i , j , Nlogic = G -> Nlogic ;
-  double gtemp[ Nlogic ] , x ;
-  int hole ;
-  for( i = 1 ; i < NGEN ; i++ ) {
-    // set up the temporaries
-    x = G[i].chisq ;
-    for( j = 0 ; j < Nlogic ; j++ ) {
-      gtemp[j] = G[i].g[j] ;
-    }
-    // set the hole we will insert into
-    hole = (int)i - 1 ;
-    while( hole >= 0 && G[hole].chisq > x ) {
-      for( j = 0 ; j < Nlogic ; j++ ) {
-	G[ hole + 1 ].g[ j ] = G[ hole ].g[ j ] ;
-      }
-      G[ hole + 1 ].chisq = G[ hole ].chisq ;
-      
-      hole-- ;
+  size_t child ;
+  while( ( child = 2*idx+1 ) < N ) {
+    if( child+1 < N && G[child+1].chisq > G[child].chisq ) {
+      child++ ;
     }
-    // swap back
-    for( j = 0 ; j < Nlogic ; j++ ) {
-      G[hole+1].g[j] = gtemp[j] ;
+    if( G[idx].chisq >= G[child].chisq ) break ;
+    swap_genes( &G[idx] , &G[child] ) ;
+    idx = child ;
+  }
+}
+
+// put the Nbreed lowest chisqs sorted at the front of G, the rest are
+// left unordered. Only pointers are moved, never the genes themselves
+static void
+select_elites( struct genes *G ,
+	       const size_t Npop ,
+	       const size_t Nbreed )
+{
+  size_t i ;
+  // max-heap of the current best Nbreed
+  for( i = Nbreed/2 ; i-- > 0 ; ) {
+    sift_down( G , i , Nbreed ) ;
+  }
+  for( i = Nbreed ; i < Npop ; i++ ) {
+    if( G[i].chisq < G[0].chisq ) {
+      swap_genes( &G[0] , &G[i] ) ;
+      sift_down( G , 0 , Nbreed ) ;
     }
-    G[hole+1].chisq = x ;
+  }
+  // and heapsort them into ascending order
+  for( i = Nbreed ; i-- > 1 ; ) {
+    swap_genes( &G[0] , &G[i] ) ;
+    sift_down( G , 0 , i ) ;
   }
   return ;
 }
@@ -128,20 +157,16 @@ insertion_sort_GA( struct genes *G )
 #ifdef VERBOSE
 // print out the whole population
 static void
-print_population( struct genes *G )
+print_population( const struct genes *G ,
+		  const struct ga_info GA ,
+		  const size_t Nlogic )
 {
   printf( "\n" ) ;
   size_t i , j ;
   printf( "ELITES\n" ) ;
-  for( i = 0 ; i < NBREED ; i++ ) {
-    for( j = 0 ; j < G[i].Nlogic ; j++ ) {
-      printf( " %1.15e " , G[i].g[j] ) ;
-    }
-    printf( " :: %e \n" , G[i].chisq ) ;
-  }
-  printf( "RABBLE\n" ) ;
-  for( i = NBREED ; i < NGEN ; i++ ) {
-    for( j = 0 ; j < G[i].Nlogic ; j++ ) {
+  for( i = 0 ; i < GA.Npop ; i++ ) {
+    if( i == GA.Nbreed ) printf( "RABBLE\n" ) ;
+    for( j = 0 ; j < Nlogic ; j++ ) {
       printf( " %1.15e " , G[i].g[j] ) ;
     }
     printf( " :: %e \n" , G[i].chisq ) ;
@@ -151,16 +176,18 @@ print_population( struct genes *G )
 }
 #endif
 
-// perform simple selection
+// perform simple selection from the elites, the rest of the population
+// is being overwritten by children whose chisq is not known yet
 static size_t
 tournament_selection( const struct genes *G ,
+		      const struct ga_info GA ,
 		      gsl_rng *r )
 {
-  // select a bunch of NTOURNAMENT elements at random
-  size_t i , idx_best = gsl_rng_uniform_int( r , NGEN ) ;
+  // select a bunch of Ntournament elements at random
+  size_t i , idx_best = gsl_rng_uniform_int( r , GA.Nbreed ) ;
   double tbest = G[ idx_best ].chisq ;
-  for( i = 0 ; i < NTOURNAMENT ; i++ ) {
-    size_t idx = gsl_rng_uniform_int( r , NGEN ) ;
+  for( i = 0 ; i < GA.Ntournament ; i++ ) {
+    size_t idx = gsl_rng_uniform_int( r , GA.Nbreed ) ;
     if( G[ idx ].chisq < tbest ) {
       tbest = G[idx].chisq ;
       idx_best = idx ;
@@ -169,27 +196,17 @@ tournament_selection( const struct genes *G ,
   return idx_best ;
 }
 
-#ifdef NORMALISE_POP
-static void
-normalise_pop( struct genes *G )
+// default settings, overwritten by the GA_* input tags
+struct ga_info
+ga_defaults( void )
 {
-  size_t i ;
-  register double Nsum = 0.0 ;
-  for( i = 0 ; i < NGEN ; i++ ) {
-    Nsum += G[i].chisq ;
-  }
-  for( i = 0 ; i < NGEN ; i++ ) {
-    G[i].chisq /= Nsum ;
-  }
-  for( i = 1 ; i < NGEN ; i++ ) {
-    G[i].chisq += G[i-1].chisq ;
-  }
-  return ;
+  const struct ga_info GA = { NGEN , NBREED , NPARENTS , NTOURNAMENT ,
+			      PMUTANT , NOISE } ;
+  return GA ;
 }
-#endif
 
 // perform a minimisation using a genetic algorithm, parameters are 
-// at the top to be played around with. Does not use any derivative 
+// in Fit -> GA to be played around with. Does not use any derivative 
 // information!
 int
 ga_iter( void *fdesc ,
@@ -199,17 +216,21 @@ ga_iter( void *fdesc ,
 {
   // point to the fit descriptor struct
   struct fit_descriptor *Fit = (struct fit_descriptor*)fdesc ;
+  const struct ga_info GA = Fit -> GA ;
     
   if( Fit -> Nlogic == 0 ) return SUCCESS ; // do nothing
+
+  if( GA.Nbreed == 0 || GA.Nbreed > GA.Npop || GA.Nparents == 0 ) {
+    fprintf( stderr , "[GA] need 0 < GA_Breed (%zu) <= GA_Pop (%zu)"
+	     " and GA_Parents (%zu) > 0\n" , GA.Nbreed , GA.Npop ,
+	     GA.Nparents ) ;
+    return FAILURE ;
+  }
   
   // counters and max iterations GAMAX
   size_t iters = 0 , i , j ;
   const size_t GAMAX = 2000 ;
 
-  // allocate the fitfunction
-  struct ffunction f2 = allocate_ffunction( Fit -> Nlogic , 
-					    Fit -> f.N ) ;
-
   // get priors
   Fit -> f.Prior = Fit -> Prior ;
 
@@ -218,18 +239,19 @@ ga_iter( void *fdesc ,
   Fit -> f.chisq = compute_chisq( Fit -> f , W , Fit -> f.CORRFIT ) ;
 
 #ifdef VERBOSE
-  printf( "[GA] Using a population of %d \n" , NGEN ) ;
-  printf( "[GA] Keeping %d elites \n" , NBREED ) ;
+  printf( "[GA] Using a population of %zu \n" , GA.Npop ) ;
+  printf( "[GA] Keeping %zu elites \n" , GA.Nbreed ) ;
 #endif
   
-  // gene pool
+  // gene pool, in one block so it is cheap to set up
   struct genes *G = NULL ;
+  double *pool = NULL ;
   gsl_rng *r = NULL ;
 
-  G = malloc( NGEN * sizeof( struct genes ) ) ;
-  for( i = 0 ; i < NGEN ; i++ ) {
-    G[i].g = NULL ;
-    G[i].g = malloc( Fit -> Nlogic * sizeof( double ) ) ;
+  G = malloc( GA.Npop * sizeof( struct genes ) ) ;
+  pool = malloc( GA.Npop * Fit -> Nlogic * sizeof( double ) ) ;
+  for( i = 0 ; i < GA.Npop ; i++ ) {
+    G[i].g = pool + i * Fit -> Nlogic ;
   }
   
   // get a seed from urandom
@@ -237,6 +259,7 @@ ga_iter( void *fdesc ,
   FILE *urandom = fopen( "/dev/urandom" , "r" ) ;
   if( fread( &Seed , sizeof( Seed ) , 1 , urandom ) != 1 ) {
     fprintf( stderr , "[GA] urandom read failure! \n" ) ;
+    fclose( urandom ) ;
     goto memfree ;
   }
   fclose( urandom ) ;
@@ -247,10 +270,8 @@ ga_iter( void *fdesc ,
   gsl_rng_set( r , Seed ) ;
 
   // initialise the population as gaussian noise around initial
-  // guesses that are gaussian distibuted with sigma of NOISE
-  // defined at the top of the file
-  for( i = 0 ; i < NGEN ; i++ ) {
-    G[i].Nlogic = Fit -> Nlogic ;
+  // guesses that are gaussian distibuted with sigma of Noise
+  for( i = 0 ; i < GA.Npop ; i++ ) {
     for( j = 0 ; j < Fit -> Nlogic ; j++ ) {
       // if we have priors we use their errors like noise vectors
       if( Fit -> Prior[j].Initialised == true ) {
@@ -259,17 +280,18 @@ ga_iter( void *fdesc ,
 				  Fit -> Prior[j].Err ) ) ;
       } else {
 	G[i].g[j] = Fit -> f.fparams[j] * 
-	  ( 1 + gsl_ran_gaussian( r , NOISE ) ) ;
+	  ( 1 + gsl_ran_gaussian( r , GA.Noise ) ) ;
       }
     }
-    G[i].chisq = compute_chi( &f2 , Fit -> f , Fit , G[i].g , data , W ) ;
+    G[i].eval = true ;
   }
+  evaluate_population( G , GA.Npop , Fit , data , W ) ;
 
-  // sort by chisq
-  insertion_sort_GA( G ) ;
+  // elites to the front
+  select_elites( G , GA.Npop , GA.Nbreed ) ;
   
   #ifdef VERBOSE
-  print_population( G ) ;
+  print_population( G , GA , Fit -> Nlogic ) ;
   #endif
   
   // iterate the algorithm
@@ -278,29 +300,28 @@ ga_iter( void *fdesc ,
 	 iters < GAMAX &&
 	 G[0].chisq > TOL ) {
 
-    for( i = NBREED ; i < NGEN ; i++ ) {
-      size_t parent[ NPARENTS ] , k ;
-      for( k = 0 ; k < NPARENTS ; k++ ) {
-	parent[k] = tournament_selection( G , r ) ;
+    // breed into the new population with an average
+    for( i = GA.Nbreed ; i < GA.Npop ; i++ ) {
+      size_t parent[ GA.Nparents ] , k ;
+      for( k = 0 ; k < GA.Nparents ; k++ ) {
+	parent[k] = tournament_selection( G , GA , r ) ;
       }
-      // breed into the new population with an average
       for( j = 0 ; j < Fit -> Nlogic ; j++ ) {
 	G[i].g[j] = 0.0 ;
-	for( k = 0 ; k < NPARENTS ; k++ ) {
+	for( k = 0 ; k < GA.Nparents ; k++ ) {
 	  G[i].g[j] += G[ parent[k] ].g[j] ;
 	}
-        G[i].g[j] /= NPARENTS ;
+        G[i].g[j] /= GA.Nparents ;
       }
-      G[i].chisq = compute_chi( &f2 , Fit -> f , Fit , G[i].g , data , W ) ;
+      G[i].eval = true ;
     }
 
     // idea here is to reduce the noise as the algorithm progresses, this is heuristic
-    const double noise = NOISE/(1.+0.5*iters);
-    for( i = 0 ; i < NGEN ; i++ ) {
-      bool is_mutated = false ;
+    const double noise = GA.Noise/(1.+0.5*iters);
+    for( i = 0 ; i < GA.Npop ; i++ ) {
       for( j = 0 ; j < Fit -> Nlogic ; j++ ) {
-	if( gsl_rng_uniform( r ) < PMUTANT ) {
-	  is_mutated = true ;
+	if( gsl_rng_uniform( r ) < GA.Pmutant ) {
+	  G[i].eval = true ;
 	  // if we have prior information we use it
 	  if( Fit -> Prior[j].Initialised == true ) {
 	    G[i].g[j] = G[ i ].g[j] * 
@@ -310,16 +331,16 @@ ga_iter( void *fdesc ,
 	  }
 	}
       }
-      if( is_mutated ) { 
-	G[i].chisq = compute_chi( &f2 , Fit -> f , Fit , G[i].g , data , W ) ;
-      }
     }
 
-    // sort for the next breeding population
-    insertion_sort_GA( G ) ;
+    // children and mutants all at once
+    evaluate_population( G , GA.Npop , Fit , data , W ) ;
+
+    // select the next breeding population
+    select_elites( G , GA.Npop , GA.Nbreed ) ;
 
     // look for the population to be static to just end it
-    chisq_diff = fabs( G[0].chisq - G[NBREED-1].chisq ) ;
+    chisq_diff = fabs( G[0].chisq - G[GA.Nbreed-1].chisq ) ;
     
     iters++ ;
   }
@@ -332,6 +353,8 @@ ga_iter( void *fdesc ,
     #endif
   }
   Fit -> f.chisq = G[0].chisq ;
+  // leave f consistent with the best parameters
+  Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ;
   
   // best fit parameter will be in population 1
   if( iters == GAMAX ) {
@@ -346,16 +369,11 @@ ga_iter( void *fdesc ,
   
   // cleanse the gene pool
   if( G != NULL ) {
-    for( i = 0 ; i < NGEN ; i++ ) {
-      if( G[i].g != NULL ) {
-	free( G[i].g ) ;
-      }
-    }
     free( G ) ;
   }
-
-  // free the fitfunction
-  free_ffunction( &f2 , Fit -> Nlogic ) ;
+  if( pool != NULL ) {
+    free( pool ) ;
+  }
 
   // free the rng
   if( r != NULL ) {
@@ -11,32 +11,53 @@
 // LU decomp is faster but can't deal with singular values
 #define WITH_SVD
 
-// perform a generalised least squares iteration
-int
-gls_iter( void *fdesc ,
-	  const void *data ,
-	  const double **W ,
-	  const double TOL )
+// u^T W v
+double
+wdot( const double *u ,
+      const double *v ,
+      const double **W ,
+      const corrtype CORRFIT ,
+      const size_t N )
 {
-  // point to the fit function
-  struct fit_descriptor *Fit = (struct fit_descriptor*)fdesc ;
-
-  // check the matrix is there
-  if( Fit -> f.U == NULL ) {
-    fprintf( stderr , "[GLS] U matrix not initialised \n" ) ;
-    return FAILURE ;
+  register double sum = 0.0 ;
+  size_t i , j ;
+  switch( CORRFIT ) {
+  case UNWEIGHTED :
+    for( i = 0 ; i < N ; i++ ) {
+      sum += u[i] * v[i] ;
+    }
+    break ;
+  case UNCORRELATED :
+    for( i = 0 ; i < N ; i++ ) {
+      sum += u[i] * W[0][i] * v[i] ;
+    }
+    break ;
+  case CORRELATED :
+    for( i = 0 ; i < N ; i++ ) {
+      register double sumj = 0.0 ;
+      for( j = 0 ; j < N ; j++ ) {
+	sumj += W[i][j] * v[j] ;
+      }
+      sum += u[i] * sumj ;
+    }
+    break ;
   }
-  
-  // point at the data
-  struct data *Data = (struct data*)data ;
-
-  // set the priors
-  Fit -> f.Prior = Fit -> Prior ;
-
-  // number of poly coefficients is Nlogic
-  const size_t M = Fit -> f.N ;
-  const size_t N = Fit -> Nlogic ;
+  return sum ;
+}
 
+// solves ( U^T W U + Q ) x = U^T W y + Q x_prior for x where Q is the
+// diagonal matrix of inverse prior variances, U is given as its N
+// columns of length M. x is only written if the solve worked
+int
+gls_solve( double *x ,
+	   const double **U ,
+	   const double *y ,
+	   const double **W ,
+	   const corrtype CORRFIT ,
+	   const struct prior *Prior ,
+	   const size_t M ,
+	   const size_t N )
+{
   // gsl matrix allocations
   gsl_matrix *alpha = gsl_matrix_alloc( N , N ) ;
   gsl_vector *beta  = gsl_vector_alloc( N ) ;
@@ -49,58 +70,26 @@ gls_iter( void *fdesc ,
   gsl_vector *S     = gsl_vector_alloc( N ) ;
   gsl_vector *Work  = gsl_vector_alloc( N ) ;
 #endif
-  
-  // usual counters
-  size_t i , j , k , l ;
-  int Flag = SUCCESS ;
 
-  // get the matrix description of our x data
-  Fit -> linmat( Fit -> f.U , data , Fit -> N , Fit -> M , Fit -> Nlogic ) ;
+  size_t i , j ;
+  int Flag = SUCCESS ;
 
-#ifdef VERBOSE
-  // tell us what it looks like
-  for( i = 0 ; i < M ; i++ ) {
-    for( j = 0 ; j < N ; j++ ) {
-      printf( " %f " , Fit -> f.U[i][j] ) ;
-    }
-    printf( "\n" ) ;
-  }
-#endif
-  
-  // initialise alpha as (U^T W^-1 U + Q ) where Q is the diagonal matrix of prior errors
   for( i = 0 ; i < N ; i++ ) {
     for( j = i ; j < N ; j++ ) {
-      register double sum = 0.0 ;
-      for( k = 0 ; k < M ; k++ ) {
-	switch( Fit -> f.CORRFIT ) {
-	case UNWEIGHTED :
-	  sum += Fit -> f.U[k][i] * Fit -> f.U[k][j] ;
-	  break ;
-	case UNCORRELATED :
-	  sum += Fit -> f.U[k][i] * W[0][k] * Fit -> f.U[k][j] ;
-	  break ;
-	case CORRELATED :
-	  for( l = 0 ; l < M ; l++ ) {
-	    sum += Fit -> f.U[k][i] * W[k][l] * Fit -> f.U[l][j] ;
-	  }
-	  break ;
-	}
-      }
-      gsl_matrix_set( alpha , i , j , sum ) ;
-	
+      double sum = wdot( U[i] , U[j] , W , CORRFIT , M ) ;
       // add in the priors
-      if( i == j ) {
-	if( Fit -> f.Prior[i].Initialised == true ) {
-	  const double alpha_ii = gsl_matrix_get( alpha , i , i ) ;
-	  const double sigmasq  = Fit -> f.Prior[i].Err * Fit -> f.Prior[i].Err ;
-	  gsl_matrix_set( alpha , i , i ,
-			  ( 1.0 / sigmasq ) + alpha_ii ) ;
-	}
-      } else {
-	gsl_matrix_set( alpha , j , i , sum ) ;
+      if( i == j && Prior[i].Initialised == true ) {
+	sum += 1.0 / ( Prior[i].Err * Prior[i].Err ) ;
       }
-      //
+      gsl_matrix_set( alpha , i , j , sum ) ;
+      gsl_matrix_set( alpha , j , i , sum ) ;
     }
+    // beta == U^T W y with tikhonov regularisation for the priors
+    double sum = wdot( U[i] , y , W , CORRFIT , M ) ;
+    if( Prior[i].Initialised == true ) {
+      sum += Prior[i].Val / ( Prior[i].Err * Prior[i].Err ) ;
+    }
+    gsl_vector_set( beta , i , sum ) ;
   }
 
 #ifdef VERBOSE
@@ -113,32 +102,7 @@ gls_iter( void *fdesc ,
   }
 #endif
 
-  // compute beta == U^T W^-1 y with tikhonov regularisation for the priors
-  for( i = 0 ; i < N ; i++ ) {
-    register double sum = 0.0 ;
-    for( j = 0 ; j < M ; j++ ) {
-      switch( Fit -> f.CORRFIT  ) {
-      case UNWEIGHTED :
-	sum += Fit -> f.U[j][i] * Data -> y[j] ;
-	break ;
-      case UNCORRELATED :
-	sum += Fit -> f.U[j][i] * W[0][j] * Data -> y[j] ;
-	break ;
-      case CORRELATED :
-	for( l = 0 ; l < M ; l++ ) {
-	  sum += Fit -> f.U[j][i] * W[j][l] * Data -> y[l] ;
-	}
-	break ;
-      }
-    }
-    if( Fit -> f.Prior[i].Initialised == true ) {
-      sum += Fit -> f.Prior[i].Val / ( Fit -> f.Prior[i].Err * Fit -> f.Prior[i].Err ) ;
-    }
-    gsl_vector_set( beta , i , sum ) ;
-  }
-
 #ifdef WITH_SVD
-
   if( gsl_linalg_SV_decomp( alpha , Q , S , Work ) != GSL_SUCCESS ) {
     fprintf( stderr , "[GLS] SVD decomp failed\n" ) ;
     Flag = FAILURE ;
@@ -148,12 +112,7 @@ gls_iter( void *fdesc ,
       fprintf( stderr , "[GLS] SVD solve failed\n" ) ;
       Flag = FAILURE ;
     }
-    for( i = 0 ; i < N ; i++ ) {
-      Fit -> f.fparams[i] = gsl_vector_get( delta , i ) ;
-    }
   }
-  // else what?
-  
 #else
   // solves alpha[p][q] * delta( a[q] ) = beta[p] for delta
   int signum ;
@@ -166,18 +125,16 @@ gls_iter( void *fdesc ,
     if( gsl_linalg_LU_solve( alpha , perm , beta , delta ) != GSL_SUCCESS ) {
       fprintf( stderr , "[GLS] LU solve failure \n" ) ;
       Flag = FAILURE ;
-    } else {
-      // set the coefficients
-      for( i = 0 ; i < N ; i++ ) {
-        Fit -> f.fparams[i] = gsl_vector_get( delta , i ) ;
-      }
     }
   }
 #endif
 
-  // set the parameter "f" and compute the chisq
-  Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ;
-  Fit -> f.chisq = compute_chisq( Fit -> f , W , Fit -> f.CORRFIT ) ;
+  // set the coefficients
+  if( Flag != FAILURE ) {
+    for( i = 0 ; i < N ; i++ ) {
+      x[i] = gsl_vector_get( delta , i ) ;
+    }
+  }
 
   // free the gsl vectors
   gsl_vector_free( beta ) ;
@@ -191,6 +148,73 @@ gls_iter( void *fdesc ,
   gsl_vector_free( S ) ;
   gsl_vector_free( Work ) ;
 #endif
+
+  return Flag ;
+}
+
+// perform a generalised least squares iteration
+int
+gls_iter( void *fdesc ,
+	  const void *data ,
+	  const double **W ,
+	  const double TOL )
+{
+  // point to the fit function
+  struct fit_descriptor *Fit = (struct fit_descriptor*)fdesc ;
+
+  // check the matrix is there
+  if( Fit -> f.U == NULL ) {
+    fprintf( stderr , "[GLS] U matrix not initialised \n" ) ;
+    return FAILURE ;
+  }
+  
+  // point at the data
+  struct data *Data = (struct data*)data ;
+
+  // set the priors
+  Fit -> f.Prior = Fit -> Prior ;
+
+  // number of poly coefficients is Nlogic
+  const size_t M = Fit -> f.N ;
+  const size_t N = Fit -> Nlogic ;
+
+  // usual counters
+  size_t i , j ;
+
+  // get the matrix description of our x data
+  Fit -> linmat( Fit -> f.U , data , Fit -> N , Fit -> M , Fit -> Nlogic ) ;
+
+#ifdef VERBOSE
+  // tell us what it looks like
+  for( i = 0 ; i < M ; i++ ) {
+    for( j = 0 ; j < N ; j++ ) {
+      printf( " %f " , Fit -> f.U[i][j] ) ;
+    }
+    printf( "\n" ) ;
+  }
+#endif
+
+  // the solve wants the columns of U
+  double **Ucol = malloc( N * sizeof( double* ) ) ;
+  for( i = 0 ; i < N ; i++ ) {
+    Ucol[i] = malloc( M * sizeof( double ) ) ;
+    for( j = 0 ; j < M ; j++ ) {
+      Ucol[i][j] = Fit -> f.U[j][i] ;
+    }
+  }
+
+  const int Flag = gls_solve( Fit -> f.fparams , (const double**)Ucol ,
+			      Data -> y , W , Fit -> f.CORRFIT ,
+			      Fit -> f.Prior , M , N ) ;
+
+  for( i = 0 ; i < N ; i++ ) {
+    free( Ucol[i] ) ;
+  }
+  free( Ucol ) ;
+
+  // set the parameter "f" and compute the chisq
+  Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ;
+  Fit -> f.chisq = compute_chisq( Fit -> f , W , Fit -> f.CORRFIT ) ;
   
   return Flag ;
 }
@@ -8,6 +8,7 @@
 
 #include "chisq.h"
 #include "ffunction.h"
+#include "profile.h"
 #include "summation.h"
 #include <gsl/gsl_errno.h>
 
@@ -15,6 +16,13 @@
 // not using them makes the code run faster sometimes
 //#define WITH_D2_DERIVS
 
+// highest derivative we want F to fill while it is at it
+#ifdef WITH_D2_DERIVS
+  #define LM_ORDER (2)
+#else
+  #define LM_ORDER (1)
+#endif
+
 //#define VERBOSE
 #define LMSVD
 
@@ -206,8 +214,8 @@ lm_step( struct ffunction *f ,
   
   LM -> pred = loc_sumd + loc_sumB/2. ;
   
-  // compute new chisq
-  fdesc.F( f -> f , data , f -> fparams ) ;
+  // compute new chisq, with the derivatives if the model gets them for free
+  cached_F( &fdesc , f , data , LM_ORDER ) ;
   return compute_chisq( *f , W , f -> CORRFIT ) ;
 }
 
@@ -291,10 +299,11 @@ lm_iter( void *fdesc ,
   }
 
   // evaluate the function, its first and second derivatives
-  Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ;
-  Fit -> dF( Fit -> f.df , data , Fit -> f.fparams ) ;
+  invalidate_ffunction( &Fit -> f ) ;
+  cached_F( Fit , &Fit -> f , data , LM_ORDER ) ;
+  cached_dF( Fit , &Fit -> f , data ) ;
   #ifdef WITH_D2_DERIVS
-  Fit -> d2F( Fit -> f.d2f , data , Fit -> f.fparams ) ;
+  cached_d2F( Fit , &Fit -> f , data ) ;
   #endif
   Fit -> f.chisq = compute_chisq( Fit -> f , W , Fit -> f.CORRFIT ) ;
 
@@ -304,6 +313,8 @@ lm_iter( void *fdesc ,
   // loop until chisq evens out
   while( chisq_diff > TOL && iters < LMMAX ) {
 
+    PROF_COUNT( PROF_LM_ITERS , 1 ) ;
+
     const double new_chisq = lm_step( &Fit -> f , &LM , *Fit , 
 				      data , W , Lambda ) ;
 
@@ -321,17 +332,18 @@ lm_iter( void *fdesc ,
       for( i = 0 ; i < Fit -> Nlogic ; i++ ) {
 	LM.old_params[ i ] = Fit -> f.fparams[ i ] ;
       }
-      // update derivatives and alpha and beta
-      Fit -> dF( Fit -> f.df , data , Fit -> f.fparams ) ;
+      // update derivatives and alpha and beta, these are usually
+      // already cached from the F evaluation in lm_step
+      cached_dF( Fit , &Fit -> f , data ) ;
       #ifdef WITH_D2_DERIVS
-      Fit -> d2F( Fit -> f.d2f , data , Fit -> f.fparams ) ;
+      cached_d2F( Fit , &Fit -> f , data ) ;
       #endif
       get_alpha_beta( &LM , Fit -> f , W ) ;
     } else {
       for( i = 0 ; i < Fit -> Nlogic ; i++ ) {
 	Fit -> f.fparams[ i ] = LM.old_params[ i ] ;
       }
-      Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ; // reset f
+      cached_F( Fit , &Fit -> f , data , 0 ) ; // reset f
       Lambda *= Mfac ;
     }
 
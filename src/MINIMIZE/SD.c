@@ -38,8 +38,10 @@ sd_iter( void *fdesc ,
   
   // evaluate the function, its first and second derivatives
   f2.Prior = Fit -> f.Prior = Fit -> Prior ;
-  Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ;
-  Fit -> dF( Fit -> f.df , data , Fit -> f.fparams ) ;
+  // the data may have changed since we were last called
+  invalidate_ffunction( &Fit -> f ) ;
+  cached_F( Fit , &Fit -> f , data , 1 ) ;
+  cached_dF( Fit , &Fit -> f , data ) ;
   Fit -> f.chisq = compute_chisq( Fit -> f , W , Fit -> f.CORRFIT ) ;
   
   double chisq_diff = 10 , alpha = 1 ;;
@@ -52,8 +54,8 @@ sd_iter( void *fdesc ,
     for( i = 0 ; i < Fit -> Nlogic ; i++ ) {
       Fit -> f.fparams[i] += alpha*grad[i] ;
     }
-    Fit -> F( Fit -> f.f , data , Fit -> f.fparams ) ;
-    Fit -> dF( Fit -> f.df , data , Fit -> f.fparams ) ;
+    cached_F( Fit , &Fit -> f , data , 1 ) ;
+    cached_dF( Fit , &Fit -> f , data ) ;
     const double chi = compute_chisq( Fit -> f , W , Fit -> f.CORRFIT ) ;
     chisq_diff = fabs( chi - Fit -> f.chisq ) ;
     Fit -> f.chisq = chi ;
@@ -0,0 +1,379 @@
+/**
+   @file VarPro.c
+   @brief variable projection for fits linear in some of their parameters
+
+   The fit parameters are split into the linear ones "a" (amplitudes)
+   and the nonlinear ones "t" (energies). For fixed t the best a is
+   the solution of the same Tikhonov regularised GLS, gls_solve, so
+   we only need to iterate over t. The outer iteration is LM on the
+   reduced chisq, whose gauss-newton matrix is the schur complement
+   of the full one
+
+   S = H_tt - H_ta H_aa^{-1} H_at
+
+   (Kaufman's approximation). The columns of the design matrix are
+   the derivatives w.r.t. the linear parameters, so the model only
+   needs to say which of its parameters are linear via is_linear
+ */
+#include "gens.h"
+
+#include "chisq.h"
+#include "ffunction.h"
+#include "GLS.h"
+#include "LM.h"
+
+//#define VERBOSE
+
+// storage for the projection
+struct vpstep {
+  size_t *lin ; // logical indices of the linear parameters
+  size_t *nonlin ; // and of the nonlinear ones
+  size_t NL , NN ;
+  double *f0 ; // minus the residual at zero amplitudes
+  double *old_params ;
+  // linear subproblem
+  gsl_matrix *Haa ;
+  gsl_matrix *Va ;
+  gsl_vector *Sa ;
+  gsl_vector *worka ;
+  gsl_vector *ba ;
+  gsl_vector *xa ;
+  // reduced nonlinear problem
+  gsl_matrix *H ;
+  gsl_vector *g ;
+  gsl_matrix *Sred ;
+  gsl_matrix *Vn ;
+  gsl_vector *Sn ;
+  gsl_vector *workn ;
+  gsl_vector *gred ;
+  gsl_vector *delta ;
+} ;
+
+// solve A.x = b with the SVD, A gets overwritten
+static int
+svd_solve( gsl_matrix *A ,
+	   gsl_matrix *V ,
+	   gsl_vector *S ,
+	   gsl_vector *work ,
+	   const gsl_vector *b ,
+	   gsl_vector *x )
+{
+  if( gsl_linalg_SV_decomp( A , V , S , work ) != GSL_SUCCESS ) {
+    fprintf( stderr , "[VARPRO] SVD decomp failed\n" ) ;
+    return FAILURE ;
+  }
+  if( gsl_linalg_SV_solve( A , V , S , b , x ) != GSL_SUCCESS ) {
+    fprintf( stderr , "[VARPRO] SVD solve failed\n" ) ;
+    return FAILURE ;
+  }
+  return SUCCESS ;
+}
+
+// a logical parameter is linear only if every local parameter
+// mapped onto it is linear
+static int
+split_params( struct vpstep *VP ,
+	      const struct fit_descriptor *Fit ,
+	      const struct data *Data )
+{
+  const size_t N = Fit -> Nlogic ;
+  bool is_lin[ N ] , seen[ N ] ;
+  size_t i , j ;
+  for( i = 0 ; i < N ; i++ ) {
+    is_lin[ i ] = true ; seen[ i ] = false ;
+  }
+  for( i = 0 ; i < Data -> n ; i++ ) {
+    for( j = 0 ; j < Data -> Npars ; j++ ) {
+      const size_t p = Data -> map[i].p[j] ;
+      seen[ p ] = true ;
+      if( Fit -> is_linear( j ) == false ) {
+	is_lin[ p ] = false ;
+      }
+    }
+  }
+  VP -> lin    = malloc( N * sizeof( size_t ) ) ;
+  VP -> nonlin = malloc( N * sizeof( size_t ) ) ;
+  VP -> NL = VP -> NN = 0 ;
+  for( i = 0 ; i < N ; i++ ) {
+    if( is_lin[ i ] && seen[ i ] ) {
+      VP -> lin[ VP -> NL++ ] = i ;
+    } else {
+      VP -> nonlin[ VP -> NN++ ] = i ;
+    }
+  }
+  if( VP -> NL == 0 ) {
+    free( VP -> lin ) ;
+    free( VP -> nonlin ) ;
+    return FAILURE ;
+  }
+  return SUCCESS ;
+}
+
+static void
+init_VP( struct vpstep *VP ,
+	 const size_t Nlogic ,
+	 const size_t Ndata )
+{
+  const size_t NL = VP -> NL , NN = VP -> NN ;
+  VP -> f0 = malloc( Ndata * sizeof( double ) ) ;
+  VP -> old_params = malloc( Nlogic * sizeof( double ) ) ;
+  VP -> Haa   = gsl_matrix_alloc( NL , NL ) ;
+  VP -> Va    = gsl_matrix_alloc( NL , NL ) ;
+  VP -> Sa    = gsl_vector_alloc( NL ) ;
+  VP -> worka = gsl_vector_alloc( NL ) ;
+  VP -> ba    = gsl_vector_alloc( NL ) ;
+  VP -> xa    = gsl_vector_alloc( NL ) ;
+  VP -> H     = gsl_matrix_alloc( Nlogic , Nlogic ) ;
+  VP -> g     = gsl_vector_alloc( Nlogic ) ;
+  if( NN > 0 ) {
+    VP -> Sred  = gsl_matrix_alloc( NN , NN ) ;
+    VP -> Vn    = gsl_matrix_alloc( NN , NN ) ;
+    VP -> Sn    = gsl_vector_alloc( NN ) ;
+    VP -> workn = gsl_vector_alloc( NN ) ;
+    VP -> gred  = gsl_vector_alloc( NN ) ;
+    VP -> delta = gsl_vector_alloc( NN ) ;
+  }
+}
+
+static void
+free_VP( struct vpstep *VP )
+{
+  gsl_matrix_free( VP -> Haa ) ;
+  gsl_matrix_free( VP -> Va ) ;
+  gsl_vector_free( VP -> Sa ) ;
+  gsl_vector_free( VP -> worka ) ;
+  gsl_vector_free( VP -> ba ) ;
+  gsl_vector_free( VP -> xa ) ;
+  gsl_matrix_free( VP -> H ) ;
+  gsl_vector_free( VP -> g ) ;
+  if( VP -> NN > 0 ) {
+    gsl_matrix_free( VP -> Sred ) ;
+    gsl_matrix_free( VP -> Vn ) ;
+    gsl_vector_free( VP -> Sn ) ;
+    gsl_vector_free( VP -> workn ) ;
+    gsl_vector_free( VP -> gred ) ;
+    gsl_vector_free( VP -> delta ) ;
+  }
+  free( VP -> f0 ) ;
+  free( VP -> old_params ) ;
+  free( VP -> lin ) ;
+  free( VP -> nonlin ) ;
+}
+
+// for the current nonlinear parameters solve the GLS for the linear
+// ones, leaves f and df at the solution in Fit -> f and returns chisq
+static double
+vp_linear( struct vpstep *VP ,
+	   struct fit_descriptor *Fit ,
+	   const void *data ,
+	   const double **W )
+{
+  struct ffunction *f = &Fit -> f ;
+  const struct prior *Prior = f -> Prior ;
+  size_t i , j ;
+
+  // f at zero amplitude is the part of the model not multiplying
+  // the amplitudes and df_a are the columns of the design matrix U
+  for( i = 0 ; i < VP -> NL ; i++ ) {
+    f -> fparams[ VP -> lin[i] ] = 0.0 ;
+  }
+  cached_F( Fit , f , data , 1 ) ;
+  cached_dF( Fit , f , data ) ;
+  for( j = 0 ; j < f -> N ; j++ ) {
+    VP -> f0[j] = -f -> f[j] ;
+  }
+
+  // ( U^T W U + P ) a = U^T W f0 + P a_prior
+  const double *U[ VP -> NL ] ;
+  struct prior P[ VP -> NL ] ;
+  double a[ VP -> NL ] ;
+  for( i = 0 ; i < VP -> NL ; i++ ) {
+    U[i] = f -> df[ VP -> lin[i] ] ;
+    P[i] = Prior[ VP -> lin[i] ] ;
+  }
+  if( gls_solve( a , U , VP -> f0 , W , f -> CORRFIT ,
+		 P , f -> N , VP -> NL ) == FAILURE ) {
+    return NAN ;
+  }
+  for( i = 0 ; i < VP -> NL ; i++ ) {
+    f -> fparams[ VP -> lin[i] ] = a[i] ;
+  }
+
+  // f and df at the solution for the outer step
+  cached_F( Fit , f , data , 1 ) ;
+  cached_dF( Fit , f , data ) ;
+  return compute_chisq( *f , W , f -> CORRFIT ) ;
+}
+
+// full gauss-newton matrix and gradient with priors, reduced onto
+// the nonlinear parameters by the schur complement
+static int
+vp_reduce( struct vpstep *VP ,
+	   const struct ffunction *f ,
+	   const double **W )
+{
+  const struct prior *Prior = f -> Prior ;
+  size_t p , q , i , j ;
+  for( p = 0 ; p < f -> NPARAMS ; p++ ) {
+    double gp = wdot( f -> df[p] , f -> f , W , f -> CORRFIT , f -> N ) ;
+    if( Prior[p].Initialised == true ) {
+      gp += ( f -> fparams[p] - Prior[p].Val ) / ( Prior[p].Err * Prior[p].Err ) ;
+    }
+    gsl_vector_set( VP -> g , p , gp ) ;
+    for( q = p ; q < f -> NPARAMS ; q++ ) {
+      double hpq = wdot( f -> df[p] , f -> df[q] , W , f -> CORRFIT , f -> N ) ;
+      if( p == q && Prior[p].Initialised == true ) {
+	hpq += 1.0 / ( Prior[p].Err * Prior[p].Err ) ;
+      }
+      gsl_matrix_set( VP -> H , p , q , hpq ) ;
+      gsl_matrix_set( VP -> H , q , p , hpq ) ;
+    }
+  }
+
+  // decompose H_aa, the same matrix as in the linear solve
+  for( i = 0 ; i < VP -> NL ; i++ ) {
+    for( j = 0 ; j < VP -> NL ; j++ ) {
+      gsl_matrix_set( VP -> Haa , i , j ,
+		      gsl_matrix_get( VP -> H , VP -> lin[i] , VP -> lin[j] ) ) ;
+    }
+  }
+  if( gsl_linalg_SV_decomp( VP -> Haa , VP -> Va , VP -> Sa , VP -> worka ) != GSL_SUCCESS ) {
+    fprintf( stderr , "[VARPRO] SVD decomp failed\n" ) ;
+    return FAILURE ;
+  }
+
+  // S = H_tt - H_ta H_aa^{-1} H_at and g_red = g_t - H_ta H_aa^{-1} g_a
+  for( i = 0 ; i < VP -> NL ; i++ ) {
+    gsl_vector_set( VP -> ba , i , gsl_vector_get( VP -> g , VP -> lin[i] ) ) ;
+  }
+  gsl_linalg_SV_solve( VP -> Haa , VP -> Va , VP -> Sa , VP -> ba , VP -> xa ) ;
+  for( i = 0 ; i < VP -> NN ; i++ ) {
+    const size_t ni = VP -> nonlin[i] ;
+    register double sum = 0.0 ;
+    for( j = 0 ; j < VP -> NL ; j++ ) {
+      sum += gsl_matrix_get( VP -> H , ni , VP -> lin[j] ) * gsl_vector_get( VP -> xa , j ) ;
+    }
+    gsl_vector_set( VP -> gred , i , gsl_vector_get( VP -> g , ni ) - sum ) ;
+  }
+  for( j = 0 ; j < VP -> NN ; j++ ) {
+    const size_t nj = VP -> nonlin[j] ;
+    for( i = 0 ; i < VP -> NL ; i++ ) {
+      gsl_vector_set( VP -> ba , i , gsl_matrix_get( VP -> H , VP -> lin[i] , nj ) ) ;
+    }
+    gsl_linalg_SV_solve( VP -> Haa , VP -> Va , VP -> Sa , VP -> ba , VP -> xa ) ;
+    for( i = 0 ; i < VP -> NN ; i++ ) {
+      const size_t ni = VP -> nonlin[i] ;
+      register double sum = 0.0 ;
+      for( p = 0 ; p < VP -> NL ; p++ ) {
+	sum += gsl_matrix_get( VP -> H , ni , VP -> lin[p] ) * gsl_vector_get( VP -> xa , p ) ;
+      }
+      gsl_matrix_set( VP -> Sred , i , j , gsl_matrix_get( VP -> H , ni , nj ) - sum ) ;
+    }
+  }
+  return SUCCESS ;
+}
+
+// perform variable projection iterations
+int
+vp_iter( void *fdesc ,
+	 const void *data ,
+	 const double **W ,
+	 const double TOL )
+{
+  // point to the fit descriptor
+  struct fit_descriptor *Fit = (struct fit_descriptor*)fdesc ;
+  const struct data *Data = (const struct data*)data ;
+
+  // set maximum iterations
+  const size_t VPMAX = 5000 ;
+
+  double chisq_diff = 1E20 , Lambda = 1. ;
+  size_t iters = 0 , i ;
+
+  // lambda growth and shrinkage factors as in LM
+  const double Dfac = 10 , Mfac = 4 ;
+
+  // without linear parameters this is just LM
+  struct vpstep VP ;
+  if( Fit -> is_linear == NULL || split_params( &VP , Fit , Data ) == FAILURE ) {
+    fprintf( stderr , "[VARPRO] no linear parameters, falling back to LM\n" ) ;
+    return lm_iter( fdesc , data , W , TOL ) ;
+  }
+
+  // get priors
+  Fit -> f.Prior = Fit -> Prior ;
+  invalidate_ffunction( &Fit -> f ) ;
+
+  init_VP( &VP , Fit -> Nlogic , Fit -> f.N ) ;
+
+  Fit -> f.chisq = vp_linear( &VP , Fit , data , W ) ;
+
+  while( VP.NN > 0 && chisq_diff > TOL && iters < VPMAX ) {
+
+    if( vp_reduce( &VP , &Fit -> f , W ) == FAILURE ) {
+      iters = VPMAX ;
+      break ;
+    }
+
+    // LM step on the reduced problem
+    for( i = 0 ; i < VP.NN ; i++ ) {
+      gsl_matrix_set( VP.Sred , i , i ,
+		      ( 1.0 + Lambda ) * gsl_matrix_get( VP.Sred , i , i ) ) ;
+      gsl_vector_set( VP.gred , i , -gsl_vector_get( VP.gred , i ) ) ;
+    }
+    if( svd_solve( VP.Sred , VP.Vn , VP.Sn , VP.workn ,
+		   VP.gred , VP.delta ) == FAILURE ) {
+      iters = VPMAX ;
+      break ;
+    }
+
+    // trial nonlinear parameters and the linear ones that go with them
+    memcpy( VP.old_params , Fit -> f.fparams , Fit -> Nlogic * sizeof( double ) ) ;
+    for( i = 0 ; i < VP.NN ; i++ ) {
+      Fit -> f.fparams[ VP.nonlin[i] ] += gsl_vector_get( VP.delta , i ) ;
+    }
+    const double new_chisq = vp_linear( &VP , Fit , data , W ) ;
+
+    #ifdef VERBOSE
+    fprintf( stdout , "[VARPRO] chis :: %f %f %e \n" , new_chisq ,
+	     Fit -> f.chisq , fabs( Fit -> f.chisq - new_chisq ) ) ;
+    #endif
+
+    if( new_chisq <= Fit -> f.chisq ) {
+      Lambda /= Dfac ;
+      chisq_diff = fabs( Fit -> f.chisq - new_chisq ) ;
+      Fit -> f.chisq = new_chisq ;
+    } else {
+      // put back the old point, f and df are cheap to recover
+      memcpy( Fit -> f.fparams , VP.old_params , Fit -> Nlogic * sizeof( double ) ) ;
+      cached_F( Fit , &Fit -> f , data , 1 ) ;
+      cached_dF( Fit , &Fit -> f , data ) ;
+      Lambda *= Mfac ;
+    }
+
+    // if lambda misses a minimum tell us
+    if( Lambda < 1E-32 || Lambda > 1E32 ) {
+      fprintf( stderr , "[VARPRO] Lambda is out of bounds %e \n" , Lambda ) ;
+      iters = VPMAX ;
+      break ;
+    }
+    iters++ ;
+  }
+
+#ifdef VERBOSE
+  if( iters == VPMAX ) {
+    fprintf( stdout , "\n[VARPRO] stopped by max iterations %zu -> Chidiff %e\n" ,
+	     iters , chisq_diff ) ;
+  } else {
+    fprintf( stdout , "\n[VARPRO] FINISHED in %zu iterations \n" , iters ) ;
+  }
+  fprintf( stdout , "[VARPRO] chisq :: %e \n\n" , Fit -> f.chisq ) ;
+  for( i = 0 ; i < Fit -> Nlogic ; i++ ) {
+    fprintf( stdout , "PARAM_%zu :: %1.15e \n" , i , Fit -> f.fparams[i] ) ;
+  }
+#endif
+
+  free_VP( &VP ) ;
+
+  return iters ;
+}
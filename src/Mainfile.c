@@ -8,6 +8,7 @@
 #include "io_wrapper.h"
 
 #include "init.h"
+#include "profile.h"
 #include "read_inputs.h"
 
 #include "autocorr.h"
@@ -29,31 +30,41 @@ main( const int argc , const char *argv[] )
     return -1 ;
   }
 
-  printf( "Here \n" ) ;
+  // does nothing unless configured with --enable-PROFILE
+  PROF_INIT() ;
 
   // initially read the inputs
   struct input_params Input ;
+  PROF_START( read_inputs ) ;
   if( read_inputs( &Input , argv[2] ) == FAILURE ) {
     printf( "[INPUT] Input reading failed\n" ) ;
     goto free_failure ;
   }
+  PROF_STOP( read_inputs ) ;
+  PROF_TAG( "analysis" , Input.Analysis ) ;
 
   printf( "Input read \n" ) ;
 
   // choose the correct IO
+  PROF_START( io_wrap ) ;
   if( io_wrap( &Input ) == FAILURE ) {
     goto free_failure ;
   }
+  PROF_STOP( io_wrap ) ;
 
   // reweight the data
+  PROF_START( reweight ) ;
   if( reweight_data( &Input ) == FAILURE ) {
     goto free_failure ;
   }
+  PROF_STOP( reweight ) ;
 
   // bin the data we have read in
+  PROF_START( bin ) ;
   if( bin_data( &Input ) == FAILURE ) {
     goto free_failure ;
   }
+  PROF_STOP( bin ) ;
 
   // have a look at the time series if we have FFTW3
 #ifdef VIEW_AUTOCORR
@@ -76,14 +87,18 @@ main( const int argc , const char *argv[] )
 #endif
 
   // resample the data we have read in
+  PROF_START( resample ) ;
   if( resample_data( &Input ) == FAILURE ) {
     goto free_failure ;
   }
+  PROF_STOP( resample ) ;
 
   // need to set this after data has been read ...
+  PROF_START( an_wrapper ) ;
   if( an_wrapper( &Input ) == FAILURE ) {
     goto free_failure ;
   }
+  PROF_STOP( an_wrapper ) ;
   
  free_failure :
 
@@ -2,7 +2,10 @@
    @file cruel_runnings.c
    @brief running code for alpha_s using embedded cash-carp
 
-   This version is thread safe
+   This version is thread safe. The _array versions run many couplings
+   together in blocks of lanes with their own step sizes, and once
+   init_running_tables() has been called the running is read off a
+   tabulated solution of the flow instead of being integrated
  */
 #include "gens.h"
 
@@ -66,6 +69,25 @@ static const double ADAPTIVE_SAFE = 0.9 ;
 // adaptive error conserving
 #define ADAPTIVE_ERRCON pow( 5./ADAPTIVE_SAFE , 1./ADAPTIVE_GROWTH )
 
+// lanes we step together in the batched runner
+#define LANES (64)
+
+// the flow tables are on a grid of FLOW_H in t = log( mu^2 ) and cover
+// alpha in [FLOW_AMIN,FLOW_AMAX], FLOW_EPS is the tolerance used to build them
+#define FLOW_H (1./128.)
+#define FLOW_AMIN (0.05)
+#define FLOW_AMAX (0.8)
+#define FLOW_EPS (1E-14)
+
+// the solution of dalpha/dt = beta( alpha ) from alpha(0) = FLOW_AMAX
+// with h*dalpha/dt and h^2*d^2alpha/dt^2 for the quintic hermite
+// interpolation, N == 0 if it has not been built
+struct flow_table {
+  size_t N ;
+  double *a , *da , *d2a ;
+} ;
+static struct flow_table flow[ 7 ][ 6 ] ;
+
 // fmin and fmax functions for the adaptive
 static double adaptfmax( const double a , const double b ) { return ( b < a ? a : b ) ; }
 static double adaptfmin( const double a , const double b ) { return ( a < b ? a : b ) ; }
@@ -90,6 +112,52 @@ beta_function( const double alpha , const size_t nf , const size_t loops )
   return -alpha * alpha * ( beta[nf][0] + alpha * ( beta[nf][1] + alpha * ( beta[nf][2] + alpha * ( beta[nf][3] + alpha * beta[nf][4] ) ) ) ) ;
 }
 
+// beta function and its derivative, for the flow tables
+static void
+beta_derivs( double *b ,
+	     double *db ,
+	     const double alpha ,
+	     const size_t nf ,
+	     const size_t loops )
+{
+  const size_t L = loops < 1 ? 1 : ( loops > 5 ? 5 : loops ) ;
+  register double P = beta[nf][L-1] , dP = 0.0 ;
+  size_t l ;
+  for( l = L-1 ; l > 0 ; l-- ) {
+    dP = P + alpha * dP ;
+    P  = beta[nf][l-1] + alpha * P ;
+  }
+  *b  = -alpha * alpha * P ;
+  *db = -alpha * ( 2. * P + alpha * dP ) ;
+  return ;
+}
+
+// beta function of n lanes, same order of operations as beta_function
+static void
+beta_lanes( double *K ,
+	    const double *alpha ,
+	    const size_t nf ,
+	    const size_t loops ,
+	    const size_t n )
+{
+  const size_t L = loops < 1 ? 1 : ( loops > 5 ? 5 : loops ) ;
+  size_t i , l ;
+  for( i = 0 ; i < n ; i++ ) {
+    K[i] = beta[nf][L-1] ;
+  }
+  for( l = L-1 ; l > 0 ; l-- ) {
+    #pragma omp simd
+    for( i = 0 ; i < n ; i++ ) {
+      K[i] = beta[nf][l-1] + alpha[i] * K[i] ;
+    }
+  }
+  #pragma omp simd
+  for( i = 0 ; i < n ; i++ ) {
+    K[i] = -alpha[i] * alpha[i] * K[i] ;
+  }
+  return ;
+}
+
 // run with the RK4
 static double
 RK4_step( const double mu , double *alpha , 
@@ -122,6 +190,53 @@ RK4_adapt( const double mu , double *alpha ,
   return ;
 }
 
+// cash-karp attempt for n lanes each with their own step dlq[i]
+static void
+RK4_adapt_lanes( double *a1 ,
+		 double *err ,
+		 const double *alpha ,
+		 const double *dlq ,
+		 const size_t nf ,
+		 const size_t loops ,
+		 const size_t n )
+{
+  double K1[ LANES ] , K2[ LANES ] , K3[ LANES ] , K4[ LANES ] ;
+  double K5[ LANES ] , K6[ LANES ] , y[ LANES ] ;
+  size_t i ;
+  beta_lanes( K1 , alpha , nf , loops , n ) ;
+  #pragma omp simd
+  for( i = 0 ; i < n ; i++ ) {
+    y[i] = alpha[i] + dlq[i]*b21*K1[i] ;
+  }
+  beta_lanes( K2 , y , nf , loops , n ) ;
+  #pragma omp simd
+  for( i = 0 ; i < n ; i++ ) {
+    y[i] = alpha[i] + dlq[i]*(b31*K1[i] + b32*K2[i]) ;
+  }
+  beta_lanes( K3 , y , nf , loops , n ) ;
+  #pragma omp simd
+  for( i = 0 ; i < n ; i++ ) {
+    y[i] = alpha[i] + dlq[i]*(b41*K1[i] + b42*K2[i] + b43*K3[i]) ;
+  }
+  beta_lanes( K4 , y , nf , loops , n ) ;
+  #pragma omp simd
+  for( i = 0 ; i < n ; i++ ) {
+    y[i] = alpha[i] + dlq[i]*(b51*K1[i] + b52*K2[i] + b53*K3[i] + b54*K4[i]) ;
+  }
+  beta_lanes( K5 , y , nf , loops , n ) ;
+  #pragma omp simd
+  for( i = 0 ; i < n ; i++ ) {
+    y[i] = alpha[i] + dlq[i]*(b61*K1[i] + b62*K2[i] + b63*K3[i] + b64*K4[i] + b65*K5[i]) ;
+  }
+  beta_lanes( K6 , y , nf , loops , n ) ;
+  #pragma omp simd
+  for( i = 0 ; i < n ; i++ ) {
+    a1[i]  = alpha[i] + dlq[i]*( c1*K1[i] + c3*K3[i] + c4*K4[i] + c6*K6[i] ) ;
+    err[i] = dlq[i]*( dc1*K1[i] + dc3*K3[i] + dc4*K4[i] + dc5*K5[i] + dc6*K6[i] ) ;
+  }
+  return ;
+}
+
 // driver for the adaptive algorithm
 static double
 adaptive( const double mu , double *alpha ,
@@ -218,6 +333,156 @@ match_down_OS( const double Alpha_Ms ,
   return Alpha_Ms * ( 1.0 + Alpha_Ms * Alpha_Ms * ( h3_term + Alpha_Ms * ( h4_term + Alpha_Ms * h5_term ) ) ) ;
 }
 
+// quintic hermite on piece j of the table at s in [0,1], dp is the
+// derivative wrt s
+static double
+flow_hermite( const struct flow_table *F ,
+	      const size_t j ,
+	      const double s ,
+	      double *dp )
+{
+  const double v0 = F -> da[j] , w0 = F -> d2a[j] ;
+  const double D = F -> a[j+1] - F -> a[j] - v0 - 0.5 * w0 ;
+  const double E = F -> da[j+1] - v0 - w0 ;
+  const double G = F -> d2a[j+1] - w0 ;
+  const double c3 = 10. * D - 4. * E + 0.5 * G ;
+  const double c4 = -15. * D + 7. * E - G ;
+  const double c5 = 6. * D - 3. * E + 0.5 * G ;
+  *dp = v0 + s * ( w0 + s * ( 3. * c3 + s * ( 4. * c4 + s * 5. * c5 ) ) ) ;
+  return F -> a[j] + s * ( v0 + s * ( 0.5 * w0 + s * ( c3 + s * ( c4 + s * c5 ) ) ) ) ;
+}
+
+// running by dt = log( muprime^2 / mu^2 ) from the tables, FAILURE if
+// they have not been built or we would leave them
+static int
+flow_lookup( double *alpha_mup ,
+	     const double alpha ,
+	     const double dt ,
+	     const size_t nf ,
+	     const size_t loops )
+{
+  if( nf > 6 ) return FAILURE ;
+  const struct flow_table *F = &flow[ nf ][ loops < 1 ? 1 : ( loops > 5 ? 5 : loops ) ] ;
+  if( F -> N < 2 || !( alpha <= F -> a[0] && alpha >= F -> a[ F -> N-1 ] ) ) {
+    return FAILURE ;
+  }
+  // alpha decreases along the table, find a[j] >= alpha >= a[j+1]
+  size_t lo = 0 , hi = F -> N-2 ;
+  while( lo < hi ) {
+    const size_t mid = ( lo + hi + 1 )/2 ;
+    if( F -> a[ mid ] >= alpha ) {
+      lo = mid ;
+    } else {
+      hi = mid - 1 ;
+    }
+  }
+  // newton for where alpha sits in the piece
+  double s = ( F -> a[lo] - alpha )/( F -> a[lo] - F -> a[lo+1] ) , ds = 1.0 , dp ;
+  size_t iter ;
+  for( iter = 0 ; iter < 20 && fabs( ds ) > 1E-14 ; iter++ ) {
+    ds = ( flow_hermite( F , lo , s , &dp ) - alpha )/dp ;
+    s -= ds ;
+  }
+  // and read it off a distance dt further along
+  const double t = lo + s + dt / FLOW_H ;
+  if( !( t >= 0 && t <= F -> N-1 ) ) {
+    return FAILURE ;
+  }
+  const size_t j = (size_t)t < F -> N-2 ? (size_t)t : F -> N-2 ;
+  *alpha_mup = flow_hermite( F , j , t - j , &dp ) ;
+  return SUCCESS ;
+}
+
+// tabulate the flow from FLOW_AMAX down to FLOW_AMIN, cash-karp steps
+// with the step size carried over between the grid points
+static int
+build_flow( struct flow_table *F ,
+	    const size_t nf ,
+	    const size_t loops )
+{
+  size_t Nalloc = 1024 , j = 0 ;
+  F -> a   = malloc( Nalloc * sizeof( double ) ) ;
+  F -> da  = malloc( Nalloc * sizeof( double ) ) ;
+  F -> d2a = malloc( Nalloc * sizeof( double ) ) ;
+  double alpha = FLOW_AMAX , dlq = 0.01 ;
+  for(;;) {
+    if( j == Nalloc ) {
+      Nalloc *= 2 ;
+      F -> a   = realloc( F -> a   , Nalloc * sizeof( double ) ) ;
+      F -> da  = realloc( F -> da  , Nalloc * sizeof( double ) ) ;
+      F -> d2a = realloc( F -> d2a , Nalloc * sizeof( double ) ) ;
+    }
+    double b , db ;
+    beta_derivs( &b , &db , alpha , nf , loops ) ;
+    F -> a[j]   = alpha ;
+    F -> da[j]  = FLOW_H * b ;
+    F -> d2a[j] = FLOW_H * FLOW_H * b * db ;
+    j++ ;
+    if( alpha < FLOW_AMIN ) break ;
+    if( !isfinite( alpha ) || j > ( 1<<20 ) ) {
+      fprintf( stderr , "[RUNNING] flow table nf %zu loops %zu failed\n" ,
+	       nf , loops ) ;
+      return FAILURE ;
+    }
+    double t = 0.0 ;
+    while( t < FLOW_H ) {
+      const double h = adaptfmin( dlq , FLOW_H - t ) ;
+      double a1 = alpha , err ;
+      RK4_adapt( 0.0 , &a1 , nf , loops , h , &err ) ;
+      const double errmax = fabs( err ) / FLOW_EPS ;
+      if( errmax > 1.0 ) {
+	dlq = adaptfmax( ADAPTIVE_SAFE * h * pow( errmax , ADAPTIVE_SHRINK ) , 0.1 * h ) ;
+	continue ;
+      }
+      alpha = a1 ;
+      t += h ;
+      // only grow the step if it wasn't cut short by the grid
+      if( h == dlq ) {
+	dlq = errmax > ADAPTIVE_ERRCON ? ADAPTIVE_SAFE * h * pow( errmax , ADAPTIVE_GROWTH ) : ADAPTIVE_SAFE * 5.0 * h ;
+      }
+    }
+  }
+  F -> N = j ;
+  return SUCCESS ;
+}
+
+void
+free_running_tables( void )
+{
+  size_t nf , l ;
+  for( nf = 0 ; nf < 7 ; nf++ ) {
+    for( l = 0 ; l < 6 ; l++ ) {
+      free( flow[nf][l].a ) ;
+      free( flow[nf][l].da ) ;
+      free( flow[nf][l].d2a ) ;
+      flow[nf][l].a = flow[nf][l].da = flow[nf][l].d2a = NULL ;
+      flow[nf][l].N = 0 ;
+    }
+  }
+  return ;
+}
+
+// not thread safe, call it before any running is done in parallel
+int
+init_running_tables( void )
+{
+  free_running_tables( ) ;
+  size_t nf , l , Ntot = 0 ;
+  for( nf = 0 ; nf < 7 ; nf++ ) {
+    for( l = 1 ; l < 6 ; l++ ) {
+      if( build_flow( &flow[nf][l] , nf , l ) == FAILURE ) {
+	free_running_tables( ) ;
+	fprintf( stderr , "[RUNNING] falling back to integrating\n" ) ;
+	return FAILURE ;
+      }
+      Ntot += flow[nf][l].N ;
+    }
+  }
+  fprintf( stdout , "[RUNNING] flow tables for alpha in [%g,%g] , %zu points\n" ,
+	   FLOW_AMIN , FLOW_AMAX , Ntot ) ;
+  return SUCCESS ;
+}
+
 // run from scale mu to mu-prime
 double
 RUN( double mu ,
@@ -232,6 +497,11 @@ RUN( double mu ,
   double alpha_mup = alpha_mu ;
   int flag = 0 ;
 
+  if( flow_lookup( &alpha_mup , alpha_mu , 2.0 * log( muprime/mu ) ,
+		   nf , loops ) == SUCCESS ) {
+    return alpha_mup ;
+  }
+
   // perfectly sensible starting point
   double dlq = 0.01 ;
   while( mu < muprime ) {
@@ -252,6 +522,76 @@ RUN( double mu ,
   return alpha_mup ;
 }
 
+// RUN for n <= LANES couplings at once, the lanes step together but
+// each has its own step size and stops when it reaches muprime
+static void
+RUN_lanes( double *alpha ,
+	   const size_t n ,
+	   const double mu0 ,
+	   const double muprime ,
+	   const size_t nf ,
+	   const size_t loops )
+{
+  double mu[ LANES ] , dlq[ LANES ] , a1[ LANES ] , err[ LANES ] ;
+  bool integrate[ LANES ] , active[ LANES ] ;
+  const bool forwards = mu0 < muprime ;
+  size_t i , Nactive = 0 ;
+  for( i = 0 ; i < n ; i++ ) {
+    integrate[i] = flow_lookup( &alpha[i] , alpha[i] , 2.0 * log( muprime/mu0 ) ,
+				nf , loops ) == FAILURE ;
+    mu[i]  = mu0 ;
+    dlq[i] = forwards ? 0.01 : -0.01 ;
+    active[i] = integrate[i] && ( mu0 != muprime ) ;
+    Nactive += active[i] ;
+  }
+  while( Nactive > 0 ) {
+    RK4_adapt_lanes( a1 , err , alpha , dlq , nf , loops , n ) ;
+    Nactive = 0 ;
+    for( i = 0 ; i < n ; i++ ) {
+      if( active[i] == false ) continue ;
+      const double errmax = fabs( err[i] ) / ADAPTIVE_EPS ;
+      if( errmax > 1.0 ) {
+	// same shrinking as adaptive()
+	register const double del_temp = ADAPTIVE_SAFE * dlq[i] * pow( errmax , ADAPTIVE_SHRINK ) ;
+	register const double tol = 0.1 * dlq[i] ;
+	dlq[i] = ( 0.0 < del_temp ? adaptfmax( del_temp , tol ) : adaptfmin( del_temp , tol ) ) ;
+      } else {
+	alpha[i] = a1[i] ;
+	mu[i] *= exp( 0.5 * dlq[i] ) ;
+	dlq[i] = errmax > ADAPTIVE_ERRCON ? ADAPTIVE_SAFE * dlq[i] * pow( errmax , ADAPTIVE_GROWTH ) : ADAPTIVE_SAFE * 5.0 * dlq[i] ;
+	active[i] = forwards ? mu[i] < muprime : mu[i] > muprime ;
+      }
+      Nactive += active[i] ;
+    }
+  }
+  // final RK4 step to exactly muprime
+  for( i = 0 ; i < n ; i++ ) {
+    if( integrate[i] == false ) continue ;
+    register const double murat = muprime/mu[i] ;
+    RK4_step( mu[i] , &alpha[i] , nf , loops , 2.0 * log( murat ) , murat ) ;
+  }
+  return ;
+}
+
+// run N couplings from mu to muprime in place
+void
+RUN_array( double *alpha ,
+	   const size_t N ,
+	   const double mu ,
+	   const double muprime ,
+	   const size_t nf ,
+	   const size_t loops )
+{
+  const size_t Nblocks = ( N + LANES - 1 ) / LANES ;
+  size_t b ;
+#pragma omp parallel for private(b)
+  for( b = 0 ; b < Nblocks ; b++ ) {
+    const size_t n = ( b + 1 ) * LANES > N ? N - b * LANES : LANES ;
+    RUN_lanes( alpha + b * LANES , n , mu , muprime , nf , loops ) ;
+  }
+  return ;
+}
+
 // running from nf=3 to MZ matching at the charm
 // I want to automate this for many nfs
 double 
@@ -304,6 +644,28 @@ run_MZ_2nf4( const double alpha ,
   return RUN( MB , alpha_mup , mu , 4 , loops ) ;
 }
 
+// run_nf3_2MZ for N couplings at once, in place
+void
+run_nf3_2MZ_array( double *alpha ,
+		   const size_t N ,
+		   const double mu ,
+		   const size_t loops )
+{
+  size_t i ;
+  RUN_array( alpha , N , mu , MC , 3 , loops ) ;
+#pragma omp parallel for private(i)
+  for( i = 0 ; i < N ; i++ ) {
+    alpha[i] = match_up_OS( alpha[i] , MC , 4 , loops ) ;
+  }
+  RUN_array( alpha , N , MC , MB , 4 , loops ) ;
+#pragma omp parallel for private(i)
+  for( i = 0 ; i < N ; i++ ) {
+    alpha[i] = match_up_OS( alpha[i] , MB , 5 , loops ) ;
+  }
+  RUN_array( alpha , N , MB , MZ , 5 , loops ) ;
+  return ;
+}
+
 // run an nf=3 distribution to MZ
 struct resampled
 run_distribution_nf3_2MZ( struct resampled alpha ,
@@ -313,11 +675,16 @@ run_distribution_nf3_2MZ( struct resampled alpha ,
   struct resampled alpha_amz = init_dist( NULL , alpha.NSAMPLES ,
 					  alpha.restype ) ;
   
-  size_t i ;
-  for( i = 0 ; i < alpha.NSAMPLES ; i++ ) {
-    alpha_amz.resampled[i] = run_nf3_2MZ( alpha.resampled[i] , mu , loops ) ;
-  }
-  alpha_amz.avg = run_nf3_2MZ( alpha.avg , mu , loops ) ;
+  // samples and the average all run together
+  double *a = malloc( ( alpha.NSAMPLES + 1 ) * sizeof( double ) ) ;
+  memcpy( a , alpha.resampled , alpha.NSAMPLES * sizeof( double ) ) ;
+  a[ alpha.NSAMPLES ] = alpha.avg ;
+
+  run_nf3_2MZ_array( a , alpha.NSAMPLES + 1 , mu , loops ) ;
+
+  memcpy( alpha_amz.resampled , a , alpha.NSAMPLES * sizeof( double ) ) ;
+  alpha_amz.avg = a[ alpha.NSAMPLES ] ;
+  free( a ) ;
   compute_err( &alpha_amz ) ;
   
   return alpha_amz ;
@@ -334,7 +701,26 @@ test_running( void )
 
   alpha = run_MZ_2nf4( amz , 3.0 , 3 ) ;
   printf( "%f -> %f -> %f \n" , amz , alpha , run_nf4_2MZ( alpha , 2.0 , 4 ) ) ;
-  
+
+  // the hermite derivative against a central difference of the table
+  const double h = 1E-5 ;
+  size_t nf , l , j ;
+  for( nf = 0 ; nf < 7 ; nf++ ) {
+    for( l = 1 ; l < 6 ; l++ ) {
+      const struct flow_table *F = &flow[nf][l] ;
+      double maxdiff = 0.0 , dp , dpp , dpm ;
+      for( j = 0 ; j+1 < F -> N ; j++ ) {
+	flow_hermite( F , j , 0.5 , &dp ) ;
+	const double fd = ( flow_hermite( F , j , 0.5 + h , &dpp ) -
+			    flow_hermite( F , j , 0.5 - h , &dpm ) ) / ( 2 * h ) ;
+	maxdiff = fmax( maxdiff , fabs( dp - fd ) / fmax( fabs( fd ) , 1E-300 ) ) ;
+      }
+      if( F -> N > 1 ) {
+	printf( "[RUNNING] nf %zu loops %zu max |dp-fd|/|fd| %e\n" ,
+		nf , l , maxdiff ) ;
+      }
+    }
+  }
   return ;
 }
 
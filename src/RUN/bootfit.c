@@ -10,14 +10,13 @@
 
 #include "ffunction.h"
 #include "fit_chooser.h"
+#include "multistart.h"
+#include "profile.h"
 #include "resampled_ops.h"
 #include "stats.h"
 
 #include <gsl/gsl_cdf.h> // pvalue
 
-#include "fake.h"
-#include "fvol_delta_fitt0v2.h"
-
 // perform a single bootstrap fit to our data
 static int
 single_fit( struct resampled *fitparams ,
@@ -29,6 +28,7 @@ single_fit( struct resampled *fitparams ,
 	    const bool is_average )
 {
   if( Data.Ntot == 0 || fdesc.Nlogic == 0 ) return FAILURE ;
+  PROF_COUNT( PROF_FITS , 1 ) ;
   
   // initialise the data we will fit
   double yloc[ Data.Ntot ] , xloc[ Data.Ntot ] ;
@@ -46,8 +46,11 @@ single_fit( struct resampled *fitparams ,
     }
   }
   
+  // models with resampled external inputs get the ones for this sample
+  const void *Ctx = fdesc.ctx != NULL ? fdesc.ctx( sample_idx , is_average ) : NULL ;
+  if( fdesc.ctx != NULL && Ctx == NULL ) return FAILURE ;
   struct data d = { Data.Ntot , xloc , yloc , Data.LT ,
-		    fdesc.Nparam , Fit.map , Fit.N , Fit.M } ;
+		    fdesc.Nparam , Fit.map , Fit.N , Fit.M , Ctx } ;
 
   // set the data to the fit params average for a guess
   // guesses are either generated in the fit function or by
@@ -60,6 +63,12 @@ single_fit( struct resampled *fitparams ,
 	fdesc.f.fparams[j] = Fit.Guess[j] ;
       }
     }
+    // search around the guesses for the global minimum, the fit
+    // below then just polishes the winner. The bootstraps start
+    // from the result so they are warm-started from it too
+    if( Fit.Nstarts > 1 ) {
+      multistart_fit( fdesc.f.fparams , &d , Data , Fit ) ;
+    }
   } else {
     for( j = 0 ; j < fdesc.Nlogic ; j++ ) {
       fdesc.f.fparams[j] = fitparams[j].avg ;
@@ -91,11 +100,13 @@ single_fit( struct resampled *fitparams ,
   return Flag ;
 }	    
 
-// perform a fit over bootstraps
+// perform a fit over bootstraps, if chisq_dist is not NULL it is
+// handed the distribution of the chisq/dof which the caller frees
 struct resampled *
-perform_bootfit( const struct data_info Data ,
-		 const struct fit_info Fit ,
-		 double *Chi )
+perform_bootfit_dist( const struct data_info Data ,
+		      const struct fit_info Fit ,
+		      double *Chi ,
+		      struct resampled *chisq_dist )
 {
   // TODO :: sanity check all indices?
   if( Data.x[0].NSAMPLES != Data.y[0].NSAMPLES ) {
@@ -127,9 +138,6 @@ perform_bootfit( const struct data_info Data ,
 
   fprintf( stdout , "[FIT] single fit for the average\n" ) ;
   
-  //set_phi3v2( 0 , true ) ;
-  //fprintf( stdout , "[FIT] set phi3\n" ) ;
-  
   // do the average first
   single_fit( fitparams , &chisq , fdesc , Data , Fit , 0 , true ) ;
 
@@ -146,10 +154,6 @@ perform_bootfit( const struct data_info Data ,
     // loop boots
     #pragma omp for private(i) schedule(dynamic) nowait
     for( i = 0 ; i < chisq.NSAMPLES ; i++ ) {
-      
-      //fprintf( stdout , "%zu did \n" , i ) ;
-      //set_phi3v2( i , false ) ;
-      
       single_fit( fitparams , &chisq , fdesc_boot ,
 		  Data , Fit , i , false ) ;
     }
@@ -188,8 +192,10 @@ perform_bootfit( const struct data_info Data ,
   
  memfree :
 
-  // free the chisq
-  if( chisq.resampled != NULL ) {
+  // free the chisq or give it back
+  if( chisq_dist != NULL ) {
+    *chisq_dist = chisq ;
+  } else if( chisq.resampled != NULL ) {
     free( chisq.resampled ) ;
   }
   
@@ -198,3 +204,12 @@ perform_bootfit( const struct data_info Data ,
 
   return fitparams ;
 }
+
+// perform a fit over bootstraps
+struct resampled *
+perform_bootfit( const struct data_info Data ,
+		 const struct fit_info Fit ,
+		 double *Chi )
+{
+  return perform_bootfit_dist( Data , Fit , Chi , NULL ) ;
+}
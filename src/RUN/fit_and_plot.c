@@ -29,7 +29,7 @@ typedef enum { NO_ERROR , NTOT_FAIL ,
 	       LT_FAIL , CORRELATION_FAIL } prune_errflag ;
 
 // filter the data to lie within the fit range
-static bool *
+bool *
 filter( size_t *N ,
 	const struct data_info Data ,
 	const struct traj *Traj )
@@ -69,6 +69,7 @@ prune_data_for_fit( struct input_params *Input ,
   Data -> Cov.Eigenvalue_Tol = Input -> Data.Cov.Eigenvalue_Tol ;
   Data -> Cov.Column_Balanced = Input -> Data.Cov.Column_Balanced ;
   Data -> Cov.Divided_Covariance = Input -> Data.Cov.Divided_Covariance ;
+  Data -> Cov.Estimator = Input -> Data.Cov.Estimator ;
 
   Data -> Ndata = NULL ;
   Data -> x = NULL ;
@@ -195,9 +196,7 @@ fit_and_plot( struct input_params Input ,
 #endif
   
   // make the graph
-  make_xmgrace_graph( Input.Graph.Name ,
-		      Input.Graph.Xaxis ,
-		      Input.Graph.Yaxis ) ;
+  open_graph( Input.Graph ) ;
 
   size_t shift = 0 , i ;
   for( i = 0 ; i < Data.Nsim ; i++ ) {
@@ -223,12 +222,16 @@ fit_and_plot( struct input_params Input ,
 
   if( fitparams != NULL ) {
     double targets[9] = { 3 , 4 , 5 , 7, 10, 14, 18, 26.5 , 35 } ;
+    struct fit_curve C = init_fit_curve( fitparams , Data , Input.Fit , 0 ) ;
     for( int l = 0 ; l < 9 ; l++ ) {
-      fprintf( stdout , "(t0mk^2)^1/2 %f :: %f\n" , targets[l] ,
-	       bisect_fitfunc( fitparams , Data , Input.Fit ,
-			       Input.Traj[0].Fit_Low , targets[l] ,
-			       Input.Traj[0].Fit_High , 0 ) ) ;
+      struct resampled root = bisect_fit_curve( &C , Input.Traj[0].Fit_Low ,
+						targets[l] ,
+						Input.Traj[0].Fit_High ) ;
+      fprintf( stdout , "(t0mk^2)^1/2 %f :: %f %f\n" , targets[l] ,
+	       root.avg , root.err ) ;
+      free( root.resampled ) ;
     }
+    free_fit_curve( &C ) ;
   }
   
   close_xmgrace_graph( ) ;
@@ -270,9 +273,7 @@ fit_and_plot_and_Nint( struct input_params Input ,
   }
   
   // make the graph
-  make_xmgrace_graph( Input.Graph.Name ,
-		      Input.Graph.Xaxis ,
-		      Input.Graph.Yaxis ) ;
+  open_graph( Input.Graph ) ;
 
   size_t shift = 0 , i ;
   for( i = 0 ; i < Data.Nsim ; i++ ) {
@@ -0,0 +1,561 @@
+/**
+   @file fit_scan.c
+   @brief scan of the fit over a grid of fit windows
+
+   Every trajectory with a ScanWindow gets its (Fit_Low,Fit_High) looped
+   over a grid, the others keep their TrajFitr range. The covariance of
+   all of the data is computed once and the inverse of each window's
+   sub-block is updated from the previous window's one, the data is
+   never copied. Windows that only differ in the upper bound of the
+   first scanned trajectory form a chain that is run in order so that
+   each fit starts from the previous window's result and only adds a
+   few rows to the inverse.
+
+   Every window is fit with FitDef and any AverageModel, each (model,chain)
+   pair is a task and the tasks are handed out longest first to whichever
+   thread is free as their costs vary a lot. The fits are then combined
+   per bootstrap with weights exp(-AIC/2), AIC = chisq + 2 Nlogic + 2 Ncut
+   where Ncut is the number of data points outside the window, and the
+   spread of the fits about the average is quoted as a systematic
+ */
+#include "gens.h"
+
+#include "bootfit.h"
+#include "correlation.h"
+#include "fit_and_plot.h"
+#include "fit_chooser.h"
+#include "fit_scan.h"
+#include "incr_correlation.h"
+#include "init.h"
+#include "pmap.h"
+#include "resampled_ops.h"
+#include "stats.h"
+#include "write_flat.h"
+
+#include <gsl/gsl_cdf.h> // pvalue
+
+// result of the fit of one model over one window
+struct scan_result {
+  double *lo , *hi ; // the window for each trajectory
+  struct resampled *fitparams ;
+  struct resampled chisq ; // chisq/dof
+  size_t model , Ntot , Dof , Nlogic ;
+  double weight ; // AIC weight of the average
+  bool fitted ;
+} ;
+
+// a chain of windows for one model, the unit of work
+struct scan_task {
+  size_t model , chain ;
+  double cost ;
+} ;
+
+// most expensive first
+static int
+task_cmp( const void *a , const void *b )
+{
+  const struct scan_task *A = (const struct scan_task*)a ;
+  const struct scan_task *B = (const struct scan_task*)b ;
+  return A -> cost < B -> cost ? 1 : ( A -> cost > B -> cost ? -1 : 0 ) ;
+}
+
+// number of grid points from min to max inclusive
+static size_t
+Ngrid( const double min , const double max , const double step )
+{
+  return (size_t)( ( max - min ) / step + 1E-9 ) + 1 ;
+}
+
+// the trajectories with their fit ranges set to the windows lo and hi
+static void
+window_traj( struct traj *Traj ,
+	     const struct input_params *Input ,
+	     const double *lo ,
+	     const double *hi )
+{
+  size_t i ;
+  for( i = 0 ; i < Input -> Data.Nsim ; i++ ) {
+    Traj[i] = Input -> Traj[i] ;
+    Traj[i].Fit_Low  = lo[i] ;
+    Traj[i].Fit_High = hi[i] ;
+  }
+}
+
+// point Data at the entries of Input -> Data within the window, the
+// resampled arrays are shared and not copied
+static int
+window_data( struct data_info *Data ,
+	     struct incr_inverse *Inv ,
+	     const struct input_params *Input ,
+	     const double **C ,
+	     const double *lo ,
+	     const double *hi )
+{
+  size_t i , j , k = 0 , idx = 0 ;
+  struct traj Traj[ Input -> Data.Nsim ] ;
+  window_traj( Traj , Input , lo , hi ) ;
+  *Data = Input -> Data ;
+  bool *in_fitrange = filter( &Data -> Ntot , Input -> Data , Traj ) ;
+  Data -> Ndata = malloc( Data -> Nsim * sizeof( size_t ) ) ;
+  Data -> x = malloc( ( Data -> Ntot + 1 ) * sizeof( struct resampled ) ) ;
+  Data -> y = malloc( ( Data -> Ntot + 1 ) * sizeof( struct resampled ) ) ;
+  Data -> LT = NULL ;
+  Data -> Cov.W = NULL ;
+  for( i = 0 ; i < Data -> Nsim ; i++ ) {
+    Data -> Ndata[i] = 0 ;
+    for( j = 0 ; j < Input -> Data.Ndata[i] ; j++ ) {
+      if( in_fitrange[ k ] == true ) {
+	Data -> x[ idx ] = Input -> Data.x[ k ] ;
+	Data -> y[ idx ] = Input -> Data.y[ k ] ;
+	Data -> Ndata[i]++ ; idx++ ;
+      }
+      k++ ;
+    }
+  }
+  int Flag = FAILURE ;
+  if( Data -> Ntot != 0 && init_LT( Data , Input -> Traj ) != FAILURE ) {
+    Flag = incr_inverse_correlation( Data , Inv , C , in_fitrange ,
+				     Input -> Fit.Corrfit ) ;
+  }
+  free( in_fitrange ) ;
+  return Flag ;
+}
+
+// only free what window_data allocated
+static void
+free_window( struct data_info *Data ,
+	     const corrtype Corrfit )
+{
+  free( Data -> x ) ;
+  free( Data -> y ) ;
+  free( Data -> Ndata ) ;
+  if( Data -> LT != NULL ) {
+    free( Data -> LT ) ;
+  }
+  free_covariance( Data -> Cov.W , Data -> Ntot , Corrfit ) ;
+  return ;
+}
+
+// decode window number c into lo and hi, the upper bound of trajectory
+// tc runs fastest so that consecutive windows are neighbours
+static void
+decode_window( double *lo ,
+	       double *hi ,
+	       size_t c ,
+	       const size_t tc ,
+	       const size_t *Nlo ,
+	       const size_t *Nhi ,
+	       const struct input_params *Input )
+{
+  const struct scan_window *S = Input -> Fit.Scan ;
+  size_t i ;
+  for( i = 0 ; i < Input -> Data.Nsim ; i++ ) {
+    lo[i] = Input -> Traj[i].Fit_Low ;
+    hi[i] = Input -> Traj[i].Fit_High ;
+  }
+  if( S[tc].Initialised == true ) {
+    hi[tc] = S[tc].High_Min + ( c % Nhi[tc] ) * S[tc].Step ;
+  }
+  c /= Nhi[tc] ;
+  for( i = 0 ; i < Input -> Data.Nsim ; i++ ) {
+    if( S[i].Initialised == false ) continue ;
+    lo[i] = S[i].Low_Min + ( c % Nlo[i] ) * S[i].Step ;
+    c /= Nlo[i] ;
+    if( i != tc ) {
+      hi[i] = S[i].High_Min + ( c % Nhi[i] ) * S[i].Step ;
+      c /= Nhi[i] ;
+    }
+  }
+  return ;
+}
+
+// fit info for one of the extra models, priors on the parameters of
+// the first trajectory are kept and the guesses come from the model
+static struct fit_info
+model_fit( const struct fit_info Base ,
+	   const struct model_info Model ,
+	   const size_t Nsim )
+{
+  struct fit_info Fit = Base ;
+  size_t k , Ncommon = 0 ;
+  Fit.Fitdef = Model.Fitdef ;
+  Fit.N = Model.N ;
+  Fit.M = Model.M ;
+  Fit.Nparam = get_Nparam( Fit ) ;
+  Fit.Sims = malloc( Fit.Nparam * sizeof( bool ) ) ;
+  for( k = 0 ; k < Fit.Nparam ; k++ ) {
+    Fit.Sims[k] = ( k < Base.Nparam ) ? Base.Sims[k] : false ;
+    Ncommon += Fit.Sims[k] ;
+  }
+  Fit.Nlogic = Nsim * ( Fit.Nparam - Ncommon ) + Ncommon ;
+  Fit.Prior = malloc( Fit.Nlogic * sizeof( struct prior ) ) ;
+  Fit.Guess = malloc( Fit.Nlogic * sizeof( double ) ) ;
+  Fit.Guesses_Initialised = false ;
+  Fit.Nprior = 0 ;
+  for( k = 0 ; k < Fit.Nlogic ; k++ ) {
+    Fit.Guess[k] = UNINIT_FLAG ;
+    Fit.Prior[k].Initialised = false ;
+    Fit.Prior[k].Val = Fit.Prior[k].Err = UNINIT_FLAG ;
+    if( k < Fit.Nparam && k < Base.Nparam &&
+	Base.Prior[k].Initialised == true ) {
+      Fit.Prior[k] = Base.Prior[k] ;
+      Fit.Nprior++ ;
+    }
+  }
+  Fit.Models = NULL ;
+  Fit.Nmodels = 0 ;
+  Fit.map = NULL ;
+  return Fit ;
+}
+
+// fit all of the windows of one chain for one model
+static void
+fit_chain( struct scan_result *res ,
+	   const struct input_params *Input ,
+	   const struct fit_info Model ,
+	   const double **C ,
+	   const size_t first ,
+	   const size_t last )
+{
+  const size_t Nlogic = Model.Nlogic ;
+  struct fit_info Fit = Model ;
+  struct incr_inverse Inv ;
+  size_t c , j ;
+
+  init_incr_inverse( &Inv , Input -> Data.Ntot ) ;
+
+  // each chain carries its own guesses along
+  Fit.Guess = malloc( Nlogic * sizeof( double ) ) ;
+  for( j = 0 ; j < Nlogic ; j++ ) {
+    Fit.Guess[j] = Model.Guess[j] ;
+  }
+
+  for( c = first ; c < last ; c++ ) {
+    struct data_info Data ;
+    bool valid = true ;
+    for( j = 0 ; j < Input -> Data.Nsim ; j++ ) {
+      valid = valid && ( res[c].lo[j] < res[c].hi[j] ) ;
+    }
+    if( valid == false ) continue ;
+
+    if( window_data( &Data , &Inv , Input ,
+		     C , res[c].lo , res[c].hi ) == FAILURE ||
+	Data.Ntot + Fit.Nprior <= Nlogic ) {
+      free_window( &Data , Fit.Corrfit ) ;
+      continue ;
+    }
+
+    Fit.map = parammap( Data , Fit ) ;
+    double chi = 0.0 ;
+    struct resampled *fitparams =
+      perform_bootfit_dist( Data , Fit , &chi , &res[c].chisq ) ;
+    if( fitparams != NULL ) {
+      bool finite = isfinite( chi ) ;
+      for( j = 0 ; j < Nlogic ; j++ ) {
+	finite = finite && isfinite( fitparams[j].avg ) ;
+      }
+      res[c].fitparams = fitparams ;
+      res[c].Ntot = Data.Ntot ;
+      res[c].Dof = Data.Ntot - Nlogic + Fit.Nprior ;
+      res[c].Nlogic = Nlogic ;
+      res[c].fitted = finite ;
+      // warm start the next window in the chain
+      if( finite == true ) {
+	for( j = 0 ; j < Nlogic ; j++ ) {
+	  Fit.Guess[j] = fitparams[j].avg ;
+	}
+	Fit.Guesses_Initialised = true ;
+      }
+    }
+    free_pmap( Fit.map , Data.Ntot ) ;
+    free_window( &Data , Fit.Corrfit ) ;
+  }
+  free_incr_inverse( &Inv ) ;
+  free( Fit.Guess ) ;
+  return ;
+}
+
+// akaike information criterion of a fit for sample idx or the
+// average if idx is the number of samples
+static double
+AIC( const struct scan_result R ,
+     const size_t idx ,
+     const size_t Nfull )
+{
+  const double chi = idx < R.chisq.NSAMPLES ?
+    R.chisq.resampled[idx] : R.chisq.avg ;
+  const double chisq = R.Dof != 0 ? chi * R.Dof : chi ;
+  return chisq + 2.0 * R.Nlogic + 2.0 * ( Nfull - R.Ntot ) ;
+}
+
+// normalised exp(-AIC/2) weights of all the fits for sample idx
+static void
+AIC_weights( double *w ,
+	     const struct scan_result *res ,
+	     const size_t Nres ,
+	     const size_t idx ,
+	     const size_t Nfull )
+{
+  double min = HUGE_VAL , sum = 0.0 ;
+  size_t f ;
+  for( f = 0 ; f < Nres ; f++ ) {
+    w[f] = res[f].fitted ? AIC( res[f] , idx , Nfull ) : HUGE_VAL ;
+    if( w[f] < min ) min = w[f] ;
+  }
+  for( f = 0 ; f < Nres ; f++ ) {
+    w[f] = isfinite( w[f] ) ? exp( -0.5 * ( w[f] - min ) ) : 0.0 ;
+    sum += w[f] ;
+  }
+  for( f = 0 ; f < Nres ; f++ ) {
+    w[f] /= sum ;
+  }
+  return ;
+}
+
+// average the first Navg parameters over all the fits, the weights are
+// recomputed for every bootstrap so their fluctuations are included
+static void
+model_average( struct scan_result *res ,
+	       const size_t Nres ,
+	       const size_t Navg ,
+	       const size_t Nfull )
+{
+  size_t f , k , b , first = Nres ;
+  for( f = 0 ; f < Nres ; f++ ) {
+    if( res[f].fitted == true ) {
+      first = f ;
+      break ;
+    }
+  }
+  if( first == Nres ) return ;
+
+  const size_t NSAMPLES = res[first].chisq.NSAMPLES ;
+  double *w = malloc( Nres * sizeof( double ) ) ;
+  struct resampled *ave = malloc( Navg * sizeof( struct resampled ) ) ;
+  for( k = 0 ; k < Navg ; k++ ) {
+    ave[k] = init_dist( NULL , NSAMPLES , res[first].chisq.restype ) ;
+    ave[k].avg = 0.0 ;
+    for( b = 0 ; b < NSAMPLES ; b++ ) {
+      ave[k].resampled[b] = 0.0 ;
+    }
+  }
+
+  for( b = 0 ; b < NSAMPLES ; b++ ) {
+    AIC_weights( w , res , Nres , b , Nfull ) ;
+    for( f = 0 ; f < Nres ; f++ ) {
+      if( w[f] == 0.0 ) continue ;
+      for( k = 0 ; k < Navg ; k++ ) {
+	ave[k].resampled[b] += w[f] * res[f].fitparams[k].resampled[b] ;
+      }
+    }
+  }
+
+  // weights of the central values are the ones we report
+  AIC_weights( w , res , Nres , NSAMPLES , Nfull ) ;
+  for( f = 0 ; f < Nres ; f++ ) {
+    res[f].weight = w[f] ;
+    if( w[f] == 0.0 ) continue ;
+    for( k = 0 ; k < Navg ; k++ ) {
+      ave[k].avg += w[f] * res[f].fitparams[k].avg ;
+    }
+  }
+
+  for( k = 0 ; k < Navg ; k++ ) {
+    double sys = 0.0 ;
+    for( f = 0 ; f < Nres ; f++ ) {
+      if( w[f] == 0.0 ) continue ;
+      const double diff = res[f].fitparams[k].avg - ave[k].avg ;
+      sys += w[f] * diff * diff ;
+    }
+    sys = sqrt( sys ) ;
+    compute_err( &ave[k] ) ;
+    fprintf( stdout , "[AVERAGE] PARAM_%zu %e stat %e sys %e total %e\n" ,
+	     k , ave[k].avg , ave[k].err , sys ,
+	     sqrt( ave[k].err * ave[k].err + sys * sys ) ) ;
+    char str[ 256 ] ;
+    sprintf( str , "%s_p%zu.flat" , AVERAGE_FILE , k ) ;
+    write_flat_single( &ave[k] , str ) ;
+    free( ave[k].resampled ) ;
+  }
+  free( ave ) ;
+  free( w ) ;
+  return ;
+}
+
+// one row per fitted window, Nlogic is that of the largest model
+static void
+write_scan( const struct scan_result *res ,
+	    const size_t Nres ,
+	    const size_t Nsim ,
+	    const size_t Nlogic )
+{
+  FILE *file = fopen( SCAN_FILE , "w" ) ;
+  size_t c , i ;
+  if( file == NULL ) {
+    fprintf( stderr , "[SCAN] cannot open %s\n" , SCAN_FILE ) ;
+    return ;
+  }
+  fprintf( file , "# model" ) ;
+  for( i = 0 ; i < Nsim ; i++ ) {
+    fprintf( file , " Low_%zu High_%zu" , i , i ) ;
+  }
+  fprintf( file , " Ntot Dof chisq/dof pvalue weight" ) ;
+  for( i = 0 ; i < Nlogic ; i++ ) {
+    fprintf( file , " PARAM_%zu ERR_%zu" , i , i ) ;
+  }
+  fprintf( file , "\n" ) ;
+  for( c = 0 ; c < Nres ; c++ ) {
+    if( res[c].fitted == false ) continue ;
+    fprintf( file , "%zu " , res[c].model ) ;
+    for( i = 0 ; i < Nsim ; i++ ) {
+      fprintf( file , "%f %f " , res[c].lo[i] , res[c].hi[i] ) ;
+    }
+    const double chi = res[c].chisq.avg ;
+    const double pvalue = res[c].Dof == 0 ? 1.0 :
+      1 - gsl_cdf_chisq_P( res[c].Dof * chi , res[c].Dof ) ;
+    fprintf( file , "%zu %zu %e %f %e" , res[c].Ntot , res[c].Dof ,
+	     chi , pvalue , res[c].weight ) ;
+    for( i = 0 ; i < res[c].Nlogic ; i++ ) {
+      fprintf( file , " %e %e" , res[c].fitparams[i].avg ,
+	       res[c].fitparams[i].err ) ;
+    }
+    // models with fewer parameters are padded to line up with the header
+    for( ; i < Nlogic ; i++ ) {
+      fprintf( file , " nan nan" ) ;
+    }
+    fprintf( file , "\n" ) ;
+  }
+  fclose( file ) ;
+  fprintf( stdout , "[SCAN] results written to %s\n" , SCAN_FILE ) ;
+  return ;
+}
+
+// fit every model to every window in the grid, write the results to
+// one table and average over them
+int
+fit_scan( struct input_params *Input )
+{
+  const size_t Nsim = Input -> Data.Nsim , Nmodel = 1 + Input -> Fit.Nmodels ;
+  const struct scan_window *S = Input -> Fit.Scan ;
+  size_t Nlo[ Nsim ] , Nhi[ Nsim ] , Nwin = 1 , tc = 0 , i , m ;
+  bool found = false ;
+  int flag = FAILURE ;
+
+  if( Input -> Fit.Fitdef == NOFIT ) {
+    fprintf( stderr , "[SCAN] need a fit function to scan over\n" ) ;
+    return FAILURE ;
+  }
+
+  for( i = 0 ; i < Nsim ; i++ ) {
+    Nlo[i] = Nhi[i] = 1 ;
+    if( S[i].Initialised == true ) {
+      Nlo[i] = Ngrid( S[i].Low_Min , S[i].Low_Max , S[i].Step ) ;
+      Nhi[i] = Ngrid( S[i].High_Min , S[i].High_Max , S[i].Step ) ;
+      if( found == false ) {
+	tc = i ; found = true ;
+      }
+    }
+    Nwin *= Nlo[i] * Nhi[i] ;
+  }
+  if( found == false ) {
+    fprintf( stderr , "[SCAN] no ScanWindow given, fitting TrajFitr only\n" ) ;
+  }
+  const size_t Nchain = Nwin / Nhi[tc] , Nres = Nmodel * Nwin ;
+  fprintf( stdout , "[SCAN] %zu windows in %zu chains for %zu models\n" ,
+	   Nwin , Nchain , Nmodel ) ;
+
+  // shared covariance, each window takes its own sub-block
+  double **C = NULL ;
+  if( full_covariance( &C , Input -> Data , Input -> Fit.Corrfit ) == FAILURE ) {
+    fprintf( stderr , "[SCAN] covariance of the data failed\n" ) ;
+    return FAILURE ;
+  }
+
+  // the models, the first is the one from FitDef. We only average the
+  // parameters of the first trajectory that all of them have
+  struct fit_info *Models = malloc( Nmodel * sizeof( struct fit_info ) ) ;
+  size_t Navg = Input -> Fit.Nparam , Nlogic_max = Input -> Fit.Nlogic ;
+  Models[0] = Input -> Fit ;
+  for( m = 1 ; m < Nmodel ; m++ ) {
+    Models[m] = model_fit( Input -> Fit , Input -> Fit.Models[m-1] , Nsim ) ;
+    if( Models[m].Nparam < Navg ) {
+      Navg = Models[m].Nparam ;
+    }
+    if( Models[m].Nlogic > Nlogic_max ) {
+      Nlogic_max = Models[m].Nlogic ;
+    }
+  }
+
+  double *lohi = malloc( 2 * Nwin * Nsim * sizeof( double ) ) ;
+  struct scan_result *res = malloc( Nres * sizeof( struct scan_result ) ) ;
+  for( i = 0 ; i < Nwin ; i++ ) {
+    decode_window( lohi + 2 * i * Nsim , lohi + ( 2 * i + 1 ) * Nsim ,
+		   i , tc , Nlo , Nhi , Input ) ;
+  }
+  for( i = 0 ; i < Nres ; i++ ) {
+    res[i].lo = lohi + 2 * ( i % Nwin ) * Nsim ;
+    res[i].hi = res[i].lo + Nsim ;
+    res[i].model = i / Nwin ;
+    res[i].fitparams = NULL ;
+    res[i].chisq.resampled = NULL ;
+    res[i].weight = 0.0 ;
+    res[i].fitted = false ;
+  }
+
+  // a chain costs about its number of data points times Nlogic^2
+  struct traj Traj[ Nsim ] ;
+  struct scan_task *tasks = malloc( Nmodel * Nchain * sizeof( struct scan_task ) ) ;
+  size_t k ;
+  for( k = 0 ; k < Nchain ; k++ ) {
+    double Npoints = 0 ;
+    for( i = k * Nhi[tc] ; i < ( k + 1 ) * Nhi[tc] ; i++ ) {
+      size_t N ;
+      window_traj( Traj , Input , res[i].lo , res[i].hi ) ;
+      free( filter( &N , Input -> Data , Traj ) ) ;
+      Npoints += N ;
+    }
+    for( m = 0 ; m < Nmodel ; m++ ) {
+      tasks[ k + Nchain * m ].model = m ;
+      tasks[ k + Nchain * m ].chain = k ;
+      tasks[ k + Nchain * m ].cost = Npoints * Models[m].Nlogic * Models[m].Nlogic ;
+    }
+  }
+  qsort( tasks , Nmodel * Nchain , sizeof( struct scan_task ) , task_cmp ) ;
+
+  #pragma omp parallel for private(k) schedule(dynamic,1)
+  for( k = 0 ; k < Nmodel * Nchain ; k++ ) {
+    const size_t first = tasks[k].model * Nwin + tasks[k].chain * Nhi[tc] ;
+    fit_chain( res , Input , Models[ tasks[k].model ] , (const double**)C ,
+	       first , first + Nhi[tc] ) ;
+  }
+
+  for( i = 0 ; i < Nres ; i++ ) {
+    if( res[i].fitted == true ) {
+      flag = SUCCESS ;
+      break ;
+    }
+  }
+  model_average( res , Nres , Navg , Input -> Data.Ntot ) ;
+  write_scan( res , Nres , Nsim , Nlogic_max ) ;
+
+  for( i = 0 ; i < Nres ; i++ ) {
+    if( res[i].fitparams != NULL ) {
+      free_fitparams( res[i].fitparams , res[i].Nlogic ) ;
+    }
+    if( res[i].chisq.resampled != NULL ) {
+      free( res[i].chisq.resampled ) ;
+    }
+  }
+  for( m = 1 ; m < Nmodel ; m++ ) {
+    free( Models[m].Sims ) ;
+    free( Models[m].Prior ) ;
+    free( Models[m].Guess ) ;
+  }
+  free_covariance( C , Input -> Data.Ntot , Input -> Fit.Corrfit ) ;
+  free( Models ) ;
+  free( tasks ) ;
+  free( lohi ) ;
+  free( res ) ;
+
+  return flag ;
+}
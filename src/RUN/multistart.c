@@ -0,0 +1,182 @@
+/**
+   @file multistart.c
+   @brief multi-start search for the central value fit
+
+   Runs Fit.Nstarts minimizations in parallel from a latin hypercube
+   of perturbations about the guesses, throws away duplicate minima
+   and hands back the one with the lowest chisq. The first start is
+   always the unperturbed guess so this is never worse than a single
+   fit. Perturbations are Fit.Spread times the size of the guess, or
+   the prior width if the parameter has a prior
+ */
+#include "gens.h"
+
+#include "ffunction.h"
+#include "fit_chooser.h"
+
+// how many of the best distinct minima we tell the user about
+#define NTOP (5)
+
+// minima are the same if all parameters agree to this relative precision
+#define DEDUP_TOL (1E-5)
+
+// result of one of the starts
+struct minimum {
+  double chisq ;
+  double *fparams ;
+  size_t count ;
+} ;
+
+// ascending chisq with nans and infs at the end
+static int
+min_cmp( const void *a , const void *b )
+{
+  const struct minimum *A = (const struct minimum*)a ;
+  const struct minimum *B = (const struct minimum*)b ;
+  if( !isfinite( A -> chisq ) ) return isfinite( B -> chisq ) ;
+  if( !isfinite( B -> chisq ) ) return -1 ;
+  return A -> chisq < B -> chisq ? -1 : ( A -> chisq > B -> chisq ) ;
+}
+
+static bool
+same_minimum( const double *a ,
+	      const double *b ,
+	      const size_t Nlogic )
+{
+  size_t j ;
+  for( j = 0 ; j < Nlogic ; j++ ) {
+    if( fabs( a[j] - b[j] ) > DEDUP_TOL * ( fabs( a[j] ) + fabs( b[j] ) + DEDUP_TOL ) ) {
+      return false ;
+    }
+  }
+  return true ;
+}
+
+// latin hypercube of starting points about guess, each parameter's
+// range is cut into Nstarts strata and each start gets one of them
+static void
+latin_hypercube( double **starts ,
+		 const double *guess ,
+		 const struct fit_info Fit ,
+		 gsl_rng *r )
+{
+  size_t perm[ Fit.Nstarts ] , j , k ;
+  for( j = 0 ; j < Fit.Nlogic ; j++ ) {
+    for( k = 0 ; k < Fit.Nstarts ; k++ ) {
+      perm[k] = k ;
+    }
+    gsl_ran_shuffle( r , perm , Fit.Nstarts , sizeof( size_t ) ) ;
+    double width = Fit.Spread * ( guess[j] != 0.0 ? fabs( guess[j] ) : 1.0 ) ;
+    if( Fit.Prior[j].Initialised == true ) {
+      width = Fit.Prior[j].Err ;
+    }
+    for( k = 0 ; k < Fit.Nstarts ; k++ ) {
+      const double u = ( perm[k] + gsl_rng_uniform( r ) ) / Fit.Nstarts ;
+      starts[k][j] = guess[j] + width * ( 2*u - 1 ) ;
+    }
+    starts[0][j] = guess[j] ;
+  }
+  return ;
+}
+
+// overwrites fparams, which holds the guesses on input, with the best
+// minimum found and returns its chisq
+double
+multistart_fit( double *fparams ,
+		const void *data ,
+		const struct data_info Data ,
+		const struct fit_info Fit )
+{
+  const size_t Nlogic = Fit.Nlogic ;
+  size_t k , j ;
+
+  // starting points are generated serially so they are reproducible
+  gsl_rng *r = gsl_rng_alloc( gsl_rng_default ) ;
+  gsl_rng_set( r , 123456 ) ;
+  double **starts = malloc( Fit.Nstarts * sizeof( double* ) ) ;
+  struct minimum *mins = malloc( Fit.Nstarts * sizeof( struct minimum ) ) ;
+  for( k = 0 ; k < Fit.Nstarts ; k++ ) {
+    starts[k] = malloc( Nlogic * sizeof( double ) ) ;
+    mins[k].fparams = malloc( Nlogic * sizeof( double ) ) ;
+    mins[k].count = 1 ;
+  }
+  latin_hypercube( starts , fparams , Fit , r ) ;
+  gsl_rng_free( r ) ;
+
+  fprintf( stdout , "[MULTISTART] %zu starts for the average fit\n" ,
+	   Fit.Nstarts ) ;
+
+  #pragma omp parallel private(j)
+  {
+    struct fit_descriptor fdesc = init_fit( Data , Fit ) ;
+    fdesc.Prior = Fit.Prior ;
+
+    #pragma omp for private(k) schedule(dynamic)
+    for( k = 0 ; k < Fit.Nstarts ; k++ ) {
+      for( j = 0 ; j < Nlogic ; j++ ) {
+	fdesc.f.fparams[j] = starts[k][j] ;
+      }
+      // the minimizers return an iteration count so a start has only
+      // failed if it leaves us without a chisq
+      fdesc.f.chisq = NAN ;
+      Fit.Minimize( &fdesc , data , (const double**)Data.Cov.W , Fit.Tol ) ;
+      mins[k].chisq = isfinite( fdesc.f.chisq ) ? fdesc.f.chisq : NAN ;
+      for( j = 0 ; j < Nlogic ; j++ ) {
+	mins[k].fparams[j] = fdesc.f.fparams[j] ;
+      }
+    }
+    free_ffunction( &fdesc.f , fdesc.Nlogic ) ;
+  }
+
+  // sort and remove duplicates, counting how often each was found
+  qsort( mins , Fit.Nstarts , sizeof( struct minimum ) , min_cmp ) ;
+  size_t Nuniq = 0 ;
+  for( k = 0 ; k < Fit.Nstarts ; k++ ) {
+    if( !isfinite( mins[k].chisq ) ) break ;
+    bool found = false ;
+    for( j = 0 ; j < Nuniq ; j++ ) {
+      if( same_minimum( mins[j].fparams , mins[k].fparams , Nlogic ) ) {
+	mins[j].count++ ;
+	found = true ;
+	break ;
+      }
+    }
+    if( found == false ) {
+      double *t = mins[Nuniq].fparams ;
+      mins[Nuniq].fparams = mins[k].fparams ;
+      mins[Nuniq].chisq = mins[k].chisq ;
+      mins[Nuniq].count = 1 ;
+      mins[k].fparams = t ;
+      Nuniq++ ;
+    }
+  }
+
+  // tell us about the best few so that multimodal fits are visible
+  for( k = 0 ; k < Nuniq && k < NTOP ; k++ ) {
+    fprintf( stdout , "[MULTISTART] minimum %zu chisq %e found %zu times\n" ,
+	     k , mins[k].chisq , mins[k].count ) ;
+    for( j = 0 ; j < Nlogic ; j++ ) {
+      fprintf( stdout , "[MULTISTART]    PARAM_%zu %e\n" ,
+	       j , mins[k].fparams[j] ) ;
+    }
+  }
+
+  double chisq = NAN ;
+  if( Nuniq == 0 ) {
+    fprintf( stderr , "[MULTISTART] all starts failed, keeping the guesses\n" ) ;
+  } else {
+    for( j = 0 ; j < Nlogic ; j++ ) {
+      fparams[j] = mins[0].fparams[j] ;
+    }
+    chisq = mins[0].chisq ;
+  }
+
+  for( k = 0 ; k < Fit.Nstarts ; k++ ) {
+    free( starts[k] ) ;
+    free( mins[k].fparams ) ;
+  }
+  free( starts ) ;
+  free( mins ) ;
+
+  return chisq ;
+}
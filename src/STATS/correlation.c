@@ -11,6 +11,134 @@
 // Cholesky decomp should be much faster
 #define CHOLESKY
 
+// tell us the shrinkage of each covariance
+//#define VERBOSE
+
+// tile sizes of the blocked covariance, COV_BLOCK rows of the data
+// against COV_BLOCK others with COV_KBLOCK samples at a time so that
+// both tiles sit in L2
+#define COV_BLOCK (32)
+#define COV_KBLOCK (512)
+
+// upper triangle of NORM * Xc Xc^T where Xc is the data with the
+// average subtracted. The centered data is stored contiguously and
+// the upper triangle of tiles is flattened into one list so that
+// every thread gets the same amount of work
+static void
+blocked_covariance( double **correlation ,
+		    double *norm2 ,
+		    const struct resampled *data ,
+		    const size_t NDATA ,
+		    const double NORM )
+{
+  const size_t NSAMPLES = data[0].NSAMPLES ;
+  const size_t Nb = ( NDATA + COV_BLOCK - 1 ) / COV_BLOCK ;
+  const size_t Ntiles = Nb * ( Nb + 1 ) / 2 ;
+  double *Xc = malloc( NDATA * NSAMPLES * sizeof( double ) ) ;
+  size_t t , k0 ;
+
+  // centre the data, if norm2 is not NULL we also accumulate the
+  // squared length of each sample's vector x_k for the shrinkage
+#pragma omp parallel for private(k0)
+  for( k0 = 0 ; k0 < NSAMPLES ; k0 += COV_KBLOCK ) {
+    const size_t k1 = k0 + COV_KBLOCK < NSAMPLES ? k0 + COV_KBLOCK : NSAMPLES ;
+    size_t i , k ;
+    for( i = 0 ; i < NDATA ; i++ ) {
+      const double ave = data[i].avg ;
+      double *x = Xc + i * NSAMPLES ;
+      for( k = k0 ; k < k1 ; k++ ) {
+	x[k] = data[i].resampled[k] - ave ;
+      }
+      if( norm2 != NULL ) {
+	for( k = k0 ; k < k1 ; k++ ) {
+	  norm2[k] += x[k] * x[k] ;
+	}
+      }
+    }
+  }
+
+#pragma omp parallel for private(t) schedule(dynamic)
+  for( t = 0 ; t < Ntiles ; t++ ) {
+    // unflatten t into the tile (ib,jb) with ib <= jb
+    size_t ib = 0 , rem = t ;
+    while( rem >= Nb - ib ) {
+      rem -= Nb - ib ;
+      ib++ ;
+    }
+    const size_t jb = ib + rem ;
+    const size_t i0 = ib * COV_BLOCK ;
+    const size_t i1 = i0 + COV_BLOCK < NDATA ? i0 + COV_BLOCK : NDATA ;
+    const size_t j0 = jb * COV_BLOCK ;
+    const size_t j1 = j0 + COV_BLOCK < NDATA ? j0 + COV_BLOCK : NDATA ;
+    double acc[ COV_BLOCK ][ COV_BLOCK ] ;
+    size_t ii , jj , k0 ;
+    for( ii = 0 ; ii < COV_BLOCK ; ii++ ) {
+      for( jj = 0 ; jj < COV_BLOCK ; jj++ ) {
+	acc[ii][jj] = 0.0 ;
+      }
+    }
+    for( k0 = 0 ; k0 < NSAMPLES ; k0 += COV_KBLOCK ) {
+      const size_t k1 = k0 + COV_KBLOCK < NSAMPLES ? k0 + COV_KBLOCK : NSAMPLES ;
+      for( ii = i0 ; ii < i1 ; ii++ ) {
+	const double *xi = Xc + ii * NSAMPLES ;
+	jj = ( ib == jb ? ii : j0 ) ;
+	// four columns at a time reuse each load of xi
+	for( ; jj + 4 <= j1 ; jj += 4 ) {
+	  const double *xj0 = Xc + jj * NSAMPLES ;
+	  const double *xj1 = xj0 + NSAMPLES ;
+	  const double *xj2 = xj1 + NSAMPLES ;
+	  const double *xj3 = xj2 + NSAMPLES ;
+	  double s0 = 0.0 , s1 = 0.0 , s2 = 0.0 , s3 = 0.0 ;
+	  size_t k ;
+#pragma omp simd reduction(+:s0,s1,s2,s3)
+	  for( k = k0 ; k < k1 ; k++ ) {
+	    s0 += xi[k] * xj0[k] ;
+	    s1 += xi[k] * xj1[k] ;
+	    s2 += xi[k] * xj2[k] ;
+	    s3 += xi[k] * xj3[k] ;
+	  }
+	  acc[ ii - i0 ][ jj - j0 ] += s0 ;
+	  acc[ ii - i0 ][ jj - j0 + 1 ] += s1 ;
+	  acc[ ii - i0 ][ jj - j0 + 2 ] += s2 ;
+	  acc[ ii - i0 ][ jj - j0 + 3 ] += s3 ;
+	}
+	for( ; jj < j1 ; jj++ ) {
+	  const double *xj = Xc + jj * NSAMPLES ;
+	  double sum = 0.0 ;
+	  size_t k ;
+#pragma omp simd reduction(+:sum)
+	  for( k = k0 ; k < k1 ; k++ ) {
+	    sum += xi[k] * xj[k] ;
+	  }
+	  acc[ ii - i0 ][ jj - j0 ] += sum ;
+	}
+      }
+    }
+    for( ii = i0 ; ii < i1 ; ii++ ) {
+      for( jj = ( ib == jb ? ii : j0 ) ; jj < j1 ; jj++ ) {
+	correlation[ii][jj] = acc[ ii - i0 ][ jj - j0 ] * NORM ;
+      }
+    }
+  }
+  free( Xc ) ;
+  return ;
+}
+
+// compute the correct normalisation for the resampling
+static double
+resample_norm( const struct resampled d )
+{
+  switch( d.restype ) {
+  case Raw :
+    return 1.0 / (double)( d.NSAMPLES * ( d.NSAMPLES - 1.0 ) ) ;
+  case JackKnife :
+    return ( 1.0 - 1.0/(double)d.NSAMPLES ) ;
+  case BootStrap :
+    return 1.0 / (double)d.NSAMPLES ;
+  }
+  return 1.0 ;
+}
+
 // computes the upper section
 void
 compute_upper_correlation( double **correlation , 
@@ -20,24 +148,9 @@ compute_upper_correlation( double **correlation ,
 {
   // initialise number of samples
   const size_t NSAMPLES = data[0].NSAMPLES ;
-
-  // compute the correct normalisation
-  double NORM = 1.0 ;
+  const double NORM = resample_norm( data[0] ) ;
   size_t i ;
 
-  // get the norm correct
-  switch( data[0].restype ) {
-  case Raw :
-    NORM = 1.0 / (double)( NSAMPLES * ( NSAMPLES - 1.0 ) ) ;
-    break ;
-  case JackKnife :
-    NORM = ( 1.0 - 1.0/(double)NSAMPLES ) ;
-    break ;
-  case BootStrap :
-    NORM = 1.0 / (double)NSAMPLES ;
-    break ;
-  }
-
   // diagonal one is pretty straightforward
   switch( CORRFIT ) {
   case UNWEIGHTED :
@@ -57,21 +170,7 @@ compute_upper_correlation( double **correlation ,
     }
     break ;
   case CORRELATED :
-#pragma omp parallel for private(i)
-    for( i = 0 ; i < NDATA ; i++ ) {
-      register const double avei = data[i].avg ;
-      size_t j , k ;
-      for( j = i ; j < NDATA ; j++ ) {
-	register const double avej = data[j].avg ;
-	register double sum = 0.0 ;
-	for( k = 0 ; k < NSAMPLES ; k++ ) {
-	  sum += 
-	    ( data[i].resampled[k] - avei ) *  
-	    ( data[j].resampled[k] - avej ) ;
-	}
-	correlation[i][j] = sum * NORM ;
-      }
-    }
+    blocked_covariance( correlation , NULL , data , NDATA , NORM ) ;
     break ;
   }
   return ;
@@ -128,6 +227,197 @@ modified_covariance( double **correlation ,
   return ;
 }
 
+// C -> ( 1 - rho ) C + rho mu I with mu the average variance
+static void
+shrink_to_identity( double **C ,
+		    const size_t NDATA ,
+		    const double rho )
+{
+  double mu = 0.0 ;
+  size_t i , j ;
+  for( i = 0 ; i < NDATA ; i++ ) {
+    mu += C[i][i] ;
+  }
+  mu /= NDATA ;
+  for( i = 0 ; i < NDATA ; i++ ) {
+    for( j = 0 ; j < NDATA ; j++ ) {
+      C[i][j] *= ( 1.0 - rho ) ;
+    }
+    C[i][i] += rho * mu ;
+  }
+  return ;
+}
+
+// trace of C and tr( C^2 ) = |C|_F^2
+static void
+traces( double *trC ,
+	double *trC2 ,
+	const double **C ,
+	const size_t NDATA )
+{
+  size_t i , j ;
+  *trC = *trC2 = 0.0 ;
+  for( i = 0 ; i < NDATA ; i++ ) {
+    *trC += C[i][i] ;
+    for( j = 0 ; j < NDATA ; j++ ) {
+      *trC2 += C[i][j] * C[i][j] ;
+    }
+  }
+  return ;
+}
+
+// Ledoit-Wolf intensity for shrinking to a scaled identity. With
+// S = C / s the covariance of the samples x_k the estimate of the
+// error of S is b^2 = ( sum_k |x_k|^4 - n |S|^2 ) / n^2 and we
+// shrink by min( b^2 , d^2 ) / d^2 with d^2 = |S - mu I|^2
+static double
+ledoit_wolf( double **C ,
+	     const size_t NDATA ,
+	     const double *norm2 ,
+	     const size_t NSAMPLES ,
+	     const double NORM )
+{
+  const double n = NSAMPLES , sc = 1.0 / ( NORM * n ) ;
+  double trC , trC2 , sum4 = 0.0 ;
+  size_t k ;
+  traces( &trC , &trC2 , (const double**)C , NDATA ) ;
+  const double trS = trC * sc , trS2 = trC2 * sc * sc ;
+  for( k = 0 ; k < NSAMPLES ; k++ ) {
+    sum4 += norm2[k] * norm2[k] ;
+  }
+  const double d2 = trS2 - trS * trS / NDATA ;
+  double b2 = ( sum4 - n * trS2 ) / ( n * n ) ;
+  if( !( d2 > 0.0 ) ) return 0.0 ;
+  b2 = b2 < d2 ? b2 : d2 ;
+  b2 = b2 > 0.0 ? b2 : 0.0 ;
+  return b2 / d2 ;
+}
+
+// oracle approximating shrinkage of Chen, Wiesel, Eldar and Hero
+static double
+oracle_approx( double **C ,
+	       const size_t NDATA ,
+	       const size_t NSAMPLES ,
+	       const double NORM )
+{
+  const double n = NSAMPLES , p = NDATA , sc = 1.0 / ( NORM * n ) ;
+  double trC , trC2 ;
+  traces( &trC , &trC2 , (const double**)C , NDATA ) ;
+  const double trS = trC * sc , trS2 = trC2 * sc * sc ;
+  const double num = ( 1.0 - 2.0 / p ) * trS2 + trS * trS ;
+  const double den = ( n + 1.0 - 2.0 / p ) * ( trS2 - trS * trS / p ) ;
+  if( !( den > 0.0 ) ) return 1.0 ;
+  return num / den < 1.0 ? num / den : 1.0 ;
+}
+
+// raise the eigenvalues of the correlation matrix that are below
+// tol times the largest to that value and rebuild C from them
+static int
+eigen_floor( double **C ,
+	     const size_t NDATA ,
+	     const double tol )
+{
+  gsl_matrix *R = gsl_matrix_alloc( NDATA , NDATA ) ;
+  gsl_matrix *V = gsl_matrix_alloc( NDATA , NDATA ) ;
+  gsl_vector *e = gsl_vector_alloc( NDATA ) ;
+  gsl_eigen_symmv_workspace *w = gsl_eigen_symmv_alloc( NDATA ) ;
+  double sigma[ NDATA ] , emax = 0.0 ;
+  size_t i , j , k , Nfloor = 0 ;
+  int flag = SUCCESS ;
+  for( i = 0 ; i < NDATA ; i++ ) {
+    sigma[i] = C[i][i] > 0.0 ? sqrt( C[i][i] ) : 1.0 ;
+  }
+  for( i = 0 ; i < NDATA ; i++ ) {
+    for( j = 0 ; j < NDATA ; j++ ) {
+      gsl_matrix_set( R , i , j , C[i][j] / ( sigma[i] * sigma[j] ) ) ;
+    }
+  }
+  if( gsl_eigen_symmv( R , e , V , w ) != GSL_SUCCESS ) {
+    flag = FAILURE ;
+    goto memfree ;
+  }
+  for( k = 0 ; k < NDATA ; k++ ) {
+    if( gsl_vector_get( e , k ) > emax ) emax = gsl_vector_get( e , k ) ;
+  }
+  for( k = 0 ; k < NDATA ; k++ ) {
+    if( gsl_vector_get( e , k ) < tol * emax ) {
+      gsl_vector_set( e , k , tol * emax ) ;
+      Nfloor++ ;
+    }
+  }
+  for( i = 0 ; i < NDATA ; i++ ) {
+    for( j = i ; j < NDATA ; j++ ) {
+      register double sum = 0.0 ;
+      for( k = 0 ; k < NDATA ; k++ ) {
+	sum += gsl_matrix_get( V , i , k ) * gsl_vector_get( e , k ) *
+	  gsl_matrix_get( V , j , k ) ;
+      }
+      C[i][j] = C[j][i] = sum * sigma[i] * sigma[j] ;
+    }
+  }
+#ifdef VERBOSE
+  fprintf( stdout , "[CORRELATION] raised %zu of %zu eigenvalues to %e\n" ,
+	   Nfloor , NDATA , tol * emax ) ;
+#endif
+ memfree :
+  gsl_eigen_symmv_free( w ) ;
+  gsl_vector_free( e ) ;
+  gsl_matrix_free( V ) ;
+  gsl_matrix_free( R ) ;
+  return flag ;
+}
+
+// full symmetric covariance matrix of data with the estimator and
+// normalisation asked for in Cov, the shrinkage intensities come
+// from quantities accumulated while building the sample covariance
+int
+compute_covariance( double **C ,
+		    const struct resampled *data ,
+		    const size_t NDATA ,
+		    const struct correlation Cov )
+{
+  const size_t NSAMPLES = data[0].NSAMPLES ;
+  const double NORM = resample_norm( data[0] ) ;
+  double *norm2 = NULL , rho = 0.0 ;
+  int flag = SUCCESS ;
+
+  if( Cov.Estimator == LEDOIT_WOLF ) {
+    norm2 = calloc( NSAMPLES , sizeof( double ) ) ;
+  }
+  blocked_covariance( C , norm2 , data , NDATA , NORM ) ;
+  fill_lower_triangular( C , NDATA ) ;
+
+  switch( Cov.Estimator ) {
+  case SAMPLE_COV :
+    break ;
+  case LEDOIT_WOLF :
+    rho = ledoit_wolf( C , NDATA , norm2 , NSAMPLES , NORM ) ;
+    shrink_to_identity( C , NDATA , rho ) ;
+#ifdef VERBOSE
+    fprintf( stdout , "[CORRELATION] Ledoit-Wolf shrinkage %f\n" , rho ) ;
+#endif
+    free( norm2 ) ;
+    break ;
+  case OAS :
+    rho = oracle_approx( C , NDATA , NSAMPLES , NORM ) ;
+    shrink_to_identity( C , NDATA , rho ) ;
+#ifdef VERBOSE
+    fprintf( stdout , "[CORRELATION] OAS shrinkage %f\n" , rho ) ;
+#endif
+    break ;
+  case EIGEN_FLOOR :
+    flag = eigen_floor( C , NDATA , Cov.Eigenvalue_Tol ) ;
+    break ;
+  }
+
+  // divides elements by sigma_i sigma_j
+  if( Cov.Divided_Covariance == true ) {
+    modified_covariance( C , NDATA ) ;
+    fill_lower_triangular( C , NDATA ) ;
+  }
+  return flag ;
+}
+
 // compute the inverse of the correlation matrix
 int
 inverse_correlation( struct data_info *Data ,
@@ -169,17 +459,14 @@ inverse_correlation( struct data_info *Data ,
       Data -> Cov.W[ i ][ i ] = C[ i ][ i ] = 1.0 ;
     }
 
-    // compute this correlation matrix (false means not diagonal)
-    compute_upper_correlation( C , Data -> y , Data -> Ntot , Fit.Corrfit ) ;
-
-    // divides elements by sigma_i sigma_j
-    if( Data -> Cov.Divided_Covariance == true ) {
-      modified_covariance( C , Data -> Ntot ) ;
+    // compute this correlation matrix with whichever estimator
+    if( compute_covariance( C , Data -> y , Data -> Ntot ,
+			    Data -> Cov ) == FAILURE ) {
+      fprintf( stderr , "[CORRELATION] covariance estimate failed\n" ) ;
+      flag = FAILURE ;
+      goto memfree ;
     }
 
-    // correlation matrix is symmetric
-    fill_lower_triangular( C , Data -> Ntot ) ;
-
     write_corrmatrix( (const double**)C , Data -> Ntot , Fit.Corrfit ) ;
 
 #ifdef CHOLESKY
@@ -213,6 +500,7 @@ inverse_correlation( struct data_info *Data ,
     write_corrmatrix( (const double**)Data -> Cov.W ,
 		      Data -> Ntot , Fit.Corrfit ) ;
     
+  memfree :
     // free the correlation matrix
     for( i = 0 ; i < Data -> Ntot ; i++ ) {
       free( C[i] ) ;
@@ -225,6 +513,113 @@ inverse_correlation( struct data_info *Data ,
   return flag ;
 }
 
+// covariance of all of Data, computed once so that fits over
+// different windows can take sub-blocks of it rather than redo it.
+// Is 1xNtot for uncorrelated fits and NULL for unweighted ones, on
+// FAILURE *C is left NULL
+int
+full_covariance( double ***C ,
+		 const struct data_info Data ,
+		 const corrtype Corrfit )
+{
+  size_t i ;
+  *C = NULL ;
+  switch( Corrfit ) {
+  case UNWEIGHTED : return SUCCESS ;
+  case UNCORRELATED :
+    *C = malloc( sizeof( double* ) ) ;
+    (*C)[ 0 ] = calloc( Data.Ntot , sizeof( double ) ) ;
+    compute_upper_correlation( *C , Data.y , Data.Ntot , Corrfit ) ;
+    break ;
+  case CORRELATED :
+    *C = malloc( Data.Ntot * sizeof( double* ) ) ;
+    for( i = 0 ; i < Data.Ntot ; i++ ) {
+      (*C)[ i ] = calloc( Data.Ntot , sizeof( double ) ) ;
+    }
+    // dividing by sigma_i sigma_j commutes with taking a sub-block,
+    // any shrinkage is of the full matrix
+    if( compute_covariance( *C , Data.y , Data.Ntot , Data.Cov ) == FAILURE ) {
+      fprintf( stderr , "[CORRELATION] covariance estimate failed\n" ) ;
+      free_covariance( *C , Data.Ntot , Corrfit ) ;
+      *C = NULL ;
+      return FAILURE ;
+    }
+    break ;
+  }
+  return SUCCESS ;
+}
+
+void
+free_covariance( double **C ,
+		 const size_t Ntot ,
+		 const corrtype Corrfit )
+{
+  size_t i ;
+  if( C == NULL ) return ;
+  const size_t Nrows = ( Corrfit == CORRELATED ) ? Ntot : 1 ;
+  for( i = 0 ; i < Nrows ; i++ ) {
+    free( C[i] ) ;
+  }
+  free( C ) ;
+  return ;
+}
+
+// inverts the sub-block of the full covariance C picked out by
+// in_fitrange and puts it in Data -> Cov.W, Data -> Ntot must be
+// the number of true entries in in_fitrange
+int
+subset_inverse_correlation( struct data_info *Data ,
+			    const double **C ,
+			    const bool *in_fitrange ,
+			    const size_t Nfull ,
+			    const corrtype Corrfit )
+{
+  const size_t N = Data -> Ntot ;
+  size_t idx[ N ] , i , j , n = 0 ;
+  int flag = SUCCESS ;
+  for( i = 0 ; i < Nfull ; i++ ) {
+    if( in_fitrange[i] == true ) {
+      idx[ n++ ] = i ;
+    }
+  }
+  Data -> Cov.W = NULL ;
+  switch( Corrfit ) {
+  case UNWEIGHTED : return flag ;
+  case UNCORRELATED :
+    Data -> Cov.W = malloc( sizeof( double* ) ) ;
+    Data -> Cov.W[ 0 ] = malloc( N * sizeof( double ) ) ;
+    for( i = 0 ; i < N ; i++ ) {
+      const double c = C[0][ idx[i] ] ;
+      Data -> Cov.W[0][i] = fabs( c ) > 1.E-32 ? 1.0 / c : 1.E-32 ;
+    }
+    break ;
+  case CORRELATED : {
+    gsl_matrix *A = gsl_matrix_alloc( N , N ) ;
+    for( i = 0 ; i < N ; i++ ) {
+      for( j = 0 ; j < N ; j++ ) {
+	gsl_matrix_set( A , i , j , C[ idx[i] ][ idx[j] ] ) ;
+      }
+    }
+    if( gsl_linalg_cholesky_decomp( A ) != GSL_SUCCESS ||
+	gsl_linalg_cholesky_invert( A ) != GSL_SUCCESS ) {
+      fprintf( stderr , "[CORRELATION] covariance sub-block is not"
+	       " positive definite\n" ) ;
+      flag = FAILURE ;
+    }
+    Data -> Cov.W = malloc( N * sizeof( double* ) ) ;
+    for( i = 0 ; i < N ; i++ ) {
+      Data -> Cov.W[i] = malloc( N * sizeof( double ) ) ;
+      for( j = 0 ; j < N ; j++ ) {
+	Data -> Cov.W[i][j] = gsl_matrix_get( A , i , j ) ;
+      }
+    }
+    gsl_matrix_free( A ) ;
+    break ;
+  }
+  }
+  return flag ;
+}
+
 void
 write_corrmatrix( const double **correlation ,
 		  const size_t NCUT ,
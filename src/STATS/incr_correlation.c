@@ -0,0 +1,253 @@
+/**
+   @file incr_correlation.c
+   @brief inverse covariance of nested fit windows by rank-one updates
+
+   Keeps the inverse of the covariance sub-block of the last window
+   and moves it to the next window by removing and adding single
+   rows/columns with the Schur complement, each costing O(N^2)
+   rather than the O(N^3) of a fresh Cholesky inverse. The rows are
+   stored in the order they were added and idx says which data point
+   each one is. We fall back to a full inverse when the windows are
+   too different, when the updates lose positivity or every NREFRESH
+   updates to stop rounding errors accumulating
+ */
+#include "gens.h"
+
+#include "correlation.h"
+#include "incr_correlation.h"
+
+// updates before we recompute from scratch
+#define NREFRESH (64)
+
+// Schur complement relative to the diagonal below which we say the
+// matrix has gone numerically singular
+#define SCHUR_TOL (1E-12)
+
+void
+init_incr_inverse( struct incr_inverse *Inv ,
+		   const size_t Nmax )
+{
+  Inv -> Nmax = Nmax ;
+  Inv -> n = 0 ;
+  Inv -> Nupdates = 0 ;
+  Inv -> idx = malloc( Nmax * sizeof( size_t ) ) ;
+  Inv -> pos = malloc( Nmax * sizeof( size_t ) ) ;
+  Inv -> Winv = malloc( Nmax * Nmax * sizeof( double ) ) ;
+  Inv -> u = malloc( Nmax * sizeof( double ) ) ;
+  return ;
+}
+
+void
+free_incr_inverse( struct incr_inverse *Inv )
+{
+  free( Inv -> idx ) ;
+  free( Inv -> pos ) ;
+  free( Inv -> Winv ) ;
+  free( Inv -> u ) ;
+  return ;
+}
+
+// inverse from scratch by cholesky of the sub-block C[T][T]
+static int
+full_inverse( struct incr_inverse *Inv ,
+	      const double **C ,
+	      const bool *in_fitrange )
+{
+  const size_t Nmax = Inv -> Nmax ;
+  size_t i , j , n = 0 ;
+  for( i = 0 ; i < Nmax ; i++ ) {
+    if( in_fitrange[i] == true ) {
+      Inv -> idx[ n++ ] = i ;
+    }
+  }
+  Inv -> n = n ;
+  Inv -> Nupdates = 0 ;
+  if( n == 0 ) return SUCCESS ;
+
+  gsl_matrix *A = gsl_matrix_alloc( n , n ) ;
+  for( i = 0 ; i < n ; i++ ) {
+    for( j = 0 ; j < n ; j++ ) {
+      gsl_matrix_set( A , i , j , C[ Inv -> idx[i] ][ Inv -> idx[j] ] ) ;
+    }
+  }
+  int flag = SUCCESS ;
+  if( gsl_linalg_cholesky_decomp( A ) != GSL_SUCCESS ||
+      gsl_linalg_cholesky_invert( A ) != GSL_SUCCESS ) {
+    fprintf( stderr , "[CORRELATION] covariance sub-block is not"
+	     " positive definite\n" ) ;
+    flag = FAILURE ;
+  }
+  for( i = 0 ; i < n ; i++ ) {
+    for( j = 0 ; j < n ; j++ ) {
+      Inv -> Winv[ j + Nmax * i ] = gsl_matrix_get( A , i , j ) ;
+    }
+  }
+  gsl_matrix_free( A ) ;
+  return flag ;
+}
+
+// remove row/column r, the inverse of the remaining block is
+// W_ij - W_ir W_rj / W_rr and the last row is moved into the gap
+static int
+remove_row( struct incr_inverse *Inv ,
+	    const size_t r )
+{
+  const size_t Nmax = Inv -> Nmax , n = Inv -> n , last = n - 1 ;
+  double *W = Inv -> Winv ;
+  const double wrr = W[ r + Nmax * r ] ;
+  size_t i , j ;
+  if( !( wrr > 0.0 ) ) return FAILURE ;
+  for( i = 0 ; i < n ; i++ ) {
+    Inv -> u[i] = W[ r + Nmax * i ] / wrr ;
+  }
+  // row r is dropped so we leave it alone as the others need it
+  for( i = 0 ; i < n ; i++ ) {
+    if( i == r ) continue ;
+    for( j = 0 ; j < n ; j++ ) {
+      W[ j + Nmax * i ] -= Inv -> u[i] * W[ j + Nmax * r ] ;
+    }
+  }
+  if( r != last ) {
+    for( j = 0 ; j < n ; j++ ) {
+      W[ j + Nmax * r ] = W[ j + Nmax * last ] ;
+    }
+    for( i = 0 ; i < n ; i++ ) {
+      W[ r + Nmax * i ] = W[ last + Nmax * i ] ;
+    }
+    Inv -> idx[ r ] = Inv -> idx[ last ] ;
+  }
+  Inv -> n = last ;
+  return SUCCESS ;
+}
+
+// append data point p, with b = C[S][p], u = W b and the Schur
+// complement s = C[p][p] - b.u the new inverse is
+//   ( W + u u^T / s , -u / s )
+//   (     -u^T / s  ,  1 / s )
+static int
+add_row( struct incr_inverse *Inv ,
+	 const double **C ,
+	 const size_t p )
+{
+  const size_t Nmax = Inv -> Nmax , n = Inv -> n ;
+  double *W = Inv -> Winv , *u = Inv -> u ;
+  size_t i , j ;
+  double s = C[p][p] ;
+  for( i = 0 ; i < n ; i++ ) {
+    register double sum = 0.0 ;
+    for( j = 0 ; j < n ; j++ ) {
+      sum += W[ j + Nmax * i ] * C[ Inv -> idx[j] ][p] ;
+    }
+    u[i] = sum ;
+    s -= C[ Inv -> idx[i] ][p] * sum ;
+  }
+  if( !( s > SCHUR_TOL * fabs( C[p][p] ) ) ) return FAILURE ;
+  const double is = 1.0 / s ;
+  for( i = 0 ; i < n ; i++ ) {
+    for( j = 0 ; j < n ; j++ ) {
+      W[ j + Nmax * i ] += u[i] * u[j] * is ;
+    }
+    W[ n + Nmax * i ] = W[ i + Nmax * n ] = -u[i] * is ;
+  }
+  W[ n + Nmax * n ] = is ;
+  Inv -> idx[ n ] = p ;
+  Inv -> n = n + 1 ;
+  return SUCCESS ;
+}
+
+// move the inverse from the last window to the one in in_fitrange
+static int
+update_inverse( struct incr_inverse *Inv ,
+		const double **C ,
+		const bool *in_fitrange ,
+		const size_t Ntot )
+{
+  const size_t Nmax = Inv -> Nmax ;
+  size_t i , Nchange = 0 ;
+
+  // in_S[p] says whether data point p is in the current inverse
+  bool in_S[ Nmax ] ;
+  for( i = 0 ; i < Nmax ; i++ ) {
+    in_S[i] = false ;
+  }
+  for( i = 0 ; i < Inv -> n ; i++ ) {
+    in_S[ Inv -> idx[i] ] = true ;
+  }
+  for( i = 0 ; i < Nmax ; i++ ) {
+    Nchange += ( in_S[i] != in_fitrange[i] ) ;
+  }
+
+  // each update is ~2N^2 against ~N^3 for cholesky and inversion
+  if( Inv -> n == 0 || Inv -> Nupdates + Nchange > NREFRESH ||
+      3 * Nchange > Ntot ) {
+    return full_inverse( Inv , C , in_fitrange ) ;
+  }
+
+  // removals first so the matrices we update are as small as possible
+  i = 0 ;
+  while( i < Inv -> n ) {
+    if( in_fitrange[ Inv -> idx[i] ] == false ) {
+      if( remove_row( Inv , i ) == FAILURE ) {
+	return full_inverse( Inv , C , in_fitrange ) ;
+      }
+    } else {
+      i++ ;
+    }
+  }
+  for( i = 0 ; i < Nmax ; i++ ) {
+    if( in_fitrange[i] == true && in_S[i] == false ) {
+      if( add_row( Inv , C , i ) == FAILURE ) {
+	return full_inverse( Inv , C , in_fitrange ) ;
+      }
+    }
+  }
+  Inv -> Nupdates += Nchange ;
+  return SUCCESS ;
+}
+
+// same as subset_inverse_correlation but reuses the inverse of the
+// previous window in Inv, which must have been initialised with the
+// full Ntot of the data
+int
+incr_inverse_correlation( struct data_info *Data ,
+			  struct incr_inverse *Inv ,
+			  const double **C ,
+			  const bool *in_fitrange ,
+			  const corrtype Corrfit )
+{
+  if( Corrfit != CORRELATED ) {
+    return subset_inverse_correlation( Data , C , in_fitrange ,
+				       Inv -> Nmax , Corrfit ) ;
+  }
+  const size_t N = Data -> Ntot , Nmax = Inv -> Nmax ;
+  size_t i , j , n = 0 ;
+  int flag = update_inverse( Inv , C , in_fitrange , N ) ;
+
+  Data -> Cov.W = malloc( N * sizeof( double* ) ) ;
+  for( i = 0 ; i < N ; i++ ) {
+    Data -> Cov.W[i] = calloc( N , sizeof( double ) ) ;
+  }
+  // start again from scratch next time
+  if( flag == FAILURE ) {
+    Inv -> n = 0 ;
+    return flag ;
+  }
+
+  // rows of Winv are in the order they were added, put them back
+  // into the order of the data
+  for( i = 0 ; i < Inv -> n ; i++ ) {
+    Inv -> pos[ Inv -> idx[i] ] = i ;
+  }
+  size_t order[ N ] ;
+  for( i = 0 ; i < Nmax ; i++ ) {
+    if( in_fitrange[i] == true ) {
+      order[ n++ ] = Inv -> pos[i] ;
+    }
+  }
+  for( i = 0 ; i < N ; i++ ) {
+    for( j = 0 ; j < N ; j++ ) {
+      Data -> Cov.W[i][j] = Inv -> Winv[ order[j] + Nmax * order[i] ] ;
+    }
+  }
+  return flag ;
+}
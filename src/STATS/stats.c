@@ -6,6 +6,7 @@
 
 #include "bootstrap.h"
 #include "jacknife.h"
+#include "profile.h"
 #include "raw.h"
 
 #include "rng.h"
@@ -14,6 +15,7 @@
 void
 compute_err( struct resampled *replicas )
 {
+  PROF_COUNT( PROF_COMPUTE_ERR , 1 ) ;
   switch( replicas -> restype ) {
   case Raw :
     raw_err( replicas ) ;
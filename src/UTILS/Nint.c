@@ -1,107 +1,54 @@
 /**
    @file Nint.c
    @brief trapezoid and generalized Simpson's numerical integrators
+   and the Gauss-Kronrod integral of a fit
  */
 #include "gens.h"
 
 #include "fit_chooser.h"
 #include "ffunction.h"
+#include "gkquad.h"
 #include "resampled_ops.h"
 #include "stats.h"
 
-// simpson evaluation
-static double
-simp_eval( const double *fparams ,
-	   const struct data_info Data ,
-	   const struct fit_info Fit ,
-	   struct fit_descriptor fdesc ,
-	   const double x ,
-	   const double h ,
-	   const size_t shift )
-{
-  struct x_desc xdesc = { x , Data.LT[shift] , Fit.N , Fit.M } ;
-
-  double sum = fdesc.func( xdesc , fparams , Fit.map[shift].bnd ) ;
-
-  xdesc.X = x+h/2. ;
-  
-  sum += 4*fdesc.func( xdesc , fparams , Fit.map[shift].bnd ) ;
-
-  xdesc.X = x+h ; 
-  sum += fdesc.func( xdesc , fparams , Fit.map[shift].bnd ) ;
-
-  return h*sum ;
-}
-
-// driver for the adaptive simpson's
-// usual two half-step approach to estimate the error
-static double
-adaptive_simpsons( const double *fparams ,
-		   const struct data_info Data ,
-		   const struct fit_info Fit ,
-		   struct fit_descriptor fdesc ,
- 		   const double low , 
-		   const double upp ,
-		   const double eps ,
-		   const size_t shift )
+// the model for all the samples at the same nodes, the average is
+// the last sample
+struct fit_nint {
+  const double *fparams ; // Nparam per sample
+  size_t Nparam ;
+  size_t NSAMPLES ;
+  const struct data_info *Data ;
+  const struct fit_info *Fit ;
+  const struct fit_descriptor *fdesc ;
+  size_t shift ;
+} ;
+
+static void
+fit_nodes( double *f ,
+	   const double *x ,
+	   const size_t Nx ,
+	   const size_t Nsamples ,
+	   void *args )
 {
-  const double inveps = 1.0 / eps ; 
-  register double fx , fxph_4 , fxph_2 , fxp3h_4 , fxph ; // some evaluations I use a lot
-  register double sum = 0.0 , diff ;
-  double h = ( upp - low ) / 100. ; // initial guess
-  double x = low ;
-  const size_t max_steps = 150 ;
-  while( x < upp ) {    
-    register double step = 0.0 , step2 = 0.0 ;
-    struct x_desc xdesc = { x , Data.LT[shift] , Fit.N , Fit.M } ;
-    
-    size_t nsteps = 0 ;
-    while( nsteps < max_steps ) {
-
-      xdesc.X = x ;
-      fx      = fdesc.func( xdesc , fparams , Fit.map[shift].bnd ) ;
-
-      xdesc.X = x+h/4. ;
-      fxph_4  = fdesc.func( xdesc , fparams , Fit.map[shift].bnd ) ;
-
-      xdesc.X = x+h/2. ;
-      fxph_2  = fdesc.func( xdesc , fparams , Fit.map[shift].bnd ) ;
-
-      xdesc.X = x+3*h/4. ;
-      fxp3h_4 = fdesc.func( xdesc , fparams , Fit.map[shift].bnd ) ;
-
-      xdesc.X = x+h ;
-      fxph    = fdesc.func( xdesc , fparams , Fit.map[shift].bnd ) ;
-
-      step  = h * ( fx + 4. * fxph_2 + fxph ) ;
-      step2 = h * ( fx + 4. * ( fxph_4 + fxp3h_4 ) + 2. * fxph_2 + fxph ) / 2.0 ;
- 
-      diff = fabs( step - step2 ) * inveps ;
-      
-      // break if the diff is within tolerance
-      if( diff < 1.0 ) 
-	break ;
-
-      // if we run into too much trouble we return a NAN
-      if( nsteps == max_steps-1 ) {
-	fprintf( stderr , "[ADS] ill convergence met\n" ) ;
-	fprintf( stderr , "[ADS] %e \n" , diff ) ;
-	return ( sum + simp_eval( fparams , Data , Fit ,
-				  fdesc , x , upp-x , shift ) ) / 6. ;
-      }
-
-      h *= 0.9 * pow( diff , -0.25 ) ; 
-      nsteps++ ;
+  const struct fit_nint *A = (const struct fit_nint*)args ;
+  size_t k ;
+#pragma omp parallel for private(k)
+  for( k = 0 ; k < Nsamples ; k++ ) {
+    const bool is_avg = ( k == A -> NSAMPLES ) ;
+    struct x_desc xdesc = { 0.0 , A -> Data -> LT[ A -> shift ] ,
+			    A -> Fit -> N , A -> Fit -> M , NULL } ;
+    if( A -> fdesc -> ctx != NULL ) {
+      xdesc.Ctx = A -> fdesc -> ctx( is_avg ? 0 : k , is_avg ) ;
     }
-    sum = sum + ( step2 + ( step2 - step ) / 15. ) ;
-    x += h ;
-    if( diff > 1E-15 ) {
-      h *= 0.9 * pow( diff , -0.2 ) ;
+    const double *fp = A -> fparams + k*A -> Nparam ;
+    size_t i ;
+    for( i = 0 ; i < Nx ; i++ ) {
+      xdesc.X = x[i] ;
+      f[ i + k*Nx ] = A -> fdesc -> func( xdesc , fp ,
+					  A -> Fit -> map[ A -> shift ].bnd ) ;
     }
   }
-  // small correction exactly to "x"
-  return ( sum + simp_eval( fparams , Data , Fit ,
-			    fdesc , x , upp-x , shift ) ) / 6. ;
+  return ;
 }
 
 static double
@@ -346,25 +293,35 @@ Nint_fit( struct resampled *f ,
 				    f[0].restype ) ;
   struct fit_descriptor fdesc = init_fit( Data , Fit ) ;
 
-  // could be done in parallel
+  // parameters of every sample and then the average
+  const size_t Ns = f[0].NSAMPLES + 1 ;
+  double *fparams = malloc( Ns*fdesc.Nparam*sizeof( double ) ) ;
+  double *res = malloc( Ns*sizeof( double ) ) ;
   size_t j , p ;
-  for( j = 0 ; j < f[0].NSAMPLES ; j++ ) {
-    double fparams[ fdesc.Nparam ] ;
-    for( p = 0 ; p < fdesc.Nparam ; p++ ) {
-      fparams[ p ] = f[ Fit.map[shift].p[p] ].resampled[j] ;
+  for( p = 0 ; p < fdesc.Nparam ; p++ ) {
+    const struct resampled *fp = &f[ Fit.map[shift].p[p] ] ;
+    for( j = 0 ; j < f[0].NSAMPLES ; j++ ) {
+      fparams[ p + j*fdesc.Nparam ] = fp -> resampled[j] ;
     }
-    Int.resampled[j] = adaptive_simpsons( fparams , Data , Fit ,
-					  fdesc , low , upp , eps ,
-					  shift ) ;
+    fparams[ p + f[0].NSAMPLES*fdesc.Nparam ] = fp -> avg ;
   }
-  // do the average
-  double fparams[ fdesc.Nparam ] ;
-  for( p = 0 ; p < fdesc.Nparam ; p++ ) {
-    fparams[ p ] = f[ Fit.map[shift].p[p] ].avg ;
+
+  // all the samples are integrated on the same intervals
+  struct fit_nint args = { fparams , fdesc.Nparam , f[0].NSAMPLES ,
+			   &Data , &Fit , &fdesc , shift } ;
+  if( gk_integrate_samples( res , NULL , fit_nodes , &args , Ns ,
+			    low , upp , eps , 0.0 , 1000 , GK21 ) == FAILURE ) {
+    fprintf( stderr , "[INT] integral not converged to %e\n" , eps ) ;
   }
-  Int.avg = adaptive_simpsons( fparams , Data , Fit ,
-			       fdesc , low , upp , eps ,
-			       shift ) ;
+  for( j = 0 ; j < f[0].NSAMPLES ; j++ ) {
+    Int.resampled[j] = res[j] ;
+  }
+  Int.avg = res[ f[0].NSAMPLES ] ;
+
+  free( fparams ) ;
+  free( res ) ;
+  free_ffunction( &fdesc.f , fdesc.Nlogic ) ;
+
   compute_err( &Int ) ;
   fprintf( stdout , "\n[INT] Integrated fit parameters\n" ) ;
   fprintf( stdout , "[INT] Integration range %e -> %e\n" ,
@@ -0,0 +1,387 @@
+/**
+   @file dual.c
+   @brief forward-mode automatic differentiation with truncated taylor numbers
+
+   A model is written once with the AD_* arithmetic of dual.h and
+   instantiated for doubles and for dual numbers. The value, gradient
+   and hessian w.r.t. the fit parameters come out of a single
+   evaluation of the dual one, the double one is for when only the
+   value is wanted. The ad_* routines at the bottom wrap these into
+   the F/dF/d2F calling convention of the fit_descriptor
+ */
+#include "gens.h"
+
+#include "bessel.h"
+#include "dual.h"
+
+// index into the packed upper triangle, assumes i <= j
+size_t
+dual_hidx( const size_t i , const size_t j , const size_t Np )
+{
+  return i * ( 2 * Np - i + 1 ) / 2 + ( j - i ) ;
+}
+
+// number of hessian entries we need to touch
+static inline size_t
+Nhess( const struct dual a )
+{
+  return a.Np * ( a.Np + 1 ) / 2 ;
+}
+
+// a constant has no derivatives
+struct dual
+dual_const( const double c , const size_t Np , const int order )
+{
+  struct dual a ;
+  a.v = c ; a.Np = Np ; a.order = order ;
+  if( order > 0 ) {
+    memset( a.d , 0 , Np * sizeof( double ) ) ;
+  }
+  if( order > 1 ) {
+    memset( a.h , 0 , Nhess( a ) * sizeof( double ) ) ;
+  }
+  return a ;
+}
+
+// independent variable number idx
+struct dual
+dual_var( const double x , const size_t idx ,
+	  const size_t Np , const int order )
+{
+  struct dual a = dual_const( x , Np , order ) ;
+  if( order > 0 ) {
+    a.d[ idx ] = 1.0 ;
+  }
+  return a ;
+}
+
+struct dual
+dual_add( const struct dual a , const struct dual b )
+{
+  struct dual c = a ;
+  size_t i ;
+  c.v += b.v ;
+  if( a.order > 0 ) {
+    for( i = 0 ; i < a.Np ; i++ ) {
+      c.d[i] += b.d[i] ;
+    }
+  }
+  if( a.order > 1 ) {
+    for( i = 0 ; i < Nhess( a ) ; i++ ) {
+      c.h[i] += b.h[i] ;
+    }
+  }
+  return c ;
+}
+
+struct dual
+dual_sub( const struct dual a , const struct dual b )
+{
+  struct dual c = a ;
+  size_t i ;
+  c.v -= b.v ;
+  if( a.order > 0 ) {
+    for( i = 0 ; i < a.Np ; i++ ) {
+      c.d[i] -= b.d[i] ;
+    }
+  }
+  if( a.order > 1 ) {
+    for( i = 0 ; i < Nhess( a ) ; i++ ) {
+      c.h[i] -= b.h[i] ;
+    }
+  }
+  return c ;
+}
+
+// product rule (ab)'' = a''b + 2a'b' + ab''
+struct dual
+dual_mul( const struct dual a , const struct dual b )
+{
+  struct dual c ;
+  size_t i , j , k = 0 ;
+  c.v = a.v * b.v ; c.Np = a.Np ; c.order = a.order ;
+  if( a.order > 0 ) {
+    for( i = 0 ; i < a.Np ; i++ ) {
+      c.d[i] = a.v * b.d[i] + b.v * a.d[i] ;
+    }
+  }
+  if( a.order > 1 ) {
+    for( i = 0 ; i < a.Np ; i++ ) {
+      for( j = i ; j < a.Np ; j++ ) {
+	c.h[k] = a.v * b.h[k] + b.v * a.h[k] +
+	  a.d[i] * b.d[j] + a.d[j] * b.d[i] ;
+	k++ ;
+      }
+    }
+  }
+  return c ;
+}
+
+struct dual
+dual_div( const struct dual a , const struct dual b )
+{
+  return dual_mul( a , dual_inv( b ) ) ;
+}
+
+struct dual
+dual_scale( const struct dual a , const double s )
+{
+  struct dual c = a ;
+  size_t i ;
+  c.v *= s ;
+  if( a.order > 0 ) {
+    for( i = 0 ; i < a.Np ; i++ ) {
+      c.d[i] *= s ;
+    }
+  }
+  if( a.order > 1 ) {
+    for( i = 0 ; i < Nhess( a ) ; i++ ) {
+      c.h[i] *= s ;
+    }
+  }
+  return c ;
+}
+
+struct dual
+dual_shift( const struct dual a , const double s )
+{
+  struct dual c = a ;
+  c.v += s ;
+  return c ;
+}
+
+// chain rule for a scalar function g where we provide g(a), g'(a), g''(a)
+struct dual
+dual_chain( const struct dual a , const double g ,
+	    const double dg , const double d2g )
+{
+  struct dual c ;
+  size_t i , j , k = 0 ;
+  c.v = g ; c.Np = a.Np ; c.order = a.order ;
+  if( a.order > 0 ) {
+    for( i = 0 ; i < a.Np ; i++ ) {
+      c.d[i] = dg * a.d[i] ;
+    }
+  }
+  if( a.order > 1 ) {
+    for( i = 0 ; i < a.Np ; i++ ) {
+      for( j = i ; j < a.Np ; j++ ) {
+	c.h[k] = dg * a.h[k] + d2g * a.d[i] * a.d[j] ;
+	k++ ;
+      }
+    }
+  }
+  return c ;
+}
+
+struct dual
+dual_inv( const struct dual a )
+{
+  const double ia = 1.0 / a.v ;
+  return dual_chain( a , ia , -ia*ia , 2*ia*ia*ia ) ;
+}
+
+struct dual
+dual_exp( const struct dual a )
+{
+  const double e = exp( a.v ) ;
+  return dual_chain( a , e , e , e ) ;
+}
+
+struct dual
+dual_log( const struct dual a )
+{
+  const double ia = 1.0 / a.v ;
+  return dual_chain( a , log( a.v ) , ia , -ia*ia ) ;
+}
+
+struct dual
+dual_sqrt( const struct dual a )
+{
+  const double s = sqrt( a.v ) ;
+  return dual_chain( a , s , 0.5/s , -0.25/( s * a.v ) ) ;
+}
+
+struct dual
+dual_pow( const struct dual a , const double c )
+{
+  const double pm2 = pow( a.v , c - 2 ) ;
+  return dual_chain( a , pm2 * a.v * a.v , c * pm2 * a.v , c * ( c - 1 ) * pm2 ) ;
+}
+
+struct dual
+dual_cosh( const struct dual a )
+{
+  const double ch = cosh( a.v ) ;
+  return dual_chain( a , ch , sinh( a.v ) , ch ) ;
+}
+
+struct dual
+dual_sinh( const struct dual a )
+{
+  const double sh = sinh( a.v ) ;
+  return dual_chain( a , sh , cosh( a.v ) , sh ) ;
+}
+
+struct dual
+dual_tanh( const struct dual a )
+{
+  const double th = tanh( a.v ) , sech2 = 1 - th*th ;
+  return dual_chain( a , th , sech2 , -2*th*sech2 ) ;
+}
+
+// K0' = -K1 , K0'' = K0 + K1/x
+struct dual
+dual_bessel_K0( const struct dual a )
+{
+  double k0 , k1 ;
+  bessel_K01_array( &k0 , &k1 , &a.v , 1 , false ) ;
+  return dual_chain( a , k0 , -k1 , k0 + k1/a.v ) ;
+}
+
+// K1' = -K0 - K1/x , K1'' = K1 + K0/x + 2K1/x^2
+struct dual
+dual_bessel_K1( const struct dual a )
+{
+  double k0 , k1 ;
+  bessel_K01_array( &k0 , &k1 , &a.v , 1 , false ) ;
+  const double ix = 1.0/a.v ;
+  return dual_chain( a , k1 , -k0 - k1*ix , k1 + k0*ix + 2*k1*ix*ix ) ;
+}
+
+// evaluate a dual model at one point with the local parameters p
+struct dual
+ad_point( const dual_func func ,
+	  const struct x_desc X ,
+	  const double *p ,
+	  const size_t Npars ,
+	  const size_t Np ,
+	  const int order )
+{
+  // init_fit refuses these, so this is a model passing the wrong Np
+  if( Np > NDUAL ) {
+    fprintf( stderr , "[AD] %zu parameters exceeds NDUAL %d\n" ,
+	     Np , NDUAL ) ;
+    exit(1) ;
+  }
+  struct dual P[ Np ] ;
+  size_t j ;
+  for( j = 0 ; j < Np ; j++ ) {
+    P[j] = dual_var( p[j] , j , Np , order ) ;
+  }
+  return func( X , P , Npars ) ;
+}
+
+// the d2f array is indexed by the logical parameters which the data
+// struct does not carry, so we infer it from the parameter map
+size_t
+ad_nlogic( const struct data *DATA )
+{
+  size_t i , j , Nlogic = 0 ;
+  for( i = 0 ; i < DATA -> n ; i++ ) {
+    for( j = 0 ; j < DATA -> Npars ; j++ ) {
+      if( DATA -> map[i].p[j] + 1 > Nlogic ) {
+	Nlogic = DATA -> map[i].p[j] + 1 ;
+      }
+    }
+  }
+  return Nlogic ;
+}
+
+// poke the result at data index i into whichever of f, df, d2f we have
+void
+ad_set_point( double *f ,
+	      double **df ,
+	      double **d2f ,
+	      const struct data *DATA ,
+	      const size_t i ,
+	      const size_t Nlogic ,
+	      const struct dual res )
+{
+  size_t j , k ;
+  if( f != NULL ) {
+    f[i] = res.v - DATA -> y[i] ;
+  }
+  if( df != NULL ) {
+    for( j = 0 ; j < DATA -> Npars ; j++ ) {
+      df[ DATA -> map[i].p[j] ][i] = res.d[j] ;
+    }
+  }
+  if( d2f != NULL ) {
+    for( j = 0 ; j < DATA -> Npars ; j++ ) {
+      const size_t pj = DATA -> map[i].p[j] ;
+      for( k = j ; k < DATA -> Npars ; k++ ) {
+	const size_t pk = DATA -> map[i].p[k] ;
+	const double hjk = res.h[ dual_hidx( j , k , DATA -> Npars ) ] ;
+	d2f[ pk + Nlogic * pj ][i] = d2f[ pj + Nlogic * pk ][i] = hjk ;
+      }
+    }
+  }
+  return ;
+}
+
+// one pass over the data filling f, df and d2f if they are not NULL
+void
+ad_fdf( double *f ,
+	double **df ,
+	double **d2f ,
+	const void *data ,
+	const double *fparams ,
+	const dual_func func )
+{
+  const struct data *DATA = (const struct data*)data ;
+  const int order = ( d2f != NULL ) ? 2 : ( df != NULL ) ? 1 : 0 ;
+  const size_t Nlogic = ( d2f != NULL ) ? ad_nlogic( DATA ) : 0 ;
+  size_t i , j ;
+  for( i = 0 ; i < DATA -> n ; i++ ) {
+    double p[ DATA -> Npars ] ;
+    for( j = 0 ; j < DATA -> Npars ; j++ ) {
+      p[ j ] = fparams[ DATA -> map[ i ].p[ j ] ] ;
+    }
+    const struct x_desc X = { DATA -> x[i] , DATA -> LT[i] ,
+			      DATA -> N , DATA -> M , DATA -> Ctx } ;
+    const struct dual res = ad_point( func , X , p , DATA -> Npars ,
+				      DATA -> Npars , order ) ;
+    ad_set_point( f , df , d2f , DATA , i , Nlogic , res ) ;
+  }
+  return ;
+}
+
+// the value alone does not need duals, the plain model is much cheaper
+void
+ad_f( double *f ,
+      const void *data ,
+      const double *fparams ,
+      const scalar_func func )
+{
+  const struct data *DATA = (const struct data*)data ;
+  size_t i , j ;
+  for( i = 0 ; i < DATA -> n ; i++ ) {
+    double p[ DATA -> Npars ] ;
+    for( j = 0 ; j < DATA -> Npars ; j++ ) {
+      p[ j ] = fparams[ DATA -> map[ i ].p[ j ] ] ;
+    }
+    const struct x_desc X = { DATA -> x[i] , DATA -> LT[i] ,
+			      DATA -> N , DATA -> M , DATA -> Ctx } ;
+    f[i] = func( X , p , DATA -> Npars ) - DATA -> y[i] ;
+  }
+  return ;
+}
+
+void
+ad_df( double **df ,
+       const void *data ,
+       const double *fparams ,
+       const dual_func func )
+{
+  ad_fdf( NULL , df , NULL , data , fparams , func ) ;
+}
+
+void
+ad_d2f( double **d2f ,
+	const void *data ,
+	const double *fparams ,
+	const dual_func func )
+{
+  ad_fdf( NULL , NULL , d2f , data , fparams , func ) ;
+}
@@ -7,6 +7,9 @@
 
 #include <string.h>
 
+#include "ffunction.h"
+#include "profile.h"
+
 // allocate the fit function
 struct ffunction
 allocate_ffunction( const size_t NPARAMS ,
@@ -35,6 +38,10 @@ allocate_ffunction( const size_t NPARAMS ,
   for( i = 0 ; i < NDATA ; i++ ) {
     f.U[i] = calloc( NPARAMS , sizeof( double ) ) ;
   }
+  // evaluation cache starts empty
+  f.cache_params = calloc( NPARAMS , sizeof( double ) ) ;
+  f.cache_data = NULL ;
+  f.cache = FCACHE_NONE ;
   return f ;
 }
 
@@ -48,6 +55,8 @@ copy_ffunction( struct ffunction *f1 ,
   f1 -> NPARAMS = f.NPARAMS ;
   f1 -> CORRFIT = f.CORRFIT ;
   f1 -> Prior = f.Prior ;
+  // f1's arrays no longer match whatever it had cached
+  f1 -> cache = FCACHE_NONE ;
   // copy the data
   for( i = 0 ; i < f.N ; i++ ) {
     f1 -> f[i] = f.f[i] ;
@@ -85,6 +94,7 @@ free_ffunction( struct ffunction *f ,
   }
   free( f -> U ) ;
 
+  free( f -> cache_params ) ;
   free( f -> fparams ) ;
   free( f -> f ) ;
   free( f -> df ) ;
@@ -92,3 +102,95 @@ free_ffunction( struct ffunction *f ,
 
   return ;
 }
+
+// forget whatever was cached, e.g. when the data changes underneath us
+void
+invalidate_ffunction( struct ffunction *f )
+{
+  f -> cache = FCACHE_NONE ;
+  f -> cache_data = NULL ;
+}
+
+// is what we want already sitting in f's arrays?
+static bool
+is_cached( const struct ffunction *f ,
+	   const void *data ,
+	   const int want )
+{
+  if( ( f -> cache & want ) != want || f -> cache_data != data ) {
+    return false ;
+  }
+  return memcmp( f -> cache_params , f -> fparams ,
+		 f -> NPARAMS * sizeof( double ) ) == 0 ;
+}
+
+// record that the arrays in f are now valid at f -> fparams
+static void
+set_cached( struct ffunction *f ,
+	    const void *data ,
+	    const int have )
+{
+  // if the key is unchanged we keep what was there before
+  if( f -> cache_data == data &&
+      memcmp( f -> cache_params , f -> fparams ,
+	      f -> NPARAMS * sizeof( double ) ) == 0 ) {
+    f -> cache |= have ;
+  } else {
+    memcpy( f -> cache_params , f -> fparams ,
+	    f -> NPARAMS * sizeof( double ) ) ;
+    f -> cache_data = data ;
+    f -> cache = have ;
+  }
+}
+
+// evaluate f at f -> fparams, if the model has a single pass FdF
+// we also fill the derivatives up to order so that the following
+// cached_dF and cached_d2F calls at the same parameters are free
+void
+cached_F( const struct fit_descriptor *Fit ,
+	  struct ffunction *f ,
+	  const void *data ,
+	  const int order )
+{
+  if( is_cached( f , data , FCACHE_F ) ) return ;
+  PROF_COUNT( PROF_FEVALS , 1 ) ;
+  if( Fit -> FdF != NULL ) {
+    Fit -> FdF( f -> f ,
+		order > 0 ? f -> df : NULL ,
+		order > 1 ? f -> d2f : NULL ,
+		data , f -> fparams ) ;
+    set_cached( f , data , FCACHE_F |
+		( order > 0 ? FCACHE_DF : FCACHE_NONE ) |
+		( order > 1 ? FCACHE_D2F : FCACHE_NONE ) ) ;
+  } else {
+    Fit -> F( f -> f , data , f -> fparams ) ;
+    set_cached( f , data , FCACHE_F ) ;
+  }
+  return ;
+}
+
+// first derivatives at f -> fparams
+void
+cached_dF( const struct fit_descriptor *Fit ,
+	   struct ffunction *f ,
+	   const void *data )
+{
+  if( is_cached( f , data , FCACHE_DF ) ) return ;
+  PROF_COUNT( PROF_FEVALS , 1 ) ;
+  Fit -> dF( f -> df , data , f -> fparams ) ;
+  set_cached( f , data , FCACHE_DF ) ;
+  return ;
+}
+
+// second derivatives at f -> fparams
+void
+cached_d2F( const struct fit_descriptor *Fit ,
+	    struct ffunction *f ,
+	    const void *data )
+{
+  if( is_cached( f , data , FCACHE_D2F ) ) return ;
+  PROF_COUNT( PROF_FEVALS , 1 ) ;
+  Fit -> d2F( f -> d2f , data , f -> fparams ) ;
+  set_cached( f , data , FCACHE_D2F ) ;
+  return ;
+}
@@ -0,0 +1,252 @@
+/**
+   @file fv_bessel.c
+   @brief tabulated finite volume Bessel sums
+
+   The finite volume corrections of the chiral fits are sums of
+   K_n( \sqrt{r} x ) over the first twelve shells r = |n|^2 of the
+   integer lattice. They are smooth in x = mL once the exponential
+   decay of the first shell is taken out, so we tabulate
+   g(x) = e^x \sqrt{x} S(x) with piecewise Chebyshev polynomials. The
+   pieces are bisected until the interpolation agrees with the direct
+   sum to the requested relative tolerance at the points between the
+   nodes. Outside of [FV_XMIN,FV_XMAX], or if the tables have not been
+   initialised, we compute the sum directly
+ */
+#include "gens.h"
+
+#include "bessel.h"
+#include "fv_bessel.h"
+
+// chebyshev polynomials per piece
+#define NCHEB (16)
+
+// range of mL we tabulate
+#define FV_XMIN (1.0)
+#define FV_XMAX (64.0)
+
+// how many times we are allowed to bisect the initial pieces
+#define MAX_DEPTH (12)
+
+#define NSHELLS (12)
+
+// shells r = |n|^2 and how many lattice vectors they have, r=7 is empty
+static const double shell_r[ NSHELLS ] = { 1 , 2 , 3 , 4 , 5 , 6 ,
+					   8 , 9 , 10 , 11 , 12 , 13 } ;
+static const double shell_sr[ NSHELLS ] = {
+  1.0 , 1.4142135623730951 , 1.7320508075688772 , 2.0 ,
+  2.23606797749979 , 2.449489742783178 , 2.8284271247461903 , 3.0 ,
+  3.1622776601683795 , 3.3166247903554 , 3.4641016151377544 ,
+  3.605551275463989 } ;
+static const double shell_m[ NSHELLS ] = { 6 , 12 , 8 , 6 , 24 , 24 ,
+					   12 , 30 , 24 , 24 , 8 , 24 } ;
+
+struct cheb_piece {
+  double a , b ;
+  double c[ NCHEB ] ;
+} ;
+
+struct fv_table {
+  size_t Npieces ;
+  size_t Nalloc ;
+  struct cheb_piece *p ;
+  double maxerr ;
+} ;
+
+// Npieces == 0 means we have not been initialised
+static struct fv_table tables[ FV_NSUMS ] ;
+
+// the shell sum from K0 and K1 at all the shells at once, K2 comes from
+// the recurrence K2(y) = K0(y) + 2K1(y)/y. If scaled we include the
+// e^x \sqrt{x} factor that we tabulate
+static double
+shell_sum( const fv_sum s ,
+	   const double x ,
+	   const bool scaled )
+{
+  double y[ NSHELLS ] , K0[ NSHELLS ] , K1[ NSHELLS ] ;
+  register double sum = 0.0 ;
+  size_t i ;
+  for( i = 0 ; i < NSHELLS ; i++ ) {
+    y[i] = shell_sr[i]*x ;
+  }
+  bessel_K01_array( s != FV_K1 ? K0 : NULL , s != FV_K0 ? K1 : NULL ,
+		    y , NSHELLS , scaled ) ;
+  for( i = 0 ; i < NSHELLS ; i++ ) {
+    // scaled functions are e^{sr x}K(sr x) so we have to damp them back
+    const double damp = scaled ? exp( -( shell_sr[i] - 1 )*x ) : 1.0 ;
+    switch( s ) {
+    case FV_K0 : sum += shell_m[i]*damp*K0[i]/shell_sr[i] ; break ;
+    case FV_K1 : sum += shell_m[i]*damp*K1[i]/shell_sr[i] ; break ;
+    case FV_K2 : sum += shell_m[i]*damp*( K0[i] + 2*K1[i]/y[i] )/shell_r[i] ; break ;
+    default : return sqrt(-1) ;
+    }
+  }
+  return scaled ? sum*sqrt( x ) : sum ;
+}
+
+double
+fv_bessel_sum_direct( const fv_sum s ,
+		      const double x )
+{
+  return shell_sum( s , x , false ) ;
+}
+
+// the function we tabulate, e^x \sqrt{x} S(x) using the scaled
+// Bessel functions so that nothing underflows at large x
+static double
+scaled_sum( const fv_sum s ,
+	    const double x )
+{
+  return shell_sum( s , x , true ) ;
+}
+
+// chebyshev coefficients from the values at the roots of T_NCHEB, the
+// constant term is halved so that cheb_eval is a plain sum
+static void
+cheb_fit( struct cheb_piece *P ,
+	  const fv_sum s )
+{
+  const double mid = 0.5*( P -> b + P -> a ) , hw = 0.5*( P -> b - P -> a ) ;
+  double f[ NCHEB ] ;
+  size_t j , k ;
+  for( k = 0 ; k < NCHEB ; k++ ) {
+    f[k] = scaled_sum( s , mid + hw*cos( M_PI*( k + 0.5 )/NCHEB ) ) ;
+  }
+  for( j = 0 ; j < NCHEB ; j++ ) {
+    register double sum = 0.0 ;
+    for( k = 0 ; k < NCHEB ; k++ ) {
+      sum += f[k]*cos( M_PI*j*( k + 0.5 )/NCHEB ) ;
+    }
+    P -> c[j] = 2*sum/NCHEB ;
+  }
+  P -> c[0] *= 0.5 ;
+  return ;
+}
+
+// clenshaw recurrence
+static double
+cheb_eval( const struct cheb_piece *P ,
+	   const double x )
+{
+  const double t = ( 2*x - P -> a - P -> b )/( P -> b - P -> a ) ;
+  register double b1 = 0.0 , b2 = 0.0 , tmp ;
+  size_t j ;
+  for( j = NCHEB-1 ; j > 0 ; j-- ) {
+    tmp = 2*t*b1 - b2 + P -> c[j] ;
+    b2 = b1 ;
+    b1 = tmp ;
+  }
+  return t*b1 - b2 + P -> c[0] ;
+}
+
+// largest relative error at the extrema of T_NCHEB, which sit between
+// the nodes we fitted to and include the ends of the piece
+static double
+cheb_error( const struct cheb_piece *P ,
+	    const fv_sum s )
+{
+  const double mid = 0.5*( P -> b + P -> a ) , hw = 0.5*( P -> b - P -> a ) ;
+  double err = 0.0 ;
+  size_t k ;
+  for( k = 0 ; k <= NCHEB ; k++ ) {
+    const double x = mid + hw*cos( M_PI*k/NCHEB ) ;
+    const double f = scaled_sum( s , x ) ;
+    const double rel = fabs( cheb_eval( P , x ) - f )/fabs( f ) ;
+    if( !( rel <= err ) ) err = rel ;
+  }
+  return err ;
+}
+
+// fits [a,b], bisecting until we meet tol, pieces are appended in order
+static int
+build_pieces( struct fv_table *T ,
+	      const fv_sum s ,
+	      const double a ,
+	      const double b ,
+	      const double tol ,
+	      const size_t depth )
+{
+  struct cheb_piece P = { .a = a , .b = b } ;
+  cheb_fit( &P , s ) ;
+  const double err = cheb_error( &P , s ) ;
+  if( err > tol || !isfinite( err ) ) {
+    if( depth == MAX_DEPTH ) {
+      fprintf( stderr , "[FV_BESSEL] cannot reach %e on [%g,%g], got %e\n" ,
+	       tol , a , b , err ) ;
+      return FAILURE ;
+    }
+    const double m = 0.5*( a + b ) ;
+    if( build_pieces( T , s , a , m , tol , depth+1 ) == FAILURE ||
+	build_pieces( T , s , m , b , tol , depth+1 ) == FAILURE ) {
+      return FAILURE ;
+    }
+    return SUCCESS ;
+  }
+  if( T -> Npieces == T -> Nalloc ) {
+    T -> Nalloc = 2*T -> Nalloc + 8 ;
+    T -> p = realloc( T -> p , T -> Nalloc * sizeof( struct cheb_piece ) ) ;
+  }
+  T -> p[ T -> Npieces++ ] = P ;
+  if( err > T -> maxerr ) T -> maxerr = err ;
+  return SUCCESS ;
+}
+
+void
+free_fv_bessel( void )
+{
+  size_t s ;
+  for( s = 0 ; s < FV_NSUMS ; s++ ) {
+    free( tables[s].p ) ;
+    tables[s].p = NULL ;
+    tables[s].Npieces = tables[s].Nalloc = 0 ;
+    tables[s].maxerr = 0.0 ;
+  }
+  return ;
+}
+
+// not thread safe, call it before any parallel region uses the sums
+int
+init_fv_bessel( const double tol )
+{
+  const char *names[ FV_NSUMS ] = { "K0" , "K1" , "K2" } ;
+  free_fv_bessel() ;
+  size_t s ;
+  for( s = 0 ; s < FV_NSUMS ; s++ ) {
+    // octaves to start with as the sums vary most at small x
+    double a = FV_XMIN ;
+    int flag = SUCCESS ;
+    while( a < FV_XMAX && flag == SUCCESS ) {
+      flag = build_pieces( &tables[s] , s , a , 2*a , tol , 0 ) ;
+      a *= 2 ;
+    }
+    if( flag == FAILURE ) {
+      free_fv_bessel() ;
+      fprintf( stderr , "[FV_BESSEL] falling back to the direct sums\n" ) ;
+      return FAILURE ;
+    }
+    fprintf( stdout , "[FV_BESSEL] %s sum in %zu pieces, max rel err %e\n" ,
+	     names[s] , tables[s].Npieces , tables[s].maxerr ) ;
+  }
+  return SUCCESS ;
+}
+
+double
+fv_bessel_sum( const fv_sum s ,
+	       const double x )
+{
+  const struct fv_table *T = &tables[s] ;
+  if( T -> Npieces == 0 || !( x >= FV_XMIN && x <= FV_XMAX ) ) {
+    return fv_bessel_sum_direct( s , x ) ;
+  }
+  // bisect for the piece, they are contiguous and in order
+  size_t lo = 0 , hi = T -> Npieces - 1 ;
+  while( lo < hi ) {
+    const size_t mid = ( lo + hi + 1 )/2 ;
+    if( T -> p[ mid ].a <= x ) {
+      lo = mid ;
+    } else {
+      hi = mid - 1 ;
+    }
+  }
+  return cheb_eval( &T -> p[lo] , x )*exp( -x )/sqrt( x ) ;
+}
@@ -0,0 +1,320 @@
+/**
+   @file gkquad.c
+   @brief globally adaptive Gauss-Kronrod quadrature over many samples
+
+   The integrand is evaluated for all of the samples (bootstrap
+   parameter sets, say) at the same nodes, so one call of the user
+   function fills a whole batch of nodes x samples. The samples share
+   the subdivision of [a,b]: we keep a heap of intervals keyed on their
+   largest error over the samples and bisect the worst one, both halves
+   are evaluated in the same batch. The error estimate per interval is
+   the usual QUADPACK one from the embedded Gauss rule
+ */
+#include "gens.h"
+
+#include <float.h>
+
+#include "gkquad.h"
+
+// default limit on the number of intervals for the scalar version
+#define GK_MAXINT (1000)
+
+// largest number of points in a rule
+#define GK_MAXPTS (21)
+
+// positive abscissae and weights of the Kronrod rules, the last
+// abscissa is the centre and the Gauss nodes are the odd entries
+static const double xgk15[ 8 ] = {
+  0.991455371120812639206854697526329 , 0.949107912342758524526189684047851 ,
+  0.864864423359769072789712788640926 , 0.741531185599394439863864773280788 ,
+  0.586087235467691130294144845693013 , 0.405845151377397166906606412076961 ,
+  0.207784955007898467600689403773245 , 0.000000000000000000000000000000000 } ;
+static const double wgk15[ 8 ] = {
+  0.022935322010529224963732008058970 , 0.063092092629978553290700663189204 ,
+  0.104790010322250183839876322541518 , 0.140653259715525918745189590510238 ,
+  0.169004726639267902826583426598550 , 0.190350578064785409913256402421014 ,
+  0.204432940075298892414161999234649 , 0.209482141084727828012999174891714 } ;
+static const double wg7[ 4 ] = {
+  0.129484966168869693270611432679082 , 0.279705391489276667901467771423780 ,
+  0.381830050505118944950369775488975 , 0.417959183673469387755102040816327 } ;
+
+static const double xgk21[ 11 ] = {
+  0.995657163025808080735527280689003 , 0.973906528517171720077964012084452 ,
+  0.930157491355708226001207180059508 , 0.865063366688984510732096688423493 ,
+  0.780817726586416897063717578345042 , 0.679409568299024406234327365114874 ,
+  0.562757134668604683339000099272694 , 0.433395394129247190799265943165784 ,
+  0.294392862701460198131126603103866 , 0.148874338981631210884826001129720 ,
+  0.000000000000000000000000000000000 } ;
+static const double wgk21[ 11 ] = {
+  0.011694638867371874278064396062192 , 0.032558162307964727478818972459390 ,
+  0.054755896574351996031381300244580 , 0.075039674810919952767043140916190 ,
+  0.093125454583697605535065465083366 , 0.109387158802297641899210590325805 ,
+  0.123491976262065851077208067535520 , 0.134709217311473325928054001771707 ,
+  0.142775938577060080797094273138717 , 0.147739104901338491374841515972068 ,
+  0.149445554002916905664936468389821 } ;
+static const double wg10[ 5 ] = {
+  0.066671344308688137593568809893332 , 0.149451349150580593145776339657697 ,
+  0.219086362515982043995534934228163 , 0.269266719309996355091226921569469 ,
+  0.295524224714752870173892994651338 } ;
+
+// the rule on [-1,1] written out in full, wg is zero at the Kronrod
+// only nodes so that both sums are plain dot products
+struct gk_table {
+  size_t N ;
+  double t[ GK_MAXPTS ] , wk[ GK_MAXPTS ] , wg[ GK_MAXPTS ] ;
+} ;
+
+struct gk_interval {
+  double a , b ;
+  double key ;
+} ;
+
+static void
+expand_rule( struct gk_table *T ,
+	     const gk_rule rule )
+{
+  const double *xgk = xgk15 , *wgk = wgk15 , *wg = wg7 ;
+  size_t Nk = 8 , i ;
+  if( rule == GK21 ) {
+    xgk = xgk21 ; wgk = wgk21 ; wg = wg10 ; Nk = 11 ;
+  }
+  T -> N = 2*Nk-1 ;
+  for( i = 0 ; i < T -> N ; i++ ) {
+    const size_t j = i < Nk ? i : 2*Nk-2-i ;
+    T -> t[i]  = i < Nk ? -xgk[j] : xgk[j] ;
+    T -> wk[i] = wgk[j] ;
+    T -> wg[i] = ( j&1 ) ? wg[j/2] : 0.0 ;
+  }
+  return ;
+}
+
+// applies the rule to the values f on [a,b], QUADPACK's error estimate
+static void
+apply_rule( double *res ,
+	    double *err ,
+	    const struct gk_table *T ,
+	    const double *f ,
+	    const double a ,
+	    const double b )
+{
+  const double h = 0.5*( b - a ) ;
+  register double resk = 0.0 , resg = 0.0 , resabs = 0.0 , resasc = 0.0 ;
+  size_t i ;
+  for( i = 0 ; i < T -> N ; i++ ) {
+    resk   += T -> wk[i]*f[i] ;
+    resg   += T -> wg[i]*f[i] ;
+    resabs += T -> wk[i]*fabs( f[i] ) ;
+  }
+  const double mean = 0.5*resk ;
+  for( i = 0 ; i < T -> N ; i++ ) {
+    resasc += T -> wk[i]*fabs( f[i] - mean ) ;
+  }
+  *res = resk*h ;
+  resasc *= fabs( h ) ;
+  resabs *= fabs( h ) ;
+  double e = fabs( ( resk - resg )*h ) ;
+  if( resasc != 0.0 && e != 0.0 ) {
+    const double r = pow( 200*e/resasc , 1.5 ) ;
+    e = resasc*( r < 1 ? r : 1 ) ;
+  }
+  if( resabs > DBL_MIN/( 50*DBL_EPSILON ) ) {
+    const double r = 50*DBL_EPSILON*resabs ;
+    e = r > e ? r : e ;
+  }
+  *err = e ;
+  return ;
+}
+
+// evaluates the Nb intervals iv[ id[j] ] in one call of f and sets
+// their results, errors and keys
+static void
+eval_intervals( struct gk_interval *iv ,
+		double *ires ,
+		double *ierr ,
+		const size_t *id ,
+		const size_t Nb ,
+		const struct gk_table *T ,
+		const gk_func f ,
+		void *args ,
+		const size_t Nsamples ,
+		double *x ,
+		double *fx )
+{
+  const size_t Nx = Nb*T -> N ;
+  size_t j , i , k ;
+  for( j = 0 ; j < Nb ; j++ ) {
+    const double c = 0.5*( iv[ id[j] ].a + iv[ id[j] ].b ) ;
+    const double h = 0.5*( iv[ id[j] ].b - iv[ id[j] ].a ) ;
+    for( i = 0 ; i < T -> N ; i++ ) {
+      x[ i + j*T -> N ] = c + h*T -> t[i] ;
+    }
+  }
+  f( fx , x , Nx , Nsamples , args ) ;
+  for( j = 0 ; j < Nb ; j++ ) {
+    double key = 0.0 ;
+    for( k = 0 ; k < Nsamples ; k++ ) {
+      double *r = ires + id[j]*Nsamples + k , *e = ierr + id[j]*Nsamples + k ;
+      apply_rule( r , e , T , fx + k*Nx + j*T -> N ,
+		  iv[ id[j] ].a , iv[ id[j] ].b ) ;
+      // samples that have gone bad do not steer the subdivision
+      if( *e > key ) key = *e ;
+    }
+    iv[ id[j] ].key = key ;
+  }
+  return ;
+}
+
+// max-heap of interval indices on their key
+static void
+heap_push( size_t *heap ,
+	   size_t *Nheap ,
+	   const struct gk_interval *iv ,
+	   const size_t id )
+{
+  size_t c = ( *Nheap )++ ;
+  while( c > 0 ) {
+    const size_t p = ( c - 1 )/2 ;
+    if( iv[ heap[p] ].key >= iv[ id ].key ) break ;
+    heap[c] = heap[p] ;
+    c = p ;
+  }
+  heap[c] = id ;
+  return ;
+}
+
+static size_t
+heap_pop( size_t *heap ,
+	  size_t *Nheap ,
+	  const struct gk_interval *iv )
+{
+  const size_t top = heap[0] , last = heap[ --( *Nheap ) ] ;
+  size_t p = 0 ;
+  for( ;; ) {
+    size_t c = 2*p + 1 ;
+    if( c >= *Nheap ) break ;
+    if( c+1 < *Nheap && iv[ heap[c+1] ].key > iv[ heap[c] ].key ) c++ ;
+    if( iv[ last ].key >= iv[ heap[c] ].key ) break ;
+    heap[p] = heap[c] ;
+    p = c ;
+  }
+  heap[p] = last ;
+  return top ;
+}
+
+static bool
+converged( const double *tres ,
+	   const double *terr ,
+	   const size_t Nsamples ,
+	   const double epsabs ,
+	   const double epsrel )
+{
+  size_t k ;
+  for( k = 0 ; k < Nsamples ; k++ ) {
+    const double tol = epsrel*fabs( tres[k] ) ;
+    if( isfinite( tres[k] ) && terr[k] > ( tol > epsabs ? tol : epsabs ) ) {
+      return false ;
+    }
+  }
+  return true ;
+}
+
+int
+gk_integrate_samples( double *res ,
+		      double *err ,
+		      const gk_func f ,
+		      void *args ,
+		      const size_t Nsamples ,
+		      const double a ,
+		      const double b ,
+		      const double epsabs ,
+		      const double epsrel ,
+		      const size_t max_intervals ,
+		      const gk_rule rule )
+{
+  struct gk_table T ;
+  expand_rule( &T , rule ) ;
+
+  const size_t Nmax = max_intervals > 0 ? max_intervals : 1 ;
+  struct gk_interval *iv = malloc( Nmax*sizeof( struct gk_interval ) ) ;
+  size_t *heap = malloc( Nmax*sizeof( size_t ) ) ;
+  double *ires = malloc( Nmax*Nsamples*sizeof( double ) ) ;
+  double *ierr = malloc( Nmax*Nsamples*sizeof( double ) ) ;
+  double *tres = malloc( Nsamples*sizeof( double ) ) ;
+  double *terr = malloc( Nsamples*sizeof( double ) ) ;
+  double *x    = malloc( 2*T.N*sizeof( double ) ) ;
+  double *fx   = malloc( 2*T.N*Nsamples*sizeof( double ) ) ;
+
+  int flag = SUCCESS ;
+  size_t Nint = 1 , Nheap = 0 , id[2] = { 0 , 0 } , j , k ;
+
+  iv[0].a = a ; iv[0].b = b ;
+  eval_intervals( iv , ires , ierr , id , 1 , &T , f , args , Nsamples , x , fx ) ;
+  heap_push( heap , &Nheap , iv , 0 ) ;
+  for( k = 0 ; k < Nsamples ; k++ ) {
+    tres[k] = ires[k] ;
+    terr[k] = ierr[k] ;
+  }
+
+  while( !converged( tres , terr , Nsamples , epsabs , epsrel ) ) {
+    if( Nint == Nmax ) {
+      fprintf( stderr , "[GKQUAD] hit the limit of %zu intervals\n" , Nmax ) ;
+      flag = FAILURE ;
+      break ;
+    }
+    // bisect the worst interval, the left half reuses its slot
+    const size_t p = heap_pop( heap , &Nheap , iv ) ;
+    const double lo = iv[p].a , hi = iv[p].b , mid = 0.5*( lo + hi ) ;
+    if( !( mid > lo && mid < hi ) ) {
+      fprintf( stderr , "[GKQUAD] interval [%e,%e] cannot be bisected\n" ,
+	       lo , hi ) ;
+      flag = FAILURE ;
+      break ;
+    }
+    for( k = 0 ; k < Nsamples ; k++ ) {
+      tres[k] -= ires[ p*Nsamples + k ] ;
+      terr[k] -= ierr[ p*Nsamples + k ] ;
+    }
+    id[0] = p ; id[1] = Nint++ ;
+    iv[ id[0] ].a = lo  ; iv[ id[0] ].b = mid ;
+    iv[ id[1] ].a = mid ; iv[ id[1] ].b = hi ;
+    eval_intervals( iv , ires , ierr , id , 2 , &T , f , args , Nsamples , x , fx ) ;
+    for( j = 0 ; j < 2 ; j++ ) {
+      for( k = 0 ; k < Nsamples ; k++ ) {
+	tres[k] += ires[ id[j]*Nsamples + k ] ;
+	terr[k] += ierr[ id[j]*Nsamples + k ] ;
+      }
+      heap_push( heap , &Nheap , iv , id[j] ) ;
+    }
+  }
+
+  // sum up again rather than trusting the running totals
+  for( k = 0 ; k < Nsamples ; k++ ) {
+    register double sr = 0.0 , se = 0.0 ;
+    for( j = 0 ; j < Nint ; j++ ) {
+      sr += ires[ j*Nsamples + k ] ;
+      se += ierr[ j*Nsamples + k ] ;
+    }
+    if( res != NULL ) res[k] = sr ;
+    if( err != NULL ) err[k] = se ;
+  }
+
+  free( iv ) ; free( heap ) ; free( ires ) ; free( ierr ) ;
+  free( tres ) ; free( terr ) ; free( x ) ; free( fx ) ;
+
+  return flag ;
+}
+
+double
+gk_integrate( const gk_func f ,
+	      void *args ,
+	      const double a ,
+	      const double b ,
+	      const double epsabs ,
+	      const double epsrel ,
+	      const gk_rule rule )
+{
+  double res ;
+  gk_integrate_samples( &res , NULL , f , args , 1 , a , b ,
+			epsabs , epsrel , GK_MAXINT , rule ) ;
+  return res ;
+}
@@ -37,70 +37,72 @@ static const double fac[169] = { 1.000000e+00 , 1.000000e+00 , 2.000000e+00 , 6.
 2.006344e+269 , 3.089770e+271 , 4.789143e+273 , 7.471063e+275 , 1.172957e+278 , 1.853272e+280 , 2.946702e+282 , 4.714724e+284 , 
 7.590705e+286 , 1.229694e+289 , 2.004402e+291 , 3.287219e+293 , 5.423911e+295 , 9.003692e+297 , 1.503617e+300 , 2.526076e+302 };
 
+// quadrature weights for the laplace transform, the derivatives are
+// then linear in the data so they can all be done in one pass
+static void
+quad_weights( double *w ,
+	      const double *x ,
+	      const size_t N )
+{
+  size_t j ;
+  for( j = 0 ; j < N ; j++ ) {
+    w[j] = 0.0 ;
+  }
 #ifdef TRAP_DLDP
-// compute the coefficients using the trapezoid rule
+  // trapezoid rule
+  for( j = 0 ; j+1 < N ; j++ ) {
+    w[j]   += ( x[j+1] - x[j] ) / 2. ;
+    w[j+1] += ( x[j+1] - x[j] ) / 2. ;
+  }
+#else
+  // simpson's rule
+  for( j = 1 ; j < N/2 ; j++ ) {
+    w[ 2*j-2 ] += 1./3. ;
+    w[ 2*j-1 ] += 4./3. ;
+    w[ 2*j ]   += 1./3. ;
+  }
+#endif
+}
+
+// derivatives d^n L(p)/dp^n / n! at each of the Np expansion points,
+// d[ n + Nders*p ], reading the correlator once
 static void
 dLdp( double *d ,
       const size_t Nders ,
       const double *x ,
       const double *y ,
       const size_t N ,
-      const double p0 )
+      const double *p0 ,
+      const size_t Np )
 {
-  double epx[ N ] ;
-  size_t i , j ;
-  // initialise the exponential factors and the powers of t
-  for( i = 0 ; i < N ; i++ ) {
-    epx[ i ] = exp( -p0 * x[i] ) * y[i] ;
-  }
-  for( i = 0 ; i < Nders ; i++ ) {
+  double w[ N ] ;
+  size_t i , j , p ;
+  quad_weights( w , x , N ) ;
+  for( i = 0 ; i < Nders*Np ; i++ ) {
     d[i] = 0.0 ;
-    for( j = 0 ; j < N-1 ; j++ ) {
-      d[i] += ( epx[j+1] + epx[j] ) * ( x[j+1] - x[j] ) ;
-      epx[j] *= -x[j] ;
-    }
-    epx[j] *= -x[j] ;
-    d[i] /= ( 2. * fac[i] ) ;
-    #ifdef VERBOSE
-    printf( "D[ %zu ] %e %e \n" , i , d[i] , fac[i] ) ;
-    #endif
   }
-  return ;
-}
-#else
-// compute the coefficients using simpson's rule
-static void
-dLdp_simp( double *d ,
-	   const size_t Nders ,
-	   const double *x ,
-	   const double *y ,
-	   const size_t N ,
-	   const double p0 )
-{
-  double epx[ N ] ;
-  size_t i , j ;
-  // initialise the exponential factors and the powers of t
-  for( i = 0 ; i < N ; i++ ) {
-    epx[ i ] = exp( -p0 * x[i] ) * y[i] ;
-  }
-  for( i = 0 ; i < Nders ; i++ ) {
-    // perform the integration
-    d[i] = 0.0 ;
-    for( j = 1 ; j < N/2 ; j++ ) {
-      d[i] += ( epx[ 2*j - 2 ] + 4*epx[ 2*j-1 ] + epx[ 2*j ] ) ;
+  for( j = 0 ; j < N ; j++ ) {
+    const double wy = w[j] * y[j] ;
+    if( wy == 0.0 ) continue ;
+    for( p = 0 ; p < Np ; p++ ) {
+      double *dp = d + Nders*p ;
+      register double epx = wy * exp( -p0[p] * x[j] ) ;
+      for( i = 0 ; i < Nders ; i++ ) {
+	dp[i] += epx ;
+	epx *= -x[j] ;
+      }
     }
-    // update the t-factors
-    for( j = 0 ; j < N ; j++ ) {
-      epx[j] *= -x[j] ;
+  }
+  for( p = 0 ; p < Np ; p++ ) {
+    for( i = 0 ; i < Nders ; i++ ) {
+      d[ i + Nders*p ] /= fac[i] ;
+      #ifdef VERBOSE
+      printf( "D[ %zu ] %e %e \n" , i , d[ i + Nders*p ] , fac[i] ) ;
+      #endif
     }
-    d[i] /= ( 3. * fac[i] ) ;
-    #ifdef VERBOSE
-    printf( "D[ %zu ] %e %e \n" , i , d[i] , fac[i] ) ;
-    #endif
   }
   return ;
 }
-#endif
 
 // qsort comparison
 static int 
@@ -279,30 +281,20 @@ get_amplitudes( double *Amps ,
   return SUCCESS ;
 }
 
-int
-pade_laplace( double *fparams ,
-	      const double *x ,
-	      const double *y ,
-	      const size_t Ndata ,
-	      const size_t Nexps ,
-	      const double p0 )
+// masses from the poles of the pade and amplitudes by SVD
+static int
+poles_and_amplitudes( double *fparams ,
+		      const double *d ,
+		      const double *x ,
+		      const double *y ,
+		      const size_t Ndata ,
+		      const size_t Nexps ,
+		      const double p0 )
 {
-  const size_t Nders = 4 * ( (Nexps + 8) ) + 1 ;
-  if( Nders > 169 ) {
-    fprintf( stderr , "[PLAP] too many exps for our simple measurement\n" ) ;
-    return FAILURE ;
-  }
-  
-  double *d = malloc( Nders * sizeof( double ) ) ;
   double Masses[ Nexps ] , Amps[ Nexps ] ;
   size_t i ;
 
-  // compute the derivatives of the amplitudes
-  //dLdp( d , Nders , x , y , Ndata , p0 ) ;
-  dLdp_simp( d , Nders , x , y , Ndata , p0 ) ;
-  
   // get the poles of the pade representation
-  int Flag = SUCCESS ;
   size_t Trials = Nexps , Nbest = 0 ;
   for( Trials = Nexps ; Trials < Nexps + 8 ; Trials++ ) {
     double Mtrials[ Trials ] ;
@@ -321,20 +313,61 @@ pade_laplace( double *fparams ,
       }
     }
   }
-  if( Flag == FAILURE ) goto free ;
-  
+
   // compute the amplitudes from the masses
-  Flag = get_amplitudes( Amps , x , y , Ndata , Masses , Nexps ) ;
-  if( Flag == FAILURE ) goto free ;
-  
+  const int Flag = get_amplitudes( Amps , x , y , Ndata , Masses , Nexps ) ;
+  if( Flag == FAILURE ) return Flag ;
+
   // set the fit parameters
   for( i = 0 ; i < Nexps ; i++ ) {
     fparams[ 2*i + 0 ] = Amps[ i ] ;
     fparams[ 2*i + 1 ] = Masses[ i ] ;
   }
+  return Flag ;
+}
+
+// pade-laplace at each of the Np expansion points p0, fparams[p] are
+// left alone for any that fail
+int
+pade_laplace_scan( double **fparams ,
+		   const double *x ,
+		   const double *y ,
+		   const size_t Ndata ,
+		   const size_t Nexps ,
+		   const double *p0 ,
+		   const size_t Np )
+{
+  const size_t Nders = 4 * ( (Nexps + 8) ) + 1 ;
+  if( Nders > 169 ) {
+    fprintf( stderr , "[PLAP] too many exps for our simple measurement\n" ) ;
+    return FAILURE ;
+  }
+
+  double *d = malloc( Nders * Np * sizeof( double ) ) ;
+  size_t p ;
+  int Flag = SUCCESS ;
 
- free :
+  // compute the derivatives of the amplitudes
+  dLdp( d , Nders , x , y , Ndata , p0 , Np ) ;
+
+  for( p = 0 ; p < Np ; p++ ) {
+    if( poles_and_amplitudes( fparams[p] , d + Nders*p , x , y ,
+			      Ndata , Nexps , p0[p] ) == FAILURE ) {
+      Flag = FAILURE ;
+    }
+  }
   free( d ) ;
 
   return Flag ;
 }
+
+int
+pade_laplace( double *fparams ,
+	      const double *x ,
+	      const double *y ,
+	      const size_t Ndata ,
+	      const size_t Nexps ,
+	      const double p0 )
+{
+  return pade_laplace_scan( &fparams , x , y , Ndata , Nexps , &p0 , 1 ) ;
+}
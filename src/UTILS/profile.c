@@ -0,0 +1,256 @@
+/**
+   @file profile.c
+   @brief lightweight timers, counters and peak memory
+
+   Only called through the macros in profile.h, which are empty unless
+   we configure with --enable-PROFILE. Timers are for the coarse stages
+   of a run and take a critical section. Counters can be hit from inside
+   parallel regions so each thread claims its own cache-line padded slot
+   the first time it counts something, the slots are summed when the
+   JSON summary is written at exit
+ */
+#include "gens.h"
+
+#include <inttypes.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "profile.h"
+
+#define PROF_MAXTIMERS (64)
+#define PROF_MAXTAGS (16)
+
+// threads past this share the last slot and can lose counts
+#define PROF_MAXTHREADS (256)
+
+// counters per slot rounded up to a 64 byte cache line
+#define PROF_STRIDE ( 8*( ( PROF_NCOUNTERS + 7 )/8 ) )
+
+static const char *counter_names[ PROF_NCOUNTERS ] = {
+  "files_opened" , "bytes_read" , "fits" , "lm_iterations" ,
+  "function_evaluations" , "compute_err" } ;
+
+struct prof_timer {
+  const char *name ;
+  size_t calls ;
+  double total ;
+  double start ;
+  long rss_kb ;
+  bool running ;
+} ;
+
+struct prof_tag {
+  const char *key ;
+  long val ;
+} ;
+
+static struct prof_timer timers[ PROF_MAXTIMERS ] ;
+static size_t Ntimers = 0 ;
+
+static struct prof_tag tags[ PROF_MAXTAGS ] ;
+static size_t Ntags = 0 ;
+
+static uint64_t counters[ PROF_MAXTHREADS ][ PROF_STRIDE ]
+__attribute__((aligned(64))) ;
+static size_t Nslots = 0 ;
+
+// 1-based so that zero means this thread has not claimed one yet
+static __thread size_t myslot = 0 ;
+
+static double t0 = 0.0 ;
+
+static double
+now( void )
+{
+  struct timespec t ;
+  clock_gettime( CLOCK_MONOTONIC , &t ) ;
+  return t.tv_sec + 1E-9*t.tv_nsec ;
+}
+
+// peak resident set size in kB as linux reports it
+static long
+peak_rss( void )
+{
+  struct rusage r ;
+  if( getrusage( RUSAGE_SELF , &r ) != 0 ) return -1 ;
+  return r.ru_maxrss ;
+}
+
+static uint64_t *
+thread_counters( void )
+{
+  if( myslot == 0 ) {
+    size_t s ;
+    #pragma omp atomic capture
+    s = ++Nslots ;
+    myslot = s < PROF_MAXTHREADS ? s : PROF_MAXTHREADS ;
+  }
+  return counters[ myslot - 1 ] ;
+}
+
+// writes a string with the characters JSON cares about escaped
+static void
+json_string( FILE *out ,
+	     const char *s )
+{
+  fputc( '"' , out ) ;
+  for( ; *s != '\0' ; s++ ) {
+    if( *s == '"' || *s == '\\' ) {
+      fputc( '\\' , out ) ;
+      fputc( *s , out ) ;
+    } else if( (unsigned char)*s < 0x20 ) {
+      fprintf( out , "\\u%04x" , (unsigned char)*s ) ;
+    } else {
+      fputc( *s , out ) ;
+    }
+  }
+  fputc( '"' , out ) ;
+  return ;
+}
+
+static void
+prof_write( void )
+{
+  const char *path = getenv( "URFIT_PROFILE_JSON" ) ;
+  if( path == NULL ) path = "urfit_profile.json" ;
+
+  FILE *out = fopen( path , "w" ) ;
+  if( out == NULL ) {
+    fprintf( stderr , "[PROFILE] cannot open %s\n" , path ) ;
+    return ;
+  }
+  const double tend = now() ;
+  const size_t Nused = Nslots < PROF_MAXTHREADS ? Nslots : PROF_MAXTHREADS ;
+  size_t i , j ;
+
+  fprintf( out , "{\n  \"wall_seconds\": %.6f,\n" , tend - t0 ) ;
+  fprintf( out , "  \"peak_rss_kb\": %ld,\n" , peak_rss() ) ;
+  fprintf( out , "  \"threads\": %zu,\n" , Nslots ) ;
+
+  fprintf( out , "  \"tags\": {" ) ;
+  for( i = 0 ; i < Ntags ; i++ ) {
+    fprintf( out , "%s\n    " , i ? "," : "" ) ;
+    json_string( out , tags[i].key ) ;
+    fprintf( out , ": %ld" , tags[i].val ) ;
+  }
+  fprintf( out , "%s},\n" , Ntags ? "\n  " : "" ) ;
+
+  fprintf( out , "  \"stages\": [" ) ;
+  for( i = 0 ; i < Ntimers ; i++ ) {
+    const struct prof_timer T = timers[i] ;
+    const double total = T.running ? T.total + ( tend - T.start ) : T.total ;
+    fprintf( out , "%s\n    { \"name\": " , i ? "," : "" ) ;
+    json_string( out , T.name ) ;
+    fprintf( out , ", \"calls\": %zu, \"seconds\": %.6f, "
+	     "\"peak_rss_kb\": %ld, \"complete\": %s }" ,
+	     T.calls , total , T.rss_kb , T.running ? "false" : "true" ) ;
+  }
+  fprintf( out , "%s],\n" , Ntimers ? "\n  " : "" ) ;
+
+  fprintf( out , "  \"counters\": {" ) ;
+  for( j = 0 ; j < PROF_NCOUNTERS ; j++ ) {
+    uint64_t sum = 0 ;
+    for( i = 0 ; i < Nused ; i++ ) {
+      sum += counters[i][j] ;
+    }
+    fprintf( out , "%s\n    \"%s\": %" PRIu64 , j ? "," : "" ,
+	     counter_names[j] , sum ) ;
+  }
+  fprintf( out , "\n  },\n" ) ;
+
+  fprintf( out , "  \"per_thread\": [" ) ;
+  for( i = 0 ; i < Nused ; i++ ) {
+    fprintf( out , "%s\n    [" , i ? "," : "" ) ;
+    for( j = 0 ; j < PROF_NCOUNTERS ; j++ ) {
+      fprintf( out , "%s%" PRIu64 , j ? ", " : " " , counters[i][j] ) ;
+    }
+    fprintf( out , " ]" ) ;
+  }
+  fprintf( out , "%s]\n}\n" , Nused ? "\n  " : "" ) ;
+
+  fclose( out ) ;
+  fprintf( stdout , "[PROFILE] summary written to %s\n" , path ) ;
+  return ;
+}
+
+void
+prof_init( void )
+{
+  t0 = now() ;
+  if( atexit( prof_write ) != 0 ) {
+    fprintf( stderr , "[PROFILE] could not register the summary\n" ) ;
+  }
+  return ;
+}
+
+size_t
+prof_timer_start( const char *name )
+{
+  size_t i ;
+  #pragma omp critical (prof_timers)
+  {
+    for( i = 0 ; i < Ntimers ; i++ ) {
+      if( strcmp( timers[i].name , name ) == 0 ) break ;
+    }
+    if( i == Ntimers && Ntimers < PROF_MAXTIMERS ) {
+      timers[ Ntimers++ ] = (struct prof_timer){ .name = name } ;
+    }
+    if( i < Ntimers ) {
+      timers[i].running = true ;
+      timers[i].start = now() ;
+    }
+  }
+  return i ;
+}
+
+void
+prof_timer_stop( const size_t idx )
+{
+  if( idx >= PROF_MAXTIMERS ) return ;
+  const double t = now() ;
+  const long rss = peak_rss() ;
+  #pragma omp critical (prof_timers)
+  {
+    timers[idx].total += t - timers[idx].start ;
+    timers[idx].calls++ ;
+    timers[idx].rss_kb = rss ;
+    timers[idx].running = false ;
+  }
+  return ;
+}
+
+void
+prof_count( const prof_counter c ,
+	    const size_t n )
+{
+  thread_counters()[c] += n ;
+  return ;
+}
+
+void
+prof_file( FILE *file )
+{
+  uint64_t *C = thread_counters() ;
+  const long pos = ftell( file ) ;
+  C[ PROF_FILES ]++ ;
+  if( pos > 0 ) C[ PROF_BYTES ] += (uint64_t)pos ;
+  return ;
+}
+
+void
+prof_tag( const char *key ,
+	  const long val )
+{
+  size_t i ;
+  #pragma omp critical (prof_timers)
+  {
+    for( i = 0 ; i < Ntags ; i++ ) {
+      if( strcmp( tags[i].key , key ) == 0 ) break ;
+    }
+    if( i < PROF_MAXTAGS ) {
+      tags[i] = (struct prof_tag){ .key = key , .val = val } ;
+      if( i == Ntags ) Ntags++ ;
+    }
+  }
+  return ;
+}